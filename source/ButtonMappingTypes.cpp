@@ -47,6 +47,7 @@ QString ButtonMappingHelper::actionToInternalKey(InternalControllerAction action
         case InternalControllerAction::ToggleTouchGestures: return "toggle_touch_gestures";
         case InternalControllerAction::PreviousPage: return "previous_page";
         case InternalControllerAction::NextPage: return "next_page";
+        case InternalControllerAction::ToggleSearch: return "toggle_search";
     }
     return "none";
 }
@@ -95,6 +96,7 @@ InternalControllerAction ButtonMappingHelper::internalKeyToAction(const QString
     if (key == "toggle_touch_gestures") return InternalControllerAction::ToggleTouchGestures;
     if (key == "previous_page") return InternalControllerAction::PreviousPage;
     if (key == "next_page") return InternalControllerAction::NextPage;
+    if (key == "toggle_search") return InternalControllerAction::ToggleSearch;
     return InternalControllerAction::None;
 }
 
@@ -143,7 +145,8 @@ QStringList ButtonMappingHelper::getTranslatedActions() {
         tr("Add/Remove Bookmark"),
         tr("Toggle Touch Gestures"),
         tr("Previous Page"),
-        tr("Next Page")
+        tr("Next Page"),
+        tr("Search PDF Text")
     };
 }
 
@@ -208,7 +211,8 @@ QStringList ButtonMappingHelper::getInternalActionKeys() {
         "add_bookmark",
         "toggle_touch_gestures",
         "previous_page",
-        "next_page"
+        "next_page",
+        "toggle_search"
     };
 }
 
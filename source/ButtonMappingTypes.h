@@ -48,7 +48,8 @@ enum class InternalControllerAction {
     AddBookmark,         // New: Add/remove current page bookmark
     ToggleTouchGestures, // New: Toggle touch gestures
     PreviousPage,        // New: Go to previous page
-    NextPage             // New: Go to next page
+    NextPage,            // New: Go to next page
+    ToggleSearch         // New: Toggle PDF text search sidebar
 };
 
 class ButtonMappingHelper {
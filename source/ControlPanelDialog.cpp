@@ -91,9 +91,15 @@ void ControlPanelDialog::createBackgroundTab() {
     densitySpin->setSuffix(" px");
     densitySpin->setSingleStep(5);
     
-    // PDF inversion checkbox
-    pdfInversionCheckbox = new QCheckBox(tr("Invert PDF Colors (Dark Mode)"), this);
-    QLabel *pdfInversionNote = new QLabel(tr("Inverts PDF colors for better readability in dark mode. Useful for PDFs with light backgrounds."), this);
+    // PDF display filter (dark mode inversion, sepia, contrast, grayscale)
+    QLabel *pdfFilterLabel = new QLabel(tr("PDF Colors:"));
+    pdfFilterCombo = new QComboBox(this);
+    pdfFilterCombo->addItem(tr("Original"), static_cast<int>(PdfDisplayFilter::None));
+    pdfFilterCombo->addItem(tr("Inverted (Dark Mode)"), static_cast<int>(PdfDisplayFilter::Invert));
+    pdfFilterCombo->addItem(tr("Sepia"), static_cast<int>(PdfDisplayFilter::Sepia));
+    pdfFilterCombo->addItem(tr("High Contrast"), static_cast<int>(PdfDisplayFilter::HighContrast));
+    pdfFilterCombo->addItem(tr("Grayscale"), static_cast<int>(PdfDisplayFilter::Grayscale));
+    QLabel *pdfInversionNote = new QLabel(tr("Changes how PDF pages are displayed. Inverted colors improve readability in dark mode for PDFs with light backgrounds."), this);
     pdfInversionNote->setWordWrap(true);
     pdfInversionNote->setStyleSheet("color: gray; font-size: 10px;");
 
@@ -104,7 +110,8 @@ void ControlPanelDialog::createBackgroundTab() {
     layout->addWidget(colorButton, 1, 1);
     layout->addWidget(densityLabel, 2, 0);
     layout->addWidget(densitySpin, 2, 1);
-    layout->addWidget(pdfInversionCheckbox, 3, 0, 1, 2);
+    layout->addWidget(pdfFilterLabel, 3, 0);
+    layout->addWidget(pdfFilterCombo, 3, 1);
     layout->addWidget(pdfInversionNote, 4, 0, 1, 2);
     // layout->setColumnStretch(1, 1); // Stretch the second column
     layout->setRowStretch(5, 1); // Stretch the last row
@@ -128,7 +135,7 @@ void ControlPanelDialog::applyChanges() {
     canvas->setBackgroundStyle(style);
     canvas->setBackgroundColor(selectedColor);
     canvas->setBackgroundDensity(densitySpin->value());
-    canvas->setPdfInversionEnabled(pdfInversionCheckbox->isChecked());
+    canvas->setPdfDisplayFilter(static_cast<PdfDisplayFilter>(pdfFilterCombo->currentData().toInt()));
     canvas->update();
     canvas->saveBackgroundMetadata();
 
@@ -183,7 +190,8 @@ void ControlPanelDialog::loadFromCanvas() {
     styleCombo->setCurrentIndex(static_cast<int>(canvas->getBackgroundStyle()));
     densitySpin->setValue(canvas->getBackgroundDensity());
     selectedColor = canvas->getBackgroundColor();
-    pdfInversionCheckbox->setChecked(canvas->isPdfInversionEnabled());
+    int filterIndex = pdfFilterCombo->findData(static_cast<int>(canvas->getPdfDisplayFilter()));
+    pdfFilterCombo->setCurrentIndex(filterIndex >= 0 ? filterIndex : 0);
 
     colorButton->setStyleSheet(QString("background-color: %1").arg(selectedColor.name()));
 
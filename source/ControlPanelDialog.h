@@ -46,7 +46,7 @@ private:
     QComboBox *styleCombo;
     QPushButton *colorButton;
     QSpinBox *densitySpin;
-    QCheckBox *pdfInversionCheckbox;
+    QComboBox *pdfFilterCombo;
 
     QPushButton *applyButton;
     QPushButton *okButton;
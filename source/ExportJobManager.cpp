@@ -0,0 +1,547 @@
+#include "ExportJobManager.h"
+#include "PdfIncrementalWriter.h"
+#include "PdfFileMapping.h"
+#include "InkPageIndex.h"
+#include "InkStrokeStore.h"
+#include "SpnPackageManager.h"
+#include "SpnPackageReader.h"
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSettings>
+#include <QMap>
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+
+namespace {
+
+const char *JOB_FILE_NAME = "job.json";
+
+QJsonArray intArray(const QList<int> &values)
+{
+    QJsonArray array;
+    for (int value : values) array.append(value);
+    return array;
+}
+
+QList<int> intList(const QJsonArray &array)
+{
+    QList<int> values;
+    for (const QJsonValue &value : array) values.append(value.toInt());
+    return values;
+}
+
+// Copies a file keeping its modification time, which the ink index and stroke files use as a stamp
+bool copyWithTimestamp(const QString &source, const QString &target)
+{
+    if (!QFile::exists(source)) return true;
+    QFile::remove(target);
+    if (!QFile::copy(source, target)) return false;
+    QFile copied(target);
+    if (copied.open(QIODevice::ReadWrite)) {
+        copied.setFileTime(QFileInfo(source).lastModified(), QFileDevice::FileModificationTime);
+    }
+    return true;
+}
+
+} // namespace
+
+ExportJobManager* ExportJobManager::instance = nullptr;
+
+ExportJobManager::ExportJobManager(QObject *parent)
+    : QObject(parent)
+{
+    progressTimer.setInterval(250);
+    connect(&progressTimer, &QTimer::timeout, this, [this]() {
+        if (queue.isEmpty() || !running) return;
+        Entry &current = queue.first();
+        const int written = running->progress.pagesWritten;
+        const int pageCount = running->pageCount;
+        if (current.pagesWritten != written || current.pageCount != pageCount) {
+            current.pagesWritten = written;
+            current.pageCount = pageCount;
+            emit progressChanged(current.id, written, pageCount);
+        }
+    });
+    connect(&runningWatcher, &QFutureWatcher<bool>::finished, this, &ExportJobManager::onJobDone);
+
+    // ✅ Quitting pauses the running job; its checkpoint is picked up on the next start
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &ExportJobManager::stopRunning);
+    }
+
+    loadPendingJobs();
+}
+
+ExportJobManager* ExportJobManager::getInstance(QObject *parent)
+{
+    if (!instance) {
+        instance = new ExportJobManager(parent);
+    }
+    return instance;
+}
+
+QString ExportJobManager::jobsFolder() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/export_jobs";
+}
+
+QString ExportJobManager::jobFolder(const QString &id) const
+{
+    return jobsFolder() + "/" + id;
+}
+
+void ExportJobManager::loadPendingJobs()
+{
+    // Folder names are creation timestamps, so sorting them restores the queue order
+    const QStringList ids = QDir(jobsFolder()).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QString &id : ids) {
+        QFile jobFile(jobFolder(id) + "/" + JOB_FILE_NAME);
+        const QJsonObject object = jobFile.open(QIODevice::ReadOnly)
+                                       ? QJsonDocument::fromJson(jobFile.readAll()).object() : QJsonObject();
+        if (object.isEmpty() || object["outputPath"].toString().isEmpty()) {
+            QDir(jobFolder(id)).removeRecursively();
+            continue;
+        }
+
+        Entry entry;
+        entry.id = id;
+        entry.title = object["title"].toString();
+        entry.notebookPath = object["notebookPath"].toString();
+        entry.outputPath = object["outputPath"].toString();
+        entry.wholeDocument = object["wholeDocument"].toBool();
+        entry.job.pdfPath = object["pdfPath"].toString();
+        entry.job.saveFolder = object["saveFolder"].toString();
+        entry.job.notebookId = object["notebookId"].toString();
+        entry.job.pages = intList(object["pages"].toArray());
+        const QList<int> annotated = intList(object["annotatedPages"].toArray());
+        entry.job.annotatedPages = QSet<int>(annotated.begin(), annotated.end());
+        entry.job.dpi = object["dpi"].toInt(192);
+        entry.job.jobs = object["jobs"].toInt();
+        entry.job.profile.pageEncoding = PdfImageEncoder::Encoding(object["pageEncoding"].toInt());
+        entry.job.profile.inkEncoding = PdfImageEncoder::Encoding(object["inkEncoding"].toInt());
+        entry.job.profile.jpegQuality = object["jpegQuality"].toInt(85);
+        entry.job.profile.downsampleDpi = object["downsampleDpi"].toInt();
+        entry.job.profile.vectorInk = object["vectorInk"].toBool(true);
+        entry.job.checkpointFolder = jobFolder(id);
+        entry.pageCount = entry.job.pages.size();
+        queue.append(entry);
+    }
+
+    if (!queue.isEmpty()) {
+        qDebug() << "Resuming" << queue.size() << "queued PDF exports";
+        // Let the windows connect to the signals before anything is reported
+        QTimer::singleShot(0, this, &ExportJobManager::startNext);
+    }
+}
+
+bool ExportJobManager::saveEntry(const Entry &entry) const
+{
+    QJsonObject object;
+    object["title"] = entry.title;
+    object["notebookPath"] = entry.notebookPath;
+    object["outputPath"] = entry.outputPath;
+    object["wholeDocument"] = entry.wholeDocument;
+    object["pdfPath"] = entry.job.pdfPath;
+    object["saveFolder"] = entry.job.saveFolder;
+    object["notebookId"] = entry.job.notebookId;
+    object["pages"] = intArray(entry.job.pages);
+    QList<int> annotated = entry.job.annotatedPages.values();
+    std::sort(annotated.begin(), annotated.end());
+    object["annotatedPages"] = intArray(annotated);
+    object["dpi"] = entry.job.dpi;
+    object["jobs"] = entry.job.jobs;
+    object["pageEncoding"] = int(entry.job.profile.pageEncoding);
+    object["inkEncoding"] = int(entry.job.profile.inkEncoding);
+    object["jpegQuality"] = entry.job.profile.jpegQuality;
+    object["downsampleDpi"] = entry.job.profile.downsampleDpi;
+    object["vectorInk"] = entry.job.profile.vectorInk;
+
+    QSaveFile jobFile(jobFolder(entry.id) + "/" + JOB_FILE_NAME);
+    if (!jobFile.open(QIODevice::WriteOnly)) return false;
+    jobFile.write(QJsonDocument(object).toJson());
+    return jobFile.commit();
+}
+
+QString ExportJobManager::newJobId() const
+{
+    const QString stamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz");
+    QString id = stamp;
+    for (int suffix = 1; QDir(jobFolder(id)).exists(); ++suffix) {
+        id = stamp + QString("-%1").arg(suffix);
+    }
+    return id;
+}
+
+QString ExportJobManager::addEntry(Entry entry)
+{
+    entry.job.checkpointFolder = jobFolder(entry.id);
+    entry.pageCount = entry.job.pages.size();
+    if (!QDir().mkpath(jobFolder(entry.id)) || !saveEntry(entry)) {
+        // Still export; the job just won't survive a restart
+        qWarning() << "Failed to persist export job" << entry.id;
+    }
+
+    queue.append(entry);
+    emit jobsChanged();
+    startNext();
+    return entry.id;
+}
+
+QString ExportJobManager::enqueue(const PdfExportRenderer::Job &job, const QString &notebookPath,
+                                  const QString &outputPath, const QString &title, bool wholeDocument)
+{
+    Entry entry;
+    entry.id = newJobId();
+    entry.title = title;
+    entry.notebookPath = notebookPath;
+    entry.outputPath = outputPath;
+    entry.wholeDocument = wholeDocument;
+    entry.job = job;
+
+    // ✅ The open notebook's working folder goes away when its tab closes; the job keeps its own
+    // copy, taken on a worker (flushing the ink index and copying pages is too slow for the GUI thread)
+    const QString snapshot = jobFolder(entry.id) + "/notebook";
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    snapshotting.insert(entry.id, entry);
+    snapshotWatchers.insert(entry.id, watcher);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, id = entry.id]() {
+        finishSnapshot(id);
+    });
+    watcher->setFuture(QtConcurrent::run([job, snapshot]() {
+        return snapshotNotebook(job, snapshot);
+    }));
+    return entry.id;
+}
+
+void ExportJobManager::finishSnapshot(const QString &id)
+{
+    QFutureWatcher<bool> *watcher = snapshotWatchers.take(id);
+    if (!watcher) return; // Already handled by waitForSnapshots()
+    const bool copied = watcher->result();
+    watcher->deleteLater();
+
+    if (!snapshotting.contains(id)) {
+        QDir(jobFolder(id)).removeRecursively(); // Canceled while copying
+        return;
+    }
+    Entry entry = snapshotting.take(id);
+    if (!copied) {
+        QDir(jobFolder(id)).removeRecursively();
+        qWarning() << "Failed to copy notebook for export, reading it in place:" << entry.job.saveFolder;
+    } else {
+        entry.job.saveFolder = jobFolder(id) + "/notebook";
+    }
+    addEntry(entry);
+}
+
+void ExportJobManager::waitForSnapshots()
+{
+    if (!instance) return;
+    QStringList ids = instance->snapshotWatchers.keys();
+    ids.sort(); // Ids are creation timestamps: queue them in order
+    for (const QString &id : ids) {
+        instance->finishSnapshot(id);
+    }
+}
+
+bool ExportJobManager::snapshotNotebook(const PdfExportRenderer::Job &job, const QString &targetFolder)
+{
+    if (!QDir().mkpath(targetFolder)) return false;
+    InkPageIndex::flush(job.saveFolder);
+
+    // Only what the export reads: the ink of its pages, their strokes and the ink index
+    bool ok = copyWithTimestamp(job.saveFolder + "/" + InkPageIndex::INDEX_FILE_NAME,
+                                targetFolder + "/" + InkPageIndex::INDEX_FILE_NAME);
+    for (int pageNumber : job.pages) {
+        if (!job.pdfPath.isEmpty() && !job.annotatedPages.contains(pageNumber)) continue;
+        ok = ok && copyWithTimestamp(InkPageIndex::pageImagePath(job.saveFolder, job.notebookId, pageNumber),
+                                     InkPageIndex::pageImagePath(targetFolder, job.notebookId, pageNumber));
+        ok = ok && copyWithTimestamp(InkStrokeStore::strokeFilePath(job.saveFolder, job.notebookId, pageNumber),
+                                     InkStrokeStore::strokeFilePath(targetFolder, job.notebookId, pageNumber));
+    }
+    return ok;
+}
+
+QString ExportJobManager::enqueueNotebook(const QString &notebookPath, const QString &outputPath,
+                                          const PdfExportProfile &profile, QString *errorMsg)
+{
+    Entry entry;
+    entry.id = newJobId();
+    entry.title = QFileInfo(notebookPath).fileName();
+    entry.notebookPath = notebookPath;
+    entry.outputPath = outputPath;
+    entry.wholeDocument = true;
+
+    if (PdfExportRenderer::isSameFile(outputPath, notebookPath)) {
+        if (errorMsg) *errorMsg = tr("The output can't replace the notebook itself: %1").arg(outputPath);
+        return QString();
+    }
+
+    if (SpnPackageManager::isSpnPackage(notebookPath)) {
+        entry.title = QFileInfo(notebookPath).completeBaseName();
+    } else if (QFileInfo(notebookPath).isDir()) {
+        entry.job.saveFolder = notebookPath;
+    } else {
+        if (errorMsg) *errorMsg = tr("Not a notebook folder or .spn package: %1").arg(notebookPath);
+        return QString();
+    }
+
+    // No notebook id yet: runJob scans the notebook off the GUI thread
+    entry.job.dpi = QSettings("SpeedyNote", "App").value("pdfRenderDPI", 192).toInt();
+    entry.job.profile = profile;
+    return addEntry(entry);
+}
+
+void ExportJobManager::cancel(const QString &id)
+{
+    if (snapshotting.remove(id) > 0) {
+        return; // Its folder is removed once the copy finishes
+    }
+    if (id == runningId) {
+        // Dropped in onJobDone once the workers have stopped
+        if (running) {
+            running->canceledByUser = true;
+            running->progress.canceled = true;
+        }
+        return;
+    }
+    for (int i = 0; i < queue.size(); ++i) {
+        if (queue[i].id == id) {
+            removeJobFiles(queue.takeAt(i));
+            emit jobsChanged();
+            return;
+        }
+    }
+}
+
+void ExportJobManager::removeJobFiles(const Entry &entry)
+{
+    InkPageIndex::forgetFolder(jobFolder(entry.id) + "/notebook"); // Unpacked package, if any
+    QDir(jobFolder(entry.id)).removeRecursively();
+}
+
+QString ExportJobManager::statusText() const
+{
+    if (queue.isEmpty()) return QString();
+    const Entry &current = queue.first();
+    QString text = current.pageCount > 0
+        ? tr("Exporting %1: page %2 of %3").arg(current.title).arg(current.pagesWritten).arg(current.pageCount)
+        : tr("Preparing export of %1").arg(current.title);
+    if (queue.size() > 1) {
+        text += tr(" (%1 more queued)").arg(queue.size() - 1);
+    }
+    return text;
+}
+
+void ExportJobManager::startNext()
+{
+    if (!runningId.isEmpty() || queue.isEmpty() || shuttingDown) return;
+
+    const Entry entry = queue.first();
+    runningId = entry.id;
+    running = std::make_unique<RunningJob>();
+    running->pageCount = entry.pageCount;
+
+    RunningJob *state = running.get();
+    runningWatcher.setFuture(QtConcurrent::run([entry, state]() {
+        return runJob(entry, state);
+    }));
+    progressTimer.start();
+    emit jobsChanged();
+}
+
+void ExportJobManager::onJobDone()
+{
+    progressTimer.stop();
+    // When quitting the job stays on disk as it is, to be resumed on the next start
+    if (shuttingDown || queue.isEmpty() || queue.first().id != runningId) return;
+
+    const bool success = runningWatcher.result();
+    const Entry entry = queue.takeFirst();
+    const std::unique_ptr<RunningJob> finished = std::move(running);
+    runningId.clear();
+
+    // Finished, failed or canceled: a failing job would only fail again after a restart
+    removeJobFiles(entry);
+    if (!finished->canceledByUser) {
+        if (!success) {
+            qWarning() << "Background PDF export failed:" << entry.outputPath << finished->errorMsg;
+        }
+        emit jobFinished(entry.id, entry.outputPath, success, finished->errorMsg);
+    }
+    emit jobsChanged();
+    startNext();
+}
+
+void ExportJobManager::stopRunning()
+{
+    shuttingDown = true;
+    waitForSnapshots(); // Queued (not started) so they resume on the next start
+    if (running) {
+        running->progress.canceled = true;
+        runningWatcher.waitForFinished();
+    }
+}
+
+bool ExportJobManager::runJob(const Entry &entry, RunningJob *running)
+{
+    PdfExportRenderer::Progress *progress = &running->progress;
+    QString *errorMsg = &running->errorMsg;
+    PdfExportRenderer::Job job = entry.job;
+
+    // Packages are unpacked into the job folder, so a resumed job doesn't depend on the
+    // app's temp folder for them (which may be in use, or gone since the last session)
+    const QString unpacked = job.checkpointFolder + "/notebook";
+    if (!QFileInfo(job.saveFolder).isDir()) {
+        if (!QFileInfo(unpacked).isDir()) {
+            SpnPackageReader reader(entry.notebookPath);
+            if (!SpnPackageManager::isSpnPackage(entry.notebookPath) || !reader.isOpen() || !reader.extractTo(unpacked)) {
+                *errorMsg = QObject::tr("Notebook no longer available: %1").arg(entry.notebookPath);
+                return false;
+            }
+            InkPageIndex::adoptUnpackedFolder(unpacked);
+        }
+        job.saveFolder = unpacked;
+    }
+
+    // Notebooks queued from the launcher are scanned here rather than on the GUI thread
+    if (job.notebookId.isEmpty()) {
+        int totalPages = 0;
+        QString prepareError;
+        if (!prepareNotebookJob(job.saveFolder, -1, -1, job, totalPages, prepareError)) {
+            *errorMsg = QString("%1: %2").arg(entry.title, prepareError);
+            return false;
+        }
+    }
+    running->pageCount = job.pages.size();
+    if (progress->canceled) {
+        return false;
+    }
+
+    // Writing over the source would destroy it before (or while) it's read
+    if (!job.pdfPath.isEmpty() && PdfExportRenderer::isSameFile(entry.outputPath, job.pdfPath)) {
+        *errorMsg = QObject::tr("%1 is the notebook's own PDF, choose another output.").arg(entry.outputPath);
+        return false;
+    }
+
+    if (entry.wholeDocument && !job.pdfPath.isEmpty()) {
+        if (job.annotatedPages.isEmpty()) {
+            if (!PdfExportRenderer::copyFileAtomically(job.pdfPath, entry.outputPath)) {
+                *errorMsg = QObject::tr("Failed to copy original PDF.");
+                return false;
+            }
+            progress->pagesWritten = job.pages.size();
+            return true;
+        }
+
+        // Same fast path as the export button: ink appended to the original file
+        QList<int> overlayPages = job.annotatedPages.values();
+        std::sort(overlayPages.begin(), overlayPages.end());
+        QString overlayError;
+        if (PdfIncrementalWriter::writeInkOverlays(job.pdfPath, entry.outputPath, job.saveFolder, job.notebookId,
+                                                   overlayPages, job.profile, job.dpi, progress, &overlayError,
+                                                   nullptr, job.jobs)) {
+            progress->pagesWritten = job.pages.size();
+            return true;
+        }
+        if (progress->canceled) {
+            return false;
+        }
+        qWarning() << "In-place PDF export failed, rendering every page instead:" << overlayError;
+        progress->pagesWritten = 0;
+    }
+
+    return PdfExportRenderer::exportPdf(job, entry.outputPath, progress, errorMsg);
+}
+
+bool ExportJobManager::prepareNotebookJob(const QString &saveFolder, int firstPage, int lastPage,
+                                          PdfExportRenderer::Job &job, int &totalPages, QString &errorMsg)
+{
+    // Notebook id and PDF from the metadata, with the older text files as fallback
+    QString notebookId;
+    QString pdfPath;
+    QFile metadataFile(saveFolder + "/" + SpnPackageManager::METADATA_FILE_NAME);
+    if (metadataFile.open(QIODevice::ReadOnly)) {
+        const QJsonObject metadata = QJsonDocument::fromJson(metadataFile.readAll()).object();
+        notebookId = metadata["notebook_id"].toString();
+        pdfPath = metadata["pdf_path"].toString();
+    }
+    if (notebookId.isEmpty()) {
+        QFile idFile(saveFolder + "/.notebook_id.txt");
+        if (idFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            notebookId = QTextStream(&idFile).readLine().trimmed();
+        }
+    }
+    if (pdfPath.isEmpty()) {
+        QFile pdfPathFile(saveFolder + "/.pdf_path.txt");
+        if (pdfPathFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            pdfPath = QTextStream(&pdfPathFile).readLine().trimmed();
+        }
+    }
+    if (notebookId.isEmpty()) {
+        errorMsg = QObject::tr("notebook id not found");
+        return false;
+    }
+
+    job.saveFolder = saveFolder;
+    job.notebookId = notebookId;
+    job.pdfPath = pdfPath;
+    job.pages.clear();
+    job.annotatedPages.clear();
+
+    const bool wholeDocument = firstPage < 0;
+    if (!pdfPath.isEmpty()) {
+        PdfDocumentHandle pdf = PdfFileMapping::loadDocument(pdfPath);
+        if (!pdf || pdf.get()->isLocked()) {
+            errorMsg = QObject::tr("cannot open PDF %1").arg(pdfPath);
+            return false;
+        }
+        totalPages = pdf.get()->numPages();
+        const int first = wholeDocument ? 0 : firstPage;
+        const int last = wholeDocument ? totalPages - 1 : qMin(lastPage, totalPages - 1);
+        if (first > last) {
+            errorMsg = QObject::tr("page range is outside the document (%1 pages)").arg(totalPages);
+            return false;
+        }
+        for (int pageNum = first; pageNum <= last; ++pageNum) {
+            job.pages.append(pageNum);
+            if (InkPageIndex::pageHasInk(saveFolder, notebookId, pageNum)) {
+                job.annotatedPages.insert(pageNum);
+            }
+        }
+        InkPageIndex::flush(saveFolder); // Keep what the scan had to decode
+    } else {
+        // Canvas-only notebook: every saved page image, in page order
+        QMap<int, QString> pageFiles;
+        const QStringList pngFiles = QDir(saveFolder).entryList(QStringList() << QString("%1_*.png").arg(notebookId),
+                                                                QDir::Files, QDir::Name);
+        for (const QString &fileName : pngFiles) {
+            bool ok = false;
+            const int pageNum = fileName.mid(notebookId.length() + 1).chopped(4).toInt(&ok);
+            if (ok) pageFiles.insert(pageNum, fileName);
+        }
+        const QList<int> sortedPages = pageFiles.keys();
+        totalPages = sortedPages.size();
+        for (int i = 0; i < sortedPages.size(); ++i) {
+            if (wholeDocument || (i >= firstPage && i <= lastPage)) {
+                job.pages.append(sortedPages[i]);
+            }
+        }
+    }
+
+    if (job.pages.isEmpty()) {
+        errorMsg = QObject::tr("no pages to export");
+        return false;
+    }
+    return true;
+}
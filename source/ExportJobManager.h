@@ -0,0 +1,105 @@
+#ifndef EXPORTJOBMANAGER_H
+#define EXPORTJOBMANAGER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QTimer>
+#include <QMap>
+#include <QHash>
+#include <QFutureWatcher>
+#include <memory>
+#include "PdfExportRenderer.h"
+
+// Background PDF export queue shared by the launcher and every main window.
+//
+// Jobs run one at a time off the GUI thread. Each job has a folder under the
+// app data directory holding its description (job.json), the render checkpoint
+// and, for .spn notebooks, a private unpacked copy. Jobs stay there until they
+// finish or are canceled, so exports interrupted by quitting the app resume
+// from their last written page on the next start.
+class ExportJobManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry {
+        QString id;
+        QString title;              // Shown in progress displays
+        QString notebookPath;       // Folder or .spn the job was queued from
+        QString outputPath;
+        PdfExportRenderer::Job job;
+        bool wholeDocument = false; // Whole annotated PDF: try an incremental update first
+        int pagesWritten = 0;
+        int pageCount = 0;
+    };
+
+    static ExportJobManager* getInstance(QObject *parent = nullptr);
+
+    // Queue an export of a notebook's working folder (job.saveFolder) and return its id
+    QString enqueue(const PdfExportRenderer::Job &job, const QString &notebookPath, const QString &outputPath,
+                    const QString &title, bool wholeDocument = false);
+    // Queue a whole-notebook export of a folder or .spn package; the package is
+    // unpacked and scanned for ink by the job itself (empty id and errorMsg set on failure)
+    QString enqueueNotebook(const QString &notebookPath, const QString &outputPath, const PdfExportProfile &profile,
+                            QString *errorMsg = nullptr);
+    // Stop (if running) and drop a job along with its checkpoint
+    void cancel(const QString &id);
+    // Block until the notebook copies of just-queued jobs are taken; call before removing a working folder
+    static void waitForSnapshots();
+
+    QList<Entry> jobs() const { return queue; }
+    bool isBusy() const { return !queue.isEmpty(); }
+    QString statusText() const; // One line for progress displays
+
+    // Export job for a notebook folder: the PDF (empty for canvas-only
+    // notebooks), its pages in [firstPage, lastPage] (-1 = whole document) and
+    // which of them carry ink. Used by the queue and the command-line exporter.
+    static bool prepareNotebookJob(const QString &saveFolder, int firstPage, int lastPage,
+                                   PdfExportRenderer::Job &job, int &totalPages, QString &errorMsg);
+
+signals:
+    void jobsChanged();
+    void progressChanged(const QString &id, int pagesWritten, int pageCount);
+    void jobFinished(const QString &id, const QString &outputPath, bool success, const QString &errorMsg);
+
+private:
+    explicit ExportJobManager(QObject *parent = nullptr);
+
+    QString jobsFolder() const;
+    QString jobFolder(const QString &id) const;
+    QString newJobId() const; // Creation timestamp, so folder order is queue order
+    QString addEntry(Entry entry);
+    void loadPendingJobs();
+    bool saveEntry(const Entry &entry) const;
+    void removeJobFiles(const Entry &entry);
+    void startNext();
+    void onJobDone();
+    void stopRunning(); // Keeps the checkpoint
+
+    // Shared between the GUI thread and the job's worker
+    struct RunningJob {
+        PdfExportRenderer::Progress progress;
+        std::atomic<int> pageCount{0}; // Known once a queued notebook has been scanned
+        QString errorMsg;              // Read only after the job finished
+        bool canceledByUser = false;
+    };
+
+    static bool runJob(const Entry &entry, RunningJob *running);
+    // Copy the files a job reads out of the notebook's working folder
+    static bool snapshotNotebook(const PdfExportRenderer::Job &job, const QString &targetFolder);
+    void finishSnapshot(const QString &id); // Queues the job once its copy is taken
+
+    QList<Entry> queue;              // Running job first
+    QMap<QString, Entry> snapshotting; // Jobs whose notebook is being copied, by id (creation order)
+    QHash<QString, QFutureWatcher<bool>*> snapshotWatchers;
+    QString runningId;
+    std::unique_ptr<RunningJob> running;
+    QFutureWatcher<bool> runningWatcher;
+    bool shuttingDown = false;
+    QTimer progressTimer;            // Polls the running job's page counter
+
+    static ExportJobManager* instance;
+};
+
+#endif // EXPORTJOBMANAGER_H
@@ -0,0 +1,328 @@
+#include "HeadlessExporter.h"
+#include "PdfExportRenderer.h"
+#include "PdfIncrementalWriter.h"
+#include "ExportJobManager.h"
+#include "InkPageIndex.h"
+#include "SpnPackageManager.h"
+#include "SpnPackageReader.h"
+#include <QGuiApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QSettings>
+#include <QElapsedTimer>
+#include <cstdio>
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+
+void printLine(const QString &line)
+{
+    std::fputs(qPrintable(line + "\n"), stdout);
+    std::fflush(stdout);
+}
+
+void printError(const QString &line)
+{
+    std::fputs(qPrintable(line + "\n"), stderr);
+    std::fflush(stderr);
+}
+
+const char *USAGE =
+    "Usage:\n"
+    "  NoteApp --export <notebook folder|.spn> --out <file.pdf> [options]\n"
+    "  NoteApp --export-batch <output dir> <notebook|@listfile>... [options]\n"
+    "\n"
+    "  --pages a-b           Export pages a to b only (1-based, inclusive)\n"
+    "  --jobs N              Render or ink encoding workers (default: one per core)\n"
+    "  --profile NAME        lossless (default), balanced or compact\n"
+    "  --jpeg-quality N      JPEG quality of rendered PDF pages (1-100, implies JPEG)\n"
+    "  --ink MODE            Ink image encoding: color, indexed or mono\n"
+    "  --downsample DPI      Scale images above DPI down to it\n"
+    "  --raster-ink          Write ink as images even where strokes were recorded\n"
+    "  @listfile             Text file with one notebook path per line\n";
+
+} // namespace
+
+bool HeadlessExporter::isExportCommand(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray arg(argv[i]);
+        if (arg == "--export" || arg == "--export-batch") return true;
+    }
+    return false;
+}
+
+int HeadlessExporter::run(int argc, char *argv[])
+{
+#ifdef Q_OS_WIN
+    // GUI-subsystem executable: print to the console that started us, if any
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+#endif
+
+    // ✅ No window is ever shown, so don't require a display (CI machines, cron jobs)
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    Options options;
+    QString error;
+    if (!parseArguments(app.arguments().mid(1), options, error)) {
+        printError(error);
+        printError(QString::fromLatin1(USAGE));
+        return 2;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int failures = 0;
+    QSet<QString> usedOutputs;
+    for (const QString &notebook : options.notebooks) {
+        const QString outputPath = options.outputPath.isEmpty()
+            ? batchOutputPath(notebook, options.outputDir, usedOutputs) : options.outputPath;
+        if (!exportNotebook(notebook, outputPath, options)) {
+            ++failures;
+        }
+    }
+
+    if (options.notebooks.size() > 1) {
+        printLine(QString("Exported %1 of %2 notebooks in %3 s")
+                  .arg(options.notebooks.size() - failures).arg(options.notebooks.size())
+                  .arg(timer.elapsed() / 1000.0, 0, 'f', 1));
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+bool HeadlessExporter::parseArguments(const QStringList &args, Options &options, QString &error)
+{
+    bool batch = false;
+    // Individual encoding options override the profile whatever their order
+    QString profileName = "lossless";
+    QString inkMode;
+    int jpegQuality = -1;
+    int downsampleDpi = -1;
+    bool rasterInk = false;
+    for (int i = 0; i < args.size(); ++i) {
+        const QString &arg = args[i];
+        const bool hasValue = i + 1 < args.size();
+
+        if (arg == "--export" && hasValue) {
+            options.notebooks.append(args[++i]);
+        } else if (arg == "--export-batch" && hasValue) {
+            batch = true;
+            options.outputDir = args[++i];
+        } else if (arg == "--out" && hasValue) {
+            options.outputPath = args[++i];
+        } else if (arg == "--jobs" && hasValue) {
+            bool ok = false;
+            options.jobs = args[++i].toInt(&ok);
+            if (!ok || options.jobs < 1) {
+                error = QString("Invalid --jobs value: %1").arg(args[i]);
+                return false;
+            }
+        } else if (arg == "--profile" && hasValue) {
+            const QString name = args[++i];
+            if (!PdfExportProfile::presetNames().contains(name)) {
+                error = QString("Unknown --profile: %1").arg(name);
+                return false;
+            }
+            profileName = name;
+        } else if (arg == "--jpeg-quality" && hasValue) {
+            bool ok = false;
+            jpegQuality = args[++i].toInt(&ok);
+            if (!ok || jpegQuality < 1 || jpegQuality > 100) {
+                error = QString("Invalid --jpeg-quality value: %1").arg(args[i]);
+                return false;
+            }
+        } else if (arg == "--ink" && hasValue) {
+            inkMode = args[++i];
+            if (inkMode != "color" && inkMode != "indexed" && inkMode != "mono") {
+                error = QString("Unknown --ink mode: %1").arg(inkMode);
+                return false;
+            }
+        } else if (arg == "--downsample" && hasValue) {
+            bool ok = false;
+            downsampleDpi = args[++i].toInt(&ok);
+            if (!ok || downsampleDpi < 1) {
+                error = QString("Invalid --downsample value: %1").arg(args[i]);
+                return false;
+            }
+        } else if (arg == "--raster-ink") {
+            rasterInk = true;
+        } else if (arg == "--pages" && hasValue) {
+            const QString range = args[++i];
+            bool firstOk = false;
+            bool lastOk = false;
+            const int first = range.section('-', 0, 0).toInt(&firstOk);
+            const int last = range.contains('-') ? range.section('-', 1, 1).toInt(&lastOk) : first;
+            if (!range.contains('-')) lastOk = firstOk;
+            if (!firstOk || !lastOk || first < 1 || last < first) {
+                error = QString("Invalid --pages range: %1").arg(range);
+                return false;
+            }
+            options.firstPage = first - 1;
+            options.lastPage = last - 1;
+        } else if (batch && arg.startsWith('@')) {
+            QFile listFile(arg.mid(1));
+            if (!listFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                error = QString("Cannot read notebook list: %1").arg(arg.mid(1));
+                return false;
+            }
+            QTextStream in(&listFile);
+            while (!in.atEnd()) {
+                const QString line = in.readLine().trimmed();
+                if (!line.isEmpty() && !line.startsWith('#')) options.notebooks.append(line);
+            }
+        } else if (batch && !arg.startsWith("--")) {
+            options.notebooks.append(arg);
+        } else {
+            error = QString("Unknown or incomplete argument: %1").arg(arg);
+            return false;
+        }
+    }
+
+    if (options.notebooks.isEmpty()) {
+        error = "No notebook to export.";
+        return false;
+    }
+    if (!batch && options.outputPath.isEmpty()) {
+        error = "--export needs --out <file.pdf>.";
+        return false;
+    }
+    if (batch && !QDir().mkpath(options.outputDir)) {
+        error = QString("Cannot create output folder: %1").arg(options.outputDir);
+        return false;
+    }
+
+    options.profile = PdfExportProfile::preset(profileName);
+    if (jpegQuality > 0) {
+        options.profile.pageEncoding = PdfImageEncoder::Jpeg;
+        options.profile.jpegQuality = jpegQuality;
+    }
+    if (inkMode == "color") options.profile.inkEncoding = PdfImageEncoder::Flate;
+    else if (inkMode == "indexed") options.profile.inkEncoding = PdfImageEncoder::Indexed;
+    else if (inkMode == "mono") options.profile.inkEncoding = PdfImageEncoder::Monochrome;
+    if (downsampleDpi > 0) options.profile.downsampleDpi = downsampleDpi;
+    if (rasterInk) options.profile.vectorInk = false;
+    return true;
+}
+
+QString HeadlessExporter::batchOutputPath(const QString &notebookPath, const QString &outputDir,
+                                          QSet<QString> &usedPaths)
+{
+    QFileInfo info(notebookPath);
+    const QString baseName = notebookPath.endsWith(".spn", Qt::CaseInsensitive) ? info.completeBaseName()
+                                                                                  : info.fileName();
+    // Compared case-insensitively: notebooks named "Notes" and "notes" collide on Windows and macOS
+    QString path = QDir(outputDir).filePath(baseName + ".pdf");
+    for (int suffix = 2; usedPaths.contains(path.toLower()); ++suffix) {
+        path = QDir(outputDir).filePath(QString("%1_%2.pdf").arg(baseName).arg(suffix));
+    }
+    usedPaths.insert(path.toLower());
+    return path;
+}
+
+bool HeadlessExporter::exportNotebook(const QString &notebookPath, const QString &outputPath, const Options &options)
+{
+    if (SpnPackageManager::isSpnPackage(notebookPath)) {
+        // ✅ Unpack into a private folder: the app's own temp folder for this package may be in use
+        QTemporaryDir unpacked;
+        SpnPackageReader reader(notebookPath);
+        if (!unpacked.isValid() || !reader.isOpen() || !reader.extractTo(unpacked.path())) {
+            printError(QString("%1: cannot read package").arg(notebookPath));
+            return false;
+        }
+        reader.close();
+        InkPageIndex::adoptUnpackedFolder(unpacked.path());
+        const bool exported = exportFolder(notebookPath, unpacked.path(), outputPath, options);
+        InkPageIndex::forgetFolder(unpacked.path());
+        return exported;
+    }
+
+    if (!QFileInfo(notebookPath).isDir()) {
+        printError(QString("%1: not a notebook folder or .spn package").arg(notebookPath));
+        return false;
+    }
+    return exportFolder(notebookPath, notebookPath, outputPath, options);
+}
+
+bool HeadlessExporter::exportFolder(const QString &notebookPath, const QString &saveFolder, const QString &outputPath,
+                                    const Options &options)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    PdfExportRenderer::Job job;
+    int totalPages = 0;
+    QString prepareError;
+    if (!ExportJobManager::prepareNotebookJob(saveFolder, options.firstPage, options.lastPage, job, totalPages,
+                                              prepareError)) {
+        printError(QString("%1: %2").arg(notebookPath, prepareError));
+        return false;
+    }
+    job.jobs = options.jobs;
+    job.dpi = QSettings("SpeedyNote", "App").value("pdfRenderDPI", 192).toInt();
+    job.profile = options.profile;
+
+    if (!job.pdfPath.isEmpty() && PdfExportRenderer::isSameFile(outputPath, job.pdfPath)) {
+        printError(QString("%1: %2 is the notebook's own PDF, choose another output").arg(notebookPath, outputPath));
+        return false;
+    }
+
+    if (!job.pdfPath.isEmpty() && options.firstPage < 0) {
+        if (job.annotatedPages.isEmpty()) {
+            if (!PdfExportRenderer::copyFileAtomically(job.pdfPath, outputPath)) {
+                printError(QString("%1: failed to copy %2").arg(notebookPath, job.pdfPath));
+                return false;
+            }
+            printLine(QString("%1: no annotations, copied the original PDF -> %2").arg(notebookPath, outputPath));
+            return true;
+        }
+
+        // Same fast path as the export button: ink appended to the original file
+        QList<int> overlayPages = job.annotatedPages.values();
+        std::sort(overlayPages.begin(), overlayPages.end());
+        QString overlayError;
+        QList<PdfExportRenderer::PageTiming> overlayTimings;
+        if (PdfIncrementalWriter::writeInkOverlays(job.pdfPath, outputPath, saveFolder, job.notebookId,
+                                                   overlayPages, job.profile, job.dpi, nullptr, &overlayError,
+                                                   &overlayTimings, options.jobs)) {
+            for (const PdfExportRenderer::PageTiming &timing : std::as_const(overlayTimings)) {
+                printLine(QString("  page %1: ink encode %2 ms (in place)")
+                          .arg(timing.pageNumber + 1).arg(timing.encodeMs));
+            }
+            printLine(QString("%1: %2 annotated of %3 pages written in place in %4 ms -> %5")
+                      .arg(notebookPath).arg(overlayPages.size()).arg(totalPages)
+                      .arg(timer.elapsed()).arg(outputPath));
+            return true;
+        }
+        printError(QString("%1: %2 Rendering every page instead.").arg(notebookPath, overlayError));
+    }
+
+    QString error;
+    QList<PdfExportRenderer::PageTiming> timings;
+    if (!PdfExportRenderer::exportPdf(job, outputPath, nullptr, &error, &timings)) {
+        printError(QString("%1: %2").arg(notebookPath, error));
+        return false;
+    }
+
+    for (const PdfExportRenderer::PageTiming &timing : timings) {
+        printLine(QString("  page %1: render %2 ms, encode %3 ms, write %4 ms%5")
+                  .arg(timing.pageNumber + 1).arg(timing.renderMs).arg(timing.encodeMs).arg(timing.writeMs)
+                  .arg(job.annotatedPages.contains(timing.pageNumber) ? " (annotated)" : ""));
+    }
+    printLine(QString("%1: %2 pages in %3 ms on %4 workers -> %5")
+              .arg(notebookPath).arg(job.pages.size()).arg(timer.elapsed())
+              .arg(PdfExportRenderer::workerCount(job)).arg(outputPath));
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef HEADLESSEXPORTER_H
+#define HEADLESSEXPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include "PdfImageEncoder.h"
+
+// Command-line export without any window:
+//
+//   NoteApp --export <notebook folder|.spn> --out <pdf> [--pages a-b] [--jobs N] [--profile NAME]
+//   NoteApp --export-batch <output dir> <notebook|@listfile>... [same options]
+//
+// Runs under an offscreen QGuiApplication and drives the same export engine as
+// the export button (PdfIncrementalWriter for whole annotated PDFs,
+// PdfExportRenderer otherwise), printing per-page timings to stdout. Outputs
+// are replaced atomically and never overwrite the notebook's own PDF.
+class HeadlessExporter
+{
+public:
+    // Whether the arguments ask for a headless export (checked before any application object exists)
+    static bool isExportCommand(int argc, char *argv[]);
+
+    // Parse the arguments, export and return the process exit code
+    static int run(int argc, char *argv[]);
+
+private:
+    struct Options {
+        QStringList notebooks;
+        QString outputPath;  // --export
+        QString outputDir;   // --export-batch
+        int firstPage = -1;  // 0-based, inclusive (-1 = whole document)
+        int lastPage = -1;
+        int jobs = 0;        // 0 = one render worker per core
+        PdfExportProfile profile;
+    };
+
+    static bool parseArguments(const QStringList &args, Options &options, QString &error);
+    static bool exportNotebook(const QString &notebookPath, const QString &outputPath, const Options &options);
+    static bool exportFolder(const QString &notebookPath, const QString &saveFolder, const QString &outputPath,
+                             const Options &options);
+    // <name>.pdf in outputDir, numbered when another notebook of the batch took that name
+    static QString batchOutputPath(const QString &notebookPath, const QString &outputDir, QSet<QString> &usedPaths);
+};
+
+#endif // HEADLESSEXPORTER_H
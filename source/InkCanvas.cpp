@@ -4,6 +4,9 @@
 #include "MarkdownWindow.h" // Include the full definition
 #include "PictureWindowManager.h"
 #include "PictureWindow.h" // Include the full definition
+#include "InkPageIndex.h"
+#include "NotebookSearchIndex.h"
+#include "ExportJobManager.h"
 #include <QMouseEvent>
 #include <QScreen>
 #include <QGuiApplication>
@@ -40,6 +43,7 @@
 #include <QSettings>
 
 #include <QtConcurrent/QtConcurrentRun>
+#include <QtConcurrent/QtConcurrentMap>
 #include <QFuture>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -51,6 +55,7 @@
 
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QSaveFile>
 #include <QProcess>
 #include <QTemporaryDir>
 #include <QMessageBox>
@@ -88,6 +93,8 @@ InkCanvas::InkCanvas(QWidget *parent)
     
     initializeBuffer();
     pdfCache.setMaxCost(6);  // ✅ Ensures the cache holds at most 6 pages
+    filteredBackgroundCache.setMaxCost(3); // Filtered variants of recently displayed pages
+    pdfTextCache.setMaxCost(16 * 1024 * 1024); // Text layouts in bytes (a few hundred typical pages)
     // No need to set auto-delete, QCache will handle deletion automatically
     
     // Initialize PDF text selection throttling timer (60 FPS = ~16.67ms)
@@ -122,6 +129,18 @@ InkCanvas::InkCanvas(QWidget *parent)
     autoSaveTimer->setSingleShot(true);
     autoSaveTimer->setInterval(autoSaveInterval);
     connect(autoSaveTimer, &QTimer::timeout, this, &InkCanvas::onAutoSaveTimeout);
+    
+    // Saves in quick succession (page flips, autosave) share one package sync
+    spnSyncTimer = new QTimer(this);
+    spnSyncTimer->setSingleShot(true);
+    spnSyncTimer->setInterval(1500);
+    connect(spnSyncTimer, &QTimer::timeout, this, &InkCanvas::startSpnSync);
+    
+    // Typing in a note saves on every keystroke; the search index catches up once it pauses
+    searchIndexTimer = new QTimer(this);
+    searchIndexTimer->setSingleShot(true);
+    searchIndexTimer->setInterval(2000);
+    connect(searchIndexTimer, &QTimer::timeout, this, &InkCanvas::startNotebookSearchIndexUpdate);
 }
 
 InkCanvas::~InkCanvas() {
@@ -130,6 +149,7 @@ InkCanvas::~InkCanvas() {
         // Save the current page using existing logic
         saveToFile(lastActivePage);
     }
+    bufferStrokesFuture.waitForFinished(); // Its worker posts back to this canvas
     
     // ✅ Cleanup PDF resources
     if (pdfDocument) {
@@ -138,8 +158,9 @@ InkCanvas::~InkCanvas() {
     }
     
     // ✅ Clear text box references (pointers owned by cache, don't delete here)
-    currentPdfTextBoxes.clear();
-    currentPdfTextBoxPageNumbers.clear();
+    currentTextLayout.clear();
+    currentTextBoxGrids.clear();
+    textReadingOrder = TextReadingOrder();
     
     // ✅ Clear page size cache and trackers
     pdfPageSizeCache.clear();
@@ -147,10 +168,9 @@ InkCanvas::~InkCanvas() {
     currentTextPageNumberSecond = -1;
     currentTextBoxesLoadedForPage = -1;
     
-    // ✅ MEMORY LEAK FIX: Clear text box cache (will delete all TextBox* via entry destructors)
-    qDeleteAll(pdfTextBoxCache);
-    pdfTextBoxCache.clear();
-    pdfTextBoxCacheAccessOrder.clear();
+    // ✅ Clear the text layout cache (layouts own their data)
+    pdfTextCache.clear();
+    pendingTextPages.clear();
     
     // ✅ Clear caches to free memory
     {
@@ -239,8 +259,8 @@ InkCanvas::~InkCanvas() {
     }
     activeNoteWatchers.clear();
     
-    // ✅ Clear PDF text boxes - CRITICAL: Clear selectedTextBoxes first to prevent crashes
-    selectedTextBoxes.clear();  // References to cached text boxes, don't delete
+    // ✅ Clear PDF text selection
+    clearSelectedTextBoxes();
     
     // ✅ Explicitly clean up window managers to prevent memory leaks
     if (pictureManager) {
@@ -249,9 +269,16 @@ InkCanvas::~InkCanvas() {
         pictureManager = nullptr;
     }
     
-    // ✅ Sync .spn package and cleanup temp directory
+    // A first indexing may still read the working folder
+    flushNotebookSearchIndex();
+    
+    // ✅ Write the ink index, sync .spn package and cleanup temp directory
+    if (isSpnPackage) {
+        spnSyncPending = true; // Final sync even if nothing was flagged
+    }
+    flushSpnPackage();
     if (isSpnPackage) {
-        syncSpnPackage();
+        ExportJobManager::waitForSnapshots(); // Export jobs copy from the working folder
         SpnPackageManager::cleanupTempDir(tempWorkingDir);
     }
 }
@@ -330,15 +357,75 @@ void InkCanvas::initializeBuffer() {
     setMaximumSize(pixelSize); // 🔥 KEY LINE to make full canvas drawable
 }
 
-// Helper function to invert PDF colors for dark mode
-static QImage invertPdfImage(const QImage &original) {
-    if (original.isNull()) {
-        return original;
+// Apply a PDF display filter (dark-mode inversion, sepia, contrast, grayscale) in place.
+// The image is split into row bands processed in parallel; the per-pixel loops are
+// branch-free table lookups so the compiler can vectorize them.
+static void applyPdfDisplayFilter(QImage &image, PdfDisplayFilter filter) {
+    if (image.isNull() || filter == PdfDisplayFilter::None) {
+        return;
+    }
+    
+    if (image.format() != QImage::Format_ARGB32 && image.format() != QImage::Format_RGB32) {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    }
+    
+    // Per-channel lookup tables (indexed by channel value, or by luminance for sepia/grayscale)
+    uchar lutR[256], lutG[256], lutB[256];
+    for (int v = 0; v < 256; ++v) {
+        switch (filter) {
+            case PdfDisplayFilter::Sepia:
+                lutR[v] = static_cast<uchar>(qMin(255, 20 + v * 92 / 100));
+                lutG[v] = static_cast<uchar>(qMin(255, 14 + v * 88 / 100));
+                lutB[v] = static_cast<uchar>(qMin(255, 8 + v * 78 / 100));
+                break;
+            case PdfDisplayFilter::HighContrast:
+                lutR[v] = lutG[v] = lutB[v] = static_cast<uchar>(qBound(0, (v - 128) * 3 / 2 + 128, 255));
+                break;
+            default:
+                lutR[v] = lutG[v] = lutB[v] = static_cast<uchar>(v);
+                break;
+        }
     }
+    const bool usesLuminance = (filter == PdfDisplayFilter::Sepia || filter == PdfDisplayFilter::Grayscale);
     
-    QImage inverted = original.copy();
-    inverted.invertPixels(QImage::InvertRgb);  // Invert RGB, keep alpha
-    return inverted;
+    const int imageWidth = image.width();
+    const int imageHeight = image.height();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    uchar *bits = image.bits(); // Detach once before going parallel
+    
+    const int bandHeight = 64;
+    QList<int> bandStarts;
+    for (int y = 0; y < imageHeight; y += bandHeight) {
+        bandStarts.append(y);
+    }
+    
+    QtConcurrent::blockingMap(bandStarts, [&](int &bandStart) {
+        const int bandEnd = qMin(bandStart + bandHeight, imageHeight);
+        for (int y = bandStart; y < bandEnd; ++y) {
+            quint32 *row = reinterpret_cast<quint32*>(bits + y * bytesPerLine);
+            
+            if (filter == PdfDisplayFilter::Invert) {
+                // Invert RGB, keep alpha
+                for (int x = 0; x < imageWidth; ++x) {
+                    row[x] ^= 0x00FFFFFFu;
+                }
+                continue;
+            }
+            
+            for (int x = 0; x < imageWidth; ++x) {
+                const quint32 pixel = row[x];
+                int r = (pixel >> 16) & 0xFF;
+                int g = (pixel >> 8) & 0xFF;
+                int b = pixel & 0xFF;
+                if (usesLuminance) {
+                    const int luminance = (r * 77 + g * 150 + b * 29) >> 8;
+                    r = g = b = luminance;
+                }
+                row[x] = (pixel & 0xFF000000u) |
+                         (quint32(lutR[r]) << 16) | (quint32(lutG[g]) << 8) | quint32(lutB[b]);
+            }
+        }
+    });
 }
 
 // Helper function to calculate contrasting text color for highlights
@@ -365,11 +452,16 @@ static QColor getContrastingTextColor(const QColor &highlightColor, bool isPdfIn
 
 
 void InkCanvas::setPdfInversionEnabled(bool enabled) {
-    if (pdfInversionEnabled != enabled) {
-        pdfInversionEnabled = enabled;
+    setPdfDisplayFilter(enabled ? PdfDisplayFilter::Invert : PdfDisplayFilter::None);
+}
+
+void InkCanvas::setPdfDisplayFilter(PdfDisplayFilter filter) {
+    if (pdfDisplayFilter != filter) {
+        pdfDisplayFilter = filter;
         
-        // Clear PDF cache to force re-rendering with new inversion setting
-        clearPdfCache();
+        // ✅ The PDF cache holds unfiltered renders, so it stays valid - only drop filtered variants
+        filteredBackgroundCache.clear();
+        update();
         
         // Save to metadata
         if (!saveFolder.isEmpty()) {
@@ -378,6 +470,26 @@ void InkCanvas::setPdfInversionEnabled(bool enabled) {
     }
 }
 
+// Return the PDF background with the current display filter applied.
+// Filtered variants are derived from the unfiltered cached render and cached by pixmap key.
+const QPixmap &InkCanvas::displayedPdfBackground() {
+    if (pdfDisplayFilter == PdfDisplayFilter::None || !isPdfLoaded || backgroundImage.isNull()) {
+        return backgroundImage;
+    }
+    
+    const qint64 sourceKey = backgroundImage.cacheKey();
+    if (QPixmap *cached = filteredBackgroundCache.object(sourceKey)) {
+        return *cached;
+    }
+    
+    QImage filtered = backgroundImage.toImage();
+    applyPdfDisplayFilter(filtered, pdfDisplayFilter);
+    filteredBackgroundCache.insert(sourceKey, new QPixmap(QPixmap::fromImage(filtered)));
+    
+    QPixmap *inserted = filteredBackgroundCache.object(sourceKey);
+    return inserted ? *inserted : backgroundImage;
+}
+
 void InkCanvas::loadPdf(const QString &pdfPath) {
     // ✅ Clear existing PDF cache before loading new PDF to prevent old pages from showing
     {
@@ -404,7 +516,13 @@ void InkCanvas::loadPdf(const QString &pdfPath) {
     }
     activePdfWatchers.clear();
     
-    pdfDocument = Poppler::Document::load(pdfPath);
+    // ✅ Open through the shared memory mapping (reused by render workers and other tabs)
+    pdfDocument.reset();
+    pdfDocumentDevice.reset();
+    PdfDocumentHandle handle = PdfFileMapping::loadDocument(pdfPath);
+    pdfFileMapping = std::move(handle.mapping);
+    pdfDocumentDevice = std::move(handle.device);
+    pdfDocument = std::move(handle.document);
     if (pdfDocument && !pdfDocument->isLocked()) {
         // Enable anti-aliasing rendering hints for better text quality
         pdfDocument->setRenderHint(Poppler::Document::Antialiasing, true);
@@ -414,6 +532,7 @@ void InkCanvas::loadPdf(const QString &pdfPath) {
         
         totalPdfPages = pdfDocument->numPages();
         isPdfLoaded = true;
+        publishRenderSnapshot();
         // ✅ Don't automatically load page 0 - let MainWindow handle initial page loading
         
         // ✅ Save the PDF path in the unified JSON metadata
@@ -422,6 +541,10 @@ void InkCanvas::loadPdf(const QString &pdfPath) {
             saveNotebookMetadata(); // Save to JSON
         }
         
+        // ✅ Index the text for search in the background (resumes from the index file if present)
+        clearSearchHighlights();
+        pdfSearchIndex.start(pdfFileMapping, pdfPath, saveFolder, totalPdfPages);
+        
         // Emit signal that PDF was loaded
         emit pdfLoaded();
         // update();
@@ -431,8 +554,11 @@ void InkCanvas::loadPdf(const QString &pdfPath) {
 void InkCanvas::clearPdf() {
     pdfDocument.reset();
     pdfDocument = nullptr;
+    pdfDocumentDevice.reset();
+    pdfFileMapping.reset();
     isPdfLoaded = false;
     totalPdfPages = 0;
+    publishRenderSnapshot();
     {
         QMutexLocker locker(&pdfCacheMutex);
         pdfCache.clear();
@@ -440,9 +566,10 @@ void InkCanvas::clearPdf() {
     }
     
     // ✅ Clear text box references (pointers owned by cache, don't delete here)
-    currentPdfTextBoxes.clear();
-    currentPdfTextBoxPageNumbers.clear();
-    selectedTextBoxes.clear();
+    currentTextLayout.clear();
+    currentTextBoxGrids.clear();
+    textReadingOrder = TextReadingOrder();
+    clearSelectedTextBoxes();
     
     // ✅ Clear page size cache and trackers
     pdfPageSizeCache.clear();
@@ -450,10 +577,16 @@ void InkCanvas::clearPdf() {
     currentTextPageNumberSecond = -1;
     currentTextBoxesLoadedForPage = -1;
     
-    // ✅ MEMORY LEAK FIX: Clear text box cache (will delete all TextBox* via entry destructors)
-    qDeleteAll(pdfTextBoxCache);
-    pdfTextBoxCache.clear();
-    pdfTextBoxCacheAccessOrder.clear();
+    // ✅ Clear the text layout cache (layouts own their data)
+    pdfTextCache.clear();
+    pendingTextPages.clear();
+    
+    // ✅ The search index belongs to the removed PDF
+    pdfSearchIndex.stop();
+    clearSearchHighlights();
+    if (!saveFolder.isEmpty()) {
+        QFile::remove(saveFolder + "/" + PdfSearchIndex::INDEX_FILE_NAME);
+    }
 
     // ✅ Clear the background image immediately to remove PDF from display
     backgroundImage = QPixmap();
@@ -486,17 +619,21 @@ void InkCanvas::clearPdf() {
 void InkCanvas::clearPdfNoDelete() {
     pdfDocument.reset();
     pdfDocument = nullptr;
+    pdfDocumentDevice.reset();
+    pdfFileMapping.reset();
     isPdfLoaded = false;
     totalPdfPages = 0;
+    publishRenderSnapshot();
     {
         QMutexLocker locker(&pdfCacheMutex);
         pdfCache.clear();
     }
     
     // ✅ Clear text box references (pointers owned by cache, don't delete here)
-    currentPdfTextBoxes.clear();
-    currentPdfTextBoxPageNumbers.clear();
-    selectedTextBoxes.clear();
+    currentTextLayout.clear();
+    currentTextBoxGrids.clear();
+    textReadingOrder = TextReadingOrder();
+    clearSelectedTextBoxes();
     
     // ✅ Clear page size cache and trackers
     pdfPageSizeCache.clear();
@@ -504,10 +641,11 @@ void InkCanvas::clearPdfNoDelete() {
     currentTextPageNumberSecond = -1;
     currentTextBoxesLoadedForPage = -1;
     
-    // ✅ MEMORY LEAK FIX: Clear text box cache
-    qDeleteAll(pdfTextBoxCache);
-    pdfTextBoxCache.clear();
-    pdfTextBoxCacheAccessOrder.clear();
+    // ✅ Clear the text layout cache
+    pdfTextCache.clear();
+    pendingTextPages.clear();
+    pdfSearchIndex.stop();
+    clearSearchHighlights();
     
     // Reset cache system state
     currentCachedPage = -1;
@@ -604,11 +742,6 @@ void InkCanvas::loadPdfPreviewAsync(int pageNumber) {
 
         QImage currentPageImage = currentPage->renderToImage(96, 96);
         if (currentPageImage.isNull()) return QPixmap();
-        
-        // Apply PDF inversion if enabled
-        if (pdfInversionEnabled) {
-            currentPageImage = invertPdfImage(currentPageImage);
-        }
 
         // Try to render next page for combination
         QImage nextPageImage;
@@ -617,11 +750,6 @@ void InkCanvas::loadPdfPreviewAsync(int pageNumber) {
             std::unique_ptr<Poppler::Page> nextPage(pdfDocument->page(nextPageNumber));
             if (nextPage) {
                 nextPageImage = nextPage->renderToImage(96, 96);
-                
-                // Apply PDF inversion if enabled
-                if (pdfInversionEnabled) {
-                    nextPageImage = invertPdfImage(nextPageImage);
-                }
             }
         }
 
@@ -802,7 +930,10 @@ void InkCanvas::paintEvent(QPaintEvent *event) {
 
     // ✅ Draw loaded image or PDF background if available
     if (!backgroundImage.isNull()) {
-        painter.drawPixmap(0, 0, backgroundImage);
+        painter.drawPixmap(0, 0, displayedPdfBackground());
+        
+        // ✅ Persistent text highlights are a cached vector overlay, not part of the PDF raster
+        drawHighlightOverlay(painter);
     }
 
     // ✅ Draw pictures (above PDF, below user strokes) - only render pictures in update region
@@ -958,11 +1089,12 @@ void InkCanvas::paintEvent(QPaintEvent *event) {
         // Note: We no longer draw the selection rectangle during dragging
         // since text selection is row-based, not area-based
         
-        // Note: Persistent highlights are now drawn directly onto cached PDF images during rendering
-        // for better performance. See drawHighlightsOnPageImage() and renderPdfPageToCacheThreadSafe()
+        // Note: Persistent highlights are drawn as a cached overlay right above the PDF background.
+        // See drawHighlightOverlay() and rebuildHighlightOverlay()
         
         // Draw highlights for selected text boxes (temporary selection during text selection)
-        if (!selectedTextBoxes.isEmpty()) {
+        // Rows were merged once in rebuildSelectionRows(), so only two points per line are mapped here
+        if (!selectionRowRects.isEmpty()) {
             // Use current pen color for highlight with semi-transparency
             // The original PDF text will show through the transparent overlay
             QColor highlightColor = penColor;
@@ -971,90 +1103,10 @@ void InkCanvas::paintEvent(QPaintEvent *event) {
             painter.setBrush(highlightColor);
             painter.setPen(Qt::NoPen);
             
-            // Group text boxes by row for connected highlighting
-            const qreal rowToleranceWidget = 10.0; // Widget coordinate pixels
-            
-            struct TextBoxWithCoords {
-                QRectF widgetRect;
-                qreal centerY;
-            };
-            
-            QList<TextBoxWithCoords> textBoxCoords;
-            
-            // Convert all text boxes to widget coordinates
-            for (int i = 0; i < selectedTextBoxes.size(); ++i) {
-                const Poppler::TextBox* textBox = selectedTextBoxes[i];
-                if (textBox) {
-                    // Find the page number for this text box
-                    int textBoxPageNumber = -1;
-                    for (int j = 0; j < currentPdfTextBoxes.size(); ++j) {
-                        if (currentPdfTextBoxes[j] == textBox) {
-                            textBoxPageNumber = (j < currentPdfTextBoxPageNumbers.size()) ? 
-                                               currentPdfTextBoxPageNumbers[j] : -1;
-                            break;
-                        }
-                    }
-                    
-                    // Convert PDF coordinates to widget coordinates
-                    QRectF pdfRect = textBox->boundingBox();
-                    QPointF topLeft = mapPdfToWidgetCoordinates(pdfRect.topLeft(), textBoxPageNumber);
-                    QPointF bottomRight = mapPdfToWidgetCoordinates(pdfRect.bottomRight(), textBoxPageNumber);
-                    QRectF widgetRect(topLeft, bottomRight);
-                    widgetRect = widgetRect.normalized();
-                    
-                    TextBoxWithCoords coords;
-                    coords.widgetRect = widgetRect;
-                    coords.centerY = (widgetRect.top() + widgetRect.bottom()) / 2.0;
-                    textBoxCoords.append(coords);
-                }
-            }
-            
-            // Group by row
-            QList<QList<QRectF>> rowGroups;
-            for (const TextBoxWithCoords &coords : textBoxCoords) {
-                bool addedToRow = false;
-                
-                // Try to add to existing row
-                for (QList<QRectF> &row : rowGroups) {
-                    if (!row.isEmpty()) {
-                        qreal avgY = (row.first().top() + row.first().bottom()) / 2.0;
-                        
-                        if (qAbs(avgY - coords.centerY) <= rowToleranceWidget) {
-                            row.append(coords.widgetRect);
-                            addedToRow = true;
-                            break;
-                        }
-                    }
-                }
-                
-                // Create new row if not added
-                if (!addedToRow) {
-                    QList<QRectF> newRow;
-                    newRow.append(coords.widgetRect);
-                    rowGroups.append(newRow);
-                }
-            }
-            
-            // Draw continuous rectangle for each row
-            for (const QList<QRectF> &row : rowGroups) {
-                if (row.isEmpty()) continue;
-                
-                // Find leftmost and rightmost bounds
-                qreal minX = row.first().left();
-                qreal maxX = row.first().right();
-                qreal minY = row.first().top();
-                qreal maxY = row.first().bottom();
-                
-                for (const QRectF &rect : row) {
-                    minX = qMin(minX, rect.left());
-                    maxX = qMax(maxX, rect.right());
-                    minY = qMin(minY, rect.top());
-                    maxY = qMax(maxY, rect.bottom());
-                }
-                
-                // Create continuous rectangle spanning the entire row
-                QRectF continuousRect(minX, minY, maxX - minX, maxY - minY);
-                painter.drawRect(continuousRect);
+            for (const SelectionRowRect &row : selectionRowRects) {
+                QPointF topLeft = mapPdfToWidgetCoordinates(row.pdfRect.topLeft(), row.pageNumber);
+                QPointF bottomRight = mapPdfToWidgetCoordinates(row.pdfRect.bottomRight(), row.pageNumber);
+                painter.drawRect(QRectF(topLeft, bottomRight).normalized());
             }
         }
         
@@ -1122,7 +1174,7 @@ void InkCanvas::tabletEvent(QTabletEvent *event) {
             pdfSelectionEnd = pdfSelectionStart;
             
             // Clear any existing selected text boxes without resetting pdfTextSelecting
-            selectedTextBoxes.clear();
+            clearSelectedTextBoxes();
             
             setCursor(Qt::IBeamCursor); // Ensure cursor is correct
             update(); // Refresh display
@@ -1206,6 +1258,7 @@ void InkCanvas::tabletEvent(QTabletEvent *event) {
 
     if (event->type() == QEvent::TabletPress) {
         drawing = true;
+        strokeInProgress = false;
         lastPoint = event->position(); // Logical widget coordinates
         if (straightLineMode) {
             straightLineStartPoint = lastPoint;
@@ -1229,6 +1282,7 @@ void InkCanvas::tabletEvent(QTabletEvent *event) {
                 
                 // If the selection area hasn't been cleared from the buffer yet, clear it now
                 if (!selectionAreaCleared && !selectionMaskPath.isEmpty()) {
+                    markInkRasterOnly();
                     QPainter painter(&buffer);
                     painter.setCompositionMode(QPainter::CompositionMode_Clear);
                     painter.fillPath(selectionMaskPath, Qt::transparent);
@@ -1402,6 +1456,7 @@ void InkCanvas::tabletEvent(QTabletEvent *event) {
         }
         
         drawing = false;
+        strokeInProgress = false;
         
         // ✅ AUTO-SAVE: Start timer when stroke ends (debouncing pattern)
         // Timer will be reset if user starts drawing again before it fires
@@ -1494,6 +1549,7 @@ void InkCanvas::tabletEvent(QTabletEvent *event) {
                 // Now, if the user presses inside selectionRect, movingSelection will become true.
             } else if (movingSelection) {
                 if (!selectionBuffer.isNull() && !selectionRect.isEmpty()) {
+                    markInkRasterOnly();
                     QPainter painter(&buffer);
                     // Explicitly set composition mode to draw on top of existing content
                     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
@@ -1817,7 +1873,7 @@ void InkCanvas::mousePressEvent(QMouseEvent *event) {
             pdfSelectionEnd = pdfSelectionStart;
             
             // Clear any existing selected text boxes without resetting pdfTextSelecting
-            selectedTextBoxes.clear();
+            clearSelectedTextBoxes();
             
             setCursor(Qt::IBeamCursor); // Ensure cursor is correct
             update(); // Refresh display
@@ -1857,7 +1913,14 @@ void InkCanvas::mouseMoveEvent(QMouseEvent *event) {
     
     // Update cursor based on mode when not actively selecting
     if (pdfTextSelectionEnabled && isPdfLoaded && !pdfTextSelecting) {
-        setCursor(Qt::IBeamCursor);
+        // Text prefetched for this page can be picked up without touching Poppler
+        if (currentCachedPage >= 0 && currentTextBoxesLoadedForPage != currentCachedPage &&
+            pdfTextCache.contains(currentCachedPage)) {
+            loadPdfTextBoxes(currentCachedPage);
+        }
+        
+        // ✅ Hand cursor over links, from the cached link map only (no Poppler calls per move)
+        setCursor(pdfLinkAt(event->position(), false) ? Qt::PointingHandCursor : Qt::IBeamCursor);
     }
     
     event->ignore();
@@ -1929,8 +1992,9 @@ void InkCanvas::mouseDoubleClickEvent(QMouseEvent *event) {
             if (pageNum < 0) continue; // Skip invalid pages
             
             // Check all highlights on this page
-            for (const TextHighlight &highlight : persistentHighlights) {
-                if (highlight.pageNumber == pageNum && highlight.boundingBox.contains(pdfCoords)) {
+            const QList<TextHighlight> pageHighlights = annotationStore.highlights(pageNum);
+            for (const TextHighlight &highlight : pageHighlights) {
+                if (highlight.boundingBox.contains(pdfCoords)) {
                     // Found a highlight at click position!
                     // If it has a linked markdown note, emit signal to open it
                     if (!highlight.markdownWindowId.isEmpty()) {
@@ -1968,6 +2032,7 @@ void InkCanvas::drawStroke(const QPointF &start, const QPointF &end, qreal press
     painter.setRenderHint(QPainter::Antialiasing);
 
     qreal thickness = penThickness;
+    QColor strokeColor = penColor;
 
     qreal updatePadding = (currentTool == ToolType::Marker) ? thickness * 4.0 : 10;
 
@@ -1982,6 +2047,7 @@ void InkCanvas::drawStroke(const QPointF &start, const QPointF &end, qreal press
             // For regular drawing, use lower alpha for the usual marker effect
             markerColor.setAlpha(4);
         }
+        strokeColor = markerColor;
         QPen pen(markerColor, thickness, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin);
         painter.setPen(pen);
     } else { // Default Pen
@@ -2004,6 +2070,7 @@ void InkCanvas::drawStroke(const QPointF &start, const QPointF &end, qreal press
     QPointF bufferEnd = (adjustedEnd / (zoomFactor / 100.0)) + QPointF(panOffsetX, panOffsetY);
 
     painter.drawLine(bufferStart, bufferEnd);
+    recordStrokeSegment(bufferStart, bufferEnd, pressure, strokeColor, thickness);
 
     QRectF updateRect = QRectF(bufferStart, bufferEnd)
                         .normalized()
@@ -2016,6 +2083,25 @@ void InkCanvas::drawStroke(const QPointF &start, const QPointF &end, qreal press
     update(scaledUpdateRect);
 }
 
+void InkCanvas::recordStrokeSegment(const QPointF &bufferStart, const QPointF &bufferEnd, qreal pressure,
+                                    const QColor &color, qreal width) {
+    // Segments continue the open stroke while it's the same pen and the line is unbroken
+    if (!strokeInProgress || bufferStrokes.isEmpty() || bufferStrokes.last().tool != currentTool ||
+        bufferStrokes.last().color != color || bufferStrokes.last().width != width ||
+        bufferStrokes.last().points.last() != bufferStart) {
+        InkStroke stroke;
+        stroke.tool = currentTool;
+        stroke.color = color;
+        stroke.width = width;
+        stroke.points.append(bufferStart);
+        stroke.pressures.append(pressure);
+        bufferStrokes.append(stroke);
+        strokeInProgress = true;
+    }
+    bufferStrokes.last().points.append(bufferEnd);
+    bufferStrokes.last().pressures.append(pressure);
+}
+
 void InkCanvas::eraseStroke(const QPointF &start, const QPointF &end, qreal pressure) {
     if (buffer.isNull()) {
         initializeBuffer();
@@ -2033,6 +2119,7 @@ void InkCanvas::eraseStroke(const QPointF &start, const QPointF &end, qreal pres
         autoSaveTimer->stop();
     }
 
+    markInkRasterOnly();
     QPainter painter(&buffer);
     painter.setCompositionMode(QPainter::CompositionMode_Clear);
 
@@ -2127,10 +2214,15 @@ void InkCanvas::setTool(ToolType tool) {
 }
 
 void InkCanvas::setSaveFolder(const QString &folderPath) {
+    // The previous package must not lose its last changes
+    flushNotebookSearchIndex();
+    flushSpnPackage(); // Also writes the ink index of folder notebooks
+    
     // ✅ Handle .spn packages by extracting to temporary directory
     if (SpnPackageManager::isSpnPackage(folderPath)) {
         // Clean up previous temp directory if exists
         if (!tempWorkingDir.isEmpty()) {
+            ExportJobManager::waitForSnapshots();
             SpnPackageManager::cleanupTempDir(tempWorkingDir);
         }
         
@@ -2195,6 +2287,7 @@ void InkCanvas::saveToFile(int pageNumber) {
             painter.drawPixmap(0, 0, currentPageBuffer);
         }
         currentImage.save(currentFilePath, "PNG");
+        InkPageIndex::recordPageAsync(saveFolder, notebookId, pageNumber, currentImage);
         
         // Save next page (bottom half) - DIRECT SAVE like top half
         // ✅ FIX: Don't merge, just save directly to properly handle erasure/deletion
@@ -2209,6 +2302,7 @@ void InkCanvas::saveToFile(int pageNumber) {
             painter.drawPixmap(0, 0, nextPageBuffer);
         }
         nextImage.save(nextFilePath, "PNG");
+        InkPageIndex::recordPageAsync(saveFolder, notebookId, nextPageNumber, nextImage);
         
         // ❌ REMOVED: Cache updates here are redundant since cache gets invalidated after save
         // Cache will be reloaded fresh from disk when needed
@@ -2220,11 +2314,15 @@ void InkCanvas::saveToFile(int pageNumber) {
         image.fill(Qt::transparent);
         QPainter painter(&image);
         painter.drawPixmap(0, 0, buffer);
+        painter.end();
         image.save(filePath, "PNG");
+        InkPageIndex::recordPageAsync(saveFolder, notebookId, pageNumber, image);
         
         // ❌ REMOVED: Cache updates here are redundant since cache gets invalidated after save
         // Cache will be reloaded fresh from disk when needed
     }
+    saveBufferStrokes(pageNumber, isCombinedCanvas, singlePageHeight);
+    scheduleInkIndexWrite();
     
     edited = false;
     
@@ -2240,6 +2338,85 @@ void InkCanvas::saveToFile(int pageNumber) {
     syncSpnPackage();
 }
 
+void InkCanvas::saveBufferStrokes(int pageNumber, bool isCombinedCanvas, int singlePageHeight) {
+    if (saveFolder.isEmpty()) {
+        return;
+    }
+    applyLoadedBufferStrokes(); // The page's saved strokes must be in before they're rewritten
+
+    const int pageCount = isCombinedCanvas ? 2 : 1;
+    for (int i = 0; i < pageCount; ++i) {
+        if (!bufferStrokesComplete) {
+            // ✅ Pixels the strokes can't reproduce: export uses the PNG instead
+            InkStrokeStore::removePage(saveFolder, notebookId, pageNumber + i);
+            continue;
+        }
+
+        // Strokes crossing the page break go to both pages; each is clipped to its own page on export
+        const QRectF pageRect(0, i * singlePageHeight, buffer.width(), singlePageHeight);
+        InkStrokePage page;
+        page.imageSize = QSize(buffer.width(), singlePageHeight);
+        for (const InkStroke &stroke : std::as_const(bufferStrokes)) {
+            if (stroke.bounds().intersects(pageRect)) {
+                InkStroke pageStroke = stroke;
+                pageStroke.translate(0, -pageRect.top());
+                page.strokes.append(pageStroke);
+            }
+        }
+        InkStrokeStore::savePage(saveFolder, notebookId, pageNumber + i, page);
+    }
+}
+
+void InkCanvas::loadBufferStrokes(int pageNumber, int nextPageOffset) {
+    bufferStrokes.clear();
+    bufferStrokesComplete = true;
+    strokeInProgress = false;
+    bufferStrokesPending = false;
+    const int generation = ++bufferStrokesGeneration;
+    if (saveFolder.isEmpty()) {
+        return;
+    }
+
+    // ✅ Checking a stroke file reads its whole PNG (and may decode it), so it's kept off page turns
+    const QString folder = saveFolder;
+    const QString id = notebookId;
+    bufferStrokesPending = true;
+    bufferStrokesFuture = QtConcurrent::run([this, folder, id, pageNumber, nextPageOffset, generation]() {
+        LoadedStrokes loaded;
+        for (int i = 0; i < 2; ++i) {
+            InkStrokePage page;
+            if (InkStrokeStore::loadPage(folder, id, pageNumber + i, page)) {
+                for (InkStroke &stroke : page.strokes) {
+                    stroke.translate(0, i * nextPageOffset);
+                }
+                loaded.strokes.append(page.strokes);
+            } else if (InkPageIndex::pageHasInk(folder, id, pageNumber + i)) {
+                // Ink saved before strokes were recorded, or changed since
+                loaded.complete = false;
+            }
+        }
+        QMetaObject::invokeMethod(this, [this, generation]() {
+            if (generation == bufferStrokesGeneration) {
+                applyLoadedBufferStrokes();
+            }
+        }, Qt::QueuedConnection);
+        return loaded;
+    });
+}
+
+void InkCanvas::applyLoadedBufferStrokes() {
+    if (!bufferStrokesPending) {
+        return;
+    }
+    bufferStrokesPending = false;
+
+    const LoadedStrokes loaded = bufferStrokesFuture.result();
+    bufferStrokes = loaded.strokes + bufferStrokes;
+    if (!loaded.complete) {
+        bufferStrokesComplete = false;
+    }
+}
+
 void InkCanvas::loadPage(int pageNumber) {
     if (saveFolder.isEmpty()) return;
 
@@ -2263,6 +2440,7 @@ void InkCanvas::loadPage(int pageNumber) {
     bool currentExists = false;
     bool nextExists = false;
     bool loadedFromCache = false; // Track if we loaded anything from cache
+    int nextPageOffset = 0;       // Where the next page starts in the combined buffer
     
     // Use the newly cached page or initialize buffer if loading failed
     {
@@ -2310,6 +2488,7 @@ void InkCanvas::loadPage(int pageNumber) {
         if (nextExists) {
             int yOffset = currentExists ? currentPageCanvas.height() : nextPageCanvas.height();
             painter.drawPixmap(0, yOffset, nextPageCanvas);
+            nextPageOffset = yOffset;
         }
         painter.end();
     } else {
@@ -2320,6 +2499,7 @@ void InkCanvas::loadPage(int pageNumber) {
     
     // Reset edited state when loading a new page
     edited = false;
+    loadBufferStrokes(pageNumber, nextPageOffset);
     
     // ✅ AUTO-SAVE: Stop timer when switching pages (new page gets fresh auto-save cycle)
     if (autoSaveTimer && autoSaveTimer->isActive()) {
@@ -2512,6 +2692,9 @@ void InkCanvas::deletePage(int pageNumber) {
     QFile::remove(fileName);
     QFile::remove(bgFileName);
     QFile::remove(metadataFileName);
+    InkPageIndex::removePage(saveFolder, pageNumber);
+    scheduleInkIndexWrite();
+    InkStrokeStore::removePage(saveFolder, notebookId, pageNumber);
 
     // Remove deleted page from note cache
     {
@@ -2541,6 +2724,11 @@ void InkCanvas::clearCurrentPage() {
     } else {
         buffer.fill(Qt::transparent);
     }
+    bufferStrokes.clear();
+    bufferStrokesComplete = true;
+    strokeInProgress = false;
+    bufferStrokesPending = false;
+    ++bufferStrokesGeneration;
     
     // Clear all picture windows from current page (already deletes files permanently)
     if (pictureManager) {
@@ -3305,6 +3493,7 @@ void InkCanvas::deleteRopeSelection() {
     if (!selectionBuffer.isNull() && !selectionRect.isEmpty()) {
         // If the selection area hasn't been cleared from the buffer yet, clear it now for deletion
         if (!selectionAreaCleared && !selectionMaskPath.isEmpty()) {
+            markInkRasterOnly();
             QPainter painter(&buffer);
             painter.setCompositionMode(QPainter::CompositionMode_Clear);
             painter.fillPath(selectionMaskPath, Qt::transparent);
@@ -3340,6 +3529,7 @@ void InkCanvas::deleteRopeSelection() {
 void InkCanvas::cancelRopeSelection() {
     if (!selectionBuffer.isNull() && !selectionRect.isEmpty()) {
         // Paste the selection back to its current location (where user moved it)
+        markInkRasterOnly();
         QPainter painter(&buffer);
         // Explicitly set composition mode to draw on top of existing content
         painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
@@ -3412,6 +3602,7 @@ void InkCanvas::copyRopeSelection() {
         }
         
         // First, permanently commit the original selection to the buffer
+        markInkRasterOnly();
         QPainter painter(&buffer);
         painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
         painter.drawPixmap(currentBufferDest.toPoint(), selectionBuffer);
@@ -3472,7 +3663,7 @@ void InkCanvas::copyRopeSelectionToClipboard() {
 // PDF text selection implementation
 void InkCanvas::clearPdfTextSelection() {
     // Clear selection state
-    selectedTextBoxes.clear();
+    clearSelectedTextBoxes();
     pdfTextSelecting = false;
     
     // Cancel any pending throttled updates
@@ -3485,22 +3676,61 @@ void InkCanvas::clearPdfTextSelection() {
     update();
 }
 
+void InkCanvas::clearSelectedTextBoxes() {
+    selectedTextWords.clear();
+    selectionRowRects.clear();
+}
+
+// Merge the selected words of each page into one rectangle per line.
+// Words arrive sorted by page, so each page is a contiguous run.
+void InkCanvas::rebuildSelectionRows() {
+    selectionRowRects.clear();
+    
+    int runStart = 0;
+    while (runStart < selectedTextWords.size()) {
+        int pageNumber = currentTextLayout.pageNumber(selectedTextWords[runStart]);
+        QList<QRectF> pageRects;
+        int i = runStart;
+        for (; i < selectedTextWords.size() && currentTextLayout.pageNumber(selectedTextWords[i]) == pageNumber; ++i) {
+            pageRects.append(currentTextLayout.rect(selectedTextWords[i]));
+        }
+        for (const QRectF &rowRect : TextHighlight::mergeRows(pageRects)) {
+            selectionRowRects.append(SelectionRowRect{pageNumber, rowRect});
+        }
+        runStart = i;
+    }
+}
+
+int InkCanvas::selectionPageAndBounds(QRectF &bounds) const {
+    bounds = QRectF();
+    if (selectedTextWords.isEmpty()) {
+        return -1;
+    }
+    
+    for (int word : selectedTextWords) {
+        QRectF wordRect = currentTextLayout.rect(word);
+        bounds = bounds.isNull() ? wordRect : bounds.united(wordRect);
+    }
+    return currentTextLayout.pageNumber(selectedTextWords.first());
+}
+
 QString InkCanvas::getSelectedPdfText() const {
-    if (selectedTextBoxes.isEmpty()) {
+    if (selectedTextWords.isEmpty()) {
         return QString();
     }
     
     // Pre-allocate string with estimated size for efficiency
     QString selectedText;
-    selectedText.reserve(selectedTextBoxes.size() * 20); // Estimate ~20 chars per text box
+    selectedText.reserve(selectedTextWords.size() * 20); // Estimate ~20 chars per word
     
     // Build text with space separators
-    for (const Poppler::TextBox* textBox : selectedTextBoxes) {
-        if (textBox && !textBox->text().isEmpty()) {
+    for (int word : selectedTextWords) {
+        QStringView text = currentTextLayout.text(word);
+        if (!text.isEmpty()) {
             if (!selectedText.isEmpty()) {
                 selectedText += " ";
             }
-            selectedText += textBox->text();
+            selectedText += text;
         }
     }
     
@@ -3508,14 +3738,13 @@ QString InkCanvas::getSelectedPdfText() const {
 }
 
 void InkCanvas::loadPdfTextBoxes(int pageNumber) {
-    // Clear existing text boxes and page number tracking
-    // CRITICAL: Clear selectedTextBoxes first to prevent crashes in paintEvent
-    selectedTextBoxes.clear();  // Must clear before deleting currentPdfTextBoxes
+    // Clear existing text layout and page number tracking
+    // Selected word indices refer to the old layout, so clear them first
+    clearSelectedTextBoxes();
     
-    // ✅ NO LONGER DELETE: currentPdfTextBoxes will reference cached data
-    // qDeleteAll(currentPdfTextBoxes); // ❌ DON'T DELETE - cached pointers!
-    currentPdfTextBoxes.clear();
-    currentPdfTextBoxPageNumbers.clear();
+    currentTextLayout.clear();
+    currentTextBoxGrids.clear();
+    textReadingOrder = TextReadingOrder();
     
     // ✅ Reset page trackers
     currentTextPageNumber = -1;
@@ -3528,89 +3757,42 @@ void InkCanvas::loadPdfTextBoxes(int pageNumber) {
 
     // Check if this is a combined canvas
     bool isCombinedCanvas = false;
-    int singlePageHeight = buffer.height();
     
     if (!backgroundImage.isNull() && buffer.height() >= backgroundImage.height() * 1.8) {
         isCombinedCanvas = true;
-        singlePageHeight = backgroundImage.height() / 2;
     } else if (buffer.height() > 1400) { // Fallback heuristic for tall buffers (handles 720p+)
         isCombinedCanvas = true;
-        singlePageHeight = buffer.height() / 2;
     }
 
-    // ✅ CACHE KEY: For combined canvas, use negative page number to differentiate
-    int cacheKey = isCombinedCanvas ? -(pageNumber + 1) : pageNumber;
-    
-    // ✅ CHECK CACHE FIRST
-    if (pdfTextBoxCache.contains(cacheKey)) {
-        TextBoxCacheEntry* entry = pdfTextBoxCache[cacheKey];
-        currentPdfTextBoxes = entry->textBoxes;
-        currentPdfTextBoxPageNumbers = entry->pageNumbers;
-        currentTextBoxesLoadedForPage = pageNumber; // Track which page these text boxes belong to
-        
-        // Restore page number trackers for coordinate mapping (critical for selection overlay)
-        if (isCombinedCanvas) {
-            currentTextPageNumber = pageNumber;
-            currentTextPageNumberSecond = pageNumber + 1;
+    // For combined canvas showing pages N and N+1:
+    // - Top half shows page N (coordinates as-is)
+    // - Bottom half shows page N+1 (coordinates will be adjusted in mapping functions)
+    // Layouts are cached per page, so both canvas modes share them
+    const int lastPage = (isCombinedCanvas && pageNumber + 1 < pdfDocument->numPages()) ? pageNumber + 1 : pageNumber;
+    for (int page = pageNumber; page <= lastPage; ++page) {
+        const PdfPageText *pageText = pdfPageText(page);
+        if (!pageText) {
+            continue;
+        }
+        
+        // ✅ Cache the page size for coordinate mapping (lightweight)
+        pdfPageSizeCache[page] = pageText->pageSize;
+        if (page == pageNumber) {
+            currentTextPageNumber = page;
         } else {
-            currentTextPageNumber = pageNumber;
-            currentTextPageNumberSecond = -1;
+            currentTextPageNumberSecond = page;
         }
         
-        // Update LRU access order
-        pdfTextBoxCacheAccessOrder.removeAll(cacheKey);
-        pdfTextBoxCacheAccessOrder.append(cacheKey);
-        return;
-    }
-    
-    // ✅ NOT IN CACHE: Allocate new text boxes
-    TextBoxCacheEntry* newEntry = new TextBoxCacheEntry();
-
-    if (isCombinedCanvas) {
-        loadPdfTextBoxesForCombinedCanvas(pageNumber, singlePageHeight, newEntry);
-    } else {
-        loadPdfTextBoxesForSinglePage(pageNumber, newEntry);
-    }
-    
-    // ✅ CACHE THE RESULT
-    pdfTextBoxCache[cacheKey] = newEntry;
-    pdfTextBoxCacheAccessOrder.append(cacheKey);
-    
-    // ✅ USE THE CACHED DATA
-    currentPdfTextBoxes = newEntry->textBoxes;
-    currentPdfTextBoxPageNumbers = newEntry->pageNumbers;
-    currentTextBoxesLoadedForPage = pageNumber; // Track which page these text boxes belong to
-    
-    // ✅ LRU EVICTION: Keep only last 5 pages in cache
-    while (pdfTextBoxCacheAccessOrder.size() > 5) {
-        int oldestKey = pdfTextBoxCacheAccessOrder.takeFirst();
-        TextBoxCacheEntry* oldEntry = pdfTextBoxCache.take(oldestKey);
-        delete oldEntry; // Destructor will qDeleteAll(textBoxes)
+        currentTextLayout.append(pageText->layout);
+        currentTextBoxGrids.insert(page, pageText->grid);
     }
+    currentTextBoxesLoadedForPage = pageNumber; // Track which page this text belongs to
     
     // ✅ CRITICAL: Also evict old page sizes from cache to prevent unbounded growth
-    // Keep page sizes synchronized with text box cache
-    // Collect which page numbers are currently in use from cache keys
-    QSet<int> pagesInUse;
-    for (int key : pdfTextBoxCacheAccessOrder) {
-        int absKey = qAbs(key);
-        // For combined canvas: key is -(pageNumber+1), so page is |key|-1
-        // For single page: key is pageNumber
-        if (key < 0) {
-            // Combined canvas: pages are (|key|-1) and |key|
-            int basePage = absKey - 1;
-            pagesInUse.insert(basePage);
-            pagesInUse.insert(basePage + 1);
-        } else {
-            // Single page
-            pagesInUse.insert(key);
-        }
-    }
-    
-    // Remove page sizes not in use
+    // Keep page sizes synchronized with the text layout cache
     auto it = pdfPageSizeCache.begin();
     while (it != pdfPageSizeCache.end()) {
-        if (!pagesInUse.contains(it.key())) {
+        if (!pdfTextCache.contains(it.key()) && it.key() != currentTextPageNumber && it.key() != currentTextPageNumberSecond) {
             it = pdfPageSizeCache.erase(it);
         } else {
             ++it;
@@ -3618,67 +3800,25 @@ void InkCanvas::loadPdfTextBoxes(int pageNumber) {
     }
 }
 
-void InkCanvas::loadPdfTextBoxesForSinglePage(int pageNumber, TextBoxCacheEntry* entry) {
+const PdfPageText *InkCanvas::pdfPageText(int pageNumber) {
+    if (PdfPageText *cached = pdfTextCache.object(pageNumber)) {
+        return cached;
+    }
+    
     // ✅ Create a temporary local page object (will be destroyed at end of function)
-    std::unique_ptr<Poppler::Page> tempPage(pdfDocument->page(pageNumber));
+    std::unique_ptr<Poppler::Page> tempPage(pdfDocument ? pdfDocument->page(pageNumber) : nullptr);
     if (!tempPage) {
-        return;
-    }
-
-    // ✅ Cache the page size for coordinate mapping (lightweight)
-    pdfPageSizeCache[pageNumber] = tempPage->pageSizeF();
-    currentTextPageNumber = pageNumber;
-
-    // Load text boxes for the single page and populate cache entry
-    auto textBoxVector = tempPage->textList();
-    for (auto& textBox : textBoxVector) {
-        entry->textBoxes.append(textBox.release()); // Transfer ownership to cache entry
-        entry->pageNumbers.append(pageNumber); // Track page number for each text box
+        return nullptr;
     }
-    // tempPage automatically destroyed here, releasing Poppler::Page resources
-}
-
-void InkCanvas::loadPdfTextBoxesForCombinedCanvas(int pageNumber, int singlePageHeight, TextBoxCacheEntry* entry) {
-    // For combined canvas showing pages N and N+1:
-    // - Top half shows page N (coordinates as-is)
-    // - Bottom half shows page N+1 (coordinates will be adjusted in mapping functions)
     
-    // Load text boxes for top half (page N) - use temporary local page object
-    {
-        std::unique_ptr<Poppler::Page> tempPage(pdfDocument->page(pageNumber));
-        if (tempPage) {
-            // ✅ Cache the page size for coordinate mapping (lightweight)
-            pdfPageSizeCache[pageNumber] = tempPage->pageSizeF();
-            currentTextPageNumber = pageNumber;
-            
-            auto topTextBoxVector = tempPage->textList();
-        for (auto& textBox : topTextBoxVector) {
-            // Text boxes for top half keep their original coordinates
-                entry->textBoxes.append(textBox.release());
-                entry->pageNumbers.append(pageNumber); // Track as page N
-        }
-        }
-        // tempPage automatically destroyed here
-    }
+    PdfPageText *pageText = new PdfPageText(PdfPageText::extract(tempPage.get(), pageNumber));
+    qsizetype cost = pageText->memoryUsage();
     
-    // Load text boxes for bottom half (page N+1) if it exists
-    int nextPageNumber = pageNumber + 1;
-    if (nextPageNumber < pdfDocument->numPages()) {
-        std::unique_ptr<Poppler::Page> tempPageSecond(pdfDocument->page(nextPageNumber));
-        if (tempPageSecond) {
-            // ✅ Cache the page size for coordinate mapping (lightweight)
-            pdfPageSizeCache[nextPageNumber] = tempPageSecond->pageSizeF();
-            currentTextPageNumberSecond = nextPageNumber;
-            
-            auto bottomTextBoxVector = tempPageSecond->textList();
-            for (auto& textBox : bottomTextBoxVector) {
-                // Text boxes for bottom half - coordinates will be adjusted in mapping functions
-                entry->textBoxes.append(textBox.release());
-                entry->pageNumbers.append(nextPageNumber); // Track as page N+1
-            }
-        }
-        // tempPageSecond automatically destroyed here
+    // QCache deletes an object that can't fit right away, so keep the pointer only if it was stored
+    if (!pdfTextCache.insert(pageNumber, pageText, cost)) {
+        return nullptr;
     }
+    return pdfTextCache.object(pageNumber);
 }
 
 QPointF InkCanvas::mapWidgetToPdfCoordinates(const QPointF &widgetPoint) {
@@ -3784,8 +3924,8 @@ QPointF InkCanvas::mapPdfToWidgetCoordinates(const QPointF &pdfPoint, int pageNu
     if (isCombinedCanvas && pageNumber != -1) {
         // Find the base page number (first page of the combined canvas)
         int basePage = -1;
-        if (!currentPdfTextBoxPageNumbers.empty()) {
-            basePage = currentPdfTextBoxPageNumbers[0];
+        if (!currentTextLayout.isEmpty()) {
+            basePage = currentTextLayout.pageNumber(0);
         }
         
         if (pageNumber > basePage && currentTextPageNumberSecond >= 0) {
@@ -3849,7 +3989,7 @@ QPointF InkCanvas::mapPdfToWidgetCoordinates(const QPointF &pdfPoint, int pageNu
 
 void InkCanvas::updatePdfTextSelection(const QPointF &start, const QPointF &end, bool isFinal) {
     // Early return if PDF is not loaded or no text boxes available
-    if (!isPdfLoaded || currentPdfTextBoxes.isEmpty()) {
+    if (!isPdfLoaded || currentTextLayout.isEmpty()) {
         return;
     }
 
@@ -3862,13 +4002,13 @@ void InkCanvas::updatePdfTextSelection(const QPointF &start, const QPointF &end,
     
     // If distance is too small, treat it as a single click and don't select anything
     if (dragDistance < minDragDistance) {
-        selectedTextBoxes.clear();
+        clearSelectedTextBoxes();
         update();
         return;
     }
 
     // Clear previous selection efficiently
-    selectedTextBoxes.clear();
+    clearSelectedTextBoxes();
 
     // Check if this is a combined canvas
     bool isCombinedCanvas = false;
@@ -3881,7 +4021,7 @@ void InkCanvas::updatePdfTextSelection(const QPointF &start, const QPointF &end,
         singlePageHeight = buffer.height() / 2;
     }
 
-    // Convert widget coordinates to PDF coordinates for start and end points
+    // Convert widget coordinates to buffer coordinates for start and end points
     QPointF startBuffer = mapWidgetToCanvas(start);
     QPointF endBuffer = mapWidgetToCanvas(end);
     
@@ -3889,149 +4029,107 @@ void InkCanvas::updatePdfTextSelection(const QPointF &start, const QPointF &end,
     int basePage = currentTextPageNumber;
     if (basePage < 0) basePage = currentCachedPage;
     
-    // Structure to hold text box info with position for sorting
-    struct TextBoxInfo {
-        Poppler::TextBox* textBox;
-        int pageNumber;
-        QRectF boundingBox; // In PDF coordinates
-        qreal centerY;      // For row-based sorting
-        qreal centerX;      // For left-to-right sorting within rows
-        int originalIndex;  // To preserve order when needed
+    // Mapping from a page's PDF coordinates to buffer coordinates (bottom page is offset in combined mode)
+    const qreal bufferHeight = isCombinedCanvas ? singlePageHeight : buffer.height();
+    auto pageToBuffer = [&](int pageNumber, qreal &scaleX, qreal &scaleY, qreal &yOffset) -> bool {
+        QSizeF pageSize = pdfPageSizeCache.value(pageNumber, QSizeF());
+        if (pageSize.isEmpty()) return false;
+        scaleX = buffer.width() / pageSize.width();
+        scaleY = bufferHeight / pageSize.height();
+        yOffset = (isCombinedCanvas && pageNumber == basePage + 1) ? singlePageHeight : 0;
+        return true;
     };
     
-    QList<TextBoxInfo> textBoxInfoList;
-    textBoxInfoList.reserve(currentPdfTextBoxes.size());
-    
-    // Build list of text boxes with position info
-    for (int i = 0; i < currentPdfTextBoxes.size(); ++i) {
-        const Poppler::TextBox* textBox = currentPdfTextBoxes[i];
-        if (!textBox) continue;
-        
-        int textBoxPage = (i < currentPdfTextBoxPageNumbers.size()) ? currentPdfTextBoxPageNumbers[i] : -1;
-        if (textBoxPage < 0) continue;
-        
-        TextBoxInfo info;
-        info.textBox = const_cast<Poppler::TextBox*>(textBox);
-        info.pageNumber = textBoxPage;
-        info.boundingBox = textBox->boundingBox();
-        info.originalIndex = i;
+    // ✅ Reading order only depends on the text boxes and the buffer geometry, so it is
+    // sorted once per layout instead of on every throttled update
+    if (textReadingOrder.page != basePage || textReadingOrder.bufferSize != buffer.size() ||
+        textReadingOrder.singlePageHeight != singlePageHeight) {
+        struct TextBoxInfo {
+            int index;          // Index into currentTextLayout
+            int pageNumber;
+            qreal centerY;      // For row-based sorting (buffer coordinates)
+            qreal centerX;      // For left-to-right sorting within rows
+        };
+        
+        QList<TextBoxInfo> textBoxInfoList;
+        textBoxInfoList.reserve(currentTextLayout.size());
+        for (int i = 0; i < currentTextLayout.size(); ++i) {
+            int textBoxPage = currentTextLayout.pageNumber(i);
+            
+            qreal scaleX, scaleY, yOffset;
+            if (!pageToBuffer(textBoxPage, scaleX, scaleY, yOffset)) continue;
+            
+            QRectF boundingBox = currentTextLayout.rect(i);
+            TextBoxInfo info;
+            info.index = i;
+            info.pageNumber = textBoxPage;
+            info.centerX = (boundingBox.left() + boundingBox.right()) / 2.0 * scaleX;
+            info.centerY = (boundingBox.top() + boundingBox.bottom()) / 2.0 * scaleY + yOffset;
+            textBoxInfoList.append(info);
+        }
+        
+        // Sort text boxes by reading order: top-to-bottom, then left-to-right
+        // Use a tolerance for "same row" detection (~10 pixels in buffer coordinates)
+        const qreal rowTolerance = 10.0;
+        std::sort(textBoxInfoList.begin(), textBoxInfoList.end(), 
+                  [rowTolerance](const TextBoxInfo &a, const TextBoxInfo &b) {
+            // First sort by page number
+            if (a.pageNumber != b.pageNumber) {
+                return a.pageNumber < b.pageNumber;
+            }
+            // Then by row (Y position with tolerance)
+            if (std::abs(a.centerY - b.centerY) > rowTolerance) {
+                return a.centerY < b.centerY;
+            }
+            // Same row: sort left to right
+            return a.centerX < b.centerX;
+        });
         
-        // Calculate position for sorting (in buffer coordinate system for consistency)
-        // For combined canvas, offset bottom page text boxes
-        qreal yOffset = 0;
-        if (isCombinedCanvas && textBoxPage == basePage + 1) {
-            yOffset = singlePageHeight;
+        textReadingOrder.page = basePage;
+        textReadingOrder.bufferSize = buffer.size();
+        textReadingOrder.singlePageHeight = singlePageHeight;
+        textReadingOrder.order.clear();
+        textReadingOrder.rank.fill(-1, currentTextLayout.size());
+        for (const TextBoxInfo &info : std::as_const(textBoxInfoList)) {
+            textReadingOrder.rank[info.index] = textReadingOrder.order.size();
+            textReadingOrder.order.append(info.index);
         }
-        
-        // Get page size for coordinate conversion
-        QSizeF pageSize = pdfPageSizeCache.value(textBoxPage, QSizeF());
-        if (pageSize.isEmpty()) continue;
-        
-        // Convert PDF box to buffer coordinates for consistent sorting
-        qreal bufferWidth = isCombinedCanvas ? buffer.width() : buffer.width();
-        qreal bufferHeight = isCombinedCanvas ? singlePageHeight : buffer.height();
-        qreal scaleX = bufferWidth / pageSize.width();
-        qreal scaleY = bufferHeight / pageSize.height();
-        
-        qreal boxCenterX = (info.boundingBox.left() + info.boundingBox.right()) / 2.0 * scaleX;
-        qreal boxCenterY = (info.boundingBox.top() + info.boundingBox.bottom()) / 2.0 * scaleY + yOffset;
-        
-        info.centerX = boxCenterX;
-        info.centerY = boxCenterY;
-        
-        textBoxInfoList.append(info);
     }
     
-    if (textBoxInfoList.isEmpty()) {
+    if (textReadingOrder.order.isEmpty()) {
         update();
         return;
     }
     
-    // Sort text boxes by reading order: top-to-bottom, then left-to-right
-    // Use a tolerance for "same row" detection (~10 pixels in buffer coordinates)
-    const qreal rowTolerance = 10.0;
-    std::sort(textBoxInfoList.begin(), textBoxInfoList.end(), 
-              [rowTolerance](const TextBoxInfo &a, const TextBoxInfo &b) {
-        // First sort by page number
-        if (a.pageNumber != b.pageNumber) {
-            return a.pageNumber < b.pageNumber;
-        }
-        // Then by row (Y position with tolerance)
-        if (std::abs(a.centerY - b.centerY) > rowTolerance) {
-            return a.centerY < b.centerY;
-        }
-        // Same row: sort left to right
-        return a.centerX < b.centerX;
-    });
-    
-    // Helper lambda to find the closest text box to a point
-    // This checks if the point is inside a text box first, then finds the nearest one
-    auto findClosestTextBox = [&textBoxInfoList, singlePageHeight, isCombinedCanvas, basePage, this]
-                               (const QPointF &point) -> int {
-        int closestIndex = -1;
+    // Find the text box closest to a buffer point (reading order position, -1 if none).
+    // Each page's grid only visits the cells around the point instead of every text box.
+    auto findClosestTextBox = [&](const QPointF &point) -> int {
+        int closestRank = -1;
         qreal minDist = std::numeric_limits<qreal>::max();
         
-        for (int i = 0; i < textBoxInfoList.size(); ++i) {
-            const TextBoxInfo &info = textBoxInfoList[i];
-            
-            // Reconstruct the text box bounds in buffer coordinates for accurate checking
-            int textBoxPage = info.pageNumber;
-            QSizeF pageSize = pdfPageSizeCache.value(textBoxPage, QSizeF());
-            if (pageSize.isEmpty()) continue;
+        for (auto it = currentTextBoxGrids.constBegin(); it != currentTextBoxGrids.constEnd(); ++it) {
+            qreal scaleX, scaleY, yOffset;
+            if (!pageToBuffer(it.key(), scaleX, scaleY, yOffset)) continue;
             
-            qreal yOffset = 0;
-            if (isCombinedCanvas && textBoxPage == basePage + 1) {
-                yOffset = singlePageHeight;
-            }
-            
-            qreal bufferWidth = isCombinedCanvas ? buffer.width() : buffer.width();
-            qreal bufferHeight = isCombinedCanvas ? singlePageHeight : buffer.height();
-            qreal scaleX = bufferWidth / pageSize.width();
-            qreal scaleY = bufferHeight / pageSize.height();
-            
-            // Convert PDF bounding box to buffer coordinates
-            QRectF boxInBuffer(
-                info.boundingBox.left() * scaleX,
-                info.boundingBox.top() * scaleY + yOffset,
-                info.boundingBox.width() * scaleX,
-                info.boundingBox.height() * scaleY
-            );
+            // Search in the page's PDF coordinates, measuring distances in buffer pixels
+            QPointF pdfPoint(point.x() / scaleX, (point.y() - yOffset) / scaleY);
+            qreal dist = 0;
+            int index = it.value().nearest(pdfPoint, scaleX, scaleY, &dist);
+            if (index < 0) continue;
             
-            qreal dist;
-            
-            // Check if point is inside the text box
-            if (boxInBuffer.contains(point)) {
-                // Point is inside - prioritize this with very small distance
-                // Use horizontal distance within the box for sub-selection priority
-                qreal horizontalPos = (point.x() - boxInBuffer.left()) / boxInBuffer.width();
-                dist = horizontalPos * 0.1; // Very small distance, ordered by horizontal position
-            } else {
-                // Point is outside - calculate distance to nearest edge/corner of the box
-                qreal dx = 0;
-                qreal dy = 0;
-                
-                if (point.x() < boxInBuffer.left()) {
-                    dx = boxInBuffer.left() - point.x();
-                } else if (point.x() > boxInBuffer.right()) {
-                    dx = point.x() - boxInBuffer.right();
-                }
-                
-                if (point.y() < boxInBuffer.top()) {
-                    dy = boxInBuffer.top() - point.y();
-                } else if (point.y() > boxInBuffer.bottom()) {
-                    dy = point.y() - boxInBuffer.bottom();
-                }
-                
-                dist = std::sqrt(dx * dx + dy * dy);
+            index += currentTextLayout.pageStart(it.key()); // Grid ids are relative to the page
+            if (index >= textReadingOrder.rank.size() || textReadingOrder.rank[index] < 0) {
+                continue;
             }
             
-            if (dist < minDist) {
+            int rank = textReadingOrder.rank[index];
+            if (dist < minDist || (dist == minDist && rank < closestRank)) {
                 minDist = dist;
-                closestIndex = i;
+                closestRank = rank;
             }
         }
         
-        return closestIndex;
+        return closestRank;
     };
     
     // Find the text box closest to start point
@@ -4049,12 +4147,13 @@ void InkCanvas::updatePdfTextSelection(const QPointF &start, const QPointF &end,
         
         // Add all text boxes in the range
         for (int i = startIndex; i <= endIndex; ++i) {
-            selectedTextBoxes.append(textBoxInfoList[i].textBox);
+            selectedTextWords.append(textReadingOrder.order[i]);
         }
     }
+    rebuildSelectionRows();
     
     // Only emit signal and update if we have selected text
-    if (!selectedTextBoxes.isEmpty()) {
+    if (!selectedTextWords.isEmpty()) {
         QString selectedText = getSelectedPdfText();
         if (!selectedText.isEmpty()) {
             emit pdfTextSelected(selectedText);
@@ -4065,8 +4164,8 @@ void InkCanvas::updatePdfTextSelection(const QPointF &start, const QPointF &end,
     update();
 }
 
-QList<Poppler::TextBox*> InkCanvas::getTextBoxesInSelection(const QPointF &start, const QPointF &end) {
-    QList<Poppler::TextBox*> selectedBoxes;
+QList<int> InkCanvas::getTextWordsInSelection(const QPointF &start, const QPointF &end) {
+    QList<int> selectedBoxes;
     
     if (currentTextPageNumber < 0) {
         return selectedBoxes;
@@ -4092,60 +4191,35 @@ QList<Poppler::TextBox*> InkCanvas::getTextBoxesInSelection(const QPointF &start
         QRectF selectionRect(pdfStart, pdfEnd);
         selectionRect = selectionRect.normalized();
         
-        // Check all text boxes
-        for (Poppler::TextBox* textBox : currentPdfTextBoxes) {
-            if (textBox) {
-                QRectF textBoxRect = textBox->boundingBox();
-                if (textBoxRect.intersects(selectionRect)) {
-                    selectedBoxes.append(textBox);
-                }
-            }
+        // Only text boxes in the grid cells under the selection are tested
+        const int pageStart = currentTextLayout.pageStart(currentTextPageNumber);
+        for (int index : currentTextBoxGrids.value(currentTextPageNumber).query(selectionRect)) {
+            selectedBoxes.append(pageStart + index);
         }
     } else {
         // Combined canvas mode - handle each page separately
-        if (currentPdfTextBoxPageNumbers.isEmpty()) {
+        if (currentTextLayout.isEmpty()) {
             return selectedBoxes;
         }
         
-        int basePage = currentPdfTextBoxPageNumbers.first();
+        int basePage = currentTextLayout.pageNumber(0);
         
         // Determine which page(s) the selection spans
         bool selectsTopHalf = (start.y() < singlePageHeight || end.y() < singlePageHeight);
         bool selectsBottomHalf = (start.y() >= singlePageHeight || end.y() >= singlePageHeight);
         
-        // Process each text box
-        for (int i = 0; i < currentPdfTextBoxes.size(); ++i) {
-            Poppler::TextBox* textBox = currentPdfTextBoxes[i];
-            if (!textBox || i >= currentPdfTextBoxPageNumbers.size()) {
-                continue;
-            }
-            
-            int textBoxPage = currentPdfTextBoxPageNumbers[i];
-            bool isTopPage = (textBoxPage == basePage);
-            bool isBottomPage = (textBoxPage == basePage + 1);
-            
-            // Skip text boxes on pages we're not selecting
-            if (isTopPage && !selectsTopHalf) {
-                continue;
-            }
-            if (isBottomPage && !selectsBottomHalf) {
+        // Create selection rectangle in widget space
+        QRectF widgetSelectionRect(start, end);
+        widgetSelectionRect = widgetSelectionRect.normalized();
+        
+        // Query each page's grid with the part of the selection over that page
+        for (int half = 0; half < 2; ++half) {
+            if ((half == 0 && !selectsTopHalf) || (half == 1 && !selectsBottomHalf)) {
                 continue;
             }
             
-            // Create selection rectangle in widget space for this page's region
-            QRectF widgetSelectionRect(start, end);
-            widgetSelectionRect = widgetSelectionRect.normalized();
-            
             // Clip selection to this page's region in widget space
-            QRectF pageRegionWidget;
-            if (isTopPage) {
-                // Top half: Y from 0 to singlePageHeight
-                pageRegionWidget = QRectF(0, 0, buffer.width(), singlePageHeight);
-            } else {
-                // Bottom half: Y from singlePageHeight to buffer.height()
-                pageRegionWidget = QRectF(0, singlePageHeight, buffer.width(), singlePageHeight);
-            }
-            
+            QRectF pageRegionWidget(0, half * singlePageHeight, buffer.width(), singlePageHeight);
             QRectF clippedWidgetRect = widgetSelectionRect.intersected(pageRegionWidget);
             
             if (clippedWidgetRect.isEmpty()) {
@@ -4159,11 +4233,9 @@ QList<Poppler::TextBox*> InkCanvas::getTextBoxesInSelection(const QPointF &start
             QRectF selectionRect(pdfTopLeft, pdfBottomRight);
             selectionRect = selectionRect.normalized();
             
-            // Check intersection
-            QRectF textBoxRect = textBox->boundingBox();
-            
-            if (textBoxRect.intersects(selectionRect)) {
-                selectedBoxes.append(textBox);
+            const int pageStart = currentTextLayout.pageStart(basePage + half);
+            for (int index : currentTextBoxGrids.value(basePage + half).query(selectionRect)) {
+                selectedBoxes.append(pageStart + index);
             }
         }
     }
@@ -4172,51 +4244,26 @@ QList<Poppler::TextBox*> InkCanvas::getTextBoxesInSelection(const QPointF &start
 }
 
 void InkCanvas::handlePdfLinkClick(const QPointF &position) {
-    if (!isPdfLoaded || currentTextPageNumber < 0) {
-        return;
+    if (const PdfPageLink *link = pdfLinkAt(position, true)) {
+        emit pdfLinkClicked(link->targetPage);
     }
+}
 
-    // Convert widget coordinates to PDF coordinates
-    QPointF pdfPoint = mapWidgetToPdfCoordinates(position);
-    
-    // Get PDF page size from cache
-    if (!pdfPageSizeCache.contains(currentTextPageNumber)) {
-        return;
+// Hit test against the page's link map (extracted with its text, usually by a prefetch worker).
+// With extractIfMissing false this never calls into Poppler, so it is cheap enough for hover.
+const PdfPageLink *InkCanvas::pdfLinkAt(const QPointF &position, bool extractIfMissing) {
+    if (!isPdfLoaded || currentTextPageNumber < 0) {
+        return nullptr;
     }
-    QSizeF pdfPageSize = pdfPageSizeCache[currentTextPageNumber];
-    
-    // Convert to normalized coordinates (0.0 to 1.0) to match Poppler's link coordinate system
-    QPointF normalizedPoint(pdfPoint.x() / pdfPageSize.width(), pdfPoint.y() / pdfPageSize.height());
     
-    // ✅ Create temporary page to get links (will be destroyed at end of function)
-    std::unique_ptr<Poppler::Page> tempPage(pdfDocument->page(currentTextPageNumber));
-    if (!tempPage) {
-        return;
+    const PdfPageText *pageText = extractIfMissing ? pdfPageText(currentTextPageNumber)
+                                                   : pdfTextCache.object(currentTextPageNumber);
+    if (!pageText || pageText->links.isEmpty()) {
+        return nullptr;
     }
     
-    // Get links for the current page
-    auto links = tempPage->links();
-    
-    for (const auto& link : links) {
-        QRectF linkArea = link->linkArea();
-        
-        // Normalize the rectangle to handle negative width/height
-        QRectF normalizedLinkArea = linkArea.normalized();
-        
-        // Check if the normalized rectangle contains the normalized point
-        if (normalizedLinkArea.contains(normalizedPoint)) {
-            // Handle different types of links
-            if (link->linkType() == Poppler::Link::Goto) {
-                Poppler::LinkGoto* gotoLink = static_cast<Poppler::LinkGoto*>(link.get());
-                if (gotoLink && gotoLink->destination().pageNumber() >= 0) {
-                    int targetPage = gotoLink->destination().pageNumber() - 1; // Convert to 0-based
-                    emit pdfLinkClicked(targetPage);
-                    return;
-                }
-            }
-            // Add other link types as needed (URI, etc.)
-        }
-    }
+    // Convert widget coordinates to PDF coordinates
+    return pageText->linkAt(mapWidgetToPdfCoordinates(position));
 }
 
 void InkCanvas::showPdfTextSelectionMenu(const QPoint &position) {
@@ -4307,7 +4354,7 @@ void InkCanvas::showPdfTextSelectionMenu(const QPoint &position) {
 
 // Add a persistent highlight from the current text selection
 void InkCanvas::addHighlightFromSelection() {
-    if (selectedTextBoxes.isEmpty()) {
+    if (selectedTextWords.isEmpty()) {
         return; // No selection to highlight
     }
     
@@ -4317,42 +4364,29 @@ void InkCanvas::addHighlightFromSelection() {
     QString combinedText;
     int highlightPage = -1;
     
-    for (int i = 0; i < selectedTextBoxes.size(); ++i) {
-        const Poppler::TextBox* textBox = selectedTextBoxes[i];
-        if (textBox) {
-            // Get page number for this text box
-            int pageNumber = -1;
-            for (int j = 0; j < currentPdfTextBoxes.size(); ++j) {
-                if (currentPdfTextBoxes[j] == textBox) {
-                    pageNumber = (j < currentPdfTextBoxPageNumbers.size()) ? 
-                                currentPdfTextBoxPageNumbers[j] : -1;
-                    break;
-                }
-            }
-            
-            if (highlightPage == -1) {
-                highlightPage = pageNumber;
-            }
-            
-            // Store individual text box rectangle
-            QRectF bbox = textBox->boundingBox();
-            individualRects.append(bbox);
-            
-            // Also create combined bounding box for intersection checks
-            if (combinedBoundingBox.isNull()) {
-                combinedBoundingBox = bbox;
-            } else {
-                combinedBoundingBox = combinedBoundingBox.united(bbox);
-            }
-            
-            // Combine text
-            QString text = textBox->text();
-            if (!text.isEmpty()) {
-                if (!combinedText.isEmpty()) {
-                    combinedText += " ";
-                }
-                combinedText += text;
+    for (int word : std::as_const(selectedTextWords)) {
+        if (highlightPage == -1) {
+            highlightPage = currentTextLayout.pageNumber(word);
+        }
+        
+        // Store individual text box rectangle
+        QRectF bbox = currentTextLayout.rect(word);
+        individualRects.append(bbox);
+        
+        // Also create combined bounding box for intersection checks
+        if (combinedBoundingBox.isNull()) {
+            combinedBoundingBox = bbox;
+        } else {
+            combinedBoundingBox = combinedBoundingBox.united(bbox);
+        }
+        
+        // Combine text
+        QStringView text = currentTextLayout.text(word);
+        if (!text.isEmpty()) {
+            if (!combinedText.isEmpty()) {
+                combinedText += " ";
             }
+            combinedText += text;
         }
     }
     
@@ -4366,12 +4400,13 @@ void InkCanvas::addHighlightFromSelection() {
     highlight.pageNumber = highlightPage;
     highlight.boundingBox = combinedBoundingBox; // For intersection checks
     highlight.textBoxRects = individualRects; // For precise rendering
+    highlight.rowRects = TextHighlight::mergeRows(individualRects); // Merged once, drawn on every paint
     highlight.text = combinedText;
     highlight.color = penColor; // Use current pen color
     highlight.markdownWindowId = ""; // No markdown window yet (for Step 3)
     
     // Add to persistent highlights
-    persistentHighlights.append(highlight);
+    annotationStore.addHighlight(highlight);
     
     // Save to metadata
     saveHighlightsToMetadata();
@@ -4379,46 +4414,19 @@ void InkCanvas::addHighlightFromSelection() {
     // Mark as edited
     setEdited(true);
     
-    // Clear PDF cache and refresh current page to show new highlight immediately
-    clearPdfCache();
-    refreshCurrentPdfPage();
+    // Repaint the highlight overlay (the cached PDF render is untouched)
+    invalidateHighlightOverlay();
 }
 
 // Remove highlight(s) that overlap with the current selection
 void InkCanvas::removeHighlightAtSelection() {
-    if (selectedTextBoxes.isEmpty()) {
+    if (selectedTextWords.isEmpty()) {
         return; // No selection
     }
     
     // Get the combined bounding box of the selection
     QRectF selectionBoundingBox;
-    int selectionPage = -1;
-    
-    for (int i = 0; i < selectedTextBoxes.size(); ++i) {
-        const Poppler::TextBox* textBox = selectedTextBoxes[i];
-        if (textBox) {
-            // Get page number for this text box
-            int pageNumber = -1;
-            for (int j = 0; j < currentPdfTextBoxes.size(); ++j) {
-                if (currentPdfTextBoxes[j] == textBox) {
-                    pageNumber = (j < currentPdfTextBoxPageNumbers.size()) ? 
-                                currentPdfTextBoxPageNumbers[j] : -1;
-                    break;
-                }
-            }
-            
-            if (selectionPage == -1) {
-                selectionPage = pageNumber;
-            }
-            
-            QRectF bbox = textBox->boundingBox();
-            if (selectionBoundingBox.isNull()) {
-                selectionBoundingBox = bbox;
-            } else {
-                selectionBoundingBox = selectionBoundingBox.united(bbox);
-            }
-        }
-    }
+    int selectionPage = selectionPageAndBounds(selectionBoundingBox);
     
     if (selectionPage == -1) {
         return;
@@ -4428,39 +4436,38 @@ void InkCanvas::removeHighlightAtSelection() {
     bool removed = false;
     QStringList removedHighlightIds; // Track IDs for cascade deletion of notes
     
-    for (int i = persistentHighlights.size() - 1; i >= 0; --i) {
-        const TextHighlight &highlight = persistentHighlights[i];
-        if (highlight.pageNumber == selectionPage && 
-            highlight.boundingBox.intersects(selectionBoundingBox)) {
+    const QList<TextHighlight> pageHighlights = annotationStore.highlights(selectionPage);
+    for (const TextHighlight &highlight : pageHighlights) {
+        if (highlight.boundingBox.intersects(selectionBoundingBox)) {
             // Track this highlight's ID for note cleanup
             if (!highlight.markdownWindowId.isEmpty()) {
                 removedHighlightIds.append(highlight.id);
             }
-            persistentHighlights.removeAt(i);
+            annotationStore.removeHighlight(highlight.id);
             removed = true;
         }
     }
     
-    // CASCADE DELETE: Remove notes linked to deleted highlights
-    for (const QString &highlightId : removedHighlightIds) {
-        for (int i = markdownNotes.size() - 1; i >= 0; --i) {
-            if (markdownNotes[i].highlightId == highlightId) {
-                qDebug() << "Cascade deleting orphaned note:" << markdownNotes[i].id;
-                markdownNotes.removeAt(i);
+    // CASCADE DELETE: Remove notes linked to deleted highlights (notes share their highlight's page)
+    if (!removedHighlightIds.isEmpty()) {
+        const QList<MarkdownNoteData> pageNotes = annotationStore.notes(selectionPage);
+        for (const MarkdownNoteData &pageNote : pageNotes) {
+            if (removedHighlightIds.contains(pageNote.highlightId)) {
+                qDebug() << "Cascade deleting orphaned note:" << pageNote.id;
+                annotationStore.removeNote(pageNote.id);
             }
         }
     }
     
     if (removed) {
-        // Save to metadata (both highlights and notes)
-        saveNotebookMetadata();
+        // Save the changed page (both highlights and notes)
+        saveHighlightsToMetadata();
         
         // Mark as edited
         setEdited(true);
         
-        // Clear PDF cache and refresh current page to remove highlight immediately
-        clearPdfCache();
-        refreshCurrentPdfPage();
+        // Repaint the highlight overlay (the cached PDF render is untouched)
+        invalidateHighlightOverlay();
         
         // Emit signal to update UI (note list needs to refresh)
         if (!removedHighlightIds.isEmpty()) {
@@ -4471,48 +4478,22 @@ void InkCanvas::removeHighlightAtSelection() {
 
 // Check if the current selection overlaps with any persistent highlight
 bool InkCanvas::isSelectionHighlighted() const {
-    if (selectedTextBoxes.isEmpty()) {
+    if (selectedTextWords.isEmpty()) {
         return false;
     }
     
     // Get the combined bounding box of the selection
     QRectF selectionBoundingBox;
-    int selectionPage = -1;
-    
-    for (int i = 0; i < selectedTextBoxes.size(); ++i) {
-        const Poppler::TextBox* textBox = selectedTextBoxes[i];
-        if (textBox) {
-            // Get page number for this text box
-            int pageNumber = -1;
-            for (int j = 0; j < currentPdfTextBoxes.size(); ++j) {
-                if (currentPdfTextBoxes[j] == textBox) {
-                    pageNumber = (j < currentPdfTextBoxPageNumbers.size()) ? 
-                                currentPdfTextBoxPageNumbers[j] : -1;
-                    break;
-                }
-            }
-            
-            if (selectionPage == -1) {
-                selectionPage = pageNumber;
-            }
-            
-            QRectF bbox = textBox->boundingBox();
-            if (selectionBoundingBox.isNull()) {
-                selectionBoundingBox = bbox;
-            } else {
-                selectionBoundingBox = selectionBoundingBox.united(bbox);
-            }
-        }
-    }
+    int selectionPage = selectionPageAndBounds(selectionBoundingBox);
     
     if (selectionPage == -1) {
         return false;
     }
     
     // Check if any highlight intersects with the selection
-    for (const TextHighlight &highlight : persistentHighlights) {
-        if (highlight.pageNumber == selectionPage && 
-            highlight.boundingBox.intersects(selectionBoundingBox)) {
+    const QList<TextHighlight> pageHighlights = annotationStore.highlights(selectionPage);
+    for (const TextHighlight &highlight : pageHighlights) {
+        if (highlight.boundingBox.intersects(selectionBoundingBox)) {
             return true;
         }
     }
@@ -4522,19 +4503,17 @@ bool InkCanvas::isSelectionHighlighted() const {
 
 // Get all highlights for a specific page
 QList<TextHighlight> InkCanvas::getHighlightsForPage(int pageNumber) const {
-    QList<TextHighlight> pageHighlights;
-    for (const TextHighlight &highlight : persistentHighlights) {
-        if (highlight.pageNumber == pageNumber) {
-            pageHighlights.append(highlight);
-        }
-    }
-    return pageHighlights;
+    return annotationStore.highlights(pageNumber);
 }
 
-// Save highlights to metadata (standalone method for Step 3)
+// Save highlights and notes: only the page shards that changed are rewritten
 void InkCanvas::saveHighlightsToMetadata() {
-    // Just call the main save function which now includes highlights
-    saveNotebookMetadata();
+    annotationStore.flush();
+    
+    // ✅ Sync changes to .spn package if needed
+    syncSpnPackage();
+    
+    updateNotebookSearchIndex();
 }
 
 // Load highlights from metadata (standalone method for Step 3)
@@ -4549,7 +4528,7 @@ void InkCanvas::loadHighlightsFromMetadata() {
 
 // Add a markdown note from current text selection
 QString InkCanvas::addMarkdownNoteFromSelection() {
-    if (selectedTextBoxes.isEmpty()) {
+    if (selectedTextWords.isEmpty()) {
         return QString(); // No selection
     }
     
@@ -4558,42 +4537,18 @@ QString InkCanvas::addMarkdownNoteFromSelection() {
     
     // Get the combined bounding box of the selection
     QRectF selectionBoundingBox;
-    int selectionPage = -1;
-    
-    for (int i = 0; i < selectedTextBoxes.size(); ++i) {
-        const Poppler::TextBox* textBox = selectedTextBoxes[i];
-        if (textBox) {
-            // Get page number for this text box
-            int pageNumber = -1;
-            for (int j = 0; j < currentPdfTextBoxes.size(); ++j) {
-                if (currentPdfTextBoxes[j] == textBox) {
-                    pageNumber = (j < currentPdfTextBoxPageNumbers.size()) ? 
-                                currentPdfTextBoxPageNumbers[j] : -1;
-                    break;
-                }
-            }
-            
-            if (selectionPage == -1) {
-                selectionPage = pageNumber;
-            }
-            
-            QRectF bbox = textBox->boundingBox();
-            if (selectionBoundingBox.isNull()) {
-                selectionBoundingBox = bbox;
-            } else {
-                selectionBoundingBox = selectionBoundingBox.united(bbox);
-            }
-        }
+    int selectionPage = selectionPageAndBounds(selectionBoundingBox);
+    
+    if (selectionPage == -1) {
+        return QString();
     }
     
     // Find existing highlight that intersects with the selection
-    if (selectionPage != -1) {
-        for (int i = 0; i < persistentHighlights.size(); ++i) {
-            if (persistentHighlights[i].pageNumber == selectionPage && 
-                persistentHighlights[i].boundingBox.intersects(selectionBoundingBox)) {
-                existingHighlight = &persistentHighlights[i];
-                break;
-            }
+    const QList<TextHighlight> pageHighlights = annotationStore.highlights(selectionPage);
+    for (const TextHighlight &highlight : pageHighlights) {
+        if (highlight.boundingBox.intersects(selectionBoundingBox)) {
+            existingHighlight = findHighlightById(highlight.id);
+            break;
         }
     }
     
@@ -4601,12 +4556,16 @@ QString InkCanvas::addMarkdownNoteFromSelection() {
     if (!existingHighlight) {
         addHighlightFromSelection();
         
-        // Get the just-created highlight (it will be the last one added)
-        if (persistentHighlights.isEmpty()) {
+        // Get the just-created highlight (it will be the last one added to this page)
+        const QList<TextHighlight> updatedHighlights = annotationStore.highlights(selectionPage);
+        if (updatedHighlights.isEmpty()) {
             return QString();
         }
         
-        existingHighlight = &persistentHighlights.last();
+        existingHighlight = findHighlightById(updatedHighlights.last().id);
+        if (!existingHighlight) {
+            return QString();
+        }
     }
     
     // Create a new markdown note linked to the highlight (existing or new)
@@ -4620,12 +4579,13 @@ QString InkCanvas::addMarkdownNoteFromSelection() {
     
     // Link the highlight to this note
     existingHighlight->markdownWindowId = note.id;
+    annotationStore.markPageDirty(existingHighlight->pageNumber);
     
     // Add the note
-    markdownNotes.append(note);
+    annotationStore.addNote(note);
     
-    // Save metadata
-    saveNotebookMetadata();
+    // Save the changed page
+    saveHighlightsToMetadata();
     setEdited(true);
     
     // Emit signal
@@ -4637,79 +4597,67 @@ QString InkCanvas::addMarkdownNoteFromSelection() {
 // Add a markdown note directly
 void InkCanvas::addMarkdownNote(const MarkdownNoteData &note) {
     // Check if note already exists
-    for (int i = 0; i < markdownNotes.size(); ++i) {
-        if (markdownNotes[i].id == note.id) {
-            // Update existing note
-            markdownNotes[i] = note;
-            saveNotebookMetadata();
-            setEdited(true);
-            emit markdownNotesUpdated();
-            return;
-        }
+    if (findMarkdownNote(note.id)) {
+        // Update existing note
+        updateMarkdownNote(note);
+        emit markdownNotesUpdated();
+        return;
     }
     
     // Add new note
-    markdownNotes.append(note);
-    saveNotebookMetadata();
+    annotationStore.addNote(note);
+    saveHighlightsToMetadata();
     setEdited(true);
     emit markdownNotesUpdated();
 }
 
 // Update an existing markdown note
 void InkCanvas::updateMarkdownNote(const MarkdownNoteData &note) {
-    for (int i = 0; i < markdownNotes.size(); ++i) {
-        if (markdownNotes[i].id == note.id) {
-            markdownNotes[i] = note;
-            saveNotebookMetadata();
-            setEdited(true);
-            // DON'T emit markdownNotesUpdated() here - that causes a feedback loop
-            // that reloads all notes and resets the editor on every keystroke!
-            // The signal is only needed when notes are added/removed, not updated.
-            return;
-        }
+    if (!annotationStore.updateNote(note)) {
+        return;
     }
+    
+    saveHighlightsToMetadata();
+    setEdited(true);
+    // DON'T emit markdownNotesUpdated() here - that causes a feedback loop
+    // that reloads all notes and resets the editor on every keystroke!
+    // The signal is only needed when notes are added/removed, not updated.
 }
 
 // Remove a markdown note
 void InkCanvas::removeMarkdownNote(const QString &noteId) {
-    for (int i = 0; i < markdownNotes.size(); ++i) {
-        if (markdownNotes[i].id == noteId) {
-            QString highlightId = markdownNotes[i].highlightId;
-            markdownNotes.removeAt(i);
-            
-            // Unlink from highlight if linked
-            if (!highlightId.isEmpty()) {
-                TextHighlight *highlight = findHighlightById(highlightId);
-                if (highlight) {
-                    highlight->markdownWindowId.clear();
-                }
-            }
-            
-            saveNotebookMetadata();
-            setEdited(true);
-            emit markdownNotesUpdated();
-            return;
+    MarkdownNoteData *note = findMarkdownNote(noteId);
+    if (!note) {
+        return;
+    }
+    
+    QString highlightId = note->highlightId;
+    annotationStore.removeNote(noteId);
+    
+    // Unlink from highlight if linked
+    if (!highlightId.isEmpty()) {
+        TextHighlight *highlight = findHighlightById(highlightId);
+        if (highlight) {
+            highlight->markdownWindowId.clear();
+            annotationStore.markPageDirty(highlight->pageNumber);
         }
     }
+    
+    saveHighlightsToMetadata();
+    setEdited(true);
+    emit markdownNotesUpdated();
 }
 
 // Find a markdown note by ID
 MarkdownNoteData* InkCanvas::findMarkdownNote(const QString &noteId) {
-    for (int i = 0; i < markdownNotes.size(); ++i) {
-        if (markdownNotes[i].id == noteId) {
-            return &markdownNotes[i];
-        }
-    }
-    return nullptr;
+    return annotationStore.findNote(noteId);
 }
 
 // Get markdown notes for specific page(s) - supports combined canvas
 QList<MarkdownNoteData> InkCanvas::getMarkdownNotesForPages(int page1, int page2) const {
-    QList<MarkdownNoteData> pageNotes;
-    for (const MarkdownNoteData &note : markdownNotes) {
-        if (note.pageNumber == page1 || (page2 >= 0 && note.pageNumber == page2)) {
-            pageNotes.append(note);
-        }
+    QList<MarkdownNoteData> pageNotes = annotationStore.notes(page1);
+    if (page2 >= 0 && page2 != page1) {
+        pageNotes.append(annotationStore.notes(page2));
     }
     return pageNotes;
 }
@@ -4719,19 +4667,15 @@ void InkCanvas::linkHighlightToNote(const QString &highlightId, const QString &n
     TextHighlight *highlight = findHighlightById(highlightId);
     if (highlight) {
         highlight->markdownWindowId = noteId;
-        saveNotebookMetadata();
+        annotationStore.markPageDirty(highlight->pageNumber);
+        saveHighlightsToMetadata();
         setEdited(true);
     }
 }
 
 // Find a highlight by ID
 TextHighlight* InkCanvas::findHighlightById(const QString &highlightId) {
-    for (int i = 0; i < persistentHighlights.size(); ++i) {
-        if (persistentHighlights[i].id == highlightId) {
-            return &persistentHighlights[i];
-        }
-    }
-    return nullptr;
+    return annotationStore.findHighlight(highlightId);
 }
 
 // Handle double-click on a highlight
@@ -4755,152 +4699,191 @@ bool InkCanvas::isValidPageNumber(int pageNumber) const {
     return (pageNumber >= 0 && pageNumber < totalPdfPages);
 }
 
-// Helper method to draw highlights onto a PDF page image during rendering/caching
-void InkCanvas::drawHighlightsOnPageImage(QImage &pageImage, int pageNumber, Poppler::Document* pdfDoc) {
-    if (pageImage.isNull() || !pdfDoc || persistentHighlights.isEmpty()) {
-        return;
-    }
+// Mark the highlight overlay as stale and schedule a repaint.
+// Highlights are composited over the cached PDF pixmap, so no re-render is needed.
+void InkCanvas::invalidateHighlightOverlay() {
+    highlightOverlayRevision = 0;
+    update();
+}
+
+// Rebuild the cached highlight rectangles for the page pair currently displayed.
+// Rectangles are stored in canvas (background image) coordinates.
+void InkCanvas::rebuildHighlightOverlay() {
+    highlightOverlayRects.clear();
+    highlightOverlayPage = currentCachedPage;
+    highlightOverlayImageSize = backgroundImage.size();
+    highlightOverlayRevision = annotationStore.revision();
     
-    // Get page size in PDF coordinates
-    std::unique_ptr<Poppler::Page> pdfPage(pdfDoc->page(pageNumber));
-    if (!pdfPage) {
+    if (!pdfDocument || backgroundImage.isNull() || currentCachedPage < 0) {
         return;
     }
-    QSizeF pdfPageSize = pdfPage->pageSizeF();
     
-    // Find all highlights for this page
-    QList<TextHighlight> pageHighlights;
-    for (const TextHighlight &highlight : persistentHighlights) {
-        if (highlight.pageNumber == pageNumber) {
-            pageHighlights.append(highlight);
+    // Page size in PDF coordinates (cheap lookup, no rendering)
+    auto pdfPageSizeOf = [this](int pageNumber) -> QSizeF {
+        QSizeF size = pdfPageSizeCache.value(pageNumber, QSizeF());
+        if (size.isEmpty()) {
+            std::unique_ptr<Poppler::Page> pdfPage(pdfDocument->page(pageNumber));
+            if (pdfPage) {
+                size = pdfPage->pageSizeF();
+            }
         }
-    }
+        return size;
+    };
     
-    if (pageHighlights.isEmpty()) {
-        return; // No highlights for this page
+    QList<TextHighlight> halfHighlights[2];
+    QList<QRectF> halfSearchRects[2];
+    bool anyRects = false;
+    for (int half = 0; half < 2; ++half) {
+        const int pageNumber = currentCachedPage + half;
+        if (!isValidPageNumber(pageNumber)) {
+            continue;
+        }
+        halfHighlights[half] = getHighlightsForPage(pageNumber);
+        halfSearchRects[half] = searchHighlightRects.value(pageNumber);
+        anyRects = anyRects || !halfHighlights[half].isEmpty() || !halfSearchRects[half].isEmpty();
+    }
+    if (!anyRects) {
+        return;
     }
     
-    // Create painter for the image
-    QPainter painter(&pageImage);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    
-    // Calculate scale from PDF coordinates to image coordinates
-    qreal scaleX = pageImage.width() / pdfPageSize.width();
-    qreal scaleY = pageImage.height() / pdfPageSize.height();
+    // The cached PDF background is a combined image: page N at the top and page N+1
+    // (or white space as tall as page N) below it. Both are rendered at one DPI, each
+    // at its own size, so one scale maps PDF points of either page to image pixels.
+    const QSizeF topPageSize = pdfPageSizeOf(currentCachedPage);
+    if (topPageSize.isEmpty()) {
+        return;
+    }
+    const QSizeF bottomPageSize = isValidPageNumber(currentCachedPage + 1) ? pdfPageSizeOf(currentCachedPage + 1)
+                                                                            : QSizeF();
+    const qreal scale = backgroundImage.height() /
+                        (topPageSize.height() + (bottomPageSize.isEmpty() ? topPageSize.height()
+                                                                          : bottomPageSize.height()));
     
-    // Draw each highlight
-    for (const TextHighlight &highlight : pageHighlights) {
-        // Use the stored highlight color with semi-transparency
-        QColor highlightColor = highlight.color;
-        highlightColor.setAlpha(120); // Semi-transparent
+    for (int half = 0; half < 2; ++half) {
+        const QList<TextHighlight> &pageHighlights = halfHighlights[half];
+        const QList<QRectF> &searchRects = halfSearchRects[half];
+        if (pageHighlights.isEmpty() && searchRects.isEmpty()) {
+            continue;
+        }
+        const QSizeF pdfPageSize = half == 0 ? topPageSize : bottomPageSize;
+        if (pdfPageSize.isEmpty()) {
+            continue;
+        }
         
-        painter.setBrush(highlightColor);
-        painter.setPen(Qt::NoPen);
+        // Calculate scale from PDF coordinates to image coordinates
+        qreal scaleX = scale;
+        qreal scaleY = scale;
+        qreal yOffset = half == 0 ? 0.0 : topPageSize.height() * scale;
         
-        // Draw connected rectangles row by row
-        if (!highlight.textBoxRects.isEmpty()) {
-            // Group text boxes by row (using Y-coordinate tolerance)
-            const qreal rowTolerance = 5.0; // PDF coordinate units
-            
-            QList<QList<QRectF>> rowGroups;
-            for (const QRectF &rect : highlight.textBoxRects) {
-                bool addedToRow = false;
-                
-                // Try to add to existing row
-                for (QList<QRectF> &row : rowGroups) {
-                    if (!row.isEmpty()) {
-                        qreal avgY = (row.first().top() + row.first().bottom()) / 2.0;
-                        qreal rectY = (rect.top() + rect.bottom()) / 2.0;
-                        
-                        if (qAbs(avgY - rectY) <= rowTolerance) {
-                            row.append(rect);
-                            addedToRow = true;
-                            break;
-                        }
-                    }
-                }
-                
-                // Create new row if not added
-                if (!addedToRow) {
-                    QList<QRectF> newRow;
-                    newRow.append(rect);
-                    rowGroups.append(newRow);
-                }
-            }
+        for (const TextHighlight &highlight : pageHighlights) {
+            // Use the stored highlight color with semi-transparency
+            QColor highlightColor = highlight.color;
+            highlightColor.setAlpha(120); // Semi-transparent
             
-            // Draw continuous rectangle for each row
-            for (const QList<QRectF> &row : rowGroups) {
-                if (row.isEmpty()) continue;
-                
-                // Find leftmost and rightmost bounds
-                qreal minX = row.first().left();
-                qreal maxX = row.first().right();
-                qreal minY = row.first().top();
-                qreal maxY = row.first().bottom();
-                
-                for (const QRectF &rect : row) {
-                    minX = qMin(minX, rect.left());
-                    maxX = qMax(maxX, rect.right());
-                    minY = qMin(minY, rect.top());
-                    maxY = qMax(maxY, rect.bottom());
-                }
-                
-                // Create continuous rectangle spanning the entire row
-                QRectF pdfRowRect(minX, minY, maxX - minX, maxY - minY);
-                QRectF imageRect(
-                    pdfRowRect.x() * scaleX,
-                    pdfRowRect.y() * scaleY,
-                    pdfRowRect.width() * scaleX,
-                    pdfRowRect.height() * scaleY
+            // Rows were merged when the highlight was created (or loaded from an older notebook)
+            for (const QRectF &pdfRect : highlight.rowRects) {
+                HighlightOverlayRect overlayRect;
+                overlayRect.rect = QRectF(
+                    pdfRect.x() * scaleX,
+                    pdfRect.y() * scaleY + yOffset,
+                    pdfRect.width() * scaleX,
+                    pdfRect.height() * scaleY
                 );
-                painter.drawRect(imageRect);
+                overlayRect.color = highlightColor;
+                highlightOverlayRects.append(overlayRect);
             }
-        } else {
-            // Legacy format: draw combined bounding box (for backward compatibility)
-            QRectF pdfRect = highlight.boundingBox;
-            QRectF imageRect(
+        }
+        
+        // Search hits go on top of the highlights in a fixed color
+        for (const QRectF &pdfRect : searchRects) {
+            HighlightOverlayRect overlayRect;
+            overlayRect.rect = QRectF(
                 pdfRect.x() * scaleX,
-                pdfRect.y() * scaleY,
+                pdfRect.y() * scaleY + yOffset,
                 pdfRect.width() * scaleX,
                 pdfRect.height() * scaleY
             );
-            painter.drawRect(imageRect);
+            overlayRect.color = QColor(255, 150, 0, 110);
+            highlightOverlayRects.append(overlayRect);
         }
     }
-    
-    painter.end();
 }
 
-// Refresh the currently displayed PDF page (for highlight updates)
-// This re-renders and displays the current page without navigation
-void InkCanvas::refreshCurrentPdfPage() {
-    if (!pdfDocument || currentCachedPage < 0) {
+// Draw persistent highlights over the PDF background (painter is in canvas coordinates).
+// The overlay is drawn after the display filter has been applied to the background, so highlight
+// colors look the same in every filter mode and switching filters never touches it.
+void InkCanvas::drawHighlightOverlay(QPainter &painter) {
+    if (!isPdfLoaded || backgroundImage.isNull()) {
         return;
     }
     
-    // Re-render the current page (which is a combined canvas of current + next page)
-    renderPdfPageToCache(currentCachedPage);
+    // ✅ Keyed by the store revision: any highlight change since the last build is picked up here
+    if (highlightOverlayRevision != annotationStore.revision() || highlightOverlayPage != currentCachedPage ||
+        highlightOverlayImageSize != backgroundImage.size()) {
+        rebuildHighlightOverlay();
+    }
     
-    // Update the backgroundImage with the newly rendered cached page
-    {
-        QMutexLocker locker(&pdfCacheMutex);
-        if (pdfCache.contains(currentCachedPage)) {
-            backgroundImage = *pdfCache.object(currentCachedPage);
-        }
+    if (highlightOverlayRects.isEmpty()) {
+        return;
     }
     
-    // Refresh display
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(Qt::NoPen);
+    for (const HighlightOverlayRect &overlayRect : highlightOverlayRects) {
+        painter.setBrush(overlayRect.color);
+        painter.drawRect(overlayRect.rect);
+    }
+    painter.restore();
+}
+
+void InkCanvas::setSearchHighlights(const QHash<int, QList<QRectF>> &pageRects) {
+    searchHighlightRects = pageRects;
+    highlightOverlayRevision = 0; // Force the overlay to be rebuilt on the next paint
+    update();
+}
+
+void InkCanvas::clearSearchHighlights() {
+    if (searchHighlightRects.isEmpty()) {
+        return;
+    }
+    searchHighlightRects.clear();
+    highlightOverlayRevision = 0;
     update();
 }
 
+void InkCanvas::setPDFRenderDPI(int dpi) {
+    if (pdfRenderDPI != dpi) {
+        pdfRenderDPI = dpi;
+        publishRenderSnapshot();
+    }
+}
+
+// Replace the render snapshot. Only the GUI thread calls this; jobs that captured
+// an older snapshot notice the version change and drop their result.
+void InkCanvas::publishRenderSnapshot() {
+    auto snapshot = std::make_shared<PdfRenderSnapshot>();
+    snapshot->version = renderSnapshotVersion.load(std::memory_order_relaxed) + 1;
+    snapshot->dpi = pdfRenderDPI;
+    snapshot->totalPages = totalPdfPages;
+    renderSnapshot = std::move(snapshot);
+    renderSnapshotVersion.store(renderSnapshot->version, std::memory_order_release);
+}
+
 void InkCanvas::renderPdfPageToCache(int pageNumber) {
-    renderPdfPageToCacheThreadSafe(pageNumber, pdfDocument.get());
+    if (!renderSnapshot) {
+        publishRenderSnapshot();
+    }
+    renderPdfPageToCacheThreadSafe(pageNumber, pdfDocument.get(), renderSnapshot);
 }
 
-void InkCanvas::renderPdfPageToCacheThreadSafe(int pageNumber, Poppler::Document* sharedDocument) {
-    if (!sharedDocument || !isValidPageNumber(pageNumber)) {
+void InkCanvas::renderPdfPageToCacheThreadSafe(int pageNumber, Poppler::Document* sharedDocument,
+                                               const std::shared_ptr<const PdfRenderSnapshot> &snapshot) {
+    // ✅ Only the captured snapshot is read here, never members the GUI thread may be changing
+    if (!sharedDocument || !snapshot || pageNumber < 0 || pageNumber >= snapshot->totalPages) {
         return;
     }
+    const int renderDpi = snapshot->dpi;
 
     // Check if already cached and manage cache size (thread-safe)
     {
@@ -4934,34 +4917,19 @@ void InkCanvas::renderPdfPageToCacheThreadSafe(int pageNumber, Poppler::Document
         return;
     }
     
-    QImage currentPageImage = currentPage->renderToImage(pdfRenderDPI, pdfRenderDPI);
+    // ✅ Render unfiltered - display filters (inversion etc.) are applied at paint time
+    QImage currentPageImage = currentPage->renderToImage(renderDpi, renderDpi);
     if (currentPageImage.isNull()) {
         return;
     }
     
-    // Apply PDF inversion if enabled
-    if (pdfInversionEnabled) {
-        currentPageImage = invertPdfImage(currentPageImage);
-    }
-    
-    // Draw highlights on the current page image
-    drawHighlightsOnPageImage(currentPageImage, pageNumber, sharedDocument);
-    
     // Try to render next page for combination
     QImage nextPageImage;
     int nextPageNumber = pageNumber + 1;
-    if (isValidPageNumber(nextPageNumber)) {
+    if (nextPageNumber < snapshot->totalPages) {
         std::unique_ptr<Poppler::Page> nextPage(sharedDocument->page(nextPageNumber));
         if (nextPage) {
-            nextPageImage = nextPage->renderToImage(pdfRenderDPI, pdfRenderDPI);
-            
-            // Apply PDF inversion if enabled
-            if (pdfInversionEnabled) {
-                nextPageImage = invertPdfImage(nextPageImage);
-            }
-            
-            // Draw highlights on the next page image
-            drawHighlightsOnPageImage(nextPageImage, nextPageNumber, sharedDocument);
+            nextPageImage = nextPage->renderToImage(renderDpi, renderDpi);
         }
     }
     
@@ -5010,6 +4978,10 @@ void InkCanvas::renderPdfPageToCacheThreadSafe(int pageNumber, Poppler::Document
         // Create QPixmap directly from QImage without intermediate copy
         {
             QMutexLocker locker(&pdfCacheMutex);
+            // ✅ Stale job (DPI changed, cache cleared or another PDF loaded meanwhile) - drop the result
+            if (snapshot->version != renderSnapshotVersion.load(std::memory_order_acquire)) {
+                return;
+            }
             pdfCache.insert(pageNumber, new QPixmap(QPixmap::fromImage(combinedImage)));
             // ✅ LRU: Add newly cached page to end of access order (most recent)
             pdfCacheAccessOrder.removeAll(pageNumber); // Remove if already present
@@ -5112,9 +5084,38 @@ void InkCanvas::cacheAdjacentPages() {
         return; // No PDF path available
     }
     
+    // ✅ Workers open their documents from the tab's memory mapping instead of re-reading the file
+    std::shared_ptr<PdfFileMapping> sharedPdf = pdfFileMapping;
+    
+    // ✅ Workers read render settings from this snapshot only
+    if (!renderSnapshot) {
+        publishRenderSnapshot();
+    }
+    std::shared_ptr<const PdfRenderSnapshot> snapshot = renderSnapshot;
+    
+    // ✅ Text layout for the displayed pair and its neighbours is extracted on the same workers,
+    // so text selection finds it in pdfTextCache instead of blocking on Poppler at stylus press
+    QSet<int> textPagesToExtract;
+    for (int page : {targetPage, nextPage, prevPage, nextNextPage}) {
+        if (isValidPageNumber(page) && !pdfTextCache.contains(page) && !pendingTextPages.contains(page)) {
+            textPagesToExtract.insert(page);
+            pendingTextPages.insert(page);
+            if (!pagesToCache.contains(page)) {
+                pagesToCache.append(page);
+            }
+        }
+    }
+    
     // ✅ MULTITHREADED OPTIMIZATION: Cache pages truly in parallel with independent document instances
     // Each thread loads its own Poppler::Document to avoid contention on shared resources
     for (int pageNum : pagesToCache) {
+        bool renderPage = false;
+        {
+            QMutexLocker locker(&pdfCacheMutex);
+            renderPage = !pdfCache.contains(pageNum);
+        }
+        bool extractText = textPagesToExtract.contains(pageNum);
+        
         QFutureWatcher<void> *watcher = new QFutureWatcher<void>(this);
         
         // Track the watcher for cleanup
@@ -5127,10 +5128,34 @@ void InkCanvas::cacheAdjacentPages() {
         });
         
         // ✅ Each thread gets its own document instance for true parallel rendering
-        QFuture<void> future = QtConcurrent::run([this, pageNum, pdfFilePath]() {
-            // Load a fresh document instance in this thread (thread-safe, no shared state)
-            std::unique_ptr<Poppler::Document> threadDocument = Poppler::Document::load(pdfFilePath);
+        QFuture<void> future = QtConcurrent::run([this, pageNum, pdfFilePath, sharedPdf, snapshot, renderPage, extractText]() {
+            // Create a fresh document instance in this thread (own read cursor over the shared mapping)
+            PdfDocumentHandle threadHandle = sharedPdf ? sharedPdf->openDocument() : PdfFileMapping::loadDocument(pdfFilePath);
+            Poppler::Document *threadDocument = threadHandle.get();
             if (!threadDocument || threadDocument->isLocked()) {
+                if (extractText) {
+                    // Still report back so the page isn't left marked as pending
+                    QMetaObject::invokeMethod(this, [this, pageNum, pdfFilePath]() {
+                        storePrefetchedPageText(pageNum, pdfFilePath, nullptr);
+                    }, Qt::QueuedConnection);
+                }
+                return;
+            }
+            
+            if (extractText) {
+                // Text extraction only reads this thread's own page object
+                std::unique_ptr<Poppler::Page> textPage(threadDocument->page(pageNum));
+                std::shared_ptr<PdfPageText> pageText;
+                if (textPage) {
+                    pageText = std::make_shared<PdfPageText>(PdfPageText::extract(textPage.get(), pageNum));
+                }
+                // The cache is GUI-thread only; the functor is dropped if this canvas is destroyed first
+                QMetaObject::invokeMethod(this, [this, pageNum, pdfFilePath, pageText]() {
+                    storePrefetchedPageText(pageNum, pdfFilePath, pageText);
+                }, Qt::QueuedConnection);
+            }
+            
+            if (!renderPage) {
                 return;
             }
             
@@ -5141,13 +5166,25 @@ void InkCanvas::cacheAdjacentPages() {
             threadDocument->setRenderHint(Poppler::Document::TextSlightHinting, true);
             
             // Render using the thread-local document instance
-            renderPdfPageToCacheThreadSafe(pageNum, threadDocument.get());
+            renderPdfPageToCacheThreadSafe(pageNum, threadDocument, snapshot);
         });
         
         watcher->setFuture(future);
     }
 }
 
+void InkCanvas::storePrefetchedPageText(int pageNumber, const QString &sourcePdfPath, std::shared_ptr<PdfPageText> pageText) {
+    pendingTextPages.remove(pageNumber);
+    
+    // Drop results for a PDF that is no longer loaded
+    if (!pageText || !isPdfLoaded || sourcePdfPath != pdfPath || pdfTextCache.contains(pageNumber)) {
+        return;
+    }
+    
+    qsizetype cost = pageText->memoryUsage();
+    pdfTextCache.insert(pageNumber, new PdfPageText(std::move(*pageText)), cost);
+}
+
 // Intelligent Note Cache System Implementation
 
 QString InkCanvas::getNotePageFilePath(int pageNumber) const {
@@ -5533,6 +5570,9 @@ QRect InkCanvas::mapCanvasToWidget(const QRect &canvasRect) const {
 void InkCanvas::loadNotebookMetadata() {
     if (saveFolder.isEmpty()) return;
     
+    // Annotation shards are only listed here; each page is parsed when first shown
+    annotationStore.open(saveFolder);
+    
     QString metadataFile = saveFolder + "/.speedynote_metadata.json";
     
     // First, try to migrate from old files if JSON doesn't exist
@@ -5587,8 +5627,13 @@ void InkCanvas::loadNotebookMetadata() {
     backgroundColor = QColor(obj["background_color"].toString("#ffffff"));
     backgroundDensity = obj["background_density"].toInt(20);
     
-    // PDF inversion setting (default to false for existing notebooks)
-    pdfInversionEnabled = obj["pdf_inversion_enabled"].toBool(false);
+    // PDF display filter (older notebooks only have the inversion flag)
+    if (obj.contains("pdf_display_filter")) {
+        pdfDisplayFilter = pdfDisplayFilterFromString(obj["pdf_display_filter"].toString());
+    } else {
+        pdfDisplayFilter = obj["pdf_inversion_enabled"].toBool(false) ? PdfDisplayFilter::Invert : PdfDisplayFilter::None;
+    }
+    filteredBackgroundCache.clear();
     
     // Load bookmarks
     bookmarks.clear();
@@ -5597,23 +5642,13 @@ void InkCanvas::loadNotebookMetadata() {
         bookmarks.append(value.toString());
     }
     
-    // Load persistent text highlights (backward compatible - defaults to empty array)
-    persistentHighlights.clear();
-    QJsonArray highlightsArray = obj["text_highlights"].toArray();
-    for (const QJsonValue &value : highlightsArray) {
-        if (value.isObject()) {
-            TextHighlight highlight = TextHighlight::fromJson(value.toObject());
-            persistentHighlights.append(highlight);
-        }
-    }
-    
-    // Load markdown notes (backward compatible - defaults to empty array)
-    markdownNotes.clear();
-    QJsonArray notesArray = obj["markdown_notes"].toArray();
-    for (const QJsonValue &value : notesArray) {
-        if (value.isObject()) {
-            MarkdownNoteData note = MarkdownNoteData::fromJson(value.toObject());
-            markdownNotes.append(note);
+    // Older notebooks keep every highlight and note inline - move them into page shards once
+    QJsonArray legacyHighlights = obj["text_highlights"].toArray();
+    QJsonArray legacyNotes = obj["markdown_notes"].toArray();
+    if (!legacyHighlights.isEmpty() || !legacyNotes.isEmpty()) {
+        annotationStore.importLegacy(legacyHighlights, legacyNotes);
+        if (annotationStore.flush()) {
+            saveNotebookMetadata(); // Rewrites the metadata without the inline arrays
         }
     }
     
@@ -5624,6 +5659,10 @@ void InkCanvas::loadNotebookMetadata() {
         }
         // Note: Missing PDF handling is done in handleMissingPdf() when the notebook is opened
     }
+    
+    // The launcher keeps the search index current for what is already on disk
+    searchIndexedRevision = annotationStore.revision();
+    searchIndexedBookmarks = bookmarks;
 }
 
 void InkCanvas::saveNotebookMetadata() {
@@ -5647,8 +5686,9 @@ void InkCanvas::saveNotebookMetadata() {
     obj["background_color"] = backgroundColor.name();
     obj["background_density"] = backgroundDensity;
     
-    // PDF inversion setting
-    obj["pdf_inversion_enabled"] = pdfInversionEnabled;
+    // PDF display filter (inversion flag kept for older versions)
+    obj["pdf_display_filter"] = pdfDisplayFilterToString(pdfDisplayFilter);
+    obj["pdf_inversion_enabled"] = (pdfDisplayFilter == PdfDisplayFilter::Invert);
     
     // Save bookmarks
     QJsonArray bookmarkArray;
@@ -5657,31 +5697,26 @@ void InkCanvas::saveNotebookMetadata() {
     }
     obj["bookmarks"] = bookmarkArray;
     
-    // Save persistent text highlights
-    QJsonArray highlightsArray;
-    for (const TextHighlight &highlight : persistentHighlights) {
-        highlightsArray.append(highlight.toJson());
-    }
-    obj["text_highlights"] = highlightsArray;
-    
-    // Save markdown notes
-    QJsonArray notesArray;
-    for (const MarkdownNoteData &note : markdownNotes) {
-        notesArray.append(note.toJson());
-    }
-    obj["markdown_notes"] = notesArray;
+    // Highlights and markdown notes live in per-page shards (see NotebookAnnotationStore)
+    obj["annotation_storage"] = NotebookAnnotationStore::SHARD_DIR_NAME;
     
     QJsonDocument doc(obj);
     
+    // ✅ Replaced in one step: a background package sync may be reading the file
     QString metadataFile = saveFolder + "/.speedynote_metadata.json";
-    QFile file(metadataFile);
+    QSaveFile file(metadataFile);
     if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         file.write(doc.toJson());
-        file.close();
+        file.commit();
     }
     
+    // Write any annotation pages that changed since the last save
+    annotationStore.flush();
+    
     // ✅ Sync changes to .spn package if needed
     syncSpnPackage();
+    
+    updateNotebookSearchIndex();
 }
 
 void InkCanvas::setLastAccessedPage(int pageNumber) {
@@ -5875,10 +5910,126 @@ QString InkCanvas::getDisplayPath() const {
 
 void InkCanvas::syncSpnPackage() {
     if (isSpnPackage && !actualPackagePath.isEmpty() && !tempWorkingDir.isEmpty()) {
+        spnSyncPending = true;
+        spnSyncTimer->start(); // Restarts the debounce window
+    }
+}
+
+void InkCanvas::scheduleInkIndexWrite() {
+    inkIndexWritePending = true;
+    spnSyncTimer->start(); // Written with the next package sync, or on its own for folders
+}
+
+void InkCanvas::startSpnSync() {
+    const bool syncPackage = spnSyncPending && !actualPackagePath.isEmpty() && !tempWorkingDir.isEmpty();
+    if (!syncPackage && !inkIndexWritePending) return;
+    
+    // One sync in flight per canvas; changes made meanwhile go in the next one
+    if (spnSyncFuture.isRunning()) {
+        spnSyncTimer->start();
+        return;
+    }
+    
+    if (syncPackage) {
+        spnSyncPending = false;
+    }
+    inkIndexWritePending = false;
+    const QString folder = saveFolder;
+    const QString packagePath = actualPackagePath;
+    const QString workingDir = tempWorkingDir;
+    spnSyncFuture = QtConcurrent::run([folder, syncPackage, packagePath, workingDir]() {
+        // The ink index goes into the package together with the pages it describes
+        InkPageIndex::flush(folder);
+        return !syncPackage || SpnPackageManager::updateSpnFromTemp(packagePath, workingDir);
+    });
+}
+
+void InkCanvas::flushSpnPackage() {
+    if (spnSyncTimer) {
+        spnSyncTimer->stop();
+    }
+    spnSyncFuture.waitForFinished();
+    
+    inkIndexWritePending = false;
+    InkPageIndex::flush(saveFolder);
+    
+    if (spnSyncPending && !actualPackagePath.isEmpty() && !tempWorkingDir.isEmpty()) {
+        spnSyncPending = false;
         SpnPackageManager::updateSpnFromTemp(actualPackagePath, tempWorkingDir);
     }
 }
 
+void InkCanvas::updateNotebookSearchIndex() {
+    if (saveFolder.isEmpty()) return;
+    if (searchIndexedRevision == annotationStore.revision() && searchIndexedBookmarks == bookmarks) return;
+    
+    // Unsaved scratch notebooks are not searchable from the launcher
+    if (saveFolder == QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/temp_session") return;
+    
+    searchIndexTimer->start(); // Restarts the debounce window
+}
+
+void InkCanvas::startNotebookSearchIndexUpdate() {
+    if (saveFolder.isEmpty()) return;
+    
+    // One update in flight per canvas; changes made meanwhile go in the next one
+    if (searchIndexFuture.isRunning()) {
+        searchIndexTimer->start();
+        return;
+    }
+    
+    // ✅ Only the pages changed since the last update are read; they are loaded already
+    const QSet<int> changedPages = annotationStore.pagesChangedSince(searchIndexedRevision);
+    searchIndexedRevision = annotationStore.revision();
+    searchIndexedBookmarks = bookmarks;
+    
+    QList<NotebookSearchItem> pageItems;
+    for (int pageNumber : changedPages) {
+        for (const TextHighlight &highlight : annotationStore.highlights(pageNumber)) {
+            if (highlight.text.trimmed().isEmpty()) continue;
+            NotebookSearchItem item;
+            item.kind = NotebookSearchItem::Highlight;
+            item.pageNumber = pageNumber;
+            item.text = highlight.text;
+            pageItems.append(item);
+        }
+        for (const MarkdownNoteData &note : annotationStore.notes(pageNumber)) {
+            NotebookSearchItem item;
+            item.kind = NotebookSearchItem::Note;
+            item.pageNumber = pageNumber;
+            item.title = note.title;
+            item.text = note.content;
+            pageItems.append(item);
+        }
+    }
+    
+    QList<NotebookSearchItem> bookmarkItems;
+    for (const QString &bookmark : std::as_const(bookmarks)) {
+        QStringList parts = bookmark.split('\t', Qt::KeepEmptyParts);
+        if (parts.size() < 2) continue;
+        NotebookSearchItem item;
+        item.kind = NotebookSearchItem::Bookmark;
+        item.pageNumber = parts[0].toInt() - 1;
+        item.title = parts[1];
+        bookmarkItems.append(item);
+    }
+    
+    const QString notebookPath = isSpnPackage ? actualPackagePath : saveFolder;
+    const QString workingFolder = saveFolder;
+    searchIndexFuture = QtConcurrent::run([notebookPath, workingFolder, changedPages, pageItems, bookmarkItems]() {
+        NotebookSearchIndex::updateNotebookPages(notebookPath, workingFolder, changedPages, pageItems, bookmarkItems);
+    });
+}
+
+void InkCanvas::flushNotebookSearchIndex() {
+    if (searchIndexTimer && searchIndexTimer->isActive()) {
+        searchIndexTimer->stop();
+        searchIndexFuture.waitForFinished();
+        startNotebookSearchIndexUpdate();
+    }
+    searchIndexFuture.waitForFinished();
+}
+
 void InkCanvas::handlePictureMouseMove(QMouseEvent *event) {
     if (!activePictureWindow) return;
     
@@ -17,7 +17,10 @@
 #include <QMenu>
 #include <QClipboard>
 #include <QFutureWatcher>
+#include <QFuture>
 #include <QMutex>
+#include <atomic>
+#include <memory>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QUuid>
@@ -27,6 +30,11 @@
 #include "ButtonMappingTypes.h"
 #include "SpnPackageManager.h"
 #include "PdfRelinkDialog.h"
+#include "PdfFileMapping.h"
+#include "NotebookAnnotationStore.h"
+#include "PdfTextLayout.h"
+#include "PdfSearchIndex.h"
+#include "InkStrokeStore.h"
 
 class PictureWindowManager;
 class PictureWindow;
@@ -43,73 +51,41 @@ enum class BackgroundStyle {
     Lines
 };
 
-// Structure to store a persistent text highlight
-struct TextHighlight {
-    QString id;              // Unique ID for this highlight (for linking to markdown windows)
-    int pageNumber;          // Page number (0-based)
-    QRectF boundingBox;      // Combined bounding box in PDF coordinates (for quick intersection checks)
-    QList<QRectF> textBoxRects; // Individual text box rectangles for precise rendering
-    QString text;            // The highlighted text content
-    QColor color;            // Highlight color
-    QString markdownWindowId; // ID of associated markdown window (empty if none) - for Step 3
-    
-    // Serialization helpers
-    QJsonObject toJson() const {
-        QJsonObject obj;
-        obj["id"] = id;
-        obj["pageNumber"] = pageNumber;
-        obj["boundingBox"] = QString("%1,%2,%3,%4")
-            .arg(boundingBox.x()).arg(boundingBox.y())
-            .arg(boundingBox.width()).arg(boundingBox.height());
-        
-        // Serialize individual text box rectangles
-        QJsonArray rectsArray;
-        for (const QRectF &rect : textBoxRects) {
-            rectsArray.append(QString("%1,%2,%3,%4")
-                .arg(rect.x()).arg(rect.y())
-                .arg(rect.width()).arg(rect.height()));
-        }
-        obj["textBoxRects"] = rectsArray;
-        
-        obj["text"] = text;
-        obj["color"] = color.name(QColor::HexArgb);
-        obj["markdownWindowId"] = markdownWindowId;
-        return obj;
-    }
-    
-    static TextHighlight fromJson(const QJsonObject &obj) {
-        TextHighlight highlight;
-        highlight.id = obj["id"].toString();
-        highlight.pageNumber = obj["pageNumber"].toInt();
-        
-        // Parse combined bounding box
-        QString bbox = obj["boundingBox"].toString();
-        QStringList parts = bbox.split(',');
-        if (parts.size() == 4) {
-            highlight.boundingBox = QRectF(
-                parts[0].toDouble(), parts[1].toDouble(),
-                parts[2].toDouble(), parts[3].toDouble()
-            );
-        }
-        
-        // Parse individual text box rectangles
-        QJsonArray rectsArray = obj["textBoxRects"].toArray();
-        for (const QJsonValue &value : rectsArray) {
-            QString rectStr = value.toString();
-            QStringList rectParts = rectStr.split(',');
-            if (rectParts.size() == 4) {
-                highlight.textBoxRects.append(QRectF(
-                    rectParts[0].toDouble(), rectParts[1].toDouble(),
-                    rectParts[2].toDouble(), rectParts[3].toDouble()
-                ));
-            }
-        }
-        
-        highlight.text = obj["text"].toString();
-        highlight.color = QColor(obj["color"].toString());
-        highlight.markdownWindowId = obj["markdownWindowId"].toString();
-        return highlight;
+// Color filters applied to the PDF background at paint time (no re-render needed)
+enum class PdfDisplayFilter {
+    None,
+    Invert,       // Dark mode
+    Sepia,
+    HighContrast,
+    Grayscale
+};
+
+inline QString pdfDisplayFilterToString(PdfDisplayFilter filter) {
+    switch (filter) {
+        case PdfDisplayFilter::Invert: return "Invert";
+        case PdfDisplayFilter::Sepia: return "Sepia";
+        case PdfDisplayFilter::HighContrast: return "HighContrast";
+        case PdfDisplayFilter::Grayscale: return "Grayscale";
+        default: return "None";
     }
+}
+
+inline PdfDisplayFilter pdfDisplayFilterFromString(const QString &name) {
+    if (name == "Invert") return PdfDisplayFilter::Invert;
+    if (name == "Sepia") return PdfDisplayFilter::Sepia;
+    if (name == "HighContrast") return PdfDisplayFilter::HighContrast;
+    if (name == "Grayscale") return PdfDisplayFilter::Grayscale;
+    return PdfDisplayFilter::None;
+}
+
+// Everything a background PDF render job reads, captured when the job starts.
+// Snapshots are immutable: the GUI thread publishes a new one (with a new
+// version) whenever render output would change, and a job whose snapshot is
+// no longer current when it finishes drops its result instead of caching it.
+struct PdfRenderSnapshot {
+    quint64 version = 0;
+    int dpi = 192;
+    int totalPages = 0;
 };
 
 class InkCanvas : public QWidget {
@@ -169,10 +145,17 @@ public:
     
     void clearPdf();
     void clearPdfNoDelete();
+    
+    // Full-text search over the loaded PDF (indexed in the background after loadPdf)
+    PdfSearchIndex *getPdfSearchIndex() { return &pdfSearchIndex; }
+    void setSearchHighlights(const QHash<int, QList<QRectF>> &pageRects); // Page -> hit rects in PDF coordinates
+    void clearSearchHighlights();
 
     QString getSaveFolder() const { return saveFolder; }
     QString getDisplayPath() const; // ✅ Get display path (.spn package or folder)
-    void syncSpnPackage(); // ✅ Sync changes back to .spn file
+    void syncSpnPackage(); // ✅ Sync changes back to .spn file (debounced, runs in the background)
+    void flushSpnPackage(); // Write the ink index and pending changes to the .spn file now and wait for it
+    void scheduleInkIndexWrite(); // Write the ink index once saves settle (MainWindow's page saves call it too)
     
     // ✅ Cache invalidation helper
     void invalidateBothPagesCache(int pageNumber); // Invalidate both pages of a combined canvas
@@ -215,21 +198,30 @@ public:
     int getBufferWidth() const { return buffer.width(); }
     int getBufferHeight() const { return buffer.height(); }
     QPixmap getBuffer() const { return buffer; } // Get buffer for concurrent saving
+    // Write (or drop, after raster-only edits) the stroke files of the page(s) just saved as PNG
+    void saveBufferStrokes(int pageNumber, bool isCombinedCanvas, int singlePageHeight);
 
 
 
     bool isEdited() const { return edited; }  // ✅ Check if the canvas has been edited
     void setEdited(bool state) { edited = state; }  // ✅ Set the edited state
 
-    void setPDFRenderDPI(int dpi) { pdfRenderDPI = dpi; }  // ✅ Set PDF render DPI
+    void setPDFRenderDPI(int dpi);  // ✅ Set PDF render DPI (in-flight renders at the old DPI are discarded)
 
-    // PDF inversion for dark mode
+    // PDF inversion for dark mode (shorthand for the Invert display filter)
     void setPdfInversionEnabled(bool enabled);
-    bool isPdfInversionEnabled() const { return pdfInversionEnabled; }
+    bool isPdfInversionEnabled() const { return pdfDisplayFilter == PdfDisplayFilter::Invert; }
+    
+    // PDF display filters (applied at paint time, render cache is kept)
+    void setPdfDisplayFilter(PdfDisplayFilter filter);
+    PdfDisplayFilter getPdfDisplayFilter() const { return pdfDisplayFilter; }
 
     void clearPdfCache() { 
         QMutexLocker locker(&pdfCacheMutex);
         pdfCache.clear(); 
+        // Renders still in flight belong to the old state; bumping the version under
+        // the same lock keeps them from refilling the cache in between
+        publishRenderSnapshot();
     }
     void clearNoteCache() { 
         {
@@ -300,7 +292,7 @@ public:
     bool isSelectionHighlighted() const; // Check if current selection overlaps with any persistent highlight
     QList<TextHighlight> getHighlightsForPage(int pageNumber) const; // Get all highlights for a specific page
     void loadHighlightsFromMetadata(); // Load highlights from JSON metadata
-    void saveHighlightsToMetadata(); // Save highlights to JSON metadata
+    void saveHighlightsToMetadata(); // Write changed annotation pages (not the whole notebook metadata)
     
     // Markdown notes management
     QString addMarkdownNoteFromSelection(); // Add a markdown note linked to current selection, returns note ID
@@ -393,26 +385,27 @@ private:
 
     void initializeBuffer();   // Helper to initialize the buffer
     void drawStroke(const QPointF &start, const QPointF &end, qreal pressure);    
+    void recordStrokeSegment(const QPointF &bufferStart, const QPointF &bufferEnd, qreal pressure, const QColor &color, qreal width);
     void eraseStroke(const QPointF &start, const QPointF &end, qreal pressure);
     QRectF calculatePreviewRect(const QPointF &start, const QPointF &oldEnd, const QPointF &newEnd);
     
 
     QCache<int, QPixmap> pdfCache; // Caches 5 pages of the PDF
     mutable QMutex pdfCacheMutex; // Thread safety for pdfCache
+    
+    // Render state published to background render jobs (GUI thread replaces it, jobs keep their copy)
+    std::shared_ptr<const PdfRenderSnapshot> renderSnapshot;
+    std::atomic<quint64> renderSnapshotVersion{0}; // Version of the current snapshot
+    void publishRenderSnapshot(); // Publish a new snapshot after DPI/document/cache changes
     QList<int> pdfCacheAccessOrder; // Track access order for LRU eviction (most recent at end)
     
     // ✅ PDF TEXT BOX CACHE: Cache text boxes to avoid re-allocation on every page visit
-    struct TextBoxCacheEntry {
-        QList<Poppler::TextBox*> textBoxes;
-        QList<int> pageNumbers;
-        ~TextBoxCacheEntry() {
-            qDeleteAll(textBoxes);
-        }
-    };
-    QMap<int, TextBoxCacheEntry*> pdfTextBoxCache; // Maps page number -> text boxes
-    QList<int> pdfTextBoxCacheAccessOrder; // Track access order for LRU eviction
+    QCache<int, PdfPageText> pdfTextCache; // Text layout per page, cost = bytes used
+    QSet<int> pendingTextPages; // Pages whose text is being extracted by a prefetch worker
     
-    std::unique_ptr<Poppler::Document> pdfDocument;
+    std::shared_ptr<PdfFileMapping> pdfFileMapping; // Memory-mapped PDF bytes, shared with render workers and other tabs
+    std::unique_ptr<QBuffer> pdfDocumentDevice; // Read cursor used by pdfDocument (must outlive it)
+    std::unique_ptr<Poppler::Document> pdfDocument; // Declared after its device so it is destroyed first
     int currentPdfPage;
     bool isPdfLoaded = false;
     int totalPdfPages = 0;
@@ -426,6 +419,24 @@ private:
 
     bool edited = false;  // ✅ Track if the canvas has been edited
 
+    // ✅ Vector copy of the pen and marker ink in the buffer (buffer pixels), saved as stroke files for PDF export
+    QList<InkStroke> bufferStrokes;
+    bool bufferStrokesComplete = true; // False once the buffer holds ink the strokes don't describe
+    bool strokeInProgress = false;     // Next segment continues the last stroke
+    void loadBufferStrokes(int pageNumber, int nextPageOffset);
+
+    // Stroke files are read and checked against their PNG on a worker; the result is
+    // put in front of any strokes drawn meanwhile
+    struct LoadedStrokes {
+        QList<InkStroke> strokes;
+        bool complete = true;
+    };
+    QFuture<LoadedStrokes> bufferStrokesFuture;
+    bool bufferStrokesPending = false; // Load result not yet applied
+    int bufferStrokesGeneration = 0;   // Drops results of loads made for an earlier page
+    void applyLoadedBufferStrokes();   // Blocks until the pending load is done
+    void markInkRasterOnly() { bufferStrokesComplete = false; } // Eraser, rope tool and other pixel edits
+
     bool benchmarking;
     std::deque<qint64> processedTimestamps;
     QElapsedTimer benchmarkTimer;
@@ -471,8 +482,7 @@ private:
     QList<PictureWindow*> loadPictureWindowsForPage(int pageNumber); // Load picture windows without affecting current
     
     // PDF text selection helpers for combined canvas
-    void loadPdfTextBoxesForSinglePage(int pageNumber, TextBoxCacheEntry* entry); // Load text boxes for single page
-    void loadPdfTextBoxesForCombinedCanvas(int pageNumber, int singlePageHeight, TextBoxCacheEntry* entry); // Load text boxes for combined canvas
+    const PdfPageText *pdfPageText(int pageNumber); // Cached text of a page, extracted on a miss
     // ✅ Migration from old txt files to JSON
     void migrateOldMetadataFiles();
     
@@ -480,7 +490,9 @@ private:
     QString pasteImageFromClipboard(); // Returns path to saved clipboard image or empty string on failure
 
     int pdfRenderDPI = 192;  // Default to 288 DPI
-    bool pdfInversionEnabled = false;  // PDF color inversion for dark mode
+    PdfDisplayFilter pdfDisplayFilter = PdfDisplayFilter::None;  // Paint-time PDF color filter (dark mode etc.)
+    QCache<qint64, QPixmap> filteredBackgroundCache; // Filtered variants keyed by unfiltered pixmap cacheKey()
+    const QPixmap &displayedPdfBackground(); // Background with the display filter applied (cached)
 
     // Touch gesture support
     TouchGestureMode touchGestureMode = TouchGestureMode::Disabled;
@@ -504,6 +516,11 @@ private:
     
     // Auto-save timer (incremental saves to reduce page-switch burden)
     QTimer* autoSaveTimer = nullptr; // Timer for periodic auto-save
+    QTimer* spnSyncTimer = nullptr; // Debounces .spn package syncs and ink index writes after saves
+    QFuture<bool> spnSyncFuture; // Background .spn sync in progress
+    bool spnSyncPending = false; // Changes not yet handed to a sync
+    bool inkIndexWritePending = false; // Ink index changed since it was last written
+    void startSpnSync();
     int autoSaveInterval = 10000; // Auto-save interval in milliseconds (default 10 seconds)
     qreal inertiaPanX = 0.0; // Smooth pan X with sub-pixel precision
     qreal inertiaPanY = 0.0; // Smooth pan Y with sub-pixel precision
@@ -530,21 +547,55 @@ private:
     bool pdfTextSelecting = false; // True when actively selecting text
     QPointF pdfSelectionStart; // Start point of text selection (logical widget coordinates)
     QPointF pdfSelectionEnd; // End point of text selection (logical widget coordinates)
-    QList<Poppler::TextBox*> currentPdfTextBoxes; // Text boxes for current page(s)
-    QList<Poppler::TextBox*> selectedTextBoxes; // Currently selected text boxes (temporary selection)
-    QList<int> currentPdfTextBoxPageNumbers; // Page number for each text box (for combined canvas)
-    
-    // Persistent text highlights storage
-    QList<TextHighlight> persistentHighlights; // All saved highlights for this notebook
-    
-    // Markdown notes storage
-    QList<MarkdownNoteData> markdownNotes; // All saved markdown notes for this notebook
+    PdfTextLayout currentTextLayout; // Words of the current page(s), top page first
+    QList<int> selectedTextWords; // Indices into currentTextLayout of the selected words (temporary selection)
+    struct SelectionRowRect {
+        int pageNumber;
+        QRectF pdfRect; // One merged rectangle per line, in PDF coordinates
+    };
+    QList<SelectionRowRect> selectionRowRects; // Built once per selection update, drawn by paintEvent
+    QMap<int, TextBoxGrid> currentTextBoxGrids; // Spatial index per page; ids are relative to the page's first word
+    
+    // Reading order of currentTextLayout for the current geometry. Rebuilt only when the
+    // text or the buffer geometry change, not on every selection update.
+    struct TextReadingOrder {
+        int page = -1; // Base page it was built for (-1 = invalid)
+        QSize bufferSize;
+        int singlePageHeight = 0;
+        QList<int> order; // Indices into currentTextLayout: top-to-bottom, then left-to-right
+        QVector<int> rank; // Position of each word in order (-1 = not selectable)
+    };
+    TextReadingOrder textReadingOrder;
+    
+    // Persistent text highlights and markdown notes, sharded by page and loaded lazily
+    NotebookAnnotationStore annotationStore;
+    
+    // What the cross-notebook search index last saw of this notebook
+    quint64 searchIndexedRevision = 0;
+    QStringList searchIndexedBookmarks;
+    QTimer* searchIndexTimer = nullptr; // Debounces search index updates after saves
+    QFuture<void> searchIndexFuture; // Background search index update in progress
+    void updateNotebookSearchIndex(); // Schedule a re-index if notes, highlights or bookmarks changed
+    void startNotebookSearchIndexUpdate(); // Re-index the changed pages on a worker
+    void flushNotebookSearchIndex(); // Run a scheduled re-index now and wait for it
+    
+    // Cached highlight overlay for the displayed page pair (canvas coordinates)
+    struct HighlightOverlayRect {
+        QRectF rect;
+        QColor color;
+    };
+    QList<HighlightOverlayRect> highlightOverlayRects;
+    int highlightOverlayPage = -1; // Page the overlay was built for (-1 = none)
+    QSize highlightOverlayImageSize; // Background size the overlay was built for
+    quint64 highlightOverlayRevision = 0; // Annotation store revision the overlay was built from (0 = never)
+    QHash<int, QList<QRectF>> searchHighlightRects; // Search hits drawn with the overlay (page -> PDF rects)
+    PdfSearchIndex pdfSearchIndex;
     
     // ✅ MEMORY LEAK FIX: Cache only page sizes instead of full Page objects
     QMap<int, QSizeF> pdfPageSizeCache; // Maps page number -> page size
     int currentTextPageNumber = -1; // Track which page we're displaying text for
     int currentTextPageNumberSecond = -1; // For combined canvas
-    int currentTextBoxesLoadedForPage = -1; // Track which page currentPdfTextBoxes belong to
+    int currentTextBoxesLoadedForPage = -1; // Track which page currentTextLayout belongs to
     
     // PDF text selection throttling (60 FPS)
     QTimer* pdfTextSelectionTimer = nullptr; // Timer for throttling text selection updates
@@ -595,16 +646,24 @@ private:
     QPointF mapPdfToWidgetCoordinates(const QPointF &pdfPoint, int pageNumber = -1); // Map PDF coordinates to widget coordinates
     void updatePdfTextSelection(const QPointF &start, const QPointF &end, bool isFinal = false); // Update text selection
     void handlePdfLinkClick(const QPointF &clickPoint); // Handle PDF link clicks
+    const PdfPageLink *pdfLinkAt(const QPointF &position, bool extractIfMissing); // Link under a widget position (nullptr if none)
     void showPdfTextSelectionMenu(const QPoint &position); // Show context menu for PDF text selection
-    QList<Poppler::TextBox*> getTextBoxesInSelection(const QPointF &start, const QPointF &end); // Get text boxes in selection area
+    QList<int> getTextWordsInSelection(const QPointF &start, const QPointF &end); // Words (indices into currentTextLayout) in selection area
+    void clearSelectedTextBoxes(); // Clear selectedTextWords and everything derived from it
+    void rebuildSelectionRows(); // Merge the selected words into per-line rectangles
+    int selectionPageAndBounds(QRectF &bounds) const; // Page of the selection (-1 = none) and its PDF bounding box
     
     // Intelligent PDF cache helper methods
     void renderPdfPageToCache(int pageNumber); // Render a single page and add to cache
-    void renderPdfPageToCacheThreadSafe(int pageNumber, Poppler::Document* sharedDocument); // Thread-safe render with separate document instance
+    void renderPdfPageToCacheThreadSafe(int pageNumber, Poppler::Document* sharedDocument,
+                                        const std::shared_ptr<const PdfRenderSnapshot> &snapshot); // Thread-safe render with separate document instance
     void checkAndCacheAdjacentPages(int targetPage); // Check and cache adjacent pages if needed
     bool isValidPageNumber(int pageNumber) const; // Check if page number is valid
-    void drawHighlightsOnPageImage(QImage &pageImage, int pageNumber, Poppler::Document* pdfDoc); // Draw highlights on a PDF page image during rendering
-    void refreshCurrentPdfPage(); // Refresh the currently displayed PDF page (for highlight updates)
+    
+    // Persistent highlight overlay (composited above the cached PDF render)
+    void invalidateHighlightOverlay(); // Mark overlay stale after highlights change
+    void rebuildHighlightOverlay(); // Rebuild cached highlight rectangles for the displayed page pair
+    void drawHighlightOverlay(QPainter &painter); // Draw cached highlights (painter in canvas coordinates)
     
     // Intelligent note cache helper methods
     void loadSingleNotePageToCache(int pageNumber); // Load a single note page and add to cache
@@ -613,7 +672,8 @@ private:
     
 private slots:
     void processPendingTextSelection(); // Process pending text selection updates (throttled to 60 FPS)
-    void cacheAdjacentPages(); // Cache adjacent pages after delay
+    void cacheAdjacentPages(); // Cache adjacent pages (and their text layout) after delay
+    void storePrefetchedPageText(int pageNumber, const QString &sourcePdfPath, std::shared_ptr<PdfPageText> pageText); // Called on the GUI thread when a worker finished extracting
     void cacheAdjacentNotePages(); // Cache adjacent note pages after delay
     void updateInertiaScroll(); // Update inertia scrolling animation
     void onAutoSaveTimeout(); // Perform auto-save when timer expires
@@ -0,0 +1,290 @@
+#include "InkPageIndex.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDebug>
+
+const QString InkPageIndex::INDEX_FILE_NAME = ".speedynote_ink_index.json";
+
+QMutex InkPageIndex::indexMutex;
+QHash<QString, QHash<int, InkPageBounds>> InkPageIndex::loadedIndexes;
+QSet<QString> InkPageIndex::dirtyFolders;
+
+namespace {
+// One thread, so records of the same page are applied in the order they were made
+QThreadPool *recordPool()
+{
+    static QThreadPool *pool = [] {
+        QThreadPool *threads = new QThreadPool();
+        threads->setMaxThreadCount(1);
+        return threads;
+    }();
+    return pool;
+}
+}
+
+QString InkPageIndex::pageImagePath(const QString &saveFolder, const QString &notebookId, int pageNumber)
+{
+    return saveFolder + QString("/%1_%2.png").arg(notebookId).arg(pageNumber, 5, 10, QChar('0'));
+}
+
+InkPageBounds InkPageIndex::computeBounds(const QImage &image)
+{
+    InkPageBounds bounds;
+    if (image.isNull()) {
+        return bounds;
+    }
+
+    // Both ARGB32 variants keep alpha in the top byte, so no conversion is needed for them
+    QImage argb = image;
+    if (argb.format() != QImage::Format_ARGB32 && argb.format() != QImage::Format_ARGB32_Premultiplied) {
+        argb = image.convertToFormat(QImage::Format_ARGB32);
+    }
+
+    const int width = argb.width();
+    const int height = argb.height();
+    int minX = width, minY = height, maxX = -1, maxY = -1;
+    qint64 inkPixels = 0;
+
+    for (int y = 0; y < height; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        int rowMin = -1, rowMax = -1;
+        for (int x = 0; x < width; ++x) {
+            if (qAlpha(line[x]) != 0) {
+                if (rowMin < 0) rowMin = x;
+                rowMax = x;
+                ++inkPixels;
+            }
+        }
+        if (rowMin >= 0) {
+            minX = qMin(minX, rowMin);
+            maxX = qMax(maxX, rowMax);
+            if (minY == height) minY = y;
+            maxY = y;
+        }
+    }
+
+    if (inkPixels > 0) {
+        bounds.bbox = QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+    }
+    bounds.inkPixels = inkPixels;
+    return bounds;
+}
+
+void InkPageIndex::stampFromFile(const QString &pagePath, InkPageBounds &bounds)
+{
+    QFileInfo pageInfo(pagePath);
+    bounds.fileSize = pageInfo.exists() ? pageInfo.size() : -1;
+    bounds.fileModified = pageInfo.exists() ? pageInfo.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QHash<int, InkPageBounds> &InkPageIndex::indexForFolder(const QString &saveFolder)
+{
+    auto it = loadedIndexes.find(saveFolder);
+    if (it != loadedIndexes.end()) {
+        return it.value();
+    }
+
+    QHash<int, InkPageBounds> pages;
+    QFile file(saveFolder + "/" + INDEX_FILE_NAME);
+    if (file.open(QIODevice::ReadOnly)) {
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+        file.close();
+
+        if (error.error == QJsonParseError::NoError) {
+            QJsonObject pagesObj = doc.object()["pages"].toObject();
+            for (auto pageIt = pagesObj.begin(); pageIt != pagesObj.end(); ++pageIt) {
+                bool ok = false;
+                int pageNumber = pageIt.key().toInt(&ok);
+                if (!ok) continue;
+
+                QJsonObject entry = pageIt.value().toObject();
+                QJsonArray box = entry["bbox"].toArray();
+                InkPageBounds bounds;
+                if (box.size() == 4) {
+                    bounds.bbox = QRect(box[0].toInt(), box[1].toInt(), box[2].toInt(), box[3].toInt());
+                }
+                bounds.inkPixels = entry["ink"].toInteger();
+                bounds.fileSize = entry["size"].toInteger(-1);
+                bounds.fileModified = entry["mtime"].toInteger(-1); // Missing before version 2: recomputed once
+                pages.insert(pageNumber, bounds);
+            }
+        } else {
+            qWarning() << "Ignoring unreadable ink index in" << saveFolder << ":" << error.errorString();
+        }
+    }
+
+    return loadedIndexes.insert(saveFolder, pages).value();
+}
+
+void InkPageIndex::writeIndex(const QString &saveFolder, const QHash<int, InkPageBounds> &pages)
+{
+    QJsonObject pagesObj;
+    for (auto it = pages.constBegin(); it != pages.constEnd(); ++it) {
+        const InkPageBounds &bounds = it.value();
+        QJsonObject entry;
+        entry["bbox"] = QJsonArray{ bounds.bbox.x(), bounds.bbox.y(), bounds.bbox.width(), bounds.bbox.height() };
+        entry["ink"] = bounds.inkPixels;
+        entry["size"] = bounds.fileSize;
+        entry["mtime"] = bounds.fileModified;
+        pagesObj[QString::number(it.key())] = entry;
+    }
+
+    QJsonObject root;
+    root["version"] = 2;
+    root["pages"] = pagesObj;
+
+    // ✅ QSaveFile so a crash mid-write never leaves a truncated index behind
+    QSaveFile file(saveFolder + "/" + INDEX_FILE_NAME);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write ink index in" << saveFolder;
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
+void InkPageIndex::recordPage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkPageBounds bounds)
+{
+    if (saveFolder.isEmpty()) return;
+
+    stampFromFile(pageImagePath(saveFolder, notebookId, pageNumber), bounds);
+
+    QMutexLocker locker(&indexMutex);
+    indexForFolder(saveFolder).insert(pageNumber, bounds);
+    dirtyFolders.insert(saveFolder);
+}
+
+void InkPageIndex::recordPageAsync(const QString &saveFolder, const QString &notebookId, int pageNumber,
+                                   const QImage &image)
+{
+    if (saveFolder.isEmpty()) return;
+
+    const QString pagePath = pageImagePath(saveFolder, notebookId, pageNumber);
+    InkPageBounds stamp;
+    stampFromFile(pagePath, stamp);
+
+    // ✅ The full-page scan runs off the GUI thread; the image is shared, not copied
+    recordPool()->start([saveFolder, pagePath, pageNumber, image, stamp]() {
+        InkPageBounds bounds = computeBounds(image);
+        InkPageBounds current;
+        stampFromFile(pagePath, current);
+        if (current.fileSize != stamp.fileSize || current.fileModified != stamp.fileModified) {
+            return; // Saved again meanwhile; that save records its own bounds
+        }
+        bounds.fileSize = stamp.fileSize;
+        bounds.fileModified = stamp.fileModified;
+
+        QMutexLocker locker(&indexMutex);
+        indexForFolder(saveFolder).insert(pageNumber, bounds);
+        dirtyFolders.insert(saveFolder);
+    });
+}
+
+void InkPageIndex::flush(const QString &saveFolder)
+{
+    if (saveFolder.isEmpty()) return;
+
+    recordPool()->waitForDone();
+    QMutexLocker locker(&indexMutex);
+    if (dirtyFolders.remove(saveFolder)) {
+        writeIndex(saveFolder, indexForFolder(saveFolder));
+    }
+}
+
+void InkPageIndex::adoptUnpackedFolder(const QString &saveFolder)
+{
+    if (saveFolder.isEmpty()) return;
+
+    // Page images are <notebook id>_<5-digit page>.png; stamped the way lookups check them
+    QHash<int, InkPageBounds> pageStamps;
+    const QFileInfoList pngFiles = QDir(saveFolder).entryInfoList(QStringList() << "*.png", QDir::Files);
+    for (const QFileInfo &info : pngFiles) {
+        bool ok = false;
+        const int pageNumber = info.completeBaseName().section('_', -1).toInt(&ok);
+        if (!ok) continue;
+        InkPageBounds stamp;
+        stampFromFile(info.filePath(), stamp);
+        pageStamps.insert(pageNumber, stamp);
+    }
+
+    QMutexLocker locker(&indexMutex);
+    QHash<int, InkPageBounds> &pages = indexForFolder(saveFolder);
+    for (auto it = pages.begin(); it != pages.end(); ++it) {
+        auto stamp = pageStamps.constFind(it.key());
+        if (stamp != pageStamps.constEnd() && stamp->fileSize == it->fileSize) {
+            it->fileSize = stamp->fileSize;
+            it->fileModified = stamp->fileModified;
+            dirtyFolders.insert(saveFolder);
+        }
+    }
+}
+
+void InkPageIndex::removePage(const QString &saveFolder, int pageNumber)
+{
+    if (saveFolder.isEmpty()) return;
+
+    QMutexLocker locker(&indexMutex);
+    if (indexForFolder(saveFolder).remove(pageNumber) > 0) {
+        dirtyFolders.insert(saveFolder);
+    }
+}
+
+bool InkPageIndex::lookupPage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkPageBounds &bounds)
+{
+    if (saveFolder.isEmpty()) return false;
+
+    {
+        QMutexLocker locker(&indexMutex);
+        const QHash<int, InkPageBounds> &pages = indexForFolder(saveFolder);
+        auto it = pages.constFind(pageNumber);
+        if (it == pages.constEnd()) {
+            return false;
+        }
+        bounds = it.value();
+    }
+
+    // A stat is far cheaper than a decode: only trust the entry while the PNG is the one it describes
+    InkPageBounds current;
+    stampFromFile(pageImagePath(saveFolder, notebookId, pageNumber), current);
+    return current.fileSize == bounds.fileSize && current.fileModified == bounds.fileModified;
+}
+
+bool InkPageIndex::pageHasInk(const QString &saveFolder, const QString &notebookId, int pageNumber)
+{
+    InkPageBounds bounds;
+    if (lookupPage(saveFolder, notebookId, pageNumber, bounds)) {
+        return !bounds.isBlank();
+    }
+
+    // A page saved a moment ago may still be scanned on the record thread: waiting is cheaper than a decode
+    recordPool()->waitForDone();
+    if (lookupPage(saveFolder, notebookId, pageNumber, bounds)) {
+        return !bounds.isBlank();
+    }
+
+    // Not indexed yet (older notebook) or changed outside SpeedyNote - decode once and remember
+    QString pagePath = pageImagePath(saveFolder, notebookId, pageNumber);
+    if (!QFile::exists(pagePath)) {
+        return false;
+    }
+
+    bounds = computeBounds(QImage(pagePath));
+    recordPage(saveFolder, notebookId, pageNumber, bounds);
+    return !bounds.isBlank();
+}
+
+void InkPageIndex::forgetFolder(const QString &saveFolder)
+{
+    recordPool()->waitForDone(); // Nothing may re-create the entry afterwards
+    QMutexLocker locker(&indexMutex);
+    loadedIndexes.remove(saveFolder);
+    dirtyFolders.remove(saveFolder);
+}
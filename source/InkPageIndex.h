@@ -0,0 +1,80 @@
+#ifndef INKPAGEINDEX_H
+#define INKPAGEINDEX_H
+
+#include <QString>
+#include <QRect>
+#include <QImage>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+
+// Ink extent of one saved page image
+struct InkPageBounds {
+    QRect bbox;            // Bounding box of all non-transparent pixels (empty = blank page)
+    qint64 inkPixels = 0;  // Number of non-transparent pixels
+    qint64 fileSize = -1;      // Size and mtime (msecs) of the page PNG this entry was
+    qint64 fileModified = -1;  // computed from (staleness check)
+
+    bool isBlank() const { return inkPixels == 0; }
+};
+
+// Per-notebook index of each page's ink bounding box, stored next to the page
+// images as .speedynote_ink_index.json. It is updated whenever a page is saved,
+// so export, thumbnails and the launcher can tell blank pages from annotated
+// ones without decoding any PNG.
+//
+// Updates go to the in-memory copy; the file is rewritten by flush(), which
+// the canvas runs once its saves settle.
+class InkPageIndex
+{
+public:
+    // Name of the index file inside a notebook's save folder
+    static const QString INDEX_FILE_NAME;
+
+    // Scan an ARGB page image for its ink extent
+    static InkPageBounds computeBounds(const QImage &image);
+
+    // Record the bounds of a page image that was just written to disk (thread-safe)
+    static void recordPage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkPageBounds bounds);
+
+    // Same for callers on the GUI thread: the PNG's stamp is taken now, the bounds are
+    // computed on a worker and dropped if the PNG was rewritten meanwhile
+    static void recordPageAsync(const QString &saveFolder, const QString &notebookId, int pageNumber,
+                                const QImage &image);
+
+    // Forget a page (e.g. after it was deleted)
+    static void removePage(const QString &saveFolder, int pageNumber);
+
+    // Write the folder's index if it changed since the last write (waits for pending records)
+    static void flush(const QString &saveFolder);
+
+    // Files unpacked from a package all have new mtimes: re-stamp the entries whose
+    // PNG still has the recorded size, as they did when the package was written
+    static void adoptUnpackedFolder(const QString &saveFolder);
+
+    // Look up a page. Returns false if the page isn't indexed or the entry no
+    // longer matches the PNG on disk.
+    static bool lookupPage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkPageBounds &bounds);
+
+    // Whether a page has any ink. Uses the index when possible and falls back to
+    // decoding the page PNG once (the result is recorded for next time).
+    static bool pageHasInk(const QString &saveFolder, const QString &notebookId, int pageNumber);
+
+    // Drop the in-memory copy of a notebook's index (e.g. when its temp folder is removed)
+    static void forgetFolder(const QString &saveFolder);
+
+    static QString pageImagePath(const QString &saveFolder, const QString &notebookId, int pageNumber);
+
+private:
+    static void stampFromFile(const QString &pagePath, InkPageBounds &bounds);
+
+    // Loaded indexes keyed by save folder; callers must hold indexMutex
+    static QHash<int, InkPageBounds> &indexForFolder(const QString &saveFolder);
+    static void writeIndex(const QString &saveFolder, const QHash<int, InkPageBounds> &pages);
+
+    static QMutex indexMutex;
+    static QHash<QString, QHash<int, InkPageBounds>> loadedIndexes;
+    static QSet<QString> dirtyFolders; // Changed since their index file was written
+};
+
+#endif // INKPAGEINDEX_H
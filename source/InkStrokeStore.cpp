@@ -0,0 +1,230 @@
+#include "InkStrokeStore.h"
+#include "InkPageIndex.h"
+#include "SpnPackageReader.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QSet>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+const quint32 STROKE_FILE_MAGIC = 0x534E534B; // "SNSK"
+const quint16 STROKE_FILE_VERSION = 2; // 2: PNG checksum next to its size
+
+QByteArray pdfNumber(qreal value, int decimals = 2)
+{
+    QByteArray text = QByteArray::number(value, 'f', decimals);
+    while (text.contains('.') && (text.endsWith('0') || text.endsWith('.'))) text.chop(1);
+    return text == "-0" ? "0" : text;
+}
+
+QByteArray pdfPoint(const QPointF &point)
+{
+    return pdfNumber(point.x()) + " " + pdfNumber(point.y());
+}
+
+// Size and checksum of a page PNG; false if it can't be read
+bool imageStamp(const QString &imagePath, qint64 &size, quint32 &checksum)
+{
+    QFile image(imagePath);
+    if (!image.open(QIODevice::ReadOnly)) return false;
+    const QByteArray data = image.readAll();
+    size = data.size();
+    checksum = SpnPackageReader::crc32c(data.constData(), data.size());
+    return image.error() == QFileDevice::NoError;
+}
+
+} // namespace
+
+qreal InkStroke::segmentWidth(int index) const
+{
+    if (tool == ToolType::Marker) return width;
+    return width * pressures.value(index, 1.0);
+}
+
+QRectF InkStroke::bounds() const
+{
+    if (points.isEmpty()) return QRectF();
+    qreal minX = points.first().x(), maxX = minX;
+    qreal minY = points.first().y(), maxY = minY;
+    for (const QPointF &point : points) {
+        minX = qMin(minX, point.x());
+        maxX = qMax(maxX, point.x());
+        minY = qMin(minY, point.y());
+        maxY = qMax(maxY, point.y());
+    }
+    qreal maxWidth = 0;
+    for (int i = 0; i < points.size(); ++i) maxWidth = qMax(maxWidth, segmentWidth(i));
+    const qreal pad = maxWidth / 2.0 + 1.0; // Round caps reach half the width past the ends
+    return QRectF(QPointF(minX, minY), QPointF(maxX, maxY)).adjusted(-pad, -pad, pad, pad);
+}
+
+void InkStroke::translate(qreal dx, qreal dy)
+{
+    for (QPointF &point : points) point += QPointF(dx, dy);
+}
+
+QString InkStrokeStore::strokeFilePath(const QString &saveFolder, const QString &notebookId, int pageNumber)
+{
+    return saveFolder + QString("/%1_%2.strokes").arg(notebookId).arg(pageNumber, 5, 10, QChar('0'));
+}
+
+bool InkStrokeStore::savePage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkStrokePage page)
+{
+    if (saveFolder.isEmpty()) return false;
+
+    if (!imageStamp(InkPageIndex::pageImagePath(saveFolder, notebookId, pageNumber),
+                    page.imageFileSize, page.imageChecksum)) {
+        page.imageFileSize = -1;
+        page.imageChecksum = 0;
+    }
+
+    // ✅ QSaveFile so export never reads a half-written stroke file
+    QSaveFile file(strokeFilePath(saveFolder, notebookId, pageNumber));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write strokes for page" << pageNumber << "in" << saveFolder;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out << STROKE_FILE_MAGIC << STROKE_FILE_VERSION
+        << qint32(page.imageSize.width()) << qint32(page.imageSize.height()) << page.imageFileSize
+        << page.imageChecksum << quint32(page.strokes.size());
+    for (const InkStroke &stroke : page.strokes) {
+        out << quint8(stroke.tool) << quint32(stroke.color.rgba()) << stroke.width << quint32(stroke.points.size());
+        for (int i = 0; i < stroke.points.size(); ++i) {
+            out << stroke.points[i].x() << stroke.points[i].y() << stroke.pressures.value(i, 1.0);
+        }
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+void InkStrokeStore::removePage(const QString &saveFolder, const QString &notebookId, int pageNumber)
+{
+    if (saveFolder.isEmpty()) return;
+    QFile::remove(strokeFilePath(saveFolder, notebookId, pageNumber));
+}
+
+bool InkStrokeStore::loadPage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkStrokePage &page)
+{
+    if (saveFolder.isEmpty()) return false;
+
+    QFile file(strokeFilePath(saveFolder, notebookId, pageNumber));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    quint32 strokeCount = 0;
+    in >> magic >> version >> width >> height >> page.imageFileSize >> page.imageChecksum >> strokeCount;
+    if (in.status() != QDataStream::Ok || magic != STROKE_FILE_MAGIC || version != STROKE_FILE_VERSION) {
+        return false;
+    }
+
+    // Only trust the strokes while the PNG is the one they were saved with: the size
+    // rules most changes out without reading it, the checksum the rest
+    const QString imagePath = InkPageIndex::pageImagePath(saveFolder, notebookId, pageNumber);
+    if (QFileInfo(imagePath).size() != page.imageFileSize) {
+        return false;
+    }
+    qint64 imageSize = -1;
+    quint32 imageChecksum = 0;
+    if (!imageStamp(imagePath, imageSize, imageChecksum) || imageSize != page.imageFileSize ||
+        imageChecksum != page.imageChecksum) {
+        return false;
+    }
+
+    page.imageSize = QSize(width, height);
+    page.strokes.clear();
+    for (quint32 s = 0; s < strokeCount && in.status() == QDataStream::Ok; ++s) {
+        InkStroke stroke;
+        quint8 tool = 0;
+        quint32 rgba = 0;
+        quint32 pointCount = 0;
+        in >> tool >> rgba >> stroke.width >> pointCount;
+        if (in.status() != QDataStream::Ok || pointCount > quint32(file.size())) return false;
+
+        stroke.tool = tool == quint8(ToolType::Marker) ? ToolType::Marker : ToolType::Pen;
+        stroke.color = QColor::fromRgba(rgba);
+        stroke.points.reserve(pointCount);
+        stroke.pressures.reserve(pointCount);
+        for (quint32 i = 0; i < pointCount; ++i) {
+            qreal x = 0, y = 0, pressure = 0;
+            in >> x >> y >> pressure;
+            stroke.points.append(QPointF(x, y));
+            stroke.pressures.append(pressure);
+        }
+        page.strokes.append(stroke);
+    }
+    return in.status() == QDataStream::Ok && page.imageSize.isValid();
+}
+
+QByteArray InkStrokeStore::pdfContent(const InkStrokePage &page, QByteArray *extGStates)
+{
+    QByteArray out = "1 J 1 j\n";
+    QSet<int> alphas;
+    QRgb currentRgb = qRgb(0, 0, 0);
+    int currentAlpha = 255;
+    QByteArray currentWidth;
+
+    for (const InkStroke &stroke : page.strokes) {
+        if (stroke.points.isEmpty()) continue;
+
+        const QRgb rgb = stroke.color.rgb();
+        if (rgb != currentRgb) {
+            out += pdfNumber(stroke.color.redF(), 3) + " " + pdfNumber(stroke.color.greenF(), 3) + " " +
+                   pdfNumber(stroke.color.blueF(), 3) + " RG\n";
+            currentRgb = rgb;
+        }
+        const int alpha = stroke.color.alpha();
+        if (alpha != currentAlpha) {
+            out += "/A" + QByteArray::number(alpha) + " gs\n";
+            alphas.insert(alpha);
+            currentAlpha = alpha;
+        }
+
+        // Translucent segments are stroked one by one, so their overlaps build up
+        // like on the canvas; opaque runs of equal width share a path
+        const int count = stroke.points.size();
+        int i = qMin(1, count - 1);
+        while (i < count) {
+            const QByteArray width = pdfNumber(stroke.segmentWidth(i));
+            if (width != currentWidth) {
+                out += width + " w\n";
+                currentWidth = width;
+            }
+            out += pdfPoint(stroke.points[qMax(0, i - 1)]) + " m " + pdfPoint(stroke.points[i]) + " l";
+            ++i;
+            while (alpha == 255 && i < count && pdfNumber(stroke.segmentWidth(i)) == currentWidth) {
+                out += " " + pdfPoint(stroke.points[i]) + " l";
+                ++i;
+            }
+            out += " S\n";
+        }
+    }
+
+    if (extGStates) {
+        extGStates->clear();
+        if (!alphas.isEmpty()) {
+            QList<int> sorted = alphas.values();
+            std::sort(sorted.begin(), sorted.end());
+            *extGStates = "<<";
+            for (int alpha : sorted) {
+                *extGStates += " /A" + QByteArray::number(alpha) + " << /Type /ExtGState /CA " +
+                               QByteArray::number(alpha / 255.0, 'f', 4) + " >>";
+            }
+            *extGStates += " >>";
+        }
+    }
+    return out;
+}
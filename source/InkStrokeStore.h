@@ -0,0 +1,64 @@
+#ifndef INKSTROKESTORE_H
+#define INKSTROKESTORE_H
+
+#include <QString>
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+#include <QColor>
+#include <QByteArray>
+#include "ToolType.h"
+
+// One pen or marker stroke, in the pixels of the page image it was drawn into.
+// Like the canvas, every segment is painted on its own with round caps:
+// segment i-1 -> i has the pressure of point i.
+struct InkStroke {
+    ToolType tool = ToolType::Pen;
+    QColor color;          // As painted, including the marker's alpha
+    qreal width = 1.0;     // Pen: width at full pressure; marker: final width
+    QList<QPointF> points;
+    QList<qreal> pressures;
+
+    qreal segmentWidth(int index) const;
+    QRectF bounds() const; // Painted area, caps included
+    void translate(qreal dx, qreal dy);
+};
+
+// Vector copy of a page's ink
+struct InkStrokePage {
+    QSize imageSize;            // Page image the strokes were drawn in
+    qint64 imageFileSize = -1;  // Size and CRC-32C of the page PNG they describe (staleness check;
+    quint32 imageChecksum = 0;  // a content hash survives copies and .spn unpacking, mtimes don't)
+    QList<InkStroke> strokes;
+};
+
+// Stroke geometry saved next to each page PNG as <id>_<page>.strokes, so
+// export can write ink as PDF paths instead of images.
+//
+// A page only has a stroke file while its strokes reproduce the PNG: the
+// canvas drops it when raster-only edits (eraser, rope tool) touch the page,
+// and a file whose PNG changed since it was written is ignored. Either way
+// export falls back to the PNG.
+class InkStrokeStore
+{
+public:
+    static QString strokeFilePath(const QString &saveFolder, const QString &notebookId, int pageNumber);
+
+    // Write a page's strokes; call after its PNG was saved, whose size and checksum are recorded
+    static bool savePage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkStrokePage page);
+
+    // Drop a page's strokes so it exports from its PNG
+    static void removePage(const QString &saveFolder, const QString &notebookId, int pageNumber);
+
+    // Read a page's strokes. Returns false if there are none or they no longer
+    // match the PNG on disk.
+    static bool loadPage(const QString &saveFolder, const QString &notebookId, int pageNumber, InkStrokePage &page);
+
+    // Content stream drawing the strokes in image pixel space (y down, origin
+    // top left). Translucent strokes select alpha states from the returned
+    // /ExtGState resource dictionary (empty when every stroke is opaque).
+    static QByteArray pdfContent(const InkStrokePage &page, QByteArray *extGStates);
+};
+
+#endif // INKSTROKESTORE_H
@@ -2,6 +2,8 @@
 #include "MainWindow.h"
 #include "RecentNotebooksManager.h"
 #include "SpnPackageManager.h"
+#include "NotebookSearchIndex.h"
+#include "ExportJobManager.h"
 #include <QApplication>
 #include <QVBoxLayout>
 #ifdef Q_OS_WIN
@@ -38,6 +40,9 @@
 #include <QScreen>
 #include <QScroller>
 #include <QHash>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QSettings>
 
 LauncherWindow::LauncherWindow(QWidget *parent)
     : QMainWindow(parent), notebookManager(nullptr), lastCalculatedWidth(0)
@@ -67,6 +72,13 @@ LauncherWindow::LauncherWindow(QWidget *parent)
                 // The cache invalidation is enough; thumbnails will refresh on next launcher open
             });
     
+    // Background exports keep running while the launcher is used
+    ExportJobManager *exportJobs = ExportJobManager::getInstance();
+    connect(exportJobs, &ExportJobManager::jobsChanged, this, &LauncherWindow::updateExportStatus);
+    connect(exportJobs, &ExportJobManager::progressChanged, this, &LauncherWindow::updateExportStatus);
+    connect(exportJobs, &ExportJobManager::jobFinished, this, &LauncherWindow::onExportJobFinished);
+    updateExportStatus();
+    
     // Don't populate grids in constructor - showEvent will handle it
     // This prevents double population (constructor + showEvent)
 }
@@ -111,6 +123,7 @@ void LauncherWindow::setupUi()
     QListWidgetItem *openNotebookItem = new QListWidgetItem(loadThemedIcon("folder"), tr("Open Notes"));
     QListWidgetItem *recentItem = new QListWidgetItem(loadThemedIcon("benchmark"), tr("Recent"));
     QListWidgetItem *starredItem = new QListWidgetItem(loadThemedIcon("star"), tr("Starred"));
+    QListWidgetItem *searchItem = new QListWidgetItem(loadThemedIcon("zoom"), tr("Search"));
     
     // Set explicit size hints for touch-friendly interface
     QSize itemSize(190, 60); // Width, Height - much taller for touch
@@ -120,6 +133,7 @@ void LauncherWindow::setupUi()
     openNotebookItem->setSizeHint(itemSize);
     recentItem->setSizeHint(itemSize);
     starredItem->setSizeHint(itemSize);
+    searchItem->setSizeHint(itemSize);
     
     // Set font for each item
     QFont itemFont;
@@ -131,6 +145,7 @@ void LauncherWindow::setupUi()
     openNotebookItem->setFont(itemFont);
     recentItem->setFont(itemFont);
     starredItem->setFont(itemFont);
+    searchItem->setFont(itemFont);
     
     tabList->addItem(returnItem);
     tabList->addItem(newItem);
@@ -138,6 +153,7 @@ void LauncherWindow::setupUi()
     tabList->addItem(openNotebookItem);
     tabList->addItem(recentItem);
     tabList->addItem(starredItem);
+    tabList->addItem(searchItem);
     
     tabList->setCurrentRow(4); // Start with Recent tab (now index 4)
     
@@ -151,6 +167,7 @@ void LauncherWindow::setupUi()
     setupOpenNotebookTab();
     setupRecentTab();
     setupStarredTab();
+    setupSearchTab();
     
     contentStack->addWidget(returnTab);
     contentStack->addWidget(newTab);
@@ -158,10 +175,40 @@ void LauncherWindow::setupUi()
     contentStack->addWidget(openNotebookTab);
     contentStack->addWidget(recentTab);
     contentStack->addWidget(starredTab);
+    contentStack->addWidget(searchTab);
     contentStack->setCurrentIndex(4); // Start with Recent tab (now index 4)
     
+    // Background export progress below the tabs, hidden while idle
+    exportStatusWidget = new QWidget();
+    QVBoxLayout *exportStatusLayout = new QVBoxLayout(exportStatusWidget);
+    exportStatusLayout->setContentsMargins(8, 4, 8, 8);
+    exportStatusLabel = new QLabel();
+    exportStatusLabel->setWordWrap(true);
+    exportStatusBar = new QProgressBar();
+    exportStatusBar->setTextVisible(false);
+    exportStatusBar->setFixedHeight(8);
+    QPushButton *cancelExportButton = new QPushButton(tr("Cancel Export"));
+    connect(cancelExportButton, &QPushButton::clicked, this, []() {
+        ExportJobManager *exportJobs = ExportJobManager::getInstance();
+        if (exportJobs->isBusy()) {
+            exportJobs->cancel(exportJobs->jobs().first().id);
+        }
+    });
+    exportStatusLayout->addWidget(exportStatusLabel);
+    exportStatusLayout->addWidget(exportStatusBar);
+    exportStatusLayout->addWidget(cancelExportButton);
+    exportStatusWidget->setVisible(false);
+    
+    QWidget *sidebar = new QWidget();
+    sidebar->setFixedWidth(205);
+    QVBoxLayout *sidebarLayout = new QVBoxLayout(sidebar);
+    sidebarLayout->setContentsMargins(0, 0, 0, 0);
+    sidebarLayout->setSpacing(0);
+    sidebarLayout->addWidget(tabList, 1);
+    sidebarLayout->addWidget(exportStatusWidget);
+    
     // Add to splitter
-    mainSplitter->addWidget(tabList);
+    mainSplitter->addWidget(sidebar);
     mainSplitter->addWidget(contentStack);
     
     // Configure stretch factors: sidebar doesn't stretch, content area does
@@ -359,6 +406,119 @@ void LauncherWindow::setupStarredTab()
     layout->addWidget(starredScrollArea);
 }
 
+void LauncherWindow::setupSearchTab()
+{
+    searchTab = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(searchTab);
+    layout->setContentsMargins(20, 20, 20, 20);
+    
+    // Title
+    QLabel *titleLabel = new QLabel(tr("Search Notebooks"));
+    titleLabel->setObjectName("titleLabel");
+    layout->addWidget(titleLabel);
+    
+    notebookSearchInput = new QLineEdit();
+    notebookSearchInput->setPlaceholderText(tr("Search notes, highlights and bookmarks..."));
+    notebookSearchInput->setClearButtonEnabled(true);
+    notebookSearchInput->setMinimumHeight(40);
+    layout->addWidget(notebookSearchInput);
+    
+    notebookSearchStatus = new QLabel();
+    notebookSearchStatus->setObjectName("descLabel");
+    layout->addWidget(notebookSearchStatus);
+    
+    notebookSearchResults = new QListWidget();
+    notebookSearchResults->setWordWrap(true);
+    notebookSearchResults->setSpacing(2);
+    notebookSearchResults->setAttribute(Qt::WA_AcceptTouchEvents, true);
+    QScroller::grabGesture(notebookSearchResults->viewport(), QScroller::LeftMouseButtonGesture);
+    layout->addWidget(notebookSearchResults, 1);
+    
+    connect(notebookSearchInput, &QLineEdit::textChanged, this, &LauncherWindow::runNotebookSearch);
+    connect(notebookSearchResults, &QListWidget::itemClicked, this, &LauncherWindow::onNotebookSearchResultClicked);
+}
+
+void LauncherWindow::refreshNotebookSearchIndex()
+{
+    if (!notebookManager || notebookSearchRefreshRunning) return;
+    
+    QStringList paths = notebookManager->getRecentNotebooks();
+    for (const QString &path : notebookManager->getStarredNotebooks()) {
+        if (!paths.contains(path)) paths.append(path);
+    }
+    paths.removeAll(QString());
+    
+    // ✅ Re-index changed notebooks in the background; results refresh when done
+    notebookSearchRefreshRunning = true;
+    QPointer<LauncherWindow> self(this);
+    QThreadPool::globalInstance()->start([self, paths]() {
+        NotebookSearchIndex::refreshNotebooks(paths);
+        if (self) {
+            QMetaObject::invokeMethod(self, [self]() {
+                if (!self) return;
+                self->notebookSearchRefreshRunning = false;
+                if (!self->notebookSearchInput->text().trimmed().isEmpty()) {
+                    self->runNotebookSearch();
+                }
+            }, Qt::QueuedConnection);
+        }
+    });
+}
+
+void LauncherWindow::runNotebookSearch()
+{
+    notebookSearchResults->clear();
+    
+    const QString query = notebookSearchInput->text().trimmed();
+    if (query.isEmpty()) {
+        notebookSearchStatus->clear();
+        return;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    const QList<NotebookSearchHit> hits = NotebookSearchIndex::search(query);
+    
+    for (const NotebookSearchHit &hit : hits) {
+        QString kindLabel;
+        switch (hit.item.kind) {
+            case NotebookSearchItem::Note: kindLabel = tr("Note"); break;
+            case NotebookSearchItem::Highlight: kindLabel = tr("Highlight"); break;
+            case NotebookSearchItem::Bookmark: kindLabel = tr("Bookmark"); break;
+        }
+        
+        // Keep the snippet short: title for notes/bookmarks, start of the text otherwise
+        QString snippet = hit.item.title.isEmpty() ? hit.item.text : hit.item.title;
+        snippet = snippet.simplified();
+        if (snippet.length() > 120) snippet = snippet.left(117) + "...";
+        
+        QListWidgetItem *item = new QListWidgetItem(
+            tr("%1 - %2, page %3\n%4").arg(hit.notebookName, kindLabel).arg(hit.item.pageNumber + 1).arg(snippet));
+        item->setData(Qt::UserRole, hit.notebookPath);
+        item->setData(Qt::UserRole + 1, hit.item.pageNumber);
+        item->setToolTip(hit.notebookPath);
+        notebookSearchResults->addItem(item);
+    }
+    
+    if (hits.isEmpty()) {
+        notebookSearchStatus->setText(notebookSearchRefreshRunning ? tr("No matches yet (updating index...)") : tr("No matches"));
+    } else {
+        notebookSearchStatus->setText(tr("%n match(es) in %1 ms", "", hits.size()).arg(timer.elapsed()));
+    }
+}
+
+void LauncherWindow::onNotebookSearchResultClicked(QListWidgetItem *item)
+{
+    if (!item) return;
+    
+    const QString path = item->data(Qt::UserRole).toString();
+    if (!QFileInfo::exists(path)) {
+        QMessageBox::warning(this, tr("Notebook Not Found"), tr("The notebook no longer exists:\n%1").arg(path));
+        return;
+    }
+    openNotebook(path, item->data(Qt::UserRole + 1).toInt());
+}
+
 void LauncherWindow::populateRecentGrid()
 {
     // Clear existing widgets more thoroughly
@@ -698,7 +858,7 @@ void LauncherWindow::onStarredNotebookClicked()
     }
 }
 
-void LauncherWindow::openNotebook(const QString &path)
+void LauncherWindow::openNotebook(const QString &path, int pageNumber)
 {
     if (path.isEmpty()) return;
     
@@ -744,7 +904,9 @@ void LauncherWindow::openNotebook(const QString &path)
         InkCanvas *canvas = targetMainWindow->currentCanvas();
         if (canvas) {
             canvas->setSaveFolder(path);
-            if (!targetMainWindow->showLastAccessedPageDialog(canvas)) {
+            if (pageNumber >= 0) {
+                // Jumped to below
+            } else if (!targetMainWindow->showLastAccessedPageDialog(canvas)) {
                 targetMainWindow->switchPageWithDirection(1, 1);
                 targetMainWindow->pageInput->setValue(1);
             } else {
@@ -754,6 +916,13 @@ void LauncherWindow::openNotebook(const QString &path)
             targetMainWindow->updateBookmarkButtonState();
         }
     }
+    
+    // Opened from a search result: go to the page of the hit
+    if (pageNumber >= 0 && targetMainWindow->currentCanvas()) {
+        targetMainWindow->switchPageWithDirection(pageNumber + 1, 1);
+        targetMainWindow->pageInput->setValue(pageNumber + 1);
+        targetMainWindow->updateBookmarkButtonState();
+    }
 }
 
 void LauncherWindow::onNotebookRightClicked(const QPoint &pos)
@@ -791,6 +960,14 @@ void LauncherWindow::onNotebookRightClicked(const QPoint &pos)
         menu->addSeparator();
     }
     
+    // Export in the background; the launcher stays usable meanwhile
+    QAction *exportAction = menu->addAction(loadThemedIcon("pdf"), tr("Export to PDF..."));
+    connect(exportAction, &QAction::triggered, this, [this, path]() {
+        exportNotebookInBackground(path);
+    });
+    
+    menu->addSeparator();
+    
     // Open in file explorer
     QAction *explorerAction = menu->addAction(loadThemedIcon("folder"), tr("Show in Explorer"));
     connect(explorerAction, &QAction::triggered, this, [path]() {
@@ -806,6 +983,62 @@ void LauncherWindow::onNotebookRightClicked(const QPoint &pos)
     menu->popup(button->mapToGlobal(pos));
 }
 
+void LauncherWindow::exportNotebookInBackground(const QString &path)
+{
+    QFileInfo info(path);
+    const QString baseName = path.endsWith(".spn", Qt::CaseInsensitive) ? info.completeBaseName() : info.fileName();
+    QString exportPath = QFileDialog::getSaveFileName(this, tr("Export Notebook to PDF"),
+        QDir(info.absolutePath()).filePath(baseName + "_annotated.pdf"), "PDF Files (*.pdf)");
+    if (exportPath.isEmpty()) return;
+    if (!exportPath.toLower().endsWith(".pdf")) {
+        exportPath += ".pdf";
+    }
+    
+    // Same image quality as the last export from a notebook window
+    const PdfExportProfile profile = PdfExportProfile::preset(
+        QSettings("SpeedyNote", "App").value("exportProfile", "lossless").toString());
+    
+    QString errorMsg;
+    const QString id = ExportJobManager::getInstance()->enqueueNotebook(path, exportPath, profile, &errorMsg);
+    if (id.isEmpty()) {
+        QMessageBox::warning(this, tr("Export Failed"), errorMsg);
+        return;
+    }
+    ownExportJobs.insert(id);
+}
+
+void LauncherWindow::updateExportStatus()
+{
+    ExportJobManager *exportJobs = ExportJobManager::getInstance();
+    exportStatusWidget->setVisible(exportJobs->isBusy());
+    if (!exportJobs->isBusy()) return;
+    
+    const ExportJobManager::Entry current = exportJobs->jobs().first();
+    exportStatusLabel->setText(exportJobs->statusText());
+    exportStatusBar->setRange(0, qMax(1, current.pageCount));
+    exportStatusBar->setValue(current.pagesWritten);
+}
+
+void LauncherWindow::onExportJobFinished(const QString &id, const QString &outputPath, bool success, const QString &errorMsg)
+{
+    // Jobs queued from a notebook window report there
+    if (!ownExportJobs.remove(id)) return;
+    
+    QMessageBox *box = new QMessageBox(this);
+    box->setAttribute(Qt::WA_DeleteOnClose);
+    if (success) {
+        box->setIcon(QMessageBox::Information);
+        box->setWindowTitle(tr("Export Complete"));
+        box->setText(tr("PDF exported to:\n%1").arg(outputPath));
+    } else {
+        box->setIcon(QMessageBox::Critical);
+        box->setWindowTitle(tr("Export Failed"));
+        box->setText(errorMsg.isEmpty() ? tr("Failed to export %1.").arg(outputPath) : errorMsg);
+    }
+    box->setModal(false);
+    box->show();
+}
+
 void LauncherWindow::toggleStarredStatus(const QString &path)
 {
     if (notebookManager->isStarred(path)) {
@@ -1014,6 +1247,9 @@ void LauncherWindow::showEvent(QShowEvent *event)
     populateRecentGrid();
     populateStarredGrid();
     
+    // Pick up notebooks changed since the launcher was last shown
+    refreshNotebookSearchIndex();
+    
     // Simple UI update
     update();
 }
@@ -1144,9 +1380,13 @@ void LauncherWindow::onTabChanged(int index)
             
         case 4: // Recent tab - show content
         case 5: // Starred tab - show content
+        case 6: // Search tab - show content
         default:
             // Show the corresponding content page
             contentStack->setCurrentIndex(index);
+            if (index == 6) {
+                notebookSearchInput->setFocus();
+            }
             break;
     }
 }
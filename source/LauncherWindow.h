@@ -16,6 +16,9 @@
 #include <QSplitter>
 #include <QListWidget>
 #include <QStackedWidget>
+#include <QLineEdit>
+#include <QProgressBar>
+#include <QSet>
 
 class MainWindow;
 class RecentNotebooksManager;
@@ -42,6 +45,8 @@ private slots:
     void onRecentNotebookClicked();
     void onStarredNotebookClicked();
     void onNotebookRightClicked(const QPoint &pos);
+    void runNotebookSearch();
+    void onNotebookSearchResultClicked(QListWidgetItem *item);
 
 private:
     void setupUi();
@@ -51,15 +56,20 @@ private:
     void setupOpenNotebookTab();
     void setupRecentTab();
     void setupStarredTab();
+    void setupSearchTab();
+    void refreshNotebookSearchIndex();
     void populateRecentGrid();
     void populateStarredGrid();
     void clearRecentGrid();
     void clearStarredGrid();
     void clearPixmapCache();
     QPushButton* createNotebookButton(const QString &path, bool isStarred = false);
-    void openNotebook(const QString &path);
+    void openNotebook(const QString &path, int pageNumber = -1); // pageNumber is 0-based, -1 = last accessed
     void toggleStarredStatus(const QString &path);
     void removeFromRecent(const QString &path);
+    void exportNotebookInBackground(const QString &path);
+    void updateExportStatus();
+    void onExportJobFinished(const QString &id, const QString &outputPath, bool success, const QString &errorMsg);
     QString getModernButtonStyle();
     QString getTabStyle();
     void applyModernStyling();
@@ -90,6 +100,7 @@ protected:
     QWidget *openNotebookTab;
     QWidget *recentTab;
     QWidget *starredTab;
+    QWidget *searchTab;
     
     // Recent and Starred grids
     QScrollArea *recentScrollArea;
@@ -99,6 +110,18 @@ protected:
     QGridLayout *recentGridLayout;
     QGridLayout *starredGridLayout;
     
+    // Search across the notes, highlights and bookmarks of known notebooks
+    QLineEdit *notebookSearchInput;
+    QLabel *notebookSearchStatus;
+    QListWidget *notebookSearchResults;
+    bool notebookSearchRefreshRunning = false;
+    
+    // Background export progress (see ExportJobManager)
+    QWidget *exportStatusWidget;
+    QLabel *exportStatusLabel;
+    QProgressBar *exportStatusBar;
+    QSet<QString> ownExportJobs; // Exports queued from this launcher
+    
     // Layout optimization
     int lastCalculatedWidth;
     
@@ -14,6 +14,8 @@
 #include "MainWindow.h"
 #include "LauncherWindow.h"
 #include "SpnPackageManager.h"
+#include "HeadlessExporter.h"
+#include "ExportJobManager.h"
 #include "InkCanvas.h" // For BackgroundStyle enum
 
 #ifdef Q_OS_WIN
@@ -126,6 +128,11 @@ static void applySystemPalette(QApplication &app) {
 }
 
 int main(int argc, char *argv[]) {
+    // ✅ Headless export: no windows, no controllers, no single-instance handoff
+    if (HeadlessExporter::isExportCommand(argc, argv)) {
+        return HeadlessExporter::run(argc, argv);
+    }
+
 #ifdef _WIN32
     FreeConsole();  // Hide console safely on Windows
 
@@ -173,6 +180,9 @@ int main(int argc, char *argv[]) {
     // from crashes/force-close can accumulate. This cleanup runs on startup to free disk space.
     SpnPackageManager::cleanupOrphanedTempDirs();
     
+    // ✅ Resume background PDF exports interrupted when the app last closed
+    ExportJobManager::getInstance(&app);
+    
     QTranslator translator;
     
     // Check for manual language override
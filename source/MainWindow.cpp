@@ -2,6 +2,9 @@
 #include "InkCanvas.h"
 #include "MarkdownWindowManager.h"
 #include "ButtonMappingTypes.h"
+#include "PdfIncrementalWriter.h"
+#include "ExportJobManager.h"
+#include "InkPageIndex.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QScreen>
@@ -40,6 +43,7 @@
 #include <QTimer>
 #include <QPdfWriter>
 #include <QProgressDialog>
+#include <QEventLoop>
 #include <QProcess>
 #include <QFileInfo>
 #include <QThread>
@@ -287,6 +291,28 @@ void MainWindow::setupUi() {
     benchmarkLabel->setFixedHeight(30);  // Make the benchmark bar smaller
     updateButtonIcon(benchmarkButton, "benchmark");
 
+    // Background export queue: progress of the running job, hidden while idle
+    exportJobProgress = new QProgressBar(this);
+    exportJobProgress->setFixedSize(160, 30);
+    exportJobProgress->setVisible(false);
+    exportJobCancelButton = new QPushButton(this);
+    exportJobCancelButton->setFixedSize(26, 30);
+    exportJobCancelButton->setStyleSheet(buttonStyle);
+    exportJobCancelButton->setToolTip(tr("Cancel Background Export"));
+    exportJobCancelButton->setIcon(loadThemedIcon("cross"));
+    exportJobCancelButton->setVisible(false);
+    connect(exportJobCancelButton, &QPushButton::clicked, this, []() {
+        ExportJobManager *exportJobs = ExportJobManager::getInstance();
+        if (exportJobs->isBusy()) {
+            exportJobs->cancel(exportJobs->jobs().first().id);
+        }
+    });
+    ExportJobManager *exportJobs = ExportJobManager::getInstance();
+    connect(exportJobs, &ExportJobManager::jobsChanged, this, &MainWindow::updateExportJobStatus);
+    connect(exportJobs, &ExportJobManager::progressChanged, this, &MainWindow::updateExportJobStatus);
+    connect(exportJobs, &ExportJobManager::jobFinished, this, &MainWindow::onExportJobFinished);
+    updateExportJobStatus(); // A job resumed at startup may already be running
+
     toggleTabBarButton = new QPushButton(this);
     toggleTabBarButton->setToolTip(tr("Show/Hide Tab Bar"));
     toggleTabBarButton->setFixedSize(26, 30);
@@ -774,6 +800,34 @@ void MainWindow::setupUi() {
     // Connect bookmarks tree item clicks
     connect(bookmarksTree, &QTreeWidget::itemClicked, this, &MainWindow::onBookmarkItemClicked);
     
+    // 🌟 PDF Search Sidebar
+    searchSidebar = new QWidget(this);
+    searchSidebar->setFixedWidth(250);
+    searchSidebar->setVisible(false); // Hidden by default
+    QVBoxLayout *searchLayout = new QVBoxLayout(searchSidebar);
+    searchLayout->setContentsMargins(5, 5, 5, 5);
+    QLabel *searchLabel = new QLabel(tr("Search PDF"), searchSidebar);
+    searchLabel->setStyleSheet("font-weight: bold; padding: 5px;");
+    searchLayout->addWidget(searchLabel);
+    searchInput = new QLineEdit(searchSidebar);
+    searchInput->setPlaceholderText(tr("Search text..."));
+    searchInput->setClearButtonEnabled(true);
+    searchLayout->addWidget(searchInput);
+    searchStatusLabel = new QLabel(searchSidebar);
+    searchStatusLabel->setStyleSheet("padding: 2px 5px;");
+    searchLayout->addWidget(searchStatusLabel);
+    searchResultsList = new QListWidget(searchSidebar);
+    searchLayout->addWidget(searchResultsList);
+    // The index answers in milliseconds, so results follow every keystroke
+    connect(searchInput, &QLineEdit::textChanged, this, &MainWindow::runPdfSearch);
+    connect(searchInput, &QLineEdit::returnPressed, this, [this]() {
+        if (searchResultsList->count() > 0) {
+            searchResultsList->setCurrentRow(0);
+            onSearchResultClicked(searchResultsList->item(0));
+        }
+    });
+    connect(searchResultsList, &QListWidget::itemClicked, this, &MainWindow::onSearchResultClicked);
+    
     // 🌟 Markdown Notes Sidebar
     markdownNotesSidebar = new MarkdownNotesSidebar(this);
     markdownNotesSidebar->setFixedWidth(300);
@@ -1119,6 +1173,8 @@ void MainWindow::setupUi() {
     controlLayout->addWidget(dezoomButton);
     controlLayout->addWidget(zoom200Button);
     controlLayout->addStretch();
+    controlLayout->addWidget(exportJobProgress);
+    controlLayout->addWidget(exportJobCancelButton);
     
     
     controlLayout->addWidget(prevPageButton);
@@ -1192,6 +1248,7 @@ void MainWindow::setupUi() {
     contentLayout->setSpacing(0);
     contentLayout->addWidget(outlineSidebar, 0); // Fixed width outline sidebar
     contentLayout->addWidget(bookmarksSidebar, 0); // Fixed width bookmarks sidebar
+    contentLayout->addWidget(searchSidebar, 0); // Fixed width search sidebar
     contentLayout->addWidget(canvasContainer, 1); // Canvas takes remaining space
     contentLayout->addWidget(markdownNotesSidebar, 0); // Fixed width markdown notes sidebar
     
@@ -1808,6 +1865,7 @@ void MainWindow::saveCurrentPageConcurrent() {
                 painter.drawPixmap(0, 0, currentPageBuffer);
             }
             currentImage.save(currentFilePath, "PNG");
+            InkPageIndex::recordPage(saveFolder, notebookId, pageNumber, InkPageIndex::computeBounds(currentImage));
             
             // Save next page (bottom half) - DIRECT SAVE like top half
             // ✅ FIX: Don't merge, just save directly to properly handle erasure/deletion
@@ -1822,6 +1880,7 @@ void MainWindow::saveCurrentPageConcurrent() {
                 painter.drawPixmap(0, 0, nextPageBuffer);
             }
             nextImage.save(nextFilePath, "PNG");
+            InkPageIndex::recordPage(saveFolder, notebookId, nextPageNumber, InkPageIndex::computeBounds(nextImage));
         } else {
             // Standard single page save
             QString filePath = saveFolder + QString("/%1_%2.png").arg(notebookId).arg(pageNumber, 5, 10, QChar('0'));
@@ -1830,13 +1889,17 @@ void MainWindow::saveCurrentPageConcurrent() {
             image.fill(Qt::transparent);
             QPainter painter(&image);
             painter.drawPixmap(0, 0, bufferCopy);
+            painter.end();
             image.save(filePath, "PNG");
+            InkPageIndex::recordPage(saveFolder, notebookId, pageNumber, InkPageIndex::computeBounds(image));
         }
     });
     
     // ✅ CRITICAL: Wait for save to complete, then invalidate cache
     // This ensures files are fully written before cache tries to reload them
     concurrentSaveFuture.waitForFinished();
+    canvas->saveBufferStrokes(pageNumber, isCombinedCanvas, singlePageHeight);
+    canvas->scheduleInkIndexWrite();
     
     // Invalidate cache after saving
     if (isCombinedCanvas) {
@@ -1908,6 +1971,21 @@ bool MainWindow::showPageRangeDialog(int totalPages, bool &exportWholeDocument,
     rangeLayout->addStretch();
     mainLayout->addLayout(rangeLayout);
     
+    mainLayout->addSpacing(10);
+    
+    // Image encoding profile (remembered between exports)
+    QHBoxLayout *profileLayout = new QHBoxLayout();
+    profileLayout->addWidget(new QLabel(tr("Image quality:")));
+    QComboBox *profileCombo = new QComboBox();
+    profileCombo->addItem(tr("Lossless (largest file)"), "lossless");
+    profileCombo->addItem(tr("Balanced (JPEG pages, indexed ink)"), "balanced");
+    profileCombo->addItem(tr("Compact (JPEG, 150 DPI)"), "compact");
+    const int profileIndex = profileCombo->findData(QSettings("SpeedyNote", "App").value("exportProfile", "lossless").toString());
+    profileCombo->setCurrentIndex(qMax(0, profileIndex));
+    profileLayout->addWidget(profileCombo);
+    profileLayout->addStretch();
+    mainLayout->addLayout(profileLayout);
+    
     mainLayout->addSpacing(20);
     
     // Buttons
@@ -1946,12 +2024,18 @@ bool MainWindow::showPageRangeDialog(int totalPages, bool &exportWholeDocument,
         exportWholeDocument = wholeDocRadio->isChecked();
         startPage = fromSpinBox->value() - 1; // Convert to 0-based
         endPage = toSpinBox->value() - 1; // Convert to 0-based
+        QSettings("SpeedyNote", "App").setValue("exportProfile", profileCombo->currentData().toString());
         return true;
     }
     
     return false; // User cancelled
 }
 
+// Export profile chosen in the page range dialog
+PdfExportProfile MainWindow::exportProfile() const {
+    return PdfExportProfile::preset(QSettings("SpeedyNote", "App").value("exportProfile", "lossless").toString());
+}
+
 void MainWindow::exportAnnotatedPdf() {
     InkCanvas *canvas = currentCanvas();
     if (!canvas) return;
@@ -2055,16 +2139,9 @@ void MainWindow::exportAnnotatedPdf() {
         scanProgress.setValue(scanIdx);
         QCoreApplication::processEvents();
         
-        QString canvasFile = saveFolder + QString("/%1_%2.png")
-                            .arg(notebookId)
-                            .arg(pageNum, 5, 10, QChar('0'));
-        
-        if (QFile::exists(canvasFile)) {
-            // Check if the file has actual content (not just an empty/transparent PNG)
-            QImage canvasImage(canvasFile);
-            if (!canvasImage.isNull() && canvasImage.width() > 0 && canvasImage.height() > 0) {
-                annotatedPages.insert(pageNum);
-            }
+        // ✅ Ink index answers this without decoding; blank (fully erased) pages are skipped too
+        if (InkPageIndex::pageHasInk(saveFolder, notebookId, pageNum)) {
+            annotatedPages.insert(pageNum);
         }
         scanIdx++;
     }
@@ -2204,6 +2281,23 @@ void MainWindow::exportAnnotatedPdf() {
         }
     }
 
+    // ✅ Whole-document exports run in the background queue: the ink is appended to the
+    // original file as an incremental update (every page is re-rendered only if that fails)
+    if (exportWholeDocument) {
+        PdfExportRenderer::Job job;
+        job.pdfPath = originalPdfPath;
+        job.saveFolder = saveFolder;
+        job.notebookId = notebookId;
+        for (int pageNum = 0; pageNum < totalPages; ++pageNum) {
+            job.pages.append(pageNum);
+        }
+        job.annotatedPages = annotatedPages;
+        job.dpi = pdfRenderDPI;
+        job.profile = exportProfile();
+        queueBackgroundExport(job, exportPath, true);
+        return;
+    }
+
     // Try to use pdftk for efficient merging (only annotated pages need rendering)
     QString tempAnnotatedPdf = QDir::temp().filePath("speedynote_annotated_pages.pdf");
     
@@ -2455,77 +2549,64 @@ void MainWindow::exportCanvasOnlyNotebook(const QString &saveFolder, const QStri
         exportPath += ".pdf";
     }
     
-    // Show progress dialog
-    QProgressDialog progress(tr("Creating PDF from canvas pages..."), tr("Cancel"), 0, sortedPages.size(), this);
-    progress.setWindowModality(Qt::WindowModal);
-    progress.setMinimumDuration(0);
-    
-    // Load first page to determine size
-    QImage firstImage(pageFiles[sortedPages.first()]);
-    if (firstImage.isNull()) {
-        QMessageBox::critical(this, tr("Export Failed"), 
-            tr("Failed to read canvas pages."));
-        return;
-    }
-    
-    // Create QPdfWriter
-    QPdfWriter pdfWriter(exportPath);
-    pdfWriter.setResolution(pdfRenderDPI);
-    
-    // Calculate page size in points (1/72 inch) from image size and DPI
-    // imageWidth pixels / DPI * 72 = points
-    qreal pageWidthPoints = (firstImage.width() * 72.0) / pdfRenderDPI;
-    qreal pageHeightPoints = (firstImage.height() * 72.0) / pdfRenderDPI;
-    
-    pdfWriter.setPageSize(QPageSize(QSizeF(pageWidthPoints, pageHeightPoints), QPageSize::Point));
-    pdfWriter.setPageMargins(QMarginsF(0, 0, 0, 0));
-    
-    QPainter painter;
-    if (!painter.begin(&pdfWriter)) {
-        QMessageBox::critical(this, tr("Export Failed"), 
-            tr("Failed to create PDF file."));
-        return;
-    }
-    
-    // Export each page
-    for (int i = 0; i < sortedPages.size(); ++i) {
-        if (progress.wasCanceled()) {
-            painter.end();
-            QFile::remove(exportPath);
-            return;
-        }
-        
-        int pageNum = sortedPages[i];
-        progress.setValue(i);
-        progress.setLabelText(tr("Exporting page %1 of %2...").arg(pageNum + 1).arg(sortedPages.size()));
-        QCoreApplication::processEvents();
-        
-        // Add new page if not the first
-        if (i > 0) {
-            pdfWriter.newPage();
-        }
-        
-        // Load and draw canvas image
-        QImage canvasImage(pageFiles[pageNum]);
-        if (!canvasImage.isNull()) {
-            QSizeF targetSize = pdfWriter.pageLayout().paintRectPixels(pdfRenderDPI).size();
-            QRectF targetRect(0, 0, targetSize.width(), targetSize.height());
-            painter.drawImage(targetRect, canvasImage);
-        }
+    // ✅ Pages are decoded on render workers and written in order in the background queue
+    PdfExportRenderer::Job job;
+    job.saveFolder = saveFolder;
+    job.notebookId = notebookId;
+    job.pages = sortedPages;
+    job.dpi = pdfRenderDPI;
+    job.profile = exportProfile();
+    queueBackgroundExport(job, exportPath);
+}
+
+// Queue an export in the background; the control bar shows its progress
+void MainWindow::queueBackgroundExport(const PdfExportRenderer::Job &job, const QString &exportPath, bool wholeDocument) {
+    InkCanvas *canvas = currentCanvas();
+    const QString notebookPath = canvas ? canvas->getDisplayPath() : job.saveFolder;
+    QString title = QFileInfo(notebookPath).completeBaseName();
+    if (title.isEmpty()) {
+        title = QFileInfo(exportPath).completeBaseName();
+    }
+    
+    ExportJobManager *exportJobs = ExportJobManager::getInstance();
+    ownExportJobs.insert(exportJobs->enqueue(job, notebookPath, exportPath, title, wholeDocument));
+    updateExportJobStatus();
+}
+
+void MainWindow::updateExportJobStatus() {
+    ExportJobManager *exportJobs = ExportJobManager::getInstance();
+    const bool busy = exportJobs->isBusy();
+    exportJobProgress->setVisible(busy);
+    exportJobCancelButton->setVisible(busy);
+    if (!busy) return;
+    
+    const ExportJobManager::Entry current = exportJobs->jobs().first();
+    exportJobProgress->setRange(0, qMax(1, current.pageCount));
+    exportJobProgress->setValue(current.pagesWritten);
+    exportJobProgress->setFormat(tr("Export %1/%2").arg(current.pagesWritten).arg(current.pageCount));
+    exportJobProgress->setToolTip(exportJobs->statusText());
+}
+
+void MainWindow::onExportJobFinished(const QString &id, const QString &outputPath, bool success, const QString &errorMsg) {
+    // Jobs queued from the launcher or another window report there
+    if (!ownExportJobs.remove(id)) return;
+    
+    // Non-modal, so a finished background job never interrupts writing
+    QMessageBox *box = new QMessageBox(this);
+    box->setAttribute(Qt::WA_DeleteOnClose);
+    if (success) {
+        box->setIcon(QMessageBox::Information);
+        box->setWindowTitle(tr("Export Complete"));
+        box->setText(tr("PDF exported successfully!\n\nOutput size: %1 MB\nSaved to: %2")
+                     .arg(QFileInfo(outputPath).size() / 1024.0 / 1024.0, 0, 'f', 2)
+                     .arg(outputPath));
+    } else {
+        box->setIcon(QMessageBox::Critical);
+        box->setWindowTitle(tr("Export Failed"));
+        box->setText(errorMsg.isEmpty() ? tr("Failed to export %1.").arg(outputPath) : errorMsg);
     }
-    
-    painter.end();
-    progress.setValue(sortedPages.size());
-    
-    QFileInfo outputInfo(exportPath);
-    QMessageBox::information(this, tr("Export Complete"), 
-        tr("Canvas notebook exported successfully!\n\n"
-           "Pages exported: %1\n"
-           "Output size: %2 MB\n"
-           "Saved to: %3")
-        .arg(sortedPages.size())
-        .arg(outputInfo.size() / 1024.0 / 1024.0, 0, 'f', 2)
-        .arg(exportPath));
+    box->setModal(false);
+    box->show();
 }
 
 // Helper function for full render fallback
@@ -2534,99 +2615,25 @@ void MainWindow::exportAnnotatedPdfFullRender(const QString &exportPath, const Q
     InkCanvas *canvas = currentCanvas();
     if (!canvas) return;
     
-    Poppler::Document* pdfDoc = canvas->getPdfDocument();
-    QString saveFolder = canvas->getSaveFolder();
-    QString notebookId = canvas->getNotebookId();
-    QString originalPdfPath = canvas->getPdfPath();
     int totalPages = canvas->getTotalPdfPages();
     
     // Determine the range to export
     int startPage = exportWholeDocument ? 0 : exportStartPage;
     int endPage = exportWholeDocument ? (totalPages - 1) : exportEndPage;
-    int pageCount = endPage - startPage + 1;
-
-    QProgressDialog progress(tr("Exporting annotated PDF..."), tr("Cancel"), 0, pageCount, this);
-    progress.setWindowModality(Qt::WindowModal);
-    progress.setMinimumDuration(0);
-
-    QPdfWriter pdfWriter(exportPath);
-    pdfWriter.setResolution(pdfRenderDPI);
-    
-    std::unique_ptr<Poppler::Page> firstPage(pdfDoc->page(startPage));
-    if (!firstPage) return;
-    
-    QSizeF pageSize = firstPage->pageSizeF();
-    pdfWriter.setPageSize(QPageSize(pageSize, QPageSize::Point));
-    pdfWriter.setPageMargins(QMarginsF(0, 0, 0, 0));
-
-    QPainter painter;
-    if (!painter.begin(&pdfWriter)) {
-        QMessageBox::critical(this, tr("Export Failed"), 
-            tr("Failed to create PDF file."));
-        return;
-    }
 
-    bool firstPageWritten = false;
-    int exportedPageIndex = 0;
+    PdfExportRenderer::Job job;
+    job.pdfPath = canvas->getPdfPath();
+    job.saveFolder = canvas->getSaveFolder();
+    job.notebookId = canvas->getNotebookId();
     for (int pageNum = startPage; pageNum <= endPage; ++pageNum) {
-        if (progress.wasCanceled()) {
-            painter.end();
-            QFile::remove(exportPath);
-            return;
-        }
-
-        progress.setValue(exportedPageIndex);
-        if (annotatedPages.contains(pageNum)) {
-            progress.setLabelText(tr("Rendering page %1 of %2 (annotated)...").arg(exportedPageIndex + 1).arg(pageCount));
-        } else {
-            progress.setLabelText(tr("Rendering page %1 of %2...").arg(exportedPageIndex + 1).arg(pageCount));
-        }
-        QCoreApplication::processEvents();
-
-        if (firstPageWritten) {
-            pdfWriter.newPage();
-        }
-        firstPageWritten = true;
-
-        std::unique_ptr<Poppler::Page> pdfPage(pdfDoc->page(pageNum));
-        if (!pdfPage) {
-            exportedPageIndex++;
-            continue;
-        }
-
-        QImage pdfImage = pdfPage->renderToImage(pdfRenderDPI, pdfRenderDPI);
-        if (pdfImage.isNull()) {
-            exportedPageIndex++;
-            continue;
-        }
-
-        QSizeF targetSize = pdfWriter.pageLayout().paintRectPixels(pdfRenderDPI).size();
-        QRectF targetRect(0, 0, targetSize.width(), targetSize.height());
-
-        painter.drawImage(targetRect, pdfImage);
-
-        // Overlay annotations only if they exist
-        if (annotatedPages.contains(pageNum)) {
-            QString canvasFile = saveFolder + QString("/%1_%2.png")
-                                .arg(notebookId)
-                                .arg(pageNum, 5, 10, QChar('0'));
-
-            if (QFile::exists(canvasFile)) {
-                QImage canvasImage(canvasFile);
-                if (!canvasImage.isNull()) {
-                    painter.drawImage(targetRect, canvasImage);
-                }
-            }
-        }
-        
-        exportedPageIndex++;
+        job.pages.append(pageNum);
     }
+    job.annotatedPages = annotatedPages;
+    job.dpi = pdfRenderDPI;
+    job.profile = exportProfile();
 
-    painter.end();
-    progress.setValue(pageCount);
-
-    QMessageBox::information(this, tr("Export Complete"), 
-        tr("Annotated PDF exported to:\n%1").arg(exportPath));
+    // ✅ Slow path: render every page in the background, resumable if interrupted
+    queueBackgroundExport(job, exportPath);
 }
 
 // Helper function to create PDF with only annotated pages
@@ -2634,63 +2641,68 @@ bool MainWindow::createAnnotatedPagesPdf(const QString &outputPath, const QList<
     InkCanvas *canvas = currentCanvas();
     if (!canvas) return false;
     
-    Poppler::Document* pdfDoc = canvas->getPdfDocument();
-    QString saveFolder = canvas->getSaveFolder();
-    QString notebookId = canvas->getNotebookId();
-
-    QPdfWriter pdfWriter(outputPath);
-    pdfWriter.setResolution(pdfRenderDPI);
-    
-    std::unique_ptr<Poppler::Page> firstPage(pdfDoc->page(pages.first()));
-    if (!firstPage) return false;
-    
-    QSizeF pageSize = firstPage->pageSizeF();
-    pdfWriter.setPageSize(QPageSize(pageSize, QPageSize::Point));
-    pdfWriter.setPageMargins(QMarginsF(0, 0, 0, 0));
-
-    QPainter painter;
-    if (!painter.begin(&pdfWriter)) return false;
-
-    for (int i = 0; i < pages.size(); ++i) {
-        if (progress.wasCanceled()) {
-            painter.end();
-            return false;
-        }
+    PdfExportRenderer::Job job;
+    job.pdfPath = canvas->getPdfPath();
+    job.saveFolder = canvas->getSaveFolder();
+    job.notebookId = canvas->getNotebookId();
+    job.pages = pages;
+    job.annotatedPages = QSet<int>(pages.begin(), pages.end());
+    job.dpi = pdfRenderDPI;
+    job.profile = exportProfile();
 
-        int pageNum = pages[i];
-        progress.setValue(i);
-        progress.setLabelText(tr("Rendering page %1...").arg(pageNum + 1));
-        QCoreApplication::processEvents();
-
-        if (i > 0) {
-            pdfWriter.newPage();
+    QString errorMsg;
+    if (!runPdfExport(job, outputPath, progress, &errorMsg)) {
+        if (!errorMsg.isEmpty()) {
+            QMessageBox::critical(this, tr("Export Failed"), errorMsg);
         }
+        return false;
+    }
+    return true;
+}
 
-        std::unique_ptr<Poppler::Page> pdfPage(pdfDoc->page(pageNum));
-        if (!pdfPage) continue;
-
-        QImage pdfImage = pdfPage->renderToImage(pdfRenderDPI, pdfRenderDPI);
-        if (pdfImage.isNull()) continue;
-
-        QSizeF targetSize = pdfWriter.pageLayout().paintRectPixels(pdfRenderDPI).size();
-        QRectF targetRect(0, 0, targetSize.width(), targetSize.height());
-
-        painter.drawImage(targetRect, pdfImage);
-
-        QString canvasFile = saveFolder + QString("/%1_%2.png")
-                            .arg(notebookId)
-                            .arg(pageNum, 5, 10, QChar('0'));
+// Run an export on the render workers while keeping the window and the progress dialog live
+bool MainWindow::runPdfExport(const PdfExportRenderer::Job &job, const QString &outputPath,
+                              QProgressDialog &progress, QString *errorMsg) {
+    return runExportTask([job, outputPath](PdfExportRenderer::Progress *state, QString *error) {
+        return PdfExportRenderer::exportPdf(job, outputPath, state, error);
+    }, job.pages.size(), progress, errorMsg);
+}
 
-        if (QFile::exists(canvasFile)) {
-            QImage canvasImage(canvasFile);
-            if (!canvasImage.isNull()) {
-                painter.drawImage(targetRect, canvasImage);
-            }
-        }
+bool MainWindow::runExportTask(const std::function<bool(PdfExportRenderer::Progress *, QString *)> &task, int pageCount,
+                               QProgressDialog &progress, QString *errorMsg) {
+    auto state = std::make_shared<PdfExportRenderer::Progress>();
+    auto error = std::make_shared<QString>();
+    
+    QEventLoop loop;
+    QFutureWatcher<bool> watcher;
+    connect(&watcher, &QFutureWatcher<bool>::finished, &loop, &QEventLoop::quit);
+    connect(&progress, &QProgressDialog::canceled, &loop, [state]() {
+        state->canceled = true;
+    });
+    
+    QTimer progressTimer;
+    connect(&progressTimer, &QTimer::timeout, &loop, [&progress, state, pageCount]() {
+        if (progress.wasCanceled()) return;
+        int written = state->pagesWritten;
+        progress.setValue(written);
+        progress.setLabelText(tr("Exporting page %1 of %2...").arg(qMin(written + 1, pageCount)).arg(pageCount));
+    });
+    progressTimer.start(100);
+    
+    watcher.setFuture(QtConcurrent::run([task, state, error]() {
+        return task(state.get(), error.get());
+    }));
+    loop.exec();
+    progressTimer.stop();
+    
+    bool success = watcher.result();
+    if (success) {
+        progress.setValue(pageCount);
     }
-
-    painter.end();
-    return true;
+    if (errorMsg) {
+        *errorMsg = *error;
+    }
+    return success;
 }
 
 // Helper function to merge using pdftk
@@ -3201,6 +3213,11 @@ void MainWindow::clearPdf() {
     if (outlineSidebarVisible) {
         loadPdfOutline(); // This will clear the outline since no PDF is loaded
     }
+    
+    // ✅ Search results pointed into the removed PDF
+    if (searchSidebarVisible) {
+        runPdfSearch();
+    }
 }
 
 void MainWindow::handleSmartPdfButton() {
@@ -3320,13 +3337,18 @@ void MainWindow::switchTab(int index) {
                 loadBookmarks();
             }
             
+            // ✅ Re-run the search against the new tab's PDF
+            if (searchSidebarVisible) {
+                runPdfSearch();
+            }
+            
             // ✅ Refresh markdown notes if sidebar is visible
             if (markdownNotesSidebarVisible) {
                 loadMarkdownNotesForCurrentPage();
             }
             
             // Force layout refresh when switching tabs with sidebar visible
-            if (markdownNotesSidebarVisible || outlineSidebarVisible || bookmarksSidebarVisible) {
+            if (markdownNotesSidebarVisible || outlineSidebarVisible || bookmarksSidebarVisible || searchSidebarVisible) {
                 if (centralWidget() && centralWidget()->layout()) {
                     centralWidget()->layout()->invalidate();
                     centralWidget()->layout()->activate();
@@ -3569,6 +3591,17 @@ void MainWindow::addNewTab() {
     connect(newCanvas, &InkCanvas::earlySaveRequested, this, &MainWindow::onEarlySaveRequested);
     connect(newCanvas, &InkCanvas::markdownNotesUpdated, this, &MainWindow::onMarkdownNotesUpdated);
     connect(newCanvas, &InkCanvas::highlightDoubleClicked, this, &MainWindow::onHighlightDoubleClicked);
+    connect(newCanvas->getPdfSearchIndex(), &PdfSearchIndex::progressChanged, this, [this, newCanvas]() {
+        if (searchSidebarVisible && newCanvas == currentCanvas()) {
+            updateSearchStatus();
+        }
+    });
+    connect(newCanvas->getPdfSearchIndex(), &PdfSearchIndex::indexingFinished, this, [this, newCanvas]() {
+        // Pages indexed after the query ran may hold more hits
+        if (searchSidebarVisible && newCanvas == currentCanvas() && !searchInput->text().isEmpty()) {
+            runPdfSearch();
+        }
+    });
     
     // Install event filter to detect mouse movement for scrollbar visibility
     newCanvas->setMouseTracking(true);
@@ -4060,6 +4093,9 @@ void MainWindow::positionDialContainer() {
     if (bookmarksSidebar && bookmarksSidebar->isVisible()) {
         leftSidebarWidth += bookmarksSidebar->width();
     }
+    if (searchSidebar && searchSidebar->isVisible()) {
+        leftSidebarWidth += searchSidebar->width();
+    }
 
     // Calculate ideal position (top-right corner with margins, accounting for sidebars)
     int idealX = windowWidth - dialWidth - rightMargin - rightSidebarWidth;
@@ -5223,6 +5259,30 @@ void MainWindow::updateTheme() {
                 background: transparent;
             }
         )").arg(bgColor).arg(textColor).arg(hoverColor).arg(selectedColor));
+        
+        // Search sidebar uses the same look
+        if (searchSidebar && searchResultsList) {
+            searchSidebar->setStyleSheet(outlineSidebar->styleSheet());
+            searchResultsList->setStyleSheet(QString(R"(
+                QListWidget {
+                    background-color: %1;
+                    border: none;
+                    color: %2;
+                    outline: none;
+                }
+                QListWidget::item {
+                    padding: 4px;
+                    border: none;
+                }
+                QListWidget::item:hover {
+                    background-color: %3;
+                }
+                QListWidget::item:selected {
+                    background-color: %4;
+                    color: %2;
+                }
+            )").arg(bgColor).arg(textColor).arg(hoverColor).arg(selectedColor));
+        }
     }
     
     // Update horizontal tab bar container and tab list styling - entire container uses accent color
@@ -5961,6 +6021,9 @@ void MainWindow::handleControllerButton(const QString &buttonName) {  // This is
         case ControllerAction::NextPage:
             goToNextPage();
             break;
+        case ControllerAction::ToggleSearch:
+            toggleSearchSidebar();
+            break;
         default:
             break;
     }
@@ -7099,6 +7162,9 @@ void MainWindow::handleKeyboardShortcut(const QString &keySequence) {
         case ControllerAction::NextPage:
             goToNextPage();
             break;
+        case ControllerAction::ToggleSearch:
+            toggleSearchSidebar();
+            break;
         default:
             break;
     }
@@ -7236,6 +7302,17 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
         return;
     }
     
+    // ✅ Ctrl+F opens PDF search unless the user mapped it to something else
+    if (fullSequence == "Ctrl+F") {
+        if (!searchSidebarVisible) {
+            toggleSearchSidebar();
+        }
+        searchInput->setFocus();
+        searchInput->selectAll();
+        event->accept();
+        return;
+    }
+    
     // If not handled, pass to parent
     QMainWindow::keyPressEvent(event);
 }
@@ -7296,6 +7373,11 @@ void MainWindow::toggleOutlineSidebar() {
         }
     }
     
+    // Hide search sidebar too (one left sidebar at a time)
+    if (outlineSidebarVisible && searchSidebarVisible) {
+        toggleSearchSidebar();
+    }
+    
     outlineSidebar->setVisible(outlineSidebarVisible);
     
     // Update button toggle state
@@ -7575,6 +7657,11 @@ void MainWindow::toggleBookmarksSidebar() {
         }
     }
     
+    // Hide search sidebar too (one left sidebar at a time)
+    if (!isVisible && searchSidebarVisible) {
+        toggleSearchSidebar();
+    }
+    
     bookmarksSidebar->setVisible(!isVisible);
     bookmarksSidebarVisible = !isVisible;
     
@@ -7591,6 +7678,99 @@ void MainWindow::toggleBookmarksSidebar() {
     }
 }
 
+// PDF text search functionality
+void MainWindow::toggleSearchSidebar() {
+    if (!searchSidebar) return;
+    
+    searchSidebarVisible = !searchSidebarVisible;
+    
+    // Only one left sidebar at a time
+    if (searchSidebarVisible) {
+        if (outlineSidebarVisible) {
+            toggleOutlineSidebar();
+        }
+        if (bookmarksSidebarVisible) {
+            toggleBookmarksSidebar();
+        }
+    }
+    
+    searchSidebar->setVisible(searchSidebarVisible);
+    
+    if (searchSidebarVisible) {
+        runPdfSearch(); // The tab may have changed while the sidebar was hidden
+        searchInput->setFocus();
+        searchInput->selectAll();
+    } else if (InkCanvas *canvas = currentCanvas()) {
+        canvas->clearSearchHighlights();
+    }
+}
+
+void MainWindow::runPdfSearch() {
+    if (!searchResultsList) return;
+    
+    searchResultsList->clear();
+    searchResults.clear();
+    
+    InkCanvas *canvas = currentCanvas();
+    if (!canvas) return;
+    
+    const QString query = searchInput->text();
+    if (!query.trimmed().isEmpty() && canvas->isPdfLoadedFunc()) {
+        searchResults = canvas->getPdfSearchIndex()->search(query);
+    }
+    
+    // Highlight every hit, so pages reached by scrolling show theirs too
+    QHash<int, QList<QRectF>> hitRects;
+    for (const PdfSearchPageHits &pageHits : std::as_const(searchResults)) {
+        hitRects.insert(pageHits.pageNumber, pageHits.rects);
+        
+        QListWidgetItem *item = new QListWidgetItem(
+            pageHits.matchCount == 1 ? tr("Page %1").arg(pageHits.pageNumber + 1)
+                                     : tr("Page %1 (%2 matches)").arg(pageHits.pageNumber + 1).arg(pageHits.matchCount),
+            searchResultsList);
+        item->setData(Qt::UserRole, pageHits.pageNumber + 1); // 1-based like the outline and bookmarks
+    }
+    
+    if (hitRects.isEmpty()) {
+        canvas->clearSearchHighlights();
+    } else {
+        canvas->setSearchHighlights(hitRects);
+    }
+    updateSearchStatus();
+}
+
+void MainWindow::updateSearchStatus() {
+    if (!searchStatusLabel) return;
+    
+    InkCanvas *canvas = currentCanvas();
+    if (!canvas || !canvas->isPdfLoadedFunc()) {
+        searchStatusLabel->setText(tr("No PDF loaded"));
+        return;
+    }
+    
+    const PdfSearchIndex *index = canvas->getPdfSearchIndex();
+    QString status;
+    if (!searchInput->text().trimmed().isEmpty()) {
+        status = searchResults.isEmpty() ? tr("No matches") : tr("%n page(s) with matches", "", searchResults.size());
+    }
+    if (!index->isComplete()) {
+        const QString progress = tr("Indexing %1/%2 pages...").arg(index->indexedPages()).arg(index->pageCount());
+        status = status.isEmpty() ? progress : status + " - " + progress;
+    }
+    searchStatusLabel->setText(status);
+}
+
+void MainWindow::onSearchResultClicked(QListWidgetItem *item) {
+    if (!item) return;
+    
+    bool ok;
+    int pageNumber = item->data(Qt::UserRole).toInt(&ok);
+    if (ok && pageNumber > 0) {
+        switchPageWithDirection(pageNumber, (pageNumber > getCurrentPageForCanvas(currentCanvas()) + 1) ? 1 : -1);
+        pageInput->setValue(pageNumber);
+    }
+}
+
 void MainWindow::onBookmarkItemClicked(QTreeWidgetItem *item, int column) {
     Q_UNUSED(column);
     if (!item) return;
@@ -12,6 +12,7 @@
 #include <QSlider>
 #include <QScrollBar>
 #include <QComboBox>
+#include <QProgressBar>
 #include <QSpinBox>
 #include <QRadioButton>
 #include <QDialog>
@@ -36,6 +37,7 @@
 #include "ControlPanelDialog.h"
 #include "PictureWindowManager.h"
 #include "SpnPackageManager.h"
+#include "PdfExportRenderer.h"
 #include <QLocalServer>
 #include <QLocalSocket>
 #include <QSharedMemory>
@@ -91,7 +93,8 @@ enum class ControllerAction {
     AddBookmark,
     ToggleTouchGestures,
     PreviousPage,
-    NextPage
+    NextPage,
+    ToggleSearch
 };
 
 static QString actionToString(ControllerAction action) {
@@ -126,6 +129,7 @@ static QString actionToString(ControllerAction action) {
         case ControllerAction::ToggleTouchGestures: return "Toggle Touch Gestures";
         case ControllerAction::PreviousPage: return "Previous Page";
         case ControllerAction::NextPage: return "Next Page";
+        case ControllerAction::ToggleSearch: return "Search PDF Text";
         default: return "None";
     }
 }
@@ -166,6 +170,7 @@ static ControllerAction stringToAction(const QString &str) {
         case InternalControllerAction::ToggleTouchGestures: return ControllerAction::ToggleTouchGestures;
         case InternalControllerAction::PreviousPage: return ControllerAction::PreviousPage;
         case InternalControllerAction::NextPage: return ControllerAction::NextPage;
+        case InternalControllerAction::ToggleSearch: return ControllerAction::ToggleSearch;
     }
     return ControllerAction::None;
 }
@@ -330,6 +335,11 @@ private slots:
     void exportCanvasOnlyNotebook(const QString &saveFolder, const QString &notebookId); // Export canvas-only notebook (no PDF)
     void exportAnnotatedPdfFullRender(const QString &exportPath, const QSet<int> &annotatedPages, bool exportWholeDocument = true, int exportStartPage = 0, int exportEndPage = -1); // Full render fallback
     bool createAnnotatedPagesPdf(const QString &outputPath, const QList<int> &pages, QProgressDialog &progress); // Create temp PDF
+    bool runPdfExport(const PdfExportRenderer::Job &job, const QString &outputPath, QProgressDialog &progress, QString *errorMsg = nullptr); // Background export with live progress
+    void queueBackgroundExport(const PdfExportRenderer::Job &job, const QString &exportPath, bool wholeDocument = false); // Export without blocking the window
+    void updateExportJobStatus();
+    void onExportJobFinished(const QString &id, const QString &outputPath, bool success, const QString &errorMsg);
+    bool runExportTask(const std::function<bool(PdfExportRenderer::Progress *, QString *)> &task, int pageCount, QProgressDialog &progress, QString *errorMsg = nullptr); // Runs task on a worker thread
     bool mergePdfWithPdftk(const QString &originalPdf, const QString &annotatedPagesPdf, const QString &outputPdf, const QList<int> &annotatedPageNumbers, QString *errorMsg = nullptr, bool exportWholeDocument = true, int exportStartPage = 0, int exportEndPage = -1); // Merge using pdftk
     
     // PDF outline preservation helpers
@@ -339,6 +349,7 @@ private slots:
     
     // Helper function to show page range dialog (returns false if cancelled)
     bool showPageRangeDialog(int totalPages, bool &exportWholeDocument, int &startPage, int &endPage);
+    PdfExportProfile exportProfile() const; // Image encoding chosen in that dialog
 
     void updateZoom();
     void onZoomSliderChanged(int value); // Handle manual zoom slider changes
@@ -447,6 +458,12 @@ private:
     void saveBookmarks();            // Save bookmarks to file
     void toggleCurrentPageBookmark(); // Add/remove current page from bookmarks
     
+    // PDF text search sidebar functionality
+    void toggleSearchSidebar();      // Toggle PDF search sidebar
+    void runPdfSearch();             // Search the current canvas's PDF index and list the hits
+    void onSearchResultClicked(QListWidgetItem *item); // Jump to the page of a search hit
+    void updateSearchStatus();       // Show the index progress / hit count
+    
     // Markdown notes sidebar functionality
     void toggleMarkdownNotesSidebar();  // Toggle markdown notes sidebar
     void onMarkdownNotesUpdated();      // Handle markdown notes updates
@@ -460,6 +477,9 @@ private:
     InkCanvas *canvas;
     QPushButton *benchmarkButton;
     QLabel *benchmarkLabel;
+    QProgressBar *exportJobProgress;      // Running background export
+    QPushButton *exportJobCancelButton;
+    QSet<QString> ownExportJobs;          // Background exports queued from this window
     QTimer *benchmarkTimer;
     bool benchmarking;
 
@@ -534,6 +554,14 @@ private:
     QMap<int, QString> bookmarks;  // Map of page number to bookmark title
     QPushButton *jumpToPageButton; // Button to jump to a specific page
     
+    // PDF Search Sidebar
+    QWidget *searchSidebar;        // Container for PDF text search
+    QLineEdit *searchInput;        // Query field
+    QLabel *searchStatusLabel;     // Indexing progress / number of hits
+    QListWidget *searchResultsList; // One item per page with hits
+    bool searchSidebarVisible = false;
+    QList<PdfSearchPageHits> searchResults; // Hits of the last query
+    
     // Markdown Notes Sidebar
     MarkdownNotesSidebar *markdownNotesSidebar;  // Sidebar for markdown notes
     QPushButton *toggleMarkdownNotesButton; // Button to toggle markdown notes sidebar
@@ -0,0 +1,400 @@
+#include "NotebookAnnotationStore.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QDataStream>
+#include <QDebug>
+#include <algorithm>
+
+const QString NotebookAnnotationStore::SHARD_DIR_NAME = ".speedynote_annotations";
+
+QList<QRectF> TextHighlight::mergeRows(QList<QRectF> rects, qreal rowTolerance)
+{
+    // After sorting by vertical center every line is a contiguous run
+    std::sort(rects.begin(), rects.end(), [](const QRectF &a, const QRectF &b) {
+        return a.center().y() < b.center().y();
+    });
+
+    QList<QRectF> rows;
+    qreal rowCenterY = 0;
+    for (const QRectF &rect : std::as_const(rects)) {
+        if (!rows.isEmpty() && qAbs(rect.center().y() - rowCenterY) <= rowTolerance) {
+            rows.last() = rows.last().united(rect);
+        } else {
+            rows.append(rect);
+            rowCenterY = rect.center().y();
+        }
+    }
+    return rows;
+}
+
+QByteArray TextHighlight::packRects(const QList<QRectF> &rects)
+{
+    QByteArray data;
+    data.reserve(rects.size() * 4 * int(sizeof(float)));
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    for (const QRectF &rect : rects) {
+        stream << rect.x() << rect.y() << rect.width() << rect.height();
+    }
+    return data;
+}
+
+QList<QRectF> TextHighlight::unpackRects(const QByteArray &data)
+{
+    QList<QRectF> rects;
+    const int count = data.size() / (4 * int(sizeof(float)));
+    rects.reserve(count);
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    for (int i = 0; i < count; ++i) {
+        qreal x, y, width, height;
+        stream >> x >> y >> width >> height;
+        rects.append(QRectF(x, y, width, height));
+    }
+    return rects;
+}
+
+QString NotebookAnnotationStore::shardPath(int pageNumber) const
+{
+    return shardDir + QString("/%1.json").arg(pageNumber, 5, 10, QChar('0'));
+}
+
+void NotebookAnnotationStore::open(const QString &saveFolder)
+{
+    // Never drop edits that belong to the previous folder
+    if (hasUnsavedChanges()) {
+        flush();
+    }
+
+    loadedPages.clear();
+    pagesOnDisk.clear();
+    dirtyPages.clear();
+    highlightPageById.clear();
+    notePageById.clear();
+    allPagesLoaded = false;
+    pageRevisions.clear();
+    ++storeRevision;
+    shardDir = saveFolder.isEmpty() ? QString() : saveFolder + "/" + SHARD_DIR_NAME;
+
+    if (shardDir.isEmpty()) {
+        return;
+    }
+
+    // ✅ Only list file names here - shards are parsed when their page is needed
+    const QStringList shardFiles = QDir(shardDir).entryList(QStringList() << "*.json", QDir::Files | QDir::Hidden);
+    for (const QString &fileName : shardFiles) {
+        bool ok = false;
+        int pageNumber = fileName.chopped(5).toInt(&ok);
+        if (ok) {
+            pagesOnDisk.insert(pageNumber);
+        }
+    }
+}
+
+NotebookAnnotationStore::PageShard &NotebookAnnotationStore::shard(int pageNumber) const
+{
+    auto it = loadedPages.find(pageNumber);
+    if (it != loadedPages.end()) {
+        return it->second;
+    }
+
+    PageShard &pageShard = loadedPages[pageNumber];
+    if (!pagesOnDisk.contains(pageNumber)) {
+        return pageShard;
+    }
+
+    QFile file(shardPath(pageNumber));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open annotation shard:" << file.fileName();
+        pageShard.unreadable = true;
+        return pageShard;
+    }
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    file.close();
+
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "Failed to parse annotation shard" << file.fileName() << ":" << error.errorString();
+
+        // ✅ Keep the damaged file for recovery; the page starts empty and its next save can't destroy it
+        QString corruptPath = file.fileName() + ".corrupt";
+        for (int suffix = 2; QFile::exists(corruptPath); ++suffix) {
+            corruptPath = file.fileName() + QString(".corrupt%1").arg(suffix);
+        }
+        if (QFile::rename(file.fileName(), corruptPath)) {
+            qWarning() << "Moved corrupt annotation shard to" << corruptPath;
+        } else {
+            pageShard.unreadable = true;
+        }
+        return pageShard;
+    }
+
+    QJsonObject obj = doc.object();
+    const QJsonArray highlightsArray = obj["text_highlights"].toArray();
+    for (const QJsonValue &value : highlightsArray) {
+        if (value.isObject()) {
+            pageShard.highlights.append(TextHighlight::fromJson(value.toObject()));
+            highlightPageById.insert(pageShard.highlights.last().id, pageNumber);
+        }
+    }
+    const QJsonArray notesArray = obj["markdown_notes"].toArray();
+    for (const QJsonValue &value : notesArray) {
+        if (value.isObject()) {
+            pageShard.notes.append(MarkdownNoteData::fromJson(value.toObject()));
+            notePageById.insert(pageShard.notes.last().id, pageNumber);
+        }
+    }
+    return pageShard;
+}
+
+void NotebookAnnotationStore::importLegacy(const QJsonArray &highlights, const QJsonArray &notes)
+{
+    // Legacy entries may already have been migrated by an earlier open
+    loadAllPages();
+
+    for (const QJsonValue &value : highlights) {
+        if (!value.isObject()) continue;
+        TextHighlight highlight = TextHighlight::fromJson(value.toObject());
+        if (!highlightPageById.contains(highlight.id)) {
+            addHighlight(highlight);
+        }
+    }
+
+    for (const QJsonValue &value : notes) {
+        if (!value.isObject()) continue;
+        MarkdownNoteData note = MarkdownNoteData::fromJson(value.toObject());
+        if (!notePageById.contains(note.id)) {
+            addNote(note);
+        }
+    }
+}
+
+QList<TextHighlight> NotebookAnnotationStore::highlights(int pageNumber) const
+{
+    if (!pagesOnDisk.contains(pageNumber) && loadedPages.find(pageNumber) == loadedPages.end()) {
+        return QList<TextHighlight>(); // Nothing stored for this page, don't create an entry
+    }
+    return shard(pageNumber).highlights;
+}
+
+QList<MarkdownNoteData> NotebookAnnotationStore::notes(int pageNumber) const
+{
+    if (!pagesOnDisk.contains(pageNumber) && loadedPages.find(pageNumber) == loadedPages.end()) {
+        return QList<MarkdownNoteData>();
+    }
+    return shard(pageNumber).notes;
+}
+
+void NotebookAnnotationStore::touchPage(int pageNumber)
+{
+    dirtyPages.insert(pageNumber);
+    pageRevisions.insert(pageNumber, ++storeRevision);
+}
+
+QSet<int> NotebookAnnotationStore::pagesChangedSince(quint64 revision) const
+{
+    QSet<int> pages;
+    for (auto it = pageRevisions.constBegin(); it != pageRevisions.constEnd(); ++it) {
+        if (it.value() > revision) {
+            pages.insert(it.key());
+        }
+    }
+    return pages;
+}
+
+void NotebookAnnotationStore::addHighlight(const TextHighlight &highlight)
+{
+    shard(highlight.pageNumber).highlights.append(highlight);
+    highlightPageById.insert(highlight.id, highlight.pageNumber);
+    touchPage(highlight.pageNumber);
+}
+
+bool NotebookAnnotationStore::removeHighlight(const QString &highlightId)
+{
+    if (!findHighlight(highlightId)) {
+        return false;
+    }
+
+    int pageNumber = highlightPageById.take(highlightId);
+    QList<TextHighlight> &pageHighlights = shard(pageNumber).highlights;
+    for (int i = 0; i < pageHighlights.size(); ++i) {
+        if (pageHighlights[i].id == highlightId) {
+            pageHighlights.removeAt(i);
+            break;
+        }
+    }
+    touchPage(pageNumber);
+    return true;
+}
+
+void NotebookAnnotationStore::addNote(const MarkdownNoteData &note)
+{
+    shard(note.pageNumber).notes.append(note);
+    notePageById.insert(note.id, note.pageNumber);
+    touchPage(note.pageNumber);
+}
+
+bool NotebookAnnotationStore::updateNote(const MarkdownNoteData &note)
+{
+    MarkdownNoteData *existing = findNote(note.id);
+    if (!existing) {
+        return false;
+    }
+
+    if (existing->pageNumber != note.pageNumber) {
+        // Moved to another page: the note changes shards
+        removeNote(note.id);
+        addNote(note);
+    } else {
+        *existing = note;
+        touchPage(note.pageNumber);
+    }
+    return true;
+}
+
+bool NotebookAnnotationStore::removeNote(const QString &noteId)
+{
+    if (!findNote(noteId)) {
+        return false;
+    }
+
+    int pageNumber = notePageById.take(noteId);
+    QList<MarkdownNoteData> &pageNotes = shard(pageNumber).notes;
+    for (int i = 0; i < pageNotes.size(); ++i) {
+        if (pageNotes[i].id == noteId) {
+            pageNotes.removeAt(i);
+            break;
+        }
+    }
+    touchPage(pageNumber);
+    return true;
+}
+
+TextHighlight *NotebookAnnotationStore::findHighlight(const QString &highlightId)
+{
+    auto it = highlightPageById.constFind(highlightId);
+    if (it == highlightPageById.constEnd()) {
+        // Not in any loaded page - the id can only be in a shard we haven't parsed yet
+        loadAllPages();
+        it = highlightPageById.constFind(highlightId);
+        if (it == highlightPageById.constEnd()) {
+            return nullptr;
+        }
+    }
+
+    for (TextHighlight &highlight : shard(it.value()).highlights) {
+        if (highlight.id == highlightId) {
+            return &highlight;
+        }
+    }
+    return nullptr;
+}
+
+MarkdownNoteData *NotebookAnnotationStore::findNote(const QString &noteId)
+{
+    auto it = notePageById.constFind(noteId);
+    if (it == notePageById.constEnd()) {
+        loadAllPages();
+        it = notePageById.constFind(noteId);
+        if (it == notePageById.constEnd()) {
+            return nullptr;
+        }
+    }
+
+    for (MarkdownNoteData &note : shard(it.value()).notes) {
+        if (note.id == noteId) {
+            return &note;
+        }
+    }
+    return nullptr;
+}
+
+QList<int> NotebookAnnotationStore::annotatedPages() const
+{
+    QSet<int> pages = pagesOnDisk;
+    for (const auto &entry : loadedPages) {
+        if (!entry.second.highlights.isEmpty() || !entry.second.notes.isEmpty()) {
+            pages.insert(entry.first);
+        }
+    }
+    QList<int> sorted = pages.values();
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+void NotebookAnnotationStore::loadAllPages() const
+{
+    if (allPagesLoaded) {
+        return;
+    }
+
+    for (int pageNumber : pagesOnDisk) {
+        shard(pageNumber);
+    }
+    // New shards only ever come from pages that are already loaded, so this stays true
+    allPagesLoaded = true;
+}
+
+bool NotebookAnnotationStore::flush()
+{
+    if (dirtyPages.isEmpty() || shardDir.isEmpty()) {
+        return true;
+    }
+
+    QDir().mkpath(shardDir);
+
+    QSet<int> failedPages;
+    for (int pageNumber : std::as_const(dirtyPages)) {
+        auto it = loadedPages.find(pageNumber);
+        if (it == loadedPages.end()) continue;
+        const PageShard &pageShard = it->second;
+
+        if (pageShard.unreadable) {
+            qWarning() << "Not overwriting unreadable annotation shard for page" << pageNumber;
+            failedPages.insert(pageNumber);
+            continue;
+        }
+
+        if (pageShard.highlights.isEmpty() && pageShard.notes.isEmpty()) {
+            // Nothing left on this page - drop its shard instead of writing an empty one
+            QFile::remove(shardPath(pageNumber));
+            pagesOnDisk.remove(pageNumber);
+            continue;
+        }
+
+        QJsonArray highlightsArray;
+        for (const TextHighlight &highlight : pageShard.highlights) {
+            highlightsArray.append(highlight.toJson());
+        }
+        QJsonArray notesArray;
+        for (const MarkdownNoteData &note : pageShard.notes) {
+            notesArray.append(note.toJson());
+        }
+
+        QJsonObject obj;
+        obj["page"] = pageNumber;
+        obj["text_highlights"] = highlightsArray;
+        obj["markdown_notes"] = notesArray;
+
+        // ✅ QSaveFile: a crash mid-write keeps the previous shard intact
+        QSaveFile file(shardPath(pageNumber));
+        if (!file.open(QIODevice::WriteOnly) ||
+            file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact)) < 0 ||
+            !file.commit()) {
+            qWarning() << "Failed to write annotation shard for page" << pageNumber;
+            failedPages.insert(pageNumber);
+            continue;
+        }
+        pagesOnDisk.insert(pageNumber);
+    }
+
+    // Failed pages stay dirty so the next flush retries them
+    dirtyPages = failedPages;
+    return failedPages.isEmpty();
+}
@@ -0,0 +1,184 @@
+#ifndef NOTEBOOKANNOTATIONSTORE_H
+#define NOTEBOOKANNOTATIONSTORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+#include <QHash>
+#include <QRectF>
+#include <QColor>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <unordered_map>
+#include "MarkdownNoteEntry.h"
+
+// Structure to store a persistent text highlight
+struct TextHighlight {
+    QString id;              // Unique ID for this highlight (for linking to markdown windows)
+    int pageNumber;          // Page number (0-based)
+    QRectF boundingBox;      // Combined bounding box in PDF coordinates (for quick intersection checks)
+    QList<QRectF> textBoxRects; // Individual text box rectangles for precise rendering
+    QList<QRectF> rowRects;  // Text boxes merged into one rectangle per line (what gets drawn)
+    QString text;            // The highlighted text content
+    QColor color;            // Highlight color
+    QString markdownWindowId; // ID of associated markdown window (empty if none) - for Step 3
+    
+    // Serialization helpers
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["id"] = id;
+        obj["pageNumber"] = pageNumber;
+        obj["boundingBox"] = QString("%1,%2,%3,%4")
+            .arg(boundingBox.x()).arg(boundingBox.y())
+            .arg(boundingBox.width()).arg(boundingBox.height());
+        
+        // Serialize individual text box rectangles
+        QJsonArray rectsArray;
+        for (const QRectF &rect : textBoxRects) {
+            rectsArray.append(QString("%1,%2,%3,%4")
+                .arg(rect.x()).arg(rect.y())
+                .arg(rect.width()).arg(rect.height()));
+        }
+        obj["textBoxRects"] = rectsArray;
+        obj["rowRects"] = QString::fromLatin1(packRects(rowRects).toBase64());
+        
+        obj["text"] = text;
+        obj["color"] = color.name(QColor::HexArgb);
+        obj["markdownWindowId"] = markdownWindowId;
+        return obj;
+    }
+    
+    static TextHighlight fromJson(const QJsonObject &obj) {
+        TextHighlight highlight;
+        highlight.id = obj["id"].toString();
+        highlight.pageNumber = obj["pageNumber"].toInt();
+        
+        // Parse combined bounding box
+        QString bbox = obj["boundingBox"].toString();
+        QStringList parts = bbox.split(',');
+        if (parts.size() == 4) {
+            highlight.boundingBox = QRectF(
+                parts[0].toDouble(), parts[1].toDouble(),
+                parts[2].toDouble(), parts[3].toDouble()
+            );
+        }
+        
+        // Parse individual text box rectangles
+        QJsonArray rectsArray = obj["textBoxRects"].toArray();
+        for (const QJsonValue &value : rectsArray) {
+            QString rectStr = value.toString();
+            QStringList rectParts = rectStr.split(',');
+            if (rectParts.size() == 4) {
+                highlight.textBoxRects.append(QRectF(
+                    rectParts[0].toDouble(), rectParts[1].toDouble(),
+                    rectParts[2].toDouble(), rectParts[3].toDouble()
+                ));
+            }
+        }
+        
+        // Merged rows are stored once computed; highlights saved before that get them here
+        if (obj.contains("rowRects")) {
+            highlight.rowRects = unpackRects(QByteArray::fromBase64(obj["rowRects"].toString().toLatin1()));
+        } else if (!highlight.textBoxRects.isEmpty()) {
+            highlight.rowRects = mergeRows(highlight.textBoxRects);
+        } else if (!highlight.boundingBox.isNull()) {
+            highlight.rowRects.append(highlight.boundingBox); // Legacy format: combined bounding box only
+        }
+        
+        highlight.text = obj["text"].toString();
+        highlight.color = QColor(obj["color"].toString());
+        highlight.markdownWindowId = obj["markdownWindowId"].toString();
+        return highlight;
+    }
+    
+    // Merge text boxes whose vertical centers lie within rowTolerance into one
+    // rectangle per line. Sort-based, so O(n log n) in the number of boxes.
+    static QList<QRectF> mergeRows(QList<QRectF> rects, qreal rowTolerance = 5.0);
+    
+    // Rectangles as little-endian float32 x, y, width, height (16 bytes each)
+    static QByteArray packRects(const QList<QRectF> &rects);
+    static QList<QRectF> unpackRects(const QByteArray &data);
+};
+
+// Highlights and markdown notes of a notebook, sharded by page.
+// Each page's annotations live in their own small JSON file under
+// .speedynote_annotations/ in the save folder. Shards are parsed the first
+// time a page is asked for, and only pages that changed are rewritten, so
+// editing one highlight costs one page's worth of I/O instead of the whole
+// notebook's.
+class NotebookAnnotationStore
+{
+public:
+    // Switch to a save folder: flushes pending changes, forgets loaded pages and
+    // lists the shards on disk (nothing is parsed yet)
+    void open(const QString &saveFolder);
+
+    // Move highlights/notes from a pre-sharding metadata file into page shards.
+    // Entries whose id is already known are skipped.
+    void importLegacy(const QJsonArray &highlights, const QJsonArray &notes);
+
+    // Read access (loads the page's shard on first use)
+    QList<TextHighlight> highlights(int pageNumber) const;
+    QList<MarkdownNoteData> notes(int pageNumber) const;
+
+    // Mutations keep the id indexes in sync and mark the affected pages dirty
+    void addHighlight(const TextHighlight &highlight);
+    bool removeHighlight(const QString &highlightId);
+    void addNote(const MarkdownNoteData &note);
+    bool updateNote(const MarkdownNoteData &note); // Moves the note if its page changed
+    bool removeNote(const QString &noteId);
+
+    // Lookups by id: a hash lookup for the page, then a scan of that page only.
+    // Unknown ids parse the remaining shards once. Callers that modify the
+    // result in place must call markPageDirty() for its page (ids and page
+    // numbers must not be changed this way - use the mutators above).
+    TextHighlight *findHighlight(const QString &highlightId);
+    MarkdownNoteData *findNote(const QString &noteId);
+    void markPageDirty(int pageNumber) { touchPage(pageNumber); }
+
+    // Bumped on every change (and on open). Caches derived from the annotations
+    // remember the revision they were built from instead of tracking dirty flags.
+    quint64 revision() const { return storeRevision; }
+    // Pages changed after the given revision (only changes since the last open() are known)
+    QSet<int> pagesChangedSince(quint64 revision) const;
+
+    // Pages that have (or may have) annotations, sorted
+    QList<int> annotatedPages() const;
+
+    // Parse every shard that isn't loaded yet
+    void loadAllPages() const;
+
+    bool hasUnsavedChanges() const { return !dirtyPages.isEmpty(); }
+
+    // Write the shards of changed pages. Pages left empty lose their shard file.
+    bool flush();
+
+    static const QString SHARD_DIR_NAME;
+
+private:
+    struct PageShard {
+        QList<TextHighlight> highlights;
+        QList<MarkdownNoteData> notes;
+        bool unreadable = false; // Shard file exists but couldn't be read: never overwritten
+    };
+
+    PageShard &shard(int pageNumber) const;
+    void touchPage(int pageNumber); // Mark dirty and record the revision it changed at
+    QString shardPath(int pageNumber) const;
+
+    QString shardDir;
+    // Node-based so pointers handed out by the find functions survive rehashing
+    mutable std::unordered_map<int, PageShard> loadedPages;
+    mutable bool allPagesLoaded = false;
+    QSet<int> pagesOnDisk;
+    QSet<int> dirtyPages;
+    quint64 storeRevision = 1;
+    QHash<int, quint64> pageRevisions; // Page -> revision of its last change
+
+    // Id -> page for everything in loadedPages
+    mutable QHash<QString, int> highlightPageById;
+    mutable QHash<QString, int> notePageById;
+};
+
+#endif // NOTEBOOKANNOTATIONSTORE_H
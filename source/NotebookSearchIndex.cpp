@@ -0,0 +1,470 @@
+#include "NotebookSearchIndex.h"
+#include "NotebookAnnotationStore.h"
+#include "PdfSearchIndex.h"
+#include "SpnPackageManager.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QSet>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+const QString METADATA_FILE_NAME = ".speedynote_metadata.json";
+
+QString kindToString(NotebookSearchItem::Kind kind)
+{
+    switch (kind) {
+        case NotebookSearchItem::Highlight: return "highlight";
+        case NotebookSearchItem::Bookmark: return "bookmark";
+        case NotebookSearchItem::Note: break;
+    }
+    return "note";
+}
+}
+
+QMutex NotebookSearchIndex::indexMutex;
+bool NotebookSearchIndex::loaded = false;
+QVector<NotebookSearchIndex::NotebookRecord> NotebookSearchIndex::records;
+QHash<QString, int> NotebookSearchIndex::slotByPath;
+QHash<QString, QVector<NotebookSearchIndex::ItemRef>> NotebookSearchIndex::postings;
+QStringList NotebookSearchIndex::sortedTokens;
+bool NotebookSearchIndex::sortedTokensValid = false;
+
+QJsonObject NotebookSearchItem::toJson() const
+{
+    QJsonObject obj;
+    obj["kind"] = kindToString(kind);
+    obj["page"] = pageNumber;
+    if (!title.isEmpty()) obj["title"] = title;
+    obj["text"] = text;
+    return obj;
+}
+
+NotebookSearchItem NotebookSearchItem::fromJson(const QJsonObject &obj)
+{
+    NotebookSearchItem item;
+    const QString kind = obj["kind"].toString();
+    item.kind = kind == "highlight" ? Highlight : (kind == "bookmark" ? Bookmark : Note);
+    item.pageNumber = obj["page"].toInt();
+    item.title = obj["title"].toString();
+    item.text = obj["text"].toString();
+    return item;
+}
+
+QString NotebookSearchIndex::indexDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/notebook_search";
+}
+
+QString NotebookSearchIndex::recordFilePath(const QString &notebookPath)
+{
+    return indexDir() + "/" + QCryptographicHash::hash(notebookPath.toUtf8(), QCryptographicHash::Md5).toHex() + ".json";
+}
+
+QString NotebookSearchIndex::notebookDisplayName(const QString &notebookPath)
+{
+    QFileInfo info(notebookPath);
+    return notebookPath.endsWith(".spn", Qt::CaseInsensitive) ? info.completeBaseName() : info.fileName();
+}
+
+QStringList NotebookSearchIndex::itemTokens(const NotebookSearchItem &item)
+{
+    return PdfSearchIndex::tokenize(item.title) + PdfSearchIndex::tokenize(item.text);
+}
+
+void NotebookSearchIndex::ensureLoaded()
+{
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+
+    const QStringList recordFiles = QDir(indexDir()).entryList(QStringList() << "*.json", QDir::Files);
+    for (const QString &fileName : recordFiles) {
+        QFile file(indexDir() + "/" + fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+        file.close();
+        if (error.error != QJsonParseError::NoError) {
+            qWarning() << "Ignoring unreadable search index file" << fileName << ":" << error.errorString();
+            continue;
+        }
+
+        QJsonObject obj = doc.object();
+        NotebookRecord record;
+        record.path = obj["path"].toString();
+        record.name = obj["name"].toString();
+        record.indexedAt = obj["indexed_at"].toInteger();
+        const QJsonArray itemsArray = obj["items"].toArray();
+        for (const QJsonValue &value : itemsArray) {
+            record.items.append(NotebookSearchItem::fromJson(value.toObject()));
+        }
+        if (!record.path.isEmpty()) {
+            insertRecord(record);
+        }
+    }
+}
+
+void NotebookSearchIndex::insertRecord(NotebookRecord record)
+{
+    auto existing = slotByPath.constFind(record.path);
+    if (existing != slotByPath.constEnd()) {
+        eraseRecord(existing.value());
+    }
+
+    // Reuse a free slot so ids stay small
+    int slot = -1;
+    for (int i = 0; i < records.size(); ++i) {
+        if (records[i].path.isEmpty()) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        slot = records.size();
+        records.append(NotebookRecord());
+    }
+
+    QSet<QString> distinct;
+    for (int item = 0; item < record.items.size(); ++item) {
+        QSet<QString> itemDistinct;
+        for (const QString &token : itemTokens(record.items[item])) {
+            if (!itemDistinct.contains(token)) {
+                itemDistinct.insert(token);
+                postings[token].append(ItemRef{slot, item});
+            }
+        }
+        distinct.unite(itemDistinct);
+    }
+    record.tokens = QStringList(distinct.begin(), distinct.end());
+    sortedTokensValid = false;
+
+    slotByPath.insert(record.path, slot);
+    records[slot] = std::move(record);
+}
+
+void NotebookSearchIndex::eraseRecord(int slot)
+{
+    NotebookRecord &record = records[slot];
+    for (const QString &token : std::as_const(record.tokens)) {
+        auto it = postings.find(token);
+        if (it == postings.end()) continue;
+        it->erase(std::remove_if(it->begin(), it->end(), [slot](const ItemRef &ref) { return ref.notebook == slot; }), it->end());
+        if (it->isEmpty()) {
+            postings.erase(it);
+        }
+    }
+    sortedTokensValid = false;
+
+    slotByPath.remove(record.path);
+    record = NotebookRecord(); // Empty path marks a free slot
+}
+
+void NotebookSearchIndex::writeRecord(const NotebookRecord &record)
+{
+    QJsonArray itemsArray;
+    for (const NotebookSearchItem &item : record.items) {
+        itemsArray.append(item.toJson());
+    }
+
+    QJsonObject root;
+    root["version"] = 1;
+    root["path"] = record.path;
+    root["name"] = record.name;
+    root["indexed_at"] = record.indexedAt;
+    root["items"] = itemsArray;
+
+    QDir().mkpath(indexDir());
+    // ✅ QSaveFile so a crash mid-write never leaves a truncated record behind
+    QSaveFile file(recordFilePath(record.path));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write search index for" << record.path;
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
+void NotebookSearchIndex::updateNotebook(const QString &notebookPath, const QList<NotebookSearchItem> &items)
+{
+    if (notebookPath.isEmpty()) return;
+
+    QMutexLocker locker(&indexMutex);
+    ensureLoaded();
+    storeNotebook(notebookPath, items);
+}
+
+void NotebookSearchIndex::storeNotebook(const QString &notebookPath, const QList<NotebookSearchItem> &items)
+{
+    NotebookRecord record;
+    record.path = notebookPath;
+    record.name = notebookDisplayName(notebookPath);
+    record.indexedAt = QDateTime::currentMSecsSinceEpoch();
+    record.items = items;
+
+    writeRecord(record);
+    insertRecord(record);
+}
+
+void NotebookSearchIndex::updateNotebookPages(const QString &notebookPath, const QString &workingFolder,
+                                              const QSet<int> &pages, const QList<NotebookSearchItem> &pageItems,
+                                              const QList<NotebookSearchItem> &bookmarkItems)
+{
+    if (notebookPath.isEmpty()) return;
+
+    // A notebook not indexed yet starts from its files, read without holding the lock
+    QList<NotebookSearchItem> fromFiles;
+    bool indexed = false;
+    {
+        QMutexLocker locker(&indexMutex);
+        ensureLoaded();
+        indexed = slotByPath.contains(notebookPath);
+    }
+    if (!indexed) {
+        fromFiles = itemsFromNotebookFiles(readNotebookFiles(workingFolder));
+    }
+
+    // ✅ Read, merge and write under one lock, so concurrent updates of a notebook can't drop each other's pages
+    QMutexLocker locker(&indexMutex);
+    auto it = slotByPath.constFind(notebookPath);
+    const QList<NotebookSearchItem> previous = it != slotByPath.constEnd() ? records[it.value()].items : fromFiles;
+
+    QList<NotebookSearchItem> items;
+    for (const NotebookSearchItem &item : previous) {
+        if (item.kind == NotebookSearchItem::Bookmark || pages.contains(item.pageNumber)) continue;
+        items.append(item);
+    }
+    items += pageItems;
+    items += bookmarkItems;
+    storeNotebook(notebookPath, items);
+}
+
+void NotebookSearchIndex::removeNotebook(const QString &notebookPath)
+{
+    QMutexLocker locker(&indexMutex);
+    ensureLoaded();
+    auto it = slotByPath.constFind(notebookPath);
+    if (it != slotByPath.constEnd()) {
+        eraseRecord(it.value());
+    }
+    QFile::remove(recordFilePath(notebookPath));
+}
+
+qint64 NotebookSearchIndex::sourceModified(const QString &notebookPath)
+{
+    QFileInfo info(notebookPath);
+    if (!info.exists()) {
+        return -1;
+    }
+    if (info.isFile()) {
+        return info.lastModified().toMSecsSinceEpoch(); // .spn package
+    }
+
+    // Folder notebooks: the newest of the metadata and the annotation shards
+    qint64 newest = QFileInfo(notebookPath + "/" + METADATA_FILE_NAME).lastModified().toMSecsSinceEpoch();
+    const QFileInfoList shards = QDir(notebookPath + "/" + NotebookAnnotationStore::SHARD_DIR_NAME)
+                                     .entryInfoList(QStringList() << "*.json", QDir::Files | QDir::Hidden);
+    for (const QFileInfo &shard : shards) {
+        newest = qMax(newest, shard.lastModified().toMSecsSinceEpoch());
+    }
+    return newest;
+}
+
+QHash<QString, QByteArray> NotebookSearchIndex::readNotebookFiles(const QString &notebookPath)
+{
+    const QString shardPrefix = NotebookAnnotationStore::SHARD_DIR_NAME + "/";
+    auto wanted = [&shardPrefix](const QString &relativePath) {
+        return relativePath == METADATA_FILE_NAME || relativePath.startsWith(shardPrefix);
+    };
+
+    if (SpnPackageManager::isSpnPackage(notebookPath)) {
+        return SpnPackageManager::readSpnFiles(notebookPath, wanted);
+    }
+
+    QHash<QString, QByteArray> files;
+    QStringList relativePaths;
+    relativePaths << METADATA_FILE_NAME;
+    const QStringList shardFiles = QDir(notebookPath + "/" + NotebookAnnotationStore::SHARD_DIR_NAME)
+                                       .entryList(QStringList() << "*.json", QDir::Files | QDir::Hidden);
+    for (const QString &shardFile : shardFiles) {
+        relativePaths << shardPrefix + shardFile;
+    }
+    for (const QString &relativePath : std::as_const(relativePaths)) {
+        QFile file(notebookPath + "/" + relativePath);
+        if (file.open(QIODevice::ReadOnly)) {
+            files.insert(relativePath, file.readAll());
+        }
+    }
+    return files;
+}
+
+QList<NotebookSearchItem> NotebookSearchIndex::itemsFromNotebookFiles(const QHash<QString, QByteArray> &files)
+{
+    QList<NotebookSearchItem> items;
+    QJsonArray highlights;
+    QJsonArray notes;
+
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(it.value(), &error);
+        if (error.error != QJsonParseError::NoError) {
+            continue;
+        }
+        QJsonObject obj = doc.object();
+
+        if (it.key() == METADATA_FILE_NAME) {
+            // Bookmarks are "page<TAB>title" lines with 1-based pages
+            const QJsonArray bookmarkArray = obj["bookmarks"].toArray();
+            for (const QJsonValue &value : bookmarkArray) {
+                QStringList parts = value.toString().split('\t', Qt::KeepEmptyParts);
+                bool ok = false;
+                int pageNumber = parts.isEmpty() ? 0 : parts[0].toInt(&ok);
+                if (!ok || parts.size() < 2) continue;
+
+                NotebookSearchItem item;
+                item.kind = NotebookSearchItem::Bookmark;
+                item.pageNumber = pageNumber - 1;
+                item.title = parts[1];
+                items.append(item);
+            }
+        }
+
+        // Shards, or the inline arrays of notebooks saved before sharding
+        for (const QJsonValue &value : obj["text_highlights"].toArray()) highlights.append(value);
+        for (const QJsonValue &value : obj["markdown_notes"].toArray()) notes.append(value);
+    }
+
+    for (const QJsonValue &value : std::as_const(highlights)) {
+        TextHighlight highlight = TextHighlight::fromJson(value.toObject());
+        if (highlight.text.trimmed().isEmpty()) continue;
+
+        NotebookSearchItem item;
+        item.kind = NotebookSearchItem::Highlight;
+        item.pageNumber = highlight.pageNumber;
+        item.text = highlight.text;
+        items.append(item);
+    }
+    for (const QJsonValue &value : std::as_const(notes)) {
+        MarkdownNoteData note = MarkdownNoteData::fromJson(value.toObject());
+
+        NotebookSearchItem item;
+        item.kind = NotebookSearchItem::Note;
+        item.pageNumber = note.pageNumber;
+        item.title = note.title;
+        item.text = note.content;
+        items.append(item);
+    }
+    return items;
+}
+
+void NotebookSearchIndex::refreshNotebooks(const QStringList &notebookPaths)
+{
+    QList<QString> stale;
+    {
+        QMutexLocker locker(&indexMutex);
+        ensureLoaded();
+
+        // Forget notebooks the launcher no longer lists
+        const QSet<QString> listed(notebookPaths.begin(), notebookPaths.end());
+        const QStringList indexedPaths = slotByPath.keys();
+        for (const QString &path : indexedPaths) {
+            if (!listed.contains(path)) {
+                eraseRecord(slotByPath.value(path));
+                QFile::remove(recordFilePath(path));
+            }
+        }
+
+        for (const QString &path : notebookPaths) {
+            const qint64 modified = sourceModified(path);
+            if (modified < 0) continue;
+            auto it = slotByPath.constFind(path);
+            if (it == slotByPath.constEnd() || records[it.value()].indexedAt < modified) {
+                stale.append(path);
+            }
+        }
+    }
+
+    // ✅ Files are read without holding the lock, so searches stay responsive meanwhile
+    for (const QString &path : std::as_const(stale)) {
+        updateNotebook(path, itemsFromNotebookFiles(readNotebookFiles(path)));
+    }
+}
+
+QList<NotebookSearchHit> NotebookSearchIndex::search(const QString &query, int maxHits)
+{
+    QList<NotebookSearchHit> hits;
+    const QStringList queryTokens = PdfSearchIndex::tokenize(query);
+    if (queryTokens.isEmpty()) {
+        return hits;
+    }
+
+    QMutexLocker locker(&indexMutex);
+    ensureLoaded();
+
+    if (!sortedTokensValid) {
+        sortedTokens = postings.keys();
+        std::sort(sortedTokens.begin(), sortedTokens.end());
+        sortedTokensValid = true;
+    }
+
+    auto refKey = [](const ItemRef &ref) { return (quint64(quint32(ref.notebook)) << 32) | quint32(ref.item); };
+
+    // Every query word must occur in the item; the last one may be a prefix
+    QSet<quint64> matches;
+    for (int i = 0; i < queryTokens.size(); ++i) {
+        QSet<quint64> tokenMatches;
+        if (i < queryTokens.size() - 1) {
+            for (const ItemRef &ref : postings.value(queryTokens[i])) {
+                tokenMatches.insert(refKey(ref));
+            }
+        } else {
+            for (auto it = std::lower_bound(sortedTokens.cbegin(), sortedTokens.cend(), queryTokens[i]);
+                 it != sortedTokens.cend() && it->startsWith(queryTokens[i]); ++it) {
+                for (const ItemRef &ref : postings.value(*it)) {
+                    tokenMatches.insert(refKey(ref));
+                }
+            }
+        }
+
+        matches = (i == 0) ? tokenMatches : matches.intersect(tokenMatches);
+        if (matches.isEmpty()) {
+            return hits;
+        }
+    }
+
+    QList<quint64> ordered(matches.begin(), matches.end());
+    std::sort(ordered.begin(), ordered.end(), [](quint64 a, quint64 b) {
+        const NotebookRecord &recordA = records[int(a >> 32)];
+        const NotebookRecord &recordB = records[int(b >> 32)];
+        if (recordA.indexedAt != recordB.indexedAt) {
+            return recordA.indexedAt > recordB.indexedAt;
+        }
+        if (recordA.path != recordB.path) {
+            return recordA.path < recordB.path;
+        }
+        const NotebookSearchItem &itemA = recordA.items[int(quint32(a))];
+        const NotebookSearchItem &itemB = recordB.items[int(quint32(b))];
+        return itemA.pageNumber != itemB.pageNumber ? itemA.pageNumber < itemB.pageNumber : a < b;
+    });
+
+    for (quint64 key : std::as_const(ordered)) {
+        if (hits.size() >= maxHits) break;
+        const NotebookRecord &record = records[int(key >> 32)];
+        NotebookSearchHit hit;
+        hit.notebookPath = record.path;
+        hit.notebookName = record.name;
+        hit.item = record.items[int(quint32(key))];
+        hits.append(hit);
+    }
+    return hits;
+}
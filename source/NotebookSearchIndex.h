@@ -0,0 +1,104 @@
+#ifndef NOTEBOOKSEARCHINDEX_H
+#define NOTEBOOKSEARCHINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QJsonObject>
+
+// One searchable piece of a notebook
+struct NotebookSearchItem {
+    enum Kind { Note, Highlight, Bookmark };
+
+    Kind kind = Note;
+    int pageNumber = 0;  // 0-based
+    QString title;       // Note or bookmark title (empty for highlights)
+    QString text;        // Note content or highlighted text
+
+    QJsonObject toJson() const;
+    static NotebookSearchItem fromJson(const QJsonObject &obj);
+};
+
+struct NotebookSearchHit {
+    QString notebookPath;  // .spn package or notebook folder
+    QString notebookName;
+    NotebookSearchItem item;
+};
+
+// Search index over the markdown notes, highlight texts and bookmarks of every
+// notebook the launcher knows about. Each notebook's items are stored in their
+// own small JSON file under notebook_search/ in the app data folder, so an
+// update rewrites one file. The token index is built in memory on first use.
+//
+// The open canvas re-indexes the pages it changed shortly after it saves; the
+// launcher re-indexes notebooks whose files are newer than the last indexing.
+class NotebookSearchIndex
+{
+public:
+    // Replace everything indexed for a notebook
+    static void updateNotebook(const QString &notebookPath, const QList<NotebookSearchItem> &items);
+    static void removeNotebook(const QString &notebookPath);
+
+    // Replace the items of some pages and all bookmarks, keeping the other
+    // pages' items. A notebook not indexed yet starts from the saved files in
+    // workingFolder. Does file I/O, so call it off the GUI thread.
+    static void updateNotebookPages(const QString &notebookPath, const QString &workingFolder,
+                                    const QSet<int> &pages, const QList<NotebookSearchItem> &pageItems,
+                                    const QList<NotebookSearchItem> &bookmarkItems);
+
+    // Index the notebooks that changed since they were last indexed and forget
+    // the ones no longer listed. Reads notebook files, so call it off the GUI thread.
+    static void refreshNotebooks(const QStringList &notebookPaths);
+
+    // Items containing every word of the query (the last word as a prefix),
+    // most recently indexed notebooks first
+    static QList<NotebookSearchHit> search(const QString &query, int maxHits = 200);
+
+    // Items of a notebook given its saved files (relative path -> contents):
+    // the metadata JSON and the annotation shards
+    static QList<NotebookSearchItem> itemsFromNotebookFiles(const QHash<QString, QByteArray> &files);
+
+    static QString notebookDisplayName(const QString &notebookPath);
+
+private:
+    struct NotebookRecord {
+        QString path;
+        QString name;
+        qint64 indexedAt = 0;          // msecs since epoch
+        QList<NotebookSearchItem> items;
+        QStringList tokens;            // Distinct tokens of all items (to remove postings again)
+    };
+
+    struct ItemRef {
+        qint32 notebook; // Slot in records
+        qint32 item;     // Index in that record's items
+    };
+
+    // Callers must hold indexMutex
+    static void ensureLoaded();
+    static void insertRecord(NotebookRecord record);
+    static void eraseRecord(int slot);
+    static void storeNotebook(const QString &notebookPath, const QList<NotebookSearchItem> &items);
+
+    static QString indexDir();
+    static QString recordFilePath(const QString &notebookPath);
+    static void writeRecord(const NotebookRecord &record);
+    static qint64 sourceModified(const QString &notebookPath);
+    static QHash<QString, QByteArray> readNotebookFiles(const QString &notebookPath);
+    static QStringList itemTokens(const NotebookSearchItem &item);
+
+    static QMutex indexMutex;
+    static bool loaded;
+    static QVector<NotebookRecord> records;         // Erased slots keep an empty path
+    static QHash<QString, int> slotByPath;
+    static QHash<QString, QVector<ItemRef>> postings;
+    static QStringList sortedTokens;                // Keys of postings in order, for prefix lookups
+    static bool sortedTokensValid;
+};
+
+#endif // NOTEBOOKSEARCHINDEX_H
@@ -0,0 +1,556 @@
+#include "PdfExportRenderer.h"
+#include "PdfFileMapping.h"
+#include "InkPageIndex.h"
+#include "InkStrokeStore.h"
+#include <QPainter>
+#include <QPageSize>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThread>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <poppler-qt6.h>
+#include <filesystem>
+#include <memory>
+
+namespace {
+
+// Minimal PDF writer for image pages with optional ink paths. Pages arrive already encoded,
+// so the sink only copies bytes; QPdfWriter would re-encode every image itself.
+// Object 1 is the catalog, object 2 the page tree (written last, once every
+// page is known), and each page adds its image, content streams and page object.
+//
+// With a checkpoint folder the file is built there and the writer state is saved
+// after every page, so an interrupted export reopens the partial file, cuts it
+// back to the last completed page and carries on from there.
+class ImagePdfWriter
+{
+public:
+    ImagePdfWriter(const QString &path, const QString &checkpointFolder, const QByteArray &signature)
+        : outputPath(path), checkpointFolder(checkpointFolder), signature(signature), saveFile(path),
+          partialFile(checkpointFolder + "/export_partial.pdf")
+    {
+        file = checkpointFolder.isEmpty() ? static_cast<QFileDevice *>(&saveFile) : &partialFile;
+    }
+
+    bool open()
+    {
+        if (!checkpointFolder.isEmpty() && resume()) return true;
+
+        offsets = QList<qint64>(2, 0);
+        pageObjects.clear();
+        if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+        write("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+        return ok;
+    }
+
+    int pagesWritten() const { return pageObjects.size(); }
+
+    // The page image (if any) is drawn first, then the compressed ink strokes (if any)
+    bool addPage(const QSizeF &pageSize, const PdfEncodedImage &image,
+                 const QByteArray &inkStrokes = QByteArray(), const QByteArray &inkExtGStates = QByteArray())
+    {
+        const QByteArray width = QByteArray::number(pageSize.width(), 'f', 3);
+        const QByteArray height = QByteArray::number(pageSize.height(), 'f', 3);
+
+        QByteArray resources;
+        QByteArray contents;
+        if (!image.isNull()) {
+            const int imageObject = beginObject();
+            write("<< /Type /XObject /Subtype /Image /Width " + QByteArray::number(image.width) +
+                  " /Height " + QByteArray::number(image.height) + image.dictionaryEntries() +
+                  " /Length " + QByteArray::number(image.data.size()) + " >>\nstream\n");
+            write(image.data);
+            write("\nendstream\nendobj\n");
+            resources += " /XObject << /Im0 " + QByteArray::number(imageObject) + " 0 R >>";
+            contents = "q " + width + " 0 0 " + height + " 0 0 cm /Im0 Do Q";
+        }
+        if (!inkExtGStates.isEmpty()) {
+            resources += " /ExtGState " + inkExtGStates;
+        }
+        if (!resources.isEmpty()) {
+            resources = " /Resources <<" + resources + " >>";
+        }
+
+        const int contentObject = beginObject();
+        write("<< /Length " + QByteArray::number(contents.size()) + " >>\nstream\n" + contents + "\nendstream\nendobj\n");
+        QByteArray contentRefs = QByteArray::number(contentObject) + " 0 R";
+
+        if (!inkStrokes.isEmpty()) {
+            const int strokesObject = beginObject();
+            write("<< /Filter /FlateDecode /Length " + QByteArray::number(inkStrokes.size()) + " >>\nstream\n");
+            write(inkStrokes);
+            write("\nendstream\nendobj\n");
+            contentRefs = "[" + contentRefs + " " + QByteArray::number(strokesObject) + " 0 R]";
+        }
+
+        pageObjects.append(beginObject());
+        write("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + width + " " + height + "]" + resources +
+              " /Contents " + contentRefs + " >>\nendobj\n");
+
+        if (ok && !checkpointFolder.isEmpty()) saveCheckpoint();
+        return ok;
+    }
+
+    bool finish()
+    {
+        offsets[0] = file->pos();
+        write("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+        QByteArray kids;
+        for (int object : pageObjects) kids += QByteArray::number(object) + " 0 R ";
+        offsets[1] = file->pos();
+        write("2 0 obj\n<< /Type /Pages /Kids [" + kids.trimmed() + "] /Count " +
+              QByteArray::number(pageObjects.size()) + " >>\nendobj\n");
+
+        const qint64 xrefOffset = file->pos();
+        QByteArray xref = "xref\n0 " + QByteArray::number(offsets.size() + 1) + "\n0000000000 65535 f \n";
+        for (qint64 offset : offsets) {
+            xref += QByteArray::number(offset).rightJustified(10, '0') + " 00000 n \n";
+        }
+        write(xref);
+        write("trailer\n<< /Size " + QByteArray::number(offsets.size() + 1) + " /Root 1 0 R >>\nstartxref\n" +
+              QByteArray::number(xrefOffset) + "\n%%EOF\n");
+
+        if (checkpointFolder.isEmpty()) {
+            return ok && saveFile.commit();
+        }
+
+        // ✅ Move the finished file into place in one step, replacing any previous output;
+        // the checkpoint is only dropped once it's there
+        partialFile.close();
+        if (!ok) return false;
+        std::error_code renameError;
+        std::filesystem::rename(partialFile.filesystemFileName(), QFile(outputPath).filesystemFileName(), renameError);
+        if (renameError) {
+            // Another file system: copy through QSaveFile, which also replaces atomically
+            if (!PdfExportRenderer::copyFileAtomically(partialFile.fileName(), outputPath)) return false;
+            QFile::remove(partialFile.fileName());
+        }
+        QFile::remove(checkpointPath());
+        return true;
+    }
+
+    // Leaves any existing file at the path untouched. A checkpointed export keeps
+    // its progress so the next run resumes it.
+    void discard()
+    {
+        if (checkpointFolder.isEmpty()) {
+            saveFile.cancelWriting();
+        } else {
+            partialFile.close();
+        }
+    }
+
+private:
+    QString checkpointPath() const { return checkpointFolder + "/export_progress.json"; }
+
+    bool resume()
+    {
+        QFile checkpoint(checkpointPath());
+        if (!checkpoint.open(QIODevice::ReadOnly)) return false;
+        const QJsonObject state = QJsonDocument::fromJson(checkpoint.readAll()).object();
+        checkpoint.close();
+
+        // A different job (other pages, profile or output) starts over
+        const qint64 size = qint64(state["size"].toDouble());
+        if (state["signature"].toString().toLatin1() != signature || size <= 0 ||
+            !partialFile.open(QIODevice::ReadWrite) || partialFile.size() < size) {
+            partialFile.close();
+            return false;
+        }
+
+        offsets.clear();
+        pageObjects.clear();
+        for (const QJsonValue &offset : state["offsets"].toArray()) offsets.append(qint64(offset.toDouble()));
+        for (const QJsonValue &object : state["pages"].toArray()) pageObjects.append(object.toInt());
+        if (offsets.size() < 2) {
+            partialFile.close();
+            return false;
+        }
+
+        // Anything after the last saved page was cut off mid-write
+        if (!partialFile.resize(size) || !partialFile.seek(size)) {
+            partialFile.close();
+            return false;
+        }
+        return true;
+    }
+
+    void saveCheckpoint()
+    {
+        if (!partialFile.flush()) {
+            ok = false;
+            return;
+        }
+        QJsonArray offsetArray;
+        for (qint64 offset : offsets) offsetArray.append(double(offset));
+        QJsonArray pageArray;
+        for (int object : pageObjects) pageArray.append(object);
+
+        QJsonObject state;
+        state["signature"] = QString::fromLatin1(signature);
+        state["size"] = double(partialFile.pos());
+        state["offsets"] = offsetArray;
+        state["pages"] = pageArray;
+
+        QSaveFile checkpoint(checkpointPath());
+        if (checkpoint.open(QIODevice::WriteOnly)) {
+            checkpoint.write(QJsonDocument(state).toJson(QJsonDocument::Compact));
+            checkpoint.commit();
+        }
+    }
+
+    int beginObject()
+    {
+        offsets.append(file->pos());
+        const int number = offsets.size();
+        write(QByteArray::number(number) + " 0 obj\n");
+        return number;
+    }
+
+    void write(const QByteArray &data)
+    {
+        if (ok && file->write(data) != data.size()) ok = false;
+    }
+
+    QString outputPath;
+    QString checkpointFolder;
+    QByteArray signature;
+    QSaveFile saveFile;  // Plain exports: replaced atomically on commit
+    QFile partialFile;   // Checkpointed exports: built in the checkpoint folder
+    QFileDevice *file = nullptr;
+    QList<qint64> offsets; // Object n is at offsets[n - 1]
+    QList<int> pageObjects;
+    bool ok = true;
+};
+
+// Identifies a job, so a checkpoint is only resumed by the export that wrote it
+QByteArray jobSignature(const PdfExportRenderer::Job &job, const QString &outputPath)
+{
+    QStringList parts;
+    parts << job.pdfPath << job.notebookId << outputPath << QString::number(job.dpi)
+          << QString::number(job.profile.pageEncoding) << QString::number(job.profile.inkEncoding)
+          << QString::number(job.profile.jpegQuality) << QString::number(job.profile.downsampleDpi)
+          << QString::number(job.profile.vectorInk);
+    for (int page : job.pages) {
+        parts << QString::number(page) + (job.annotatedPages.contains(page) ? "a" : "");
+    }
+    return QCryptographicHash::hash(parts.join('|').toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+} // namespace
+
+int PdfExportRenderer::workerCount(const Job &job)
+{
+    int workers = job.jobs > 0 ? job.jobs : QThread::idealThreadCount();
+    return qBound(1, workers, qMax(1, int(job.pages.size())));
+}
+
+bool PdfExportRenderer::isSameFile(const QString &a, const QString &b)
+{
+    const QFileInfo infoA(a);
+    const QFileInfo infoB(b);
+    const QString pathA = infoA.exists() ? infoA.canonicalFilePath() : infoA.absoluteFilePath();
+    const QString pathB = infoB.exists() ? infoB.canonicalFilePath() : infoB.absoluteFilePath();
+    return QDir::cleanPath(pathA) == QDir::cleanPath(pathB);
+}
+
+bool PdfExportRenderer::copyFileAtomically(const QString &source, const QString &target)
+{
+    QFile in(source);
+    QSaveFile out(target);
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray buffer;
+    while (!(buffer = in.read(1024 * 1024)).isEmpty()) {
+        if (out.write(buffer) != buffer.size()) {
+            return false; // QSaveFile discards the partial copy
+        }
+    }
+    return in.error() == QFileDevice::NoError && out.commit();
+}
+
+PdfExportRenderer::RenderedPage PdfExportRenderer::renderPdfPage(Poppler::Document *document, const Job &job, int pageNumber)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    RenderedPage rendered;
+    std::unique_ptr<Poppler::Page> pdfPage(document ? document->page(pageNumber) : nullptr);
+    if (!pdfPage) {
+        return rendered;
+    }
+    rendered.pageSize = pdfPage->pageSizeF();
+
+    QImage pageImage = pdfPage->renderToImage(job.dpi, job.dpi);
+    if (pageImage.isNull()) {
+        return rendered;
+    }
+
+    // ✅ Composite the ink here, on the worker, so the sink only writes finished pages
+    // (recorded strokes are drawn over the page image as paths instead)
+    if (job.annotatedPages.contains(pageNumber) && !encodeStrokes(job, rendered, pageNumber)) {
+        QImage inkImage(InkPageIndex::pageImagePath(job.saveFolder, job.notebookId, pageNumber));
+        if (!inkImage.isNull()) {
+            pageImage = pageImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            QPainter painter(&pageImage);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+            painter.drawImage(QRectF(pageImage.rect()), inkImage);
+        } else {
+            rendered.inkMissing = true;
+        }
+    }
+
+    // Nothing below the page is transparent, so drop the alpha channel before encoding
+    rendered.image = pageImage.convertToFormat(QImage::Format_RGB32);
+    rendered.renderMs = timer.elapsed();
+    encodePage(job, rendered, job.profile.pageEncoding);
+    return rendered;
+}
+
+PdfExportRenderer::RenderedPage PdfExportRenderer::renderCanvasPage(const Job &job, int pageNumber)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    RenderedPage rendered;
+    const QString imagePath = InkPageIndex::pageImagePath(job.saveFolder, job.notebookId, pageNumber);
+
+    // Page size comes from the image header; blank pages still get a page but nothing is decoded
+    QImageReader reader(imagePath);
+    const QSize imageSize = reader.size();
+    if (imageSize.isValid()) {
+        rendered.pageSize = QSizeF(imageSize.width() * 72.0 / job.dpi, imageSize.height() * 72.0 / job.dpi);
+    }
+
+    InkPageBounds inkBounds;
+    if (InkPageIndex::lookupPage(job.saveFolder, job.notebookId, pageNumber, inkBounds) && inkBounds.isBlank()) {
+        return rendered;
+    }
+    // White paper is the PDF default, so stroke paths alone make the page
+    if (rendered.pageSize.isValid() && encodeStrokes(job, rendered, pageNumber)) {
+        rendered.renderMs = timer.elapsed();
+        return rendered;
+    }
+
+    // ✅ Flatten the ink onto white paper; the page image is a pure ink layer
+    const QImage inkImage = reader.read();
+    if (!inkImage.isNull()) {
+        QImage paper(inkImage.size(), QImage::Format_RGB32);
+        paper.fill(Qt::white);
+        QPainter painter(&paper);
+        painter.drawImage(0, 0, inkImage);
+        painter.end();
+        rendered.image = paper;
+    }
+    rendered.renderMs = timer.elapsed();
+    encodePage(job, rendered, job.profile.inkEncoding);
+    return rendered;
+}
+
+void PdfExportRenderer::encodePage(const Job &job, RenderedPage &rendered, PdfImageEncoder::Encoding encoding)
+{
+    if (rendered.image.isNull()) return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QImage image = rendered.image;
+    rendered.image = QImage(); // Only the encoded bytes wait for the sink
+    if (job.profile.downsampleDpi > 0 && job.profile.downsampleDpi < job.dpi) {
+        const qreal scale = qreal(job.profile.downsampleDpi) / job.dpi;
+        image = image.scaled(qMax(1, qRound(image.width() * scale)), qMax(1, qRound(image.height() * scale)),
+                             Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    rendered.encoded = PdfImageEncoder::encode(image, encoding, job.profile.jpegQuality);
+    rendered.encodeMs = timer.elapsed();
+}
+
+bool PdfExportRenderer::encodeStrokes(const Job &job, RenderedPage &rendered, int pageNumber)
+{
+    InkStrokePage strokes;
+    if (!job.profile.vectorInk ||
+        !InkStrokeStore::loadPage(job.saveFolder, job.notebookId, pageNumber, strokes)) {
+        return false;
+    }
+
+    // Stroke coordinates are page image pixels, y running downwards
+    const qreal scaleX = rendered.pageSize.width() / strokes.imageSize.width();
+    const qreal scaleY = rendered.pageSize.height() / strokes.imageSize.height();
+    const QByteArray content = "q " + QByteArray::number(scaleX, 'f', 6) + " 0 0 " + QByteArray::number(-scaleY, 'f', 6) +
+                               " 0 " + QByteArray::number(rendered.pageSize.height(), 'f', 3) + " cm\n" +
+                               InkStrokeStore::pdfContent(strokes, &rendered.inkExtGStates) + "Q";
+    rendered.inkStrokes = PdfImageEncoder::flate(content);
+    return true;
+}
+
+bool PdfExportRenderer::exportPdf(const Job &job, const QString &outputPath, Progress *progress,
+                                  QString *errorMsg, QList<PageTiming> *timings)
+{
+    auto fail = [&](const QString &message) {
+        if (errorMsg) *errorMsg = message;
+        return false;
+    };
+
+    if (job.pages.isEmpty()) {
+        return fail(QObject::tr("No pages to export."));
+    }
+
+    const bool canvasOnly = job.pdfPath.isEmpty();
+    std::shared_ptr<PdfFileMapping> sharedPdf;
+    if (!canvasOnly) {
+        // One mapping shared by every worker; each opens its own document over it
+        sharedPdf = PdfFileMapping::acquire(job.pdfPath);
+        PdfDocumentHandle probe = sharedPdf ? sharedPdf->openDocument() : PdfFileMapping::loadDocument(job.pdfPath);
+        if (!probe || probe.get()->isLocked()) {
+            return fail(QObject::tr("Failed to open PDF: %1").arg(job.pdfPath));
+        }
+    }
+
+    // Opened first: a resumed checkpoint decides where rendering starts
+    ImagePdfWriter pdfWriter(outputPath, job.checkpointFolder, jobSignature(job, outputPath));
+    if (!pdfWriter.open()) {
+        return fail(QObject::tr("Failed to create PDF file."));
+    }
+    const int pageCount = job.pages.size();
+    const int firstIndex = qMin(pdfWriter.pagesWritten(), pageCount);
+    if (progress) {
+        progress->pagesWritten = firstIndex;
+    }
+
+    const int workers = workerCount(job);
+    const int window = workers + workers / 2 + 1; // Pages rendered ahead of the sink
+
+    QMutex resultMutex;
+    QWaitCondition pageReady;
+    QWaitCondition slotFree;
+    QHash<int, RenderedPage> finished; // Output index -> page, until the sink takes it
+    int nextToWrite = firstIndex;
+    std::atomic<int> nextToClaim{firstIndex};
+    std::atomic<bool> stop{false};
+
+    auto worker = [&]() {
+        PdfDocumentHandle handle;
+        if (!canvasOnly) {
+            handle = sharedPdf ? sharedPdf->openDocument() : PdfFileMapping::loadDocument(job.pdfPath);
+            if (handle) {
+                handle.get()->setRenderHint(Poppler::Document::Antialiasing, true);
+                handle.get()->setRenderHint(Poppler::Document::TextAntialiasing, true);
+                handle.get()->setRenderHint(Poppler::Document::TextHinting, true);
+                handle.get()->setRenderHint(Poppler::Document::TextSlightHinting, true);
+            }
+        }
+
+        while (!stop) {
+            const int index = nextToClaim.fetch_add(1);
+            if (index >= pageCount) break;
+
+            {
+                QMutexLocker locker(&resultMutex);
+                while (index >= nextToWrite + window && !stop) {
+                    slotFree.wait(&resultMutex);
+                }
+            }
+            if (stop) break;
+
+            const int pageNumber = job.pages[index];
+            RenderedPage rendered = canvasOnly ? renderCanvasPage(job, pageNumber)
+                                               : renderPdfPage(handle.get(), job, pageNumber);
+
+            QMutexLocker locker(&resultMutex);
+            finished.insert(index, std::move(rendered));
+            pageReady.wakeAll();
+        }
+    };
+
+    QThreadPool renderPool;
+    renderPool.setMaxThreadCount(workers);
+    for (int i = 0; i < workers; ++i) {
+        renderPool.start(worker);
+    }
+
+    auto stopWorkers = [&]() {
+        {
+            QMutexLocker locker(&resultMutex);
+            stop = true;
+            slotFree.wakeAll();
+        }
+        renderPool.waitForDone();
+    };
+
+    // ✅ Ordered sink: pre-encoded pages reach the file strictly in output order
+    QSizeF lastPageSize;
+
+    for (int index = firstIndex; index < pageCount; ++index) {
+        RenderedPage rendered;
+        {
+            QMutexLocker locker(&resultMutex);
+            while (!finished.contains(index)) {
+                if (progress && progress->canceled) break;
+                pageReady.wait(&resultMutex, 100); // Wake up now and then to notice cancellation
+            }
+            if (!finished.contains(index)) {
+                locker.unlock();
+                stopWorkers();
+                pdfWriter.discard();
+                return false;
+            }
+            rendered = finished.take(index);
+            nextToWrite = index + 1;
+            slotFree.wakeAll();
+        }
+
+        // ✅ Never write an annotated page without its ink
+        if (rendered.inkMissing) {
+            stopWorkers();
+            pdfWriter.discard();
+            return fail(QObject::tr("Ink for page %1 is missing.").arg(job.pages[index] + 1));
+        }
+
+        QElapsedTimer writeTimer;
+        writeTimer.start();
+
+        // Pages that failed to render keep the previous page's size
+        QSizeF pageSize = rendered.pageSize.isValid() ? rendered.pageSize : lastPageSize;
+        if (!pageSize.isValid()) pageSize = QPageSize(QPageSize::A4).size(QPageSize::Point);
+        lastPageSize = pageSize;
+
+        if (!pdfWriter.addPage(pageSize, rendered.encoded, rendered.inkStrokes, rendered.inkExtGStates)) {
+            stopWorkers();
+            pdfWriter.discard();
+            return fail(QObject::tr("Failed to write PDF file."));
+        }
+
+        if (timings) {
+            PageTiming timing;
+            timing.pageNumber = job.pages[index];
+            timing.renderMs = rendered.renderMs;
+            timing.encodeMs = rendered.encodeMs;
+            timing.writeMs = writeTimer.elapsed();
+            timings->append(timing);
+        }
+        if (progress) {
+            progress->pagesWritten = index + 1;
+        }
+    }
+
+    stopWorkers();
+    if (!pdfWriter.finish()) {
+        return fail(QObject::tr("Failed to write PDF file."));
+    }
+    return true;
+}
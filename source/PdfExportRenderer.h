@@ -0,0 +1,84 @@
+#ifndef PDFEXPORTRENDERER_H
+#define PDFEXPORTRENDERER_H
+
+#include <QString>
+#include <QList>
+#include <QSet>
+#include <QImage>
+#include <QSizeF>
+#include <atomic>
+#include "PdfImageEncoder.h"
+
+namespace Poppler { class Document; }
+
+// Export engine for annotated PDFs and canvas-only notebooks.
+//
+// Pages are rasterized, composited with their ink PNG and encoded (per the job's
+// export profile) by a pool of render workers, each reading the PDF through its
+// own Poppler document. Ink with recorded strokes is drawn as paths over the page
+// image instead of being composited. The calling thread is the ordered sink: it
+// appends the pre-encoded pages to the output PDF in page order while the workers run
+// ahead by a bounded number of pages, so memory stays flat however long the
+// document is. Blocking; call it off the GUI thread.
+class PdfExportRenderer
+{
+public:
+    struct Job {
+        QString pdfPath;          // Source PDF (empty = canvas-only notebook)
+        QString saveFolder;       // Notebook working folder holding the ink PNGs
+        QString notebookId;
+        QList<int> pages;         // 0-based page numbers, in output order
+        QSet<int> annotatedPages; // Pages whose ink is composited over the PDF
+        int dpi = 192;
+        int jobs = 0;             // Render workers (0 = one per core)
+        PdfExportProfile profile; // Image encoding and downsampling
+        QString checkpointFolder; // Resumable export state (empty = none); see exportPdf
+    };
+
+    // Shared with the thread that watches an export
+    struct Progress {
+        std::atomic<int> pagesWritten{0};
+        std::atomic<bool> canceled{false};
+    };
+
+    struct PageTiming {
+        int pageNumber = 0;
+        qint64 renderMs = 0; // Rasterizing and compositing, on a worker
+        qint64 encodeMs = 0; // Compressing the page image, on a worker
+        qint64 writeMs = 0;  // Appending the page to the file, on the sink
+    };
+
+    // Write the job's pages to outputPath. On failure or cancellation false is
+    // returned (errorMsg stays empty when canceled) and outputPath is left alone.
+    // With a checkpoint folder the partial file and per-page progress are kept
+    // there, and running the same job again continues after the last written page.
+    static bool exportPdf(const Job &job, const QString &outputPath, Progress *progress = nullptr,
+                          QString *errorMsg = nullptr, QList<PageTiming> *timings = nullptr);
+
+    static int workerCount(const Job &job);
+
+    // Whether two paths name the same file (symlinks and relative paths resolved)
+    static bool isSameFile(const QString &a, const QString &b);
+
+    // Copy through QSaveFile, so an existing target is only replaced by a complete copy
+    static bool copyFileAtomically(const QString &source, const QString &target);
+
+private:
+    struct RenderedPage {
+        QImage image;           // Composited page (null = blank page)
+        PdfEncodedImage encoded;
+        QByteArray inkStrokes;  // Compressed stroke paths drawn over the page (empty = none)
+        QByteArray inkExtGStates;
+        QSizeF pageSize;        // In points
+        bool inkMissing = false; // Annotated page whose ink image couldn't be read
+        qint64 renderMs = 0;
+        qint64 encodeMs = 0;
+    };
+
+    static RenderedPage renderPdfPage(Poppler::Document *document, const Job &job, int pageNumber);
+    static RenderedPage renderCanvasPage(const Job &job, int pageNumber);
+    static void encodePage(const Job &job, RenderedPage &rendered, PdfImageEncoder::Encoding encoding);
+    static bool encodeStrokes(const Job &job, RenderedPage &rendered, int pageNumber);
+};
+
+#endif // PDFEXPORTRENDERER_H
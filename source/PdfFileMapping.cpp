@@ -0,0 +1,111 @@
+#include "PdfFileMapping.h"
+#include <QFileInfo>
+#include <QDebug>
+
+QMutex PdfFileMapping::registryMutex;
+QHash<QString, std::weak_ptr<PdfFileMapping>> PdfFileMapping::registry;
+
+PdfFileMapping::PdfFileMapping(const QString &canonicalPath, const QDateTime &lastModified)
+    : canonicalPath(canonicalPath), lastModified(lastModified), file(canonicalPath)
+{
+}
+
+PdfFileMapping::~PdfFileMapping()
+{
+    if (mappedData) {
+        file.unmap(mappedData);
+        mappedData = nullptr;
+    }
+    file.close();
+}
+
+bool PdfFileMapping::map()
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open PDF for mapping:" << canonicalPath;
+        return false;
+    }
+
+    mappedSize = file.size();
+    if (mappedSize <= 0) {
+        return false;
+    }
+
+    mappedData = file.map(0, mappedSize);
+    if (!mappedData) {
+        qWarning() << "Failed to memory-map PDF:" << canonicalPath;
+        return false;
+    }
+
+    // ✅ Raw view: no copy is made, QBuffer only ever reads through constData()
+    bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(mappedData), mappedSize);
+    return true;
+}
+
+std::shared_ptr<PdfFileMapping> PdfFileMapping::acquire(const QString &pdfPath)
+{
+    QFileInfo info(pdfPath);
+    QString canonical = info.canonicalFilePath();
+    if (canonical.isEmpty()) {
+        return nullptr; // File doesn't exist
+    }
+    QDateTime modified = info.lastModified();
+
+    QMutexLocker locker(&registryMutex);
+
+    // Reuse a live mapping of the same, unmodified file
+    std::shared_ptr<PdfFileMapping> existing = registry.value(canonical).lock();
+    if (existing && existing->lastModified == modified && existing->mappedSize == info.size()) {
+        return existing;
+    }
+
+    std::shared_ptr<PdfFileMapping> mapping(new PdfFileMapping(canonical, modified));
+    if (!mapping->map()) {
+        return nullptr;
+    }
+
+    // Drop registry entries whose mappings have been released
+    for (auto it = registry.begin(); it != registry.end();) {
+        if (it.value().expired()) {
+            it = registry.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    registry.insert(canonical, mapping);
+    return mapping;
+}
+
+PdfDocumentHandle PdfFileMapping::loadDocument(const QString &pdfPath)
+{
+    std::shared_ptr<PdfFileMapping> mapping = acquire(pdfPath);
+    if (mapping) {
+        PdfDocumentHandle handle = mapping->openDocument();
+        if (handle) {
+            return handle;
+        }
+    }
+
+    // Fallback: let Poppler read the file itself
+    PdfDocumentHandle handle;
+    handle.document = Poppler::Document::load(pdfPath);
+    return handle;
+}
+
+PdfDocumentHandle PdfFileMapping::openDocument()
+{
+    PdfDocumentHandle handle;
+    handle.mapping = shared_from_this();
+
+    handle.device = std::make_unique<QBuffer>();
+    handle.device->setData(bytes); // Shallow copy of the raw view
+    if (!handle.device->open(QIODevice::ReadOnly)) {
+        handle.device.reset();
+        handle.mapping.reset();
+        return handle;
+    }
+
+    handle.document = Poppler::Document::load(handle.device.get());
+    return handle;
+}
@@ -0,0 +1,65 @@
+#ifndef PDFFILEMAPPING_H
+#define PDFFILEMAPPING_H
+
+#include <QString>
+#include <QFile>
+#include <QBuffer>
+#include <QByteArray>
+#include <QDateTime>
+#include <QMutex>
+#include <QHash>
+#include <memory>
+#include <poppler-qt6.h>
+
+class PdfFileMapping;
+
+// A Poppler document together with everything it reads from.
+// Members are destroyed in reverse order, so the document goes first.
+struct PdfDocumentHandle {
+    std::shared_ptr<PdfFileMapping> mapping;     // Keeps the mapped bytes alive (null for path-loaded fallback)
+    std::unique_ptr<QBuffer> device;             // Per-document read cursor over the mapping
+    std::unique_ptr<Poppler::Document> document; // The document itself
+
+    Poppler::Document* get() const { return document.get(); }
+    explicit operator bool() const { return document != nullptr; }
+};
+
+// A PDF file mapped into memory once and shared by every document instance that
+// reads it: the tab's main document, background render workers and other tabs
+// that open the same file. Mappings are reference-counted and looked up by
+// canonical path, so the file is only read through the page cache once.
+class PdfFileMapping : public std::enable_shared_from_this<PdfFileMapping>
+{
+public:
+    ~PdfFileMapping();
+
+    // Get the shared mapping for a PDF file (maps it on first use). Returns null on failure.
+    static std::shared_ptr<PdfFileMapping> acquire(const QString &pdfPath);
+
+    // Open a document for a PDF path through the shared mapping.
+    // Falls back to Poppler's own file loading if the file can't be mapped.
+    static PdfDocumentHandle loadDocument(const QString &pdfPath);
+
+    // Open a new, independent document instance reading from this mapping.
+    // Each instance has its own device, so instances can be used on different threads.
+    PdfDocumentHandle openDocument();
+
+    QString filePath() const { return canonicalPath; }
+    qint64 size() const { return mappedSize; }
+
+private:
+    PdfFileMapping(const QString &canonicalPath, const QDateTime &lastModified);
+    bool map();
+
+    QString canonicalPath;
+    QDateTime lastModified; // File timestamp when mapped (a changed file gets a new mapping)
+    QFile file;
+    uchar *mappedData = nullptr;
+    qint64 mappedSize = 0;
+    QByteArray bytes; // Non-owning view of the mapped data
+
+    static QMutex registryMutex;
+    static QHash<QString, std::weak_ptr<PdfFileMapping>> registry;
+};
+
+#endif // PDFFILEMAPPING_H
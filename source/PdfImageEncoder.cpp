@@ -0,0 +1,147 @@
+#include "PdfImageEncoder.h"
+#include <QBuffer>
+#include <QImageWriter>
+
+QByteArray PdfEncodedImage::dictionaryEntries() const
+{
+    QByteArray out;
+    for (const auto &entry : entries) {
+        out += " /" + entry.first + " " + entry.second;
+    }
+    return out;
+}
+
+QByteArray PdfImageEncoder::flate(const QByteArray &data)
+{
+    // qCompress output is a 4-byte size header followed by a zlib stream (what FlateDecode reads)
+    return qCompress(data, 6).mid(4);
+}
+
+PdfEncodedImage PdfImageEncoder::encode(const QImage &image, Encoding encoding, int jpegQuality)
+{
+    PdfEncodedImage encoded;
+    if (image.isNull()) return encoded;
+    encoded.width = image.width();
+    encoded.height = image.height();
+
+    switch (encoding) {
+    case Jpeg: {
+        QBuffer buffer(&encoded.data);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, "jpeg");
+        writer.setQuality(qBound(1, jpegQuality, 100));
+        if (!writer.write(image.convertToFormat(QImage::Format_RGB32))) {
+            return PdfEncodedImage();
+        }
+        encoded.entries << qMakePair(QByteArray("ColorSpace"), QByteArray("/DeviceRGB"))
+                        << qMakePair(QByteArray("BitsPerComponent"), QByteArray("8"))
+                        << qMakePair(QByteArray("Filter"), QByteArray("/DCTDecode"));
+        return encoded;
+    }
+    case Indexed: {
+        // Nearest palette color per pixel: dithering would scatter noise over flat ink and defeat Flate
+        const QImage indexed = image.convertToFormat(QImage::Format_RGB32)
+                                   .convertToFormat(QImage::Format_Indexed8, Qt::ThresholdDither | Qt::AvoidDither);
+        const QList<QRgb> colors = indexed.colorTable();
+        if (colors.isEmpty()) return PdfEncodedImage();
+
+        QByteArray palette;
+        for (QRgb color : colors) {
+            palette.append(char(qRed(color)));
+            palette.append(char(qGreen(color)));
+            palette.append(char(qBlue(color)));
+        }
+        QByteArray samples;
+        samples.reserve(qsizetype(indexed.width()) * indexed.height());
+        for (int y = 0; y < indexed.height(); ++y) {
+            samples.append(reinterpret_cast<const char *>(indexed.constScanLine(y)), indexed.width());
+        }
+        encoded.entries << qMakePair(QByteArray("ColorSpace"),
+                                     "[/Indexed /DeviceRGB " + QByteArray::number(colors.size() - 1) + " <" + palette.toHex() + ">]")
+                        << qMakePair(QByteArray("BitsPerComponent"), QByteArray("8"))
+                        << qMakePair(QByteArray("Filter"), QByteArray("/FlateDecode"));
+        encoded.data = flate(samples);
+        return encoded;
+    }
+    case Monochrome: {
+        // Thresholded on ink coverage, not brightness, so light ink (yellow, pale marker) stays
+        // visible: with alpha, any covered pixel is ink (the soft mask keeps its strength);
+        // on white paper, any pixel with a channel clearly below white.
+        // In DeviceGray a set bit is white.
+        const bool hasAlpha = image.hasAlphaChannel();
+        const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+        const int rowBytes = (argb.width() + 7) / 8;
+        QByteArray samples(qsizetype(rowBytes) * argb.height(), '\0');
+        for (int y = 0; y < argb.height(); ++y) {
+            const QRgb *line = reinterpret_cast<const QRgb *>(argb.constScanLine(y));
+            char *out = samples.data() + qsizetype(y) * rowBytes;
+            for (int x = 0; x < argb.width(); ++x) {
+                const QRgb pixel = line[x];
+                const bool ink = hasAlpha ? qAlpha(pixel) > 0
+                                          : 255 - qMin(qRed(pixel), qMin(qGreen(pixel), qBlue(pixel))) >= 48;
+                if (!ink) out[x >> 3] = char(out[x >> 3] | (0x80 >> (x & 7)));
+            }
+        }
+        encoded.entries << qMakePair(QByteArray("ColorSpace"), QByteArray("/DeviceGray"))
+                        << qMakePair(QByteArray("BitsPerComponent"), QByteArray("1"))
+                        << qMakePair(QByteArray("Filter"), QByteArray("/FlateDecode"));
+        encoded.data = flate(samples);
+        return encoded;
+    }
+    case Flate:
+        break;
+    }
+
+    const QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+    QByteArray samples;
+    samples.reserve(qsizetype(rgb.width()) * rgb.height() * 3);
+    for (int y = 0; y < rgb.height(); ++y) {
+        samples.append(reinterpret_cast<const char *>(rgb.constScanLine(y)), qsizetype(rgb.width()) * 3);
+    }
+    encoded.entries << qMakePair(QByteArray("ColorSpace"), QByteArray("/DeviceRGB"))
+                    << qMakePair(QByteArray("BitsPerComponent"), QByteArray("8"))
+                    << qMakePair(QByteArray("Filter"), QByteArray("/FlateDecode"));
+    encoded.data = flate(samples);
+    return encoded;
+}
+
+PdfEncodedImage PdfImageEncoder::encodeAlpha(const QImage &image)
+{
+    PdfEncodedImage encoded;
+    if (image.isNull()) return encoded;
+
+    const QImage alpha = image.convertToFormat(QImage::Format_Alpha8);
+    QByteArray samples;
+    samples.reserve(qsizetype(alpha.width()) * alpha.height());
+    for (int y = 0; y < alpha.height(); ++y) {
+        samples.append(reinterpret_cast<const char *>(alpha.constScanLine(y)), alpha.width());
+    }
+    encoded.width = alpha.width();
+    encoded.height = alpha.height();
+    encoded.entries << qMakePair(QByteArray("ColorSpace"), QByteArray("/DeviceGray"))
+                    << qMakePair(QByteArray("BitsPerComponent"), QByteArray("8"))
+                    << qMakePair(QByteArray("Filter"), QByteArray("/FlateDecode"));
+    encoded.data = flate(samples);
+    return encoded;
+}
+
+PdfExportProfile PdfExportProfile::preset(const QString &name)
+{
+    PdfExportProfile profile;
+    if (name == "balanced") {
+        profile.pageEncoding = PdfImageEncoder::Jpeg;
+        profile.inkEncoding = PdfImageEncoder::Indexed;
+        profile.jpegQuality = 85;
+    } else if (name == "compact") {
+        profile.pageEncoding = PdfImageEncoder::Jpeg;
+        profile.inkEncoding = PdfImageEncoder::Indexed;
+        profile.jpegQuality = 70;
+        profile.downsampleDpi = 150;
+    }
+    return profile;
+}
+
+QStringList PdfExportProfile::presetNames()
+{
+    return QStringList() << "lossless" << "balanced" << "compact";
+}
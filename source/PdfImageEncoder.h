@@ -0,0 +1,56 @@
+#ifndef PDFIMAGEENCODER_H
+#define PDFIMAGEENCODER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QImage>
+
+// An image XObject ready to be written: compressed samples plus the
+// dictionary entries that describe them
+struct PdfEncodedImage {
+    int width = 0;
+    int height = 0;
+    QList<QPair<QByteArray, QByteArray>> entries; // Key (without the slash) -> serialized value
+    QByteArray data;
+
+    bool isNull() const { return data.isEmpty(); }
+    QByteArray dictionaryEntries() const; // " /Key value" for each entry
+};
+
+// Encodes images for PDF output on the calling thread, so exports can spread
+// the work over their render workers instead of leaving it to the writer
+class PdfImageEncoder
+{
+public:
+    enum Encoding {
+        Flate,      // Lossless 8-bit RGB
+        Jpeg,       // DCT at the profile's quality
+        Indexed,    // Up to 256 colors, lossless for flat ink
+        Monochrome  // 1 bit per pixel: ink (any coverage) or paper
+    };
+
+    // Opaque samples of an image (alpha is ignored)
+    static PdfEncodedImage encode(const QImage &image, Encoding encoding, int jpegQuality = 85);
+    // 8-bit DeviceGray soft mask holding an image's alpha channel
+    static PdfEncodedImage encodeAlpha(const QImage &image);
+
+    static QByteArray flate(const QByteArray &data);
+};
+
+// How an export encodes its images
+struct PdfExportProfile {
+    PdfImageEncoder::Encoding pageEncoding = PdfImageEncoder::Flate; // Rendered PDF pages (Flate or Jpeg)
+    PdfImageEncoder::Encoding inkEncoding = PdfImageEncoder::Flate;  // Pure ink images (Flate, Indexed or Monochrome)
+    int jpegQuality = 85;
+    int downsampleDpi = 0; // Images above this resolution are scaled down (0 = keep)
+    bool vectorInk = true; // Write recorded pen and marker strokes as paths instead of ink images
+
+    // "lossless", "balanced" or "compact"; unknown names give lossless
+    static PdfExportProfile preset(const QString &name);
+    static QStringList presetNames();
+};
+
+#endif // PDFIMAGEENCODER_H
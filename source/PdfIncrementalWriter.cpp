@@ -0,0 +1,1016 @@
+#include "PdfIncrementalWriter.h"
+#include "InkPageIndex.h"
+#include "InkStrokeStore.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QImage>
+#include <QTransform>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QtEndian>
+#include <QDebug>
+#include <QThread>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+// A parsed PDF object. Scalars keep their source text so they are written back unchanged.
+struct PdfObject {
+    enum Type { Null, Boolean, Number, String, Name, Array, Dictionary, Reference };
+
+    Type type = Null;
+    QByteArray token;                             // Source text of numbers, strings and booleans; names without the slash
+    QList<PdfObject> items;                       // Array items
+    QList<QPair<QByteArray, PdfObject>> entries;  // Dictionary entries in file order (keys without the slash)
+    int objNum = 0;                               // Reference target
+    int genNum = 0;
+
+    bool isDictionary() const { return type == Dictionary; }
+    bool isName(const char *name) const { return type == Name && token == name; }
+    qint64 toInt() const { return type == Number ? qint64(token.toDouble()) : 0; }
+    double toDouble() const { return type == Number ? token.toDouble() : 0.0; }
+
+    const PdfObject *value(const QByteArray &key) const {
+        for (const auto &entry : entries) {
+            if (entry.first == key) return &entry.second;
+        }
+        return nullptr;
+    }
+
+    void setValue(const QByteArray &key, const PdfObject &object) {
+        for (auto &entry : entries) {
+            if (entry.first == key) {
+                entry.second = object;
+                return;
+            }
+        }
+        entries.append(qMakePair(key, object));
+    }
+
+    static PdfObject reference(int num, int gen = 0) {
+        PdfObject object;
+        object.type = Reference;
+        object.objNum = num;
+        object.genNum = gen;
+        return object;
+    }
+
+    static PdfObject name(const QByteArray &value) {
+        PdfObject object;
+        object.type = Name;
+        object.token = value;
+        return object;
+    }
+
+    static PdfObject number(qint64 value) {
+        PdfObject object;
+        object.type = Number;
+        object.token = QByteArray::number(value);
+        return object;
+    }
+
+    QByteArray serialize() const {
+        switch (type) {
+        case Null: return "null";
+        case Boolean:
+        case Number:
+        case String: return token;
+        case Name: return "/" + token;
+        case Reference: return QByteArray::number(objNum) + " " + QByteArray::number(genNum) + " R";
+        case Array: {
+            QByteArray out = "[";
+            for (int i = 0; i < items.size(); ++i) {
+                if (i > 0) out += ' ';
+                out += items[i].serialize();
+            }
+            return out + "]";
+        }
+        case Dictionary: {
+            QByteArray out = "<<";
+            for (const auto &entry : entries) {
+                out += " /" + entry.first + " " + entry.second.serialize();
+            }
+            return out + " >>";
+        }
+        }
+        return "null";
+    }
+};
+
+bool isPdfWhitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+bool isPdfDelimiter(char c)
+{
+    return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+           c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+// Recursive-descent parser over the raw file bytes
+class PdfParser
+{
+public:
+    explicit PdfParser(const QByteArray &bytes) : data(bytes) {}
+
+    qsizetype pos = 0;
+
+    void skipWhitespace() {
+        while (pos < data.size()) {
+            const char c = data.at(pos);
+            if (isPdfWhitespace(c)) {
+                ++pos;
+            } else if (c == '%') {
+                while (pos < data.size() && data.at(pos) != '\n' && data.at(pos) != '\r') ++pos;
+            } else {
+                break;
+            }
+        }
+    }
+
+    QByteArray readKeyword() {
+        skipWhitespace();
+        const qsizetype start = pos;
+        while (pos < data.size() && !isPdfWhitespace(data.at(pos)) && !isPdfDelimiter(data.at(pos))) ++pos;
+        return data.mid(start, pos - start);
+    }
+
+    bool expectKeyword(const char *keyword) {
+        const qsizetype saved = pos;
+        if (readKeyword() == keyword) return true;
+        pos = saved;
+        return false;
+    }
+
+    bool readInt(qint64 &value) {
+        const QByteArray keyword = readKeyword();
+        bool ok = false;
+        value = keyword.toLongLong(&ok);
+        return ok;
+    }
+
+    bool parseObject(PdfObject &object, int depth = 0) {
+        if (depth > 64) return false;
+        skipWhitespace();
+        if (pos >= data.size()) return false;
+
+        const char c = data.at(pos);
+        if (c == '/') {
+            const qsizetype start = ++pos;
+            while (pos < data.size() && !isPdfWhitespace(data.at(pos)) && !isPdfDelimiter(data.at(pos))) ++pos;
+            object.type = PdfObject::Name;
+            object.token = data.mid(start, pos - start);
+            return true;
+        }
+        if (c == '(') {
+            const qsizetype start = pos++;
+            int nesting = 1;
+            while (pos < data.size() && nesting > 0) {
+                const char s = data.at(pos++);
+                if (s == '\\') ++pos;
+                else if (s == '(') ++nesting;
+                else if (s == ')') --nesting;
+            }
+            object.type = PdfObject::String;
+            object.token = data.mid(start, pos - start);
+            return nesting == 0;
+        }
+        if (c == '<' && pos + 1 < data.size() && data.at(pos + 1) == '<') {
+            pos += 2;
+            object.type = PdfObject::Dictionary;
+            while (true) {
+                skipWhitespace();
+                if (pos + 1 >= data.size()) return false;
+                if (data.at(pos) == '>' && data.at(pos + 1) == '>') {
+                    pos += 2;
+                    return true;
+                }
+                PdfObject key;
+                PdfObject value;
+                if (!parseObject(key, depth + 1) || key.type != PdfObject::Name) return false;
+                if (!parseObject(value, depth + 1)) return false;
+                object.entries.append(qMakePair(key.token, value));
+            }
+        }
+        if (c == '<') {
+            const qsizetype end = data.indexOf('>', pos);
+            if (end < 0) return false;
+            object.type = PdfObject::String;
+            object.token = data.mid(pos, end + 1 - pos);
+            pos = end + 1;
+            return true;
+        }
+        if (c == '[') {
+            ++pos;
+            object.type = PdfObject::Array;
+            while (true) {
+                skipWhitespace();
+                if (pos >= data.size()) return false;
+                if (data.at(pos) == ']') {
+                    ++pos;
+                    return true;
+                }
+                PdfObject item;
+                if (!parseObject(item, depth + 1)) return false;
+                object.items.append(item);
+            }
+        }
+
+        const QByteArray keyword = readKeyword();
+        if (keyword.isEmpty()) return false;
+        if (keyword == "true" || keyword == "false") {
+            object.type = PdfObject::Boolean;
+            object.token = keyword;
+            return true;
+        }
+        if (keyword == "null") {
+            object.type = PdfObject::Null;
+            return true;
+        }
+
+        bool isNumber = false;
+        keyword.toDouble(&isNumber);
+        if (!isNumber) return false; // Operator keyword (endobj, stream, ...)
+
+        // "num gen R" is a reference
+        bool isInt = false;
+        const int num = keyword.toInt(&isInt);
+        if (isInt) {
+            const qsizetype saved = pos;
+            qint64 gen = 0;
+            if (readInt(gen) && expectKeyword("R")) {
+                object = PdfObject::reference(num, int(gen));
+                return true;
+            }
+            pos = saved;
+        }
+        object.type = PdfObject::Number;
+        object.token = keyword;
+        return true;
+    }
+
+private:
+    const QByteArray &data;
+};
+
+struct XrefEntry {
+    bool compressed = false;
+    qint64 offset = 0;   // Uncompressed objects
+    int generation = 0;
+    int streamNum = 0;   // Compressed objects: containing object stream and index in it
+    int index = 0;
+};
+
+// Read-only view of a PDF: cross-reference sections, object lookup and the page tree
+class PdfFile
+{
+public:
+    struct Page {
+        int objNum = 0;
+        int genNum = 0;
+        PdfObject dict;
+        PdfObject resources;  // Own or inherited (may be a reference)
+        QRectF box;           // Crop box clipped to the media box, in default user space
+        int rotate = 0;
+    };
+
+    explicit PdfFile(const QByteArray &bytes) : data(bytes) {}
+
+    bool load(QString &error);
+
+    PdfObject trailer;
+    bool xrefIsStream = false;  // Newest section is a cross-reference stream
+    qint64 startXref = 0;
+    QList<Page> pages;
+
+    PdfObject resolve(const PdfObject &object, int depth = 0);
+    bool readObject(int num, PdfObject &object, QByteArray *streamData = nullptr);
+
+private:
+    bool readXrefSection(qint64 offset, bool newest, QString &error);
+    bool readXrefTable(PdfParser &parser, bool newest, QString &error);
+    bool readXrefStream(qint64 offset, bool newest, QString &error);
+    bool readIndirectAt(qint64 offset, PdfObject &object, QByteArray *streamData);
+    bool decodeStream(const PdfObject &dict, const QByteArray &raw, QByteArray &decoded);
+    bool collectPages(const PdfObject &node, PdfObject resources, PdfObject mediaBox, PdfObject cropBox,
+                      int rotate, QSet<int> &visited, int depth);
+    QRectF rectFrom(const PdfObject &object);
+
+    const QByteArray &data;
+    PdfObject lastSectionTrailer; // Trailer of the section being read (for /Prev)
+    QHash<int, XrefEntry> xref;
+    QHash<int, QList<PdfObject>> objectStreams; // Parsed object streams by object number
+};
+
+bool PdfFile::load(QString &error)
+{
+    const qsizetype tail = data.lastIndexOf("startxref");
+    if (tail < 0) {
+        error = QObject::tr("PDF has no cross-reference table.");
+        return false;
+    }
+    PdfParser parser(data);
+    parser.pos = tail + 9;
+    if (!parser.readInt(startXref)) {
+        error = QObject::tr("PDF cross-reference offset is damaged.");
+        return false;
+    }
+
+    QSet<qint64> visited;
+    qint64 offset = startXref;
+    bool newest = true;
+    while (offset > 0 && !visited.contains(offset)) {
+        visited.insert(offset);
+        if (!readXrefSection(offset, newest, error)) return false;
+        const PdfObject *prev = lastSectionTrailer.value("Prev");
+        offset = prev ? prev->toInt() : 0;
+        newest = false;
+    }
+
+    if (trailer.value("Encrypt")) {
+        error = QObject::tr("Encrypted PDFs can't be updated in place.");
+        return false;
+    }
+
+    const PdfObject *rootRef = trailer.value("Root");
+    const PdfObject root = rootRef ? resolve(*rootRef) : PdfObject();
+    const PdfObject *pagesRef = root.value("Pages");
+    if (!pagesRef) {
+        error = QObject::tr("PDF has no page tree.");
+        return false;
+    }
+
+    QSet<int> visitedNodes;
+    if (pagesRef->type == PdfObject::Reference) visitedNodes.insert(pagesRef->objNum);
+    if (!collectPages(resolve(*pagesRef), PdfObject(), PdfObject(), PdfObject(), 0, visitedNodes, 0) || pages.isEmpty()) {
+        error = QObject::tr("PDF page tree is damaged.");
+        return false;
+    }
+    return true;
+}
+
+bool PdfFile::readXrefSection(qint64 offset, bool newest, QString &error)
+{
+    PdfParser parser(data);
+    parser.pos = offset;
+    if (parser.expectKeyword("xref")) {
+        if (newest) xrefIsStream = false;
+        return readXrefTable(parser, newest, error);
+    }
+    if (newest) xrefIsStream = true;
+    return readXrefStream(offset, newest, error);
+}
+
+bool PdfFile::readXrefTable(PdfParser &parser, bool newest, QString &error)
+{
+    while (!parser.expectKeyword("trailer")) {
+        qint64 first = 0;
+        qint64 count = 0;
+        if (!parser.readInt(first) || !parser.readInt(count) || first < 0 || count < 0) {
+            error = QObject::tr("PDF cross-reference table is damaged.");
+            return false;
+        }
+        for (qint64 i = 0; i < count; ++i) {
+            qint64 entryOffset = 0;
+            qint64 generation = 0;
+            if (!parser.readInt(entryOffset) || !parser.readInt(generation)) {
+                error = QObject::tr("PDF cross-reference table is damaged.");
+                return false;
+            }
+            const QByteArray kind = parser.readKeyword();
+            // Free entries are skipped: hybrid files list compressed objects as free here
+            if (kind == "n" && !xref.contains(int(first + i))) {
+                XrefEntry entry;
+                entry.offset = entryOffset;
+                entry.generation = int(generation);
+                xref.insert(int(first + i), entry);
+            }
+        }
+    }
+
+    PdfObject sectionTrailer;
+    if (!parser.parseObject(sectionTrailer) || !sectionTrailer.isDictionary()) {
+        error = QObject::tr("PDF trailer is damaged.");
+        return false;
+    }
+    if (newest) trailer = sectionTrailer;
+    lastSectionTrailer = sectionTrailer;
+
+    // Hybrid files keep their compressed objects in a stream next to the table
+    if (const PdfObject *xrefStm = sectionTrailer.value("XRefStm")) {
+        const PdfObject savedTrailer = lastSectionTrailer;
+        if (!readXrefStream(xrefStm->toInt(), false, error)) return false;
+        lastSectionTrailer = savedTrailer;
+    }
+    return true;
+}
+
+bool PdfFile::readXrefStream(qint64 offset, bool newest, QString &error)
+{
+    PdfObject dict;
+    QByteArray raw;
+    QByteArray decoded;
+    if (!readIndirectAt(offset, dict, &raw) || !dict.value("Type") || !dict.value("Type")->isName("XRef") ||
+        !decodeStream(dict, raw, decoded)) {
+        error = QObject::tr("PDF cross-reference stream is damaged.");
+        return false;
+    }
+    if (newest) trailer = dict;
+    lastSectionTrailer = dict;
+
+    const PdfObject *widths = dict.value("W");
+    if (!widths || widths->items.size() != 3) {
+        error = QObject::tr("PDF cross-reference stream is damaged.");
+        return false;
+    }
+    const int w0 = int(widths->items[0].toInt());
+    const int w1 = int(widths->items[1].toInt());
+    const int w2 = int(widths->items[2].toInt());
+    const int rowSize = w0 + w1 + w2;
+    if (rowSize <= 0 || w0 > 8 || w1 > 8 || w2 > 8) {
+        error = QObject::tr("PDF cross-reference stream is damaged.");
+        return false;
+    }
+
+    QList<qint64> index;
+    if (const PdfObject *indexObject = dict.value("Index")) {
+        for (const PdfObject &item : indexObject->items) index.append(item.toInt());
+    } else {
+        index << 0 << (dict.value("Size") ? dict.value("Size")->toInt() : 0);
+    }
+
+    auto field = [&](qsizetype at, int width, qint64 defaultValue) {
+        if (width == 0) return defaultValue;
+        qint64 value = 0;
+        for (int i = 0; i < width; ++i) value = (value << 8) | quint8(decoded.at(at + i));
+        return value;
+    };
+
+    qsizetype row = 0;
+    for (int i = 0; i + 1 < index.size(); i += 2) {
+        for (qint64 n = 0; n < index[i + 1]; ++n, row += rowSize) {
+            if (row + rowSize > decoded.size()) return true;
+            const int num = int(index[i] + n);
+            const qint64 type = field(row, w0, 1);
+            if (xref.contains(num) || (type != 1 && type != 2)) continue;
+            XrefEntry entry;
+            if (type == 1) {
+                entry.offset = field(row + w0, w1, 0);
+                entry.generation = int(field(row + w0 + w1, w2, 0));
+            } else {
+                entry.compressed = true;
+                entry.streamNum = int(field(row + w0, w1, 0));
+                entry.index = int(field(row + w0 + w1, w2, 0));
+            }
+            xref.insert(num, entry);
+        }
+    }
+    return true;
+}
+
+bool PdfFile::readIndirectAt(qint64 offset, PdfObject &object, QByteArray *streamData)
+{
+    if (offset <= 0 || offset >= data.size()) return false;
+    PdfParser parser(data);
+    parser.pos = offset;
+    qint64 num = 0;
+    qint64 generation = 0;
+    if (!parser.readInt(num) || !parser.readInt(generation) || !parser.expectKeyword("obj")) return false;
+    if (!parser.parseObject(object)) return false;
+    if (!streamData) return true;
+
+    if (!object.isDictionary() || !parser.expectKeyword("stream")) return false;
+    qsizetype start = parser.pos;
+    if (start < data.size() && data.at(start) == '\r') ++start;
+    if (start < data.size() && data.at(start) == '\n') ++start;
+
+    // /Length may itself be an indirect object; check it against "endstream" either way
+    qint64 length = -1;
+    if (const PdfObject *lengthObject = object.value("Length")) {
+        length = resolve(*lengthObject).toInt();
+    }
+    if (length >= 0 && start + length <= data.size()) {
+        PdfParser check(data);
+        check.pos = start + length;
+        if (check.expectKeyword("endstream")) {
+            *streamData = data.mid(start, length);
+            return true;
+        }
+    }
+    qsizetype end = data.indexOf("endstream", start);
+    if (end < 0) return false;
+    while (end > start && (data.at(end - 1) == '\n' || data.at(end - 1) == '\r')) --end;
+    *streamData = data.mid(start, end - start);
+    return true;
+}
+
+bool PdfFile::decodeStream(const PdfObject &dict, const QByteArray &raw, QByteArray &decoded)
+{
+    PdfObject filter = dict.value("Filter") ? resolve(*dict.value("Filter")) : PdfObject();
+    PdfObject params = dict.value("DecodeParms") ? resolve(*dict.value("DecodeParms")) : PdfObject();
+    if (filter.type == PdfObject::Array) {
+        if (filter.items.size() > 1) return false;
+        filter = filter.items.isEmpty() ? PdfObject() : filter.items.first();
+        params = params.items.isEmpty() ? params : resolve(params.items.first());
+    }
+
+    if (filter.type == PdfObject::Null) {
+        decoded = raw;
+        return true;
+    }
+    if (!filter.isName("FlateDecode")) return false;
+
+    // qUncompress wants its own 4-byte size hint in front of the zlib stream
+    QByteArray sized(4, '\0');
+    qToBigEndian<quint32>(quint32(qMin<qint64>(qint64(raw.size()) * 4, 64 * 1024 * 1024)), sized.data());
+    decoded = qUncompress(sized + raw);
+    if (decoded.isEmpty()) return false;
+
+    const int predictor = params.value("Predictor") ? int(params.value("Predictor")->toInt()) : 1;
+    if (predictor < 10) return predictor == 1;
+
+    // PNG predictors, one filter-type byte per row
+    const int colors = params.value("Colors") ? int(params.value("Colors")->toInt()) : 1;
+    const int bits = params.value("BitsPerComponent") ? int(params.value("BitsPerComponent")->toInt()) : 8;
+    const int columns = params.value("Columns") ? int(params.value("Columns")->toInt()) : 1;
+    const int bytesPerPixel = qMax(1, colors * bits / 8);
+    const int rowSize = (columns * colors * bits + 7) / 8;
+    if (rowSize <= 0) return false;
+
+    QByteArray out;
+    QByteArray previous(rowSize, '\0');
+    for (qsizetype at = 0; at + rowSize + 1 <= decoded.size(); at += rowSize + 1) {
+        const int type = quint8(decoded.at(at));
+        QByteArray current = decoded.mid(at + 1, rowSize);
+        for (int i = 0; i < rowSize; ++i) {
+            const int left = i >= bytesPerPixel ? quint8(current.at(i - bytesPerPixel)) : 0;
+            const int up = quint8(previous.at(i));
+            const int upLeft = i >= bytesPerPixel ? quint8(previous.at(i - bytesPerPixel)) : 0;
+            int value = quint8(current.at(i));
+            switch (type) {
+            case 1: value += left; break;
+            case 2: value += up; break;
+            case 3: value += (left + up) / 2; break;
+            case 4: {
+                const int p = left + up - upLeft;
+                const int pa = std::abs(p - left);
+                const int pb = std::abs(p - up);
+                const int pc = std::abs(p - upLeft);
+                value += (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+                break;
+            }
+            default: break;
+            }
+            current[i] = char(value & 0xFF);
+        }
+        out += current;
+        previous = current;
+    }
+    decoded = out;
+    return true;
+}
+
+bool PdfFile::readObject(int num, PdfObject &object, QByteArray *streamData)
+{
+    const auto it = xref.constFind(num);
+    if (it == xref.constEnd()) return false;
+
+    if (!it->compressed) {
+        return readIndirectAt(it->offset, object, streamData);
+    }
+    if (streamData) return false; // Streams are never stored in object streams
+
+    if (!objectStreams.contains(it->streamNum)) {
+        objectStreams.insert(it->streamNum, {}); // Guards against a stream that contains itself
+        PdfObject streamDict;
+        QByteArray raw;
+        QByteArray decoded;
+        const auto streamEntry = xref.constFind(it->streamNum);
+        if (streamEntry == xref.constEnd() || streamEntry->compressed ||
+            !readIndirectAt(streamEntry->offset, streamDict, &raw) || !decodeStream(streamDict, raw, decoded)) {
+            return false;
+        }
+        const int count = streamDict.value("N") ? int(streamDict.value("N")->toInt()) : 0;
+        const qint64 first = streamDict.value("First") ? streamDict.value("First")->toInt() : 0;
+
+        PdfParser header(decoded);
+        QList<qint64> offsets;
+        for (int i = 0; i < count; ++i) {
+            qint64 objectNum = 0;
+            qint64 objectOffset = 0;
+            if (!header.readInt(objectNum) || !header.readInt(objectOffset)) break;
+            offsets.append(objectOffset);
+        }
+        QList<PdfObject> objects;
+        for (qint64 objectOffset : offsets) {
+            PdfParser body(decoded);
+            body.pos = first + objectOffset;
+            PdfObject parsed;
+            body.parseObject(parsed);
+            objects.append(parsed);
+        }
+        objectStreams.insert(it->streamNum, objects);
+    }
+
+    const QList<PdfObject> &objects = objectStreams[it->streamNum];
+    if (it->index < 0 || it->index >= objects.size()) return false;
+    object = objects[it->index];
+    return true;
+}
+
+PdfObject PdfFile::resolve(const PdfObject &object, int depth)
+{
+    if (object.type != PdfObject::Reference) return object;
+    PdfObject target;
+    if (depth > 16 || !readObject(object.objNum, target)) return PdfObject();
+    return resolve(target, depth + 1);
+}
+
+QRectF PdfFile::rectFrom(const PdfObject &object)
+{
+    const PdfObject rect = resolve(object);
+    if (rect.items.size() != 4) return QRectF();
+    const double x0 = resolve(rect.items[0]).toDouble();
+    const double y0 = resolve(rect.items[1]).toDouble();
+    const double x1 = resolve(rect.items[2]).toDouble();
+    const double y1 = resolve(rect.items[3]).toDouble();
+    return QRectF(QPointF(qMin(x0, x1), qMin(y0, y1)), QPointF(qMax(x0, x1), qMax(y0, y1)));
+}
+
+bool PdfFile::collectPages(const PdfObject &node, PdfObject resources, PdfObject mediaBox, PdfObject cropBox,
+                           int rotate, QSet<int> &visited, int depth)
+{
+    if (!node.isDictionary() || depth > 64) return false;
+
+    // Inheritable page attributes
+    if (const PdfObject *value = node.value("Resources")) resources = *value;
+    if (const PdfObject *value = node.value("MediaBox")) mediaBox = *value;
+    if (const PdfObject *value = node.value("CropBox")) cropBox = *value;
+    if (const PdfObject *value = node.value("Rotate")) rotate = int(resolve(*value).toInt());
+
+    const PdfObject kids = node.value("Kids") ? resolve(*node.value("Kids")) : PdfObject();
+    for (const PdfObject &kid : kids.items) {
+        if (kid.type != PdfObject::Reference || visited.contains(kid.objNum)) return false;
+        visited.insert(kid.objNum);
+
+        PdfObject child;
+        if (!readObject(kid.objNum, child) || !child.isDictionary()) return false;
+
+        const PdfObject *type = child.value("Type");
+        if (type && type->isName("Pages")) {
+            if (!collectPages(child, resources, mediaBox, cropBox, rotate, visited, depth + 1)) return false;
+            continue;
+        }
+
+        Page page;
+        page.objNum = kid.objNum;
+        page.genNum = kid.genNum;
+        page.dict = child;
+        page.resources = child.value("Resources") ? *child.value("Resources") : resources;
+        const QRectF media = rectFrom(child.value("MediaBox") ? *child.value("MediaBox") : mediaBox);
+        const QRectF crop = rectFrom(child.value("CropBox") ? *child.value("CropBox") : cropBox);
+        page.box = crop.isValid() ? crop.intersected(media) : media;
+        if (!page.box.isValid()) page.box = QRectF(0, 0, 612, 792); // Letter, the spec's default
+        page.rotate = child.value("Rotate") ? int(resolve(*child.value("Rotate")).toInt()) : rotate;
+        page.rotate = ((page.rotate % 360) + 360) % 360;
+        pages.append(page);
+    }
+    return true;
+}
+
+// Ink of one page, ready to be written as a form XObject of stroke paths or
+// as an image XObject with a soft mask
+struct EncodedInk {
+    int pageNumber = -1;
+    bool valid = false;
+    bool missing = false;  // The page's ink image couldn't be read
+    QSize imageSize;       // Full page image
+    QRect crop;            // Written part of it (ink bounding box)
+    PdfEncodedImage color; // Samples of the cropped (and possibly downsampled) ink
+    PdfEncodedImage alpha; // DeviceGray soft mask
+    QByteArray strokes;    // Compressed stroke paths in page image pixels (empty = image ink)
+    QByteArray extGStates; // Alpha states the paths use
+    qint64 encodeMs = 0;
+};
+
+EncodedInk encodeInk(const QString &saveFolder, const QString &notebookId, int pageNumber,
+                     const PdfExportProfile &profile, int inkDpi)
+{
+    EncodedInk ink;
+    ink.pageNumber = pageNumber;
+
+    // ✅ Recorded strokes become paths: nothing to decode or encode, sharp at any zoom
+    InkStrokePage strokePage;
+    if (profile.vectorInk && InkStrokeStore::loadPage(saveFolder, notebookId, pageNumber, strokePage)) {
+        if (strokePage.strokes.isEmpty()) return ink;
+        ink.imageSize = strokePage.imageSize;
+        ink.strokes = PdfImageEncoder::flate(InkStrokeStore::pdfContent(strokePage, &ink.extGStates));
+        ink.valid = true;
+        return ink;
+    }
+
+    QImage image(InkPageIndex::pageImagePath(saveFolder, notebookId, pageNumber));
+    if (image.isNull()) {
+        ink.missing = true;
+        return ink;
+    }
+    image = image.convertToFormat(QImage::Format_ARGB32);
+
+    InkPageBounds bounds;
+    if (!InkPageIndex::lookupPage(saveFolder, notebookId, pageNumber, bounds)) {
+        bounds = InkPageIndex::computeBounds(image);
+    }
+    const QRect crop = bounds.bbox.intersected(image.rect());
+    if (bounds.isBlank() || crop.isEmpty()) return ink;
+
+    // Placement uses the crop in page-image pixels, so downsampling only changes the samples
+    QImage cropped = image.copy(crop);
+    if (profile.downsampleDpi > 0 && profile.downsampleDpi < inkDpi) {
+        const qreal scale = qreal(profile.downsampleDpi) / inkDpi;
+        cropped = cropped.scaled(qMax(1, qRound(cropped.width() * scale)), qMax(1, qRound(cropped.height() * scale)),
+                                 Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    ink.imageSize = image.size();
+    ink.crop = crop;
+    ink.color = PdfImageEncoder::encode(cropped, profile.inkEncoding, profile.jpegQuality);
+    ink.alpha = PdfImageEncoder::encodeAlpha(cropped);
+    ink.valid = !ink.color.isNull() && !ink.alpha.isNull();
+    return ink;
+}
+
+// An object of the update section and where it starts in the output file
+struct WrittenObject {
+    int num = 0;
+    qint64 offset = 0;
+    int generation = 0;
+};
+
+// Maps the unit square of a displayed (rotated) page onto its default user space
+QTransform displayToUserSpace(const QRectF &box, int rotate)
+{
+    const double w = box.width();
+    const double h = box.height();
+    switch (rotate) {
+    case 90:  return QTransform(0, h, -w, 0, box.left() + w, box.top());
+    case 180: return QTransform(-w, 0, 0, -h, box.right(), box.bottom());
+    case 270: return QTransform(0, -h, w, 0, box.left(), box.bottom());
+    default:  return QTransform(w, 0, 0, h, box.left(), box.top());
+    }
+}
+
+QByteArray pdfNumber(double value)
+{
+    QByteArray text = QByteArray::number(value, 'f', 4);
+    while (text.contains('.') && (text.endsWith('0') || text.endsWith('.'))) text.chop(1);
+    return text == "-0" ? "0" : text;
+}
+
+} // namespace
+
+bool PdfIncrementalWriter::writeInkOverlays(const QString &originalPdf, const QString &outputPdf,
+                                            const QString &saveFolder, const QString &notebookId, const QList<int> &pages,
+                                            const PdfExportProfile &profile, int inkDpi,
+                                            PdfExportRenderer::Progress *progress, QString *errorMsg,
+                                            QList<PdfExportRenderer::PageTiming> *timings, int jobs)
+{
+    auto fail = [&](const QString &message) {
+        if (errorMsg) *errorMsg = message;
+        return false;
+    };
+
+    QFile source(originalPdf);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return fail(QObject::tr("Failed to open PDF: %1").arg(originalPdf));
+    }
+    // Map the original instead of reading it when possible; it's only copied once
+    QByteArray original;
+    if (uchar *mapped = source.map(0, source.size())) {
+        original = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), source.size());
+    } else {
+        original = source.readAll();
+    }
+
+    PdfFile pdf(original);
+    QString loadError;
+    if (!pdf.load(loadError)) {
+        return fail(loadError);
+    }
+
+    // ✅ Encode every page's ink on the worker threads before anything is written
+    const int pdfPageCount = pdf.pages.size();
+    QThreadPool encodePool;
+    encodePool.setMaxThreadCount(jobs > 0 ? jobs : QThread::idealThreadCount());
+    const QList<EncodedInk> inks = QtConcurrent::blockingMapped(&encodePool, pages, [&](int pageNumber) {
+        if ((progress && progress->canceled) || pageNumber < 0 || pageNumber >= pdfPageCount) {
+            return EncodedInk();
+        }
+        QElapsedTimer timer;
+        timer.start();
+        EncodedInk ink = encodeInk(saveFolder, notebookId, pageNumber, profile, inkDpi);
+        ink.encodeMs = timer.elapsed();
+        if (progress) ++progress->pagesWritten;
+        return ink;
+    });
+    if (progress && progress->canceled) {
+        return false;
+    }
+    for (const EncodedInk &ink : inks) {
+        if (ink.missing) {
+            return fail(QObject::tr("Ink for page %1 is missing.").arg(ink.pageNumber + 1));
+        }
+        if (timings && ink.pageNumber >= 0) {
+            PdfExportRenderer::PageTiming timing;
+            timing.pageNumber = ink.pageNumber;
+            timing.encodeMs = ink.encodeMs;
+            timings->append(timing);
+        }
+    }
+
+    const qint64 baseSize = pdf.trailer.value("Size") ? pdf.trailer.value("Size")->toInt() : 0;
+    int nextObject = int(baseSize);
+    QByteArray update = "\n";
+    QList<WrittenObject> offsets;
+
+    auto beginObject = [&](int num, int gen) {
+        offsets.append({num, qint64(original.size() + update.size()), gen});
+        update += QByteArray::number(num) + " " + QByteArray::number(gen) + " obj\n";
+    };
+    auto writeStream = [&](int num, PdfObject dict, const QByteArray &streamData) {
+        dict.setValue("Length", PdfObject::number(streamData.size()));
+        beginObject(num, 0);
+        update += dict.serialize() + "\nstream\n" + streamData + "\nendstream\nendobj\n";
+    };
+    auto writeImage = [&](int num, const PdfEncodedImage &encoded, const QByteArray &extraEntries) {
+        beginObject(num, 0);
+        update += "<< /Type /XObject /Subtype /Image /Width " + QByteArray::number(encoded.width) +
+                  " /Height " + QByteArray::number(encoded.height) + encoded.dictionaryEntries() + extraEntries +
+                  " /Length " + QByteArray::number(encoded.data.size()) + " >>\nstream\n" + encoded.data +
+                  "\nendstream\nendobj\n";
+    };
+
+    // Opens a graphics state in front of the page's own content, so whatever
+    // state that content leaves behind is dropped before the ink is drawn
+    PdfObject emptyDict;
+    emptyDict.type = PdfObject::Dictionary;
+    const int saveStateObject = nextObject++;
+    writeStream(saveStateObject, emptyDict, "q");
+
+    int overlaidPages = 0;
+    for (const EncodedInk &ink : inks) {
+        if (!ink.valid) continue;
+        PdfFile::Page &page = pdf.pages[ink.pageNumber];
+
+        const int inkObject = nextObject++;
+        QTransform inkToDisplay;
+        if (ink.strokes.isEmpty()) {
+            const int maskObject = nextObject++;
+            writeImage(maskObject, ink.alpha, QByteArray());
+            writeImage(inkObject, ink.color, " /SMask " + QByteArray::number(maskObject) + " 0 R");
+
+            // Place the cropped image where it sits on the displayed page (image y runs downwards)
+            const double u0 = double(ink.crop.left()) / ink.imageSize.width();
+            const double v0 = 1.0 - double(ink.crop.bottom() + 1) / ink.imageSize.height();
+            inkToDisplay = QTransform(double(ink.crop.width()) / ink.imageSize.width(), 0,
+                                      0, double(ink.crop.height()) / ink.imageSize.height(), u0, v0);
+        } else {
+            // The form's own resources keep its alpha states clear of the page's names
+            const QByteArray formResources = ink.extGStates.isEmpty()
+                ? QByteArray() : " /Resources << /ExtGState " + ink.extGStates + " >>";
+            beginObject(inkObject, 0);
+            update += "<< /Type /XObject /Subtype /Form /BBox [0 0 " + QByteArray::number(ink.imageSize.width()) + " " +
+                      QByteArray::number(ink.imageSize.height()) + "]" + formResources +
+                      " /Filter /FlateDecode /Length " + QByteArray::number(ink.strokes.size()) + " >>\nstream\n" +
+                      ink.strokes + "\nendstream\nendobj\n";
+
+            // Stroke coordinates are page image pixels, y running downwards
+            inkToDisplay = QTransform(1.0 / ink.imageSize.width(), 0, 0, -1.0 / ink.imageSize.height(), 0, 1);
+        }
+        const int contentObject = nextObject++;
+
+        // Resources: the page's own or inherited ones, with the ink XObject added
+        PdfObject resources = pdf.resolve(page.resources);
+        if (!resources.isDictionary()) {
+            resources = PdfObject();
+            resources.type = PdfObject::Dictionary;
+        }
+        PdfObject xobjects = resources.value("XObject") ? pdf.resolve(*resources.value("XObject")) : PdfObject();
+        if (!xobjects.isDictionary()) {
+            xobjects = PdfObject();
+            xobjects.type = PdfObject::Dictionary;
+        }
+        QByteArray inkName = "SpeedyNoteInk";
+        for (int suffix = 1; xobjects.value(inkName); ++suffix) {
+            inkName = "SpeedyNoteInk" + QByteArray::number(suffix);
+        }
+        xobjects.setValue(inkName, PdfObject::reference(inkObject));
+        resources.setValue("XObject", xobjects);
+
+        const QTransform m = inkToDisplay * displayToUserSpace(page.box, page.rotate);
+        const QByteArray overlay = "Q\nq " + pdfNumber(m.m11()) + " " + pdfNumber(m.m12()) + " " +
+                                   pdfNumber(m.m21()) + " " + pdfNumber(m.m22()) + " " +
+                                   pdfNumber(m.dx()) + " " + pdfNumber(m.dy()) + " cm /" + inkName + " Do Q\n";
+        writeStream(contentObject, emptyDict, overlay);
+
+        // Contents: [save state, original content..., ink]
+        PdfObject contents;
+        contents.type = PdfObject::Array;
+        contents.items.append(PdfObject::reference(saveStateObject));
+        if (const PdfObject *existing = page.dict.value("Contents")) {
+            const PdfObject target = existing->type == PdfObject::Reference ? pdf.resolve(*existing) : *existing;
+            if (target.type == PdfObject::Array) {
+                contents.items.append(target.items);
+            } else if (existing->type == PdfObject::Reference) {
+                contents.items.append(*existing); // A stream
+            }
+        }
+        contents.items.append(PdfObject::reference(contentObject));
+
+        PdfObject pageDict = page.dict;
+        pageDict.setValue("Resources", resources);
+        pageDict.setValue("Contents", contents);
+        beginObject(page.objNum, page.genNum);
+        update += pageDict.serialize() + "\nendobj\n";
+        ++overlaidPages;
+    }
+
+    if (overlaidPages == 0) {
+        return fail(QObject::tr("No ink to add."));
+    }
+
+    // Cross-reference section for the new objects, in the same form as the original's newest one
+    std::sort(offsets.begin(), offsets.end(), [](const WrittenObject &a, const WrittenObject &b) {
+        return a.num < b.num;
+    });
+    const qint64 xrefOffset = original.size() + update.size();
+
+    PdfObject newTrailer;
+    newTrailer.type = PdfObject::Dictionary;
+    newTrailer.setValue("Root", *pdf.trailer.value("Root"));
+    if (const PdfObject *info = pdf.trailer.value("Info")) newTrailer.setValue("Info", *info);
+    if (const PdfObject *id = pdf.trailer.value("ID")) newTrailer.setValue("ID", *id);
+    newTrailer.setValue("Prev", PdfObject::number(pdf.startXref));
+
+    if (pdf.xrefIsStream) {
+        const int xrefObject = nextObject++;
+        offsets.append({xrefObject, xrefOffset, 0});
+
+        QByteArray rows;
+        PdfObject index;
+        index.type = PdfObject::Array;
+        for (int i = 0; i < offsets.size();) {
+            int run = 1;
+            while (i + run < offsets.size() && offsets[i + run].num == offsets[i].num + run) ++run;
+            index.items.append(PdfObject::number(offsets[i].num));
+            index.items.append(PdfObject::number(run));
+            for (int r = 0; r < run; ++r) {
+                char row[11];
+                row[0] = 1;
+                qToBigEndian<quint64>(quint64(offsets[i + r].offset), row + 1);
+                qToBigEndian<quint16>(quint16(offsets[i + r].generation), row + 9);
+                rows.append(row, sizeof(row));
+            }
+            i += run;
+        }
+
+        PdfObject xrefDict = newTrailer;
+        xrefDict.setValue("Type", PdfObject::name("XRef"));
+        xrefDict.setValue("Size", PdfObject::number(nextObject));
+        PdfObject widths;
+        widths.type = PdfObject::Array;
+        widths.items << PdfObject::number(1) << PdfObject::number(8) << PdfObject::number(2);
+        xrefDict.setValue("W", widths);
+        xrefDict.setValue("Index", index);
+        writeStream(xrefObject, xrefDict, rows);
+    } else {
+        update += "xref\n";
+        for (int i = 0; i < offsets.size();) {
+            int run = 1;
+            while (i + run < offsets.size() && offsets[i + run].num == offsets[i].num + run) ++run;
+            update += QByteArray::number(offsets[i].num) + " " + QByteArray::number(run) + "\n";
+            for (int r = 0; r < run; ++r) {
+                update += QByteArray::number(offsets[i + r].offset).rightJustified(10, '0') + " " +
+                          QByteArray::number(offsets[i + r].generation).rightJustified(5, '0') + " n\r\n";
+            }
+            i += run;
+        }
+        newTrailer.setValue("Size", PdfObject::number(nextObject));
+        update += "trailer\n" + newTrailer.serialize() + "\n";
+    }
+    update += "startxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n";
+
+    QSaveFile output(outputPdf);
+    if (!output.open(QIODevice::WriteOnly) ||
+        output.write(original) != original.size() ||
+        output.write(update) != update.size() ||
+        !output.commit()) {
+        return fail(QObject::tr("Failed to write PDF file: %1").arg(outputPdf));
+    }
+    return true;
+}
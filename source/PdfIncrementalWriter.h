@@ -0,0 +1,34 @@
+#ifndef PDFINCREMENTALWRITER_H
+#define PDFINCREMENTALWRITER_H
+
+#include <QString>
+#include <QList>
+#include "PdfExportRenderer.h"
+
+// Writes annotated PDFs as an incremental update of the original file.
+//
+// The original PDF is copied byte for byte and one update section is appended:
+// for every annotated page an XObject with its ink, a content stream that draws
+// it over the page, and a new revision of the page object referencing both.
+// Pages with recorded strokes get a form XObject of stroke paths; the others an
+// image of their ink PNG (encoded per the export profile plus an alpha soft
+// mask, cropped to the ink's bounding box).
+// Unannotated pages, text, fonts and the outline are never touched, so the
+// work scales with the number of annotated pages only.
+//
+// Encrypted PDFs and whatever the minimal parser doesn't understand are
+// rejected with an error; callers fall back to re-rendering.
+class PdfIncrementalWriter
+{
+public:
+    // Overlay the ink of the given 0-based pages onto originalPdf. Strokes and
+    // ink images (rendered at inkDpi) are encoded on `jobs` threads (0 = all
+    // cores); progress counts encoded pages and timings get each page's encode time.
+    static bool writeInkOverlays(const QString &originalPdf, const QString &outputPdf,
+                                 const QString &saveFolder, const QString &notebookId, const QList<int> &pages,
+                                 const PdfExportProfile &profile = PdfExportProfile(), int inkDpi = 192,
+                                 PdfExportRenderer::Progress *progress = nullptr, QString *errorMsg = nullptr,
+                                 QList<PdfExportRenderer::PageTiming> *timings = nullptr, int jobs = 0);
+};
+
+#endif // PDFINCREMENTALWRITER_H
@@ -1,5 +1,6 @@
 #include "PdfOpenDialog.h"
 #include "SpnPackageManager.h"
+#include "SpnPackageReader.h"
 #include <QFileDialog>
 #include <QDir>
 #include <QMessageBox>
@@ -9,6 +10,8 @@
 #include <QGuiApplication>
 #include <QFile>
 #include <QTextStream>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 PdfOpenDialog::PdfOpenDialog(const QString &pdfPath, QWidget *parent)
     : QDialog(parent), result(Cancel), pdfPath(pdfPath)
@@ -367,15 +370,9 @@ bool PdfOpenDialog::hasValidNotebookFolder(const QString &pdfPath, QString &fold
     
     // First, check for .spn package
     QString potentialSpnPath = pdfDir + "/" + suggestedName + ".spn";
-    if (SpnPackageManager::isValidSpnPackage(potentialSpnPath)) {
-        // Extract to temp and check if it's valid for this PDF
-        QString tempDir = SpnPackageManager::extractSpnToTemp(potentialSpnPath);
-        if (!tempDir.isEmpty() && isValidNotebookFolder(tempDir, pdfPath)) {
-            SpnPackageManager::cleanupTempDir(tempDir);
-            folderPath = potentialSpnPath; // Return the .spn package path
-            return true;
-        }
-        SpnPackageManager::cleanupTempDir(tempDir);
+    if (QFileInfo(potentialSpnPath).isFile() && isValidSpnPackageForPdf(potentialSpnPath, pdfPath)) {
+        folderPath = potentialSpnPath; // Return the .spn package path
+        return true;
     }
     
     // Then, check for regular folder
@@ -388,6 +385,39 @@ bool PdfOpenDialog::hasValidNotebookFolder(const QString &pdfPath, QString &fold
     return false;
 }
 
+// Whether a .spn package is linked to the exact same PDF
+bool PdfOpenDialog::isValidSpnPackageForPdf(const QString &spnPath, const QString &pdfPath)
+{
+    // ✅ Read the PDF path from the package summary (one read), falling back to the
+    // metadata entry for packages without one - the package is never extracted
+    QString storedPdfPath;
+    SpnPackageSummary summary;
+    if (SpnPackageReader::readSummary(spnPath, summary)) {
+        storedPdfPath = summary.pdfPath;
+    } else {
+        SpnPackageReader reader(spnPath);
+        if (!reader.isOpen()) {
+            return false;
+        }
+        bool ok = false;
+        QByteArray metadata = reader.read(".speedynote_metadata.json", &ok);
+        if (ok) {
+            storedPdfPath = QJsonDocument::fromJson(metadata).object()["pdf_path"].toString();
+        }
+        if (storedPdfPath.isEmpty()) {
+            storedPdfPath = QString::fromUtf8(reader.read(".pdf_path.txt")).section('\n', 0, 0).trimmed();
+        }
+    }
+    
+    if (storedPdfPath.isEmpty()) {
+        return false;
+    }
+    
+    QFileInfo currentPdf(pdfPath);
+    QFileInfo storedPdf(storedPdfPath);
+    return storedPdf.exists() && currentPdf.absoluteFilePath() == storedPdf.absoluteFilePath();
+}
+
 // Static method to validate if a folder is a valid SpeedyNote notebook folder for the given PDF
 // Returns true only if the folder exists, contains SpeedyNote data, and is linked to the exact same PDF
 bool PdfOpenDialog::isValidNotebookFolder(const QString &folderPath, const QString &pdfPath)
@@ -42,6 +42,7 @@ private slots:
 private:
     void setupUI();
     static bool isValidNotebookFolder(const QString &folderPath, const QString &pdfPath);
+    static bool isValidSpnPackageForPdf(const QString &spnPath, const QString &pdfPath);
 
     Result result;
     QString selectedFolder;
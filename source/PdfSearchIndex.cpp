@@ -0,0 +1,394 @@
+#include "PdfSearchIndex.h"
+#include "PdfFileMapping.h"
+#include "PdfTextLayout.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QThread>
+#include <QMetaObject>
+#include <QDebug>
+#include <algorithm>
+
+const QString PdfSearchIndex::INDEX_FILE_NAME = ".speedynote_pdf_index";
+
+namespace {
+const quint32 INDEX_MAGIC = 0x53504458; // "SPDX"
+const quint32 INDEX_VERSION = 1;
+const int PAGES_PER_JOB = 8; // Pages a worker extracts before handing them to the GUI thread
+}
+
+PdfSearchIndex::PdfSearchIndex(QObject *parent)
+    : QObject(parent)
+{
+    // ✅ Indexing is background work: a few threads at the lowest priority, so
+    // rendering and the UI always win
+    workerPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+    workerPool.setThreadPriority(QThread::LowestPriority);
+}
+
+PdfSearchIndex::~PdfSearchIndex()
+{
+    stop();
+}
+
+void PdfSearchIndex::start(std::shared_ptr<PdfFileMapping> mapping, const QString &pdfPath, const QString &saveFolder, int pageCount)
+{
+    stop();
+
+    const quint64 currentGeneration = generation;
+    totalPages = qMax(0, pageCount);
+    indexedPageBits.resize(totalPages);
+    indexPath = saveFolder.isEmpty() ? QString() : saveFolder + "/" + INDEX_FILE_NAME;
+
+    QFileInfo pdfInfo(pdfPath);
+    pdfSize = pdfInfo.size();
+    pdfModified = pdfInfo.lastModified();
+
+    // Resume from the file if it was built for this exact PDF, otherwise start a new one
+    if (!indexPath.isEmpty() && !loadIndexFile()) {
+        writeIndexHeader();
+    }
+    emit progressChanged(indexedPageCount, totalPages);
+
+    QList<int> remaining;
+    for (int page = 0; page < totalPages; ++page) {
+        if (!indexedPageBits.testBit(page)) {
+            remaining.append(page);
+        }
+    }
+    if (remaining.isEmpty()) {
+        if (totalPages > 0) {
+            emit indexingFinished();
+        }
+        return;
+    }
+    if (!mapping) {
+        qWarning() << "PdfSearchIndex: no file mapping for" << pdfPath << "- index stays incomplete";
+        return;
+    }
+
+    cancelFlag = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> cancelled = cancelFlag;
+
+    for (int first = 0; first < remaining.size(); first += PAGES_PER_JOB) {
+        const QList<int> jobPages = remaining.mid(first, PAGES_PER_JOB);
+        workerPool.start([this, mapping, cancelled, jobPages, currentGeneration]() {
+            if (cancelled->load()) {
+                return;
+            }
+
+            // ✅ Each job reads through its own document instance (Poppler documents aren't thread-safe)
+            PdfDocumentHandle handle = mapping->openDocument();
+            if (!handle || handle.get()->isLocked()) {
+                return;
+            }
+
+            QList<ExtractedPage> extracted;
+            for (int pageNumber : jobPages) {
+                if (cancelled->load()) {
+                    return;
+                }
+                std::unique_ptr<Poppler::Page> page(handle.get()->page(pageNumber));
+                extracted.append(extractPage(page.get(), pageNumber));
+            }
+
+            QMetaObject::invokeMethod(this, [this, currentGeneration, extracted]() {
+                storeIndexedPages(currentGeneration, extracted);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void PdfSearchIndex::stop()
+{
+    if (cancelFlag) {
+        cancelFlag->store(true);
+    }
+    workerPool.clear();
+    workerPool.waitForDone(); // Jobs capture this, so none may outlive the index
+    cancelFlag.reset();
+    ++generation; // Results already queued for the GUI thread are dropped
+
+    pages.clear();
+    postings.clear();
+    sortedTokens.clear();
+    postingsSorted = true;
+    indexedPageBits.clear();
+    indexedPageCount = 0;
+    totalPages = 0;
+    indexPath.clear();
+}
+
+PdfSearchIndex::ExtractedPage PdfSearchIndex::extractPage(Poppler::Page *page, int pageNumber)
+{
+    ExtractedPage extracted;
+    extracted.pageNumber = pageNumber;
+    if (page) {
+        extracted.entry.pageSize = page->pageSizeF();
+
+        const PdfTextLayout layout = PdfTextLayout::fromPage(page, pageNumber);
+        extracted.entry.wordRects.reserve(layout.size() * 4);
+        for (int word = 0; word < layout.size(); ++word) {
+            const QRectF rect = layout.rect(word);
+            extracted.entry.wordRects << float(rect.x()) << float(rect.y()) << float(rect.width()) << float(rect.height());
+
+            // A word like "e.g." or "2024-05" yields several tokens at consecutive positions
+            for (const QString &token : tokenize(layout.text(word))) {
+                extracted.tokens.append(token);
+                extracted.entry.tokenWords.append(word);
+            }
+        }
+    }
+    extracted.record = serializePage(extracted);
+    return extracted;
+}
+
+QStringList PdfSearchIndex::tokenize(QStringView text)
+{
+    QStringList tokens;
+    QString current;
+    for (QChar ch : text) {
+        if (ch.isLetterOrNumber()) {
+            current.append(ch.toCaseFolded());
+        } else if (!current.isEmpty()) {
+            tokens.append(current);
+            current.clear();
+        }
+    }
+    if (!current.isEmpty()) {
+        tokens.append(current);
+    }
+    return tokens;
+}
+
+void PdfSearchIndex::addPage(const ExtractedPage &page)
+{
+    if (page.pageNumber < 0 || page.pageNumber >= totalPages || indexedPageBits.testBit(page.pageNumber)) {
+        return;
+    }
+
+    pages.insert(page.pageNumber, page.entry);
+    for (int position = 0; position < page.tokens.size(); ++position) {
+        postings[page.tokens[position]].append(Posting{page.pageNumber, position});
+    }
+    postingsSorted = false;
+
+    indexedPageBits.setBit(page.pageNumber);
+    ++indexedPageCount;
+}
+
+void PdfSearchIndex::storeIndexedPages(quint64 resultGeneration, const QList<ExtractedPage> &extracted)
+{
+    if (resultGeneration != generation) {
+        return; // Stopped or restarted since this job was queued
+    }
+
+    for (const ExtractedPage &page : extracted) {
+        addPage(page);
+    }
+    appendToIndexFile(extracted);
+
+    emit progressChanged(indexedPageCount, totalPages);
+    if (isComplete()) {
+        emit indexingFinished();
+    }
+}
+
+QByteArray PdfSearchIndex::serializePage(const ExtractedPage &page)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << qint32(page.pageNumber) << page.entry.pageSize << page.entry.wordRects
+           << page.entry.tokenWords << page.tokens;
+    return data;
+}
+
+bool PdfSearchIndex::deserializePage(const QByteArray &record, ExtractedPage &page)
+{
+    QDataStream stream(record);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    qint32 pageNumber = -1;
+    stream >> pageNumber >> page.entry.pageSize >> page.entry.wordRects >> page.entry.tokenWords >> page.tokens;
+    page.pageNumber = pageNumber;
+
+    if (stream.status() != QDataStream::Ok || page.tokens.size() != page.entry.tokenWords.size() ||
+        page.entry.wordRects.size() % 4 != 0) {
+        return false;
+    }
+    const qint32 wordCount = qint32(page.entry.wordRects.size() / 4);
+    return std::all_of(page.entry.tokenWords.cbegin(), page.entry.tokenWords.cend(),
+                       [wordCount](qint32 word) { return word >= 0 && word < wordCount; });
+}
+
+bool PdfSearchIndex::loadIndexFile()
+{
+    QFile file(indexPath);
+    if (!file.exists() || !file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic = 0, version = 0;
+    qint64 fileSize = -1, fileModified = 0;
+    qint32 fileTotalPages = 0;
+    stream >> magic >> version >> fileSize >> fileModified >> fileTotalPages;
+    if (stream.status() != QDataStream::Ok || magic != INDEX_MAGIC || version != INDEX_VERSION ||
+        fileSize != pdfSize || fileModified != pdfModified.toMSecsSinceEpoch() || fileTotalPages != totalPages) {
+        return false; // Different PDF (or an older format): rebuild from scratch
+    }
+
+    // Records are appended as pages finish; a crash can leave a partial record at the end
+    qint64 validSize = file.pos();
+    while (!stream.atEnd()) {
+        QByteArray record;
+        stream >> record;
+        ExtractedPage page;
+        if (stream.status() != QDataStream::Ok || !deserializePage(record, page)) {
+            break;
+        }
+        addPage(page);
+        validSize = file.pos();
+    }
+
+    if (validSize < file.size()) {
+        qWarning() << "PdfSearchIndex: dropping a truncated record at the end of" << indexPath;
+        file.resize(validSize);
+    }
+    return true;
+}
+
+bool PdfSearchIndex::writeIndexHeader()
+{
+    // ✅ QSaveFile so an old index is only replaced by a complete header
+    QSaveFile file(indexPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "PdfSearchIndex: cannot write" << indexPath;
+        indexPath.clear(); // Keep indexing in memory
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << INDEX_MAGIC << INDEX_VERSION << pdfSize << qint64(pdfModified.toMSecsSinceEpoch()) << qint32(totalPages);
+    return file.commit();
+}
+
+void PdfSearchIndex::appendToIndexFile(const QList<ExtractedPage> &extracted)
+{
+    if (indexPath.isEmpty() || extracted.isEmpty()) {
+        return;
+    }
+
+    QFile file(indexPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "PdfSearchIndex: cannot append to" << indexPath;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    for (const ExtractedPage &page : extracted) {
+        stream << page.record;
+    }
+}
+
+void PdfSearchIndex::sortPostings() const
+{
+    if (postingsSorted) {
+        return;
+    }
+
+    // Jobs finish out of order, so lists may need sorting after a batch arrives
+    for (auto it = postings.begin(); it != postings.end(); ++it) {
+        if (!std::is_sorted(it->begin(), it->end())) {
+            std::sort(it->begin(), it->end());
+        }
+    }
+    sortedTokens = postings.keys();
+    std::sort(sortedTokens.begin(), sortedTokens.end());
+    postingsSorted = true;
+}
+
+QVector<PdfSearchIndex::Posting> PdfSearchIndex::postingsFor(const QString &token, bool prefix) const
+{
+    if (!prefix) {
+        return postings.value(token);
+    }
+
+    QVector<Posting> result;
+    int matchedTokens = 0;
+    for (auto it = std::lower_bound(sortedTokens.cbegin(), sortedTokens.cend(), token);
+         it != sortedTokens.cend() && it->startsWith(token); ++it) {
+        result += postings.value(*it);
+        ++matchedTokens;
+    }
+    if (matchedTokens > 1) {
+        std::sort(result.begin(), result.end());
+    }
+    return result;
+}
+
+QList<PdfSearchPageHits> PdfSearchIndex::search(const QString &query, int maxPages) const
+{
+    QList<PdfSearchPageHits> results;
+    const QStringList queryTokens = tokenize(query);
+    if (queryTokens.isEmpty()) {
+        return results;
+    }
+
+    sortPostings();
+
+    QList<QVector<Posting>> lists;
+    for (int i = 0; i < queryTokens.size(); ++i) {
+        lists.append(postingsFor(queryTokens[i], i == queryTokens.size() - 1));
+        if (lists.last().isEmpty()) {
+            return results;
+        }
+    }
+
+    // A phrase matches where token i of the query sits at position start + i on the same page
+    for (const Posting &start : std::as_const(lists.first())) {
+        bool matches = true;
+        for (int i = 1; i < lists.size() && matches; ++i) {
+            matches = std::binary_search(lists[i].cbegin(), lists[i].cend(), Posting{start.page, start.position + i});
+        }
+        if (!matches) {
+            continue;
+        }
+
+        if (results.isEmpty() || results.last().pageNumber != start.page) {
+            if (results.size() >= maxPages) {
+                break;
+            }
+            PdfSearchPageHits pageHits;
+            pageHits.pageNumber = start.page;
+            results.append(pageHits);
+        }
+
+        PdfSearchPageHits &pageHits = results.last();
+        ++pageHits.matchCount;
+        const PageEntry &entry = *pages.constFind(start.page);
+        int previousWord = -1;
+        for (int i = 0; i < queryTokens.size(); ++i) {
+            const int word = entry.tokenWords[start.position + i];
+            if (word != previousWord) {
+                const float *r = entry.wordRects.constData() + word * 4;
+                pageHits.rects.append(QRectF(r[0], r[1], r[2], r[3]));
+                previousWord = word;
+            }
+        }
+    }
+    return results;
+}
@@ -0,0 +1,124 @@
+#ifndef PDFSEARCHINDEX_H
+#define PDFSEARCHINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QRectF>
+#include <QSizeF>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QBitArray>
+#include <QThreadPool>
+#include <QDateTime>
+#include <atomic>
+#include <memory>
+#include <poppler-qt6.h>
+
+class PdfFileMapping;
+
+// All matches of a search query on one page
+struct PdfSearchPageHits {
+    int pageNumber = -1;   // 0-based
+    QList<QRectF> rects;   // One rect per matched word, PDF coordinates
+    int matchCount = 0;
+};
+
+// Full-text index of a notebook's PDF: token -> (page, position) postings plus
+// the word rects of every page, so a query never touches Poppler.
+//
+// Pages are extracted in the background by low-priority workers, each with its
+// own document instance over the shared file mapping. Finished pages are
+// appended to .speedynote_pdf_index in the save folder as they arrive, so an
+// interrupted run picks up where it stopped the next time the notebook opens.
+class PdfSearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PdfSearchIndex(QObject *parent = nullptr);
+    ~PdfSearchIndex();
+
+    // Load what is already indexed for this PDF and index the remaining pages in
+    // the background. An empty saveFolder keeps the index in memory only.
+    void start(std::shared_ptr<PdfFileMapping> mapping, const QString &pdfPath, const QString &saveFolder, int totalPages);
+
+    // Cancel the workers (waits for the page they are on) and forget the index
+    void stop();
+
+    bool isComplete() const { return totalPages > 0 && indexedPageCount == totalPages; }
+    int indexedPages() const { return indexedPageCount; }
+    int pageCount() const { return totalPages; }
+
+    // Pages matching every word of the query as a phrase, in page order. The
+    // last word also matches as a prefix, so results update while typing.
+    QList<PdfSearchPageHits> search(const QString &query, int maxPages = 500) const;
+
+    // Split text into lowercase search tokens (letters and digits)
+    static QStringList tokenize(QStringView text);
+
+    static const QString INDEX_FILE_NAME;
+
+signals:
+    void progressChanged(int indexedPages, int totalPages);
+    void indexingFinished();
+
+private:
+    struct PageEntry {
+        QSizeF pageSize;
+        QVector<float> wordRects;   // x, y, width, height per word
+        QVector<qint32> tokenWords; // Word index of each token position
+    };
+
+    // A page as produced by a worker or read back from the index file
+    struct ExtractedPage {
+        int pageNumber = -1;
+        PageEntry entry;
+        QStringList tokens;         // Token at each position
+        QByteArray record;          // Serialized form, appended to the index file
+    };
+
+    struct Posting {
+        qint32 page;
+        qint32 position;
+        bool operator<(const Posting &other) const {
+            return page != other.page ? page < other.page : position < other.position;
+        }
+        bool operator==(const Posting &other) const { return page == other.page && position == other.position; }
+    };
+
+    void addPage(const ExtractedPage &page);
+    void storeIndexedPages(quint64 generation, const QList<ExtractedPage> &extracted);
+
+    bool loadIndexFile();
+    bool writeIndexHeader();
+    void appendToIndexFile(const QList<ExtractedPage> &extracted);
+
+    static ExtractedPage extractPage(Poppler::Page *page, int pageNumber);
+    static QByteArray serializePage(const ExtractedPage &page);
+    static bool deserializePage(const QByteArray &record, ExtractedPage &page);
+
+    // Postings of a token (exact) or of every token starting with it (prefix), sorted
+    QVector<Posting> postingsFor(const QString &token, bool prefix) const;
+    void sortPostings() const;
+
+    QString indexPath;
+    qint64 pdfSize = -1;
+    QDateTime pdfModified;
+    int totalPages = 0;
+    int indexedPageCount = 0;
+    QBitArray indexedPageBits;
+
+    QHash<int, PageEntry> pages;
+    mutable QHash<QString, QVector<Posting>> postings;
+    mutable QStringList sortedTokens; // Keys of postings in order, for prefix lookups
+    mutable bool postingsSorted = true;
+
+    QThreadPool workerPool;
+    std::shared_ptr<std::atomic<bool>> cancelFlag;
+    quint64 generation = 0; // Results of an older start() are dropped
+};
+
+#endif // PDFSEARCHINDEX_H
@@ -0,0 +1,172 @@
+#include "PdfTextLayout.h"
+#include <QList>
+
+PdfTextLayout PdfTextLayout::fromPage(Poppler::Page *page, int pageNumber)
+{
+    PdfTextLayout layout;
+    if (!page) {
+        return layout;
+    }
+
+    auto textBoxes = page->textList();
+    const int count = int(textBoxes.size());
+    layout.wordRects.reserve(count * 4);
+    layout.textStarts.reserve(count);
+    layout.pageNumbers.reserve(count);
+    layout.lineIds.reserve(count);
+    layout.paragraphIds.reserve(count);
+    layout.flags.reserve(count);
+
+    int lineId = -1;
+    int paragraphId = -1;
+    QRectF lineRect;         // Extent of the line being built
+    QRectF previousLineRect; // Extent of the line before it
+    const Poppler::TextBox *previous = nullptr;
+
+    for (const auto &textBox : textBoxes) {
+        const QRectF rect = textBox->boundingBox();
+
+        // Poppler links the words of a line through nextWord()
+        if (!previous || previous->nextWord() != textBox.get()) {
+            previousLineRect = lineRect;
+            lineRect = rect;
+            ++lineId;
+
+            // A vertical gap of more than a line height (or a jump back up, e.g. a new
+            // column) starts a new paragraph
+            if (paragraphId < 0 || rect.top() - previousLineRect.bottom() > previousLineRect.height() ||
+                rect.bottom() < previousLineRect.top()) {
+                ++paragraphId;
+            }
+        } else {
+            lineRect = lineRect.united(rect);
+        }
+
+        layout.wordRects << float(rect.x()) << float(rect.y()) << float(rect.width()) << float(rect.height());
+        layout.textStarts.append(layout.textBuffer.size());
+        layout.textBuffer.append(textBox->text());
+        layout.pageNumbers.append(pageNumber);
+        layout.lineIds.append(lineId);
+        layout.paragraphIds.append(paragraphId);
+        layout.flags.append(textBox->hasSpaceAfter() ? SpaceAfter : 0);
+
+        previous = textBox.get();
+    }
+
+    layout.textBuffer.squeeze();
+    return layout;
+}
+
+void PdfTextLayout::append(const PdfTextLayout &other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    if (isEmpty()) {
+        *this = other;
+        return;
+    }
+
+    const qint32 textOffset = textBuffer.size();
+    const qint32 lineOffset = lineIds.last() + 1;
+    const qint32 paragraphOffset = paragraphIds.last() + 1;
+
+    wordRects += other.wordRects;
+    textBuffer += other.textBuffer;
+    pageNumbers += other.pageNumbers;
+    flags += other.flags;
+    for (int i = 0; i < other.size(); ++i) {
+        textStarts.append(other.textStarts[i] + textOffset);
+        lineIds.append(other.lineIds[i] + lineOffset);
+        paragraphIds.append(other.paragraphIds[i] + paragraphOffset);
+    }
+}
+
+void PdfTextLayout::clear()
+{
+    *this = PdfTextLayout();
+}
+
+QRectF PdfTextLayout::rect(int word) const
+{
+    const float *r = wordRects.constData() + word * 4;
+    return QRectF(r[0], r[1], r[2], r[3]);
+}
+
+QStringView PdfTextLayout::text(int word) const
+{
+    const qint32 start = textStarts[word];
+    const qint32 end = (word + 1 < textStarts.size()) ? textStarts[word + 1] : qint32(textBuffer.size());
+    return QStringView(textBuffer).mid(start, end - start);
+}
+
+int PdfTextLayout::pageStart(int pageNumber) const
+{
+    return int(pageNumbers.indexOf(pageNumber));
+}
+
+qsizetype PdfTextLayout::memoryUsage() const
+{
+    return sizeof(PdfTextLayout) +
+           wordRects.capacity() * qsizetype(sizeof(float)) +
+           textStarts.capacity() * qsizetype(sizeof(qint32)) +
+           textBuffer.capacity() * qsizetype(sizeof(QChar)) +
+           (pageNumbers.capacity() + lineIds.capacity() + paragraphIds.capacity()) * qsizetype(sizeof(qint32)) +
+           flags.capacity();
+}
+
+PdfPageText PdfPageText::extract(Poppler::Page *page, int pageNumber)
+{
+    PdfPageText pageText;
+    if (!page) {
+        return pageText;
+    }
+
+    pageText.pageSize = page->pageSizeF();
+    pageText.layout = PdfTextLayout::fromPage(page, pageNumber);
+
+    QList<QRectF> rects;
+    QList<int> wordIds;
+    rects.reserve(pageText.layout.size());
+    wordIds.reserve(pageText.layout.size());
+    for (int i = 0; i < pageText.layout.size(); ++i) {
+        rects.append(pageText.layout.rect(i));
+        wordIds.append(i);
+    }
+    pageText.grid.build(rects, wordIds, pageText.pageSize);
+
+    // Links: Poppler areas are normalized (0..1), store them in PDF coordinates like the text
+    QList<QRectF> linkRects;
+    QList<int> linkIds;
+    for (const auto &link : page->links()) {
+        if (link->linkType() != Poppler::Link::Goto) {
+            continue; // Add other link types as needed (URI, etc.)
+        }
+        const Poppler::LinkGoto *gotoLink = static_cast<const Poppler::LinkGoto*>(link.get());
+        if (gotoLink->destination().pageNumber() < 0) {
+            continue;
+        }
+
+        QRectF area = link->linkArea().normalized();
+        PdfPageLink pageLink;
+        pageLink.area = QRectF(area.x() * pageText.pageSize.width(), area.y() * pageText.pageSize.height(),
+                               area.width() * pageText.pageSize.width(), area.height() * pageText.pageSize.height());
+        pageLink.targetPage = gotoLink->destination().pageNumber() - 1; // Convert to 0-based
+        linkIds.append(pageText.links.size());
+        linkRects.append(pageLink.area);
+        pageText.links.append(pageLink);
+    }
+    pageText.linkGrid.build(linkRects, linkIds, pageText.pageSize);
+    return pageText;
+}
+
+const PdfPageLink *PdfPageText::linkAt(const QPointF &pdfPoint) const
+{
+    const QList<int> hits = linkGrid.at(pdfPoint);
+    return hits.isEmpty() ? nullptr : &links[hits.first()]; // First link in page order wins
+}
+
+qsizetype PdfPageText::memoryUsage() const
+{
+    return layout.memoryUsage() + links.capacity() * qsizetype(sizeof(PdfPageLink));
+}
@@ -0,0 +1,80 @@
+#ifndef PDFTEXTLAYOUT_H
+#define PDFTEXTLAYOUT_H
+
+#include <QString>
+#include <QStringView>
+#include <QRectF>
+#include <QSizeF>
+#include <QVector>
+#include <poppler-qt6.h>
+#include "TextBoxGrid.h"
+
+// Words of one or more PDF pages in a structure-of-arrays layout: float rects
+// in PDF coordinates, all text in one UTF-16 buffer, and a page, line and
+// paragraph id per word. It owns its data, so nothing points back into Poppler,
+// and a page costs a few flat arrays instead of one heap object (plus a
+// per-glyph rect list) for every word.
+class PdfTextLayout
+{
+public:
+    // Extract the words of a page in Poppler's reading order. Only touches the
+    // given page, so it can run on any thread that owns it.
+    static PdfTextLayout fromPage(Poppler::Page *page, int pageNumber);
+
+    // Append another layout (e.g. the bottom page of a combined canvas).
+    // Line and paragraph ids of the appended words are shifted to stay unique.
+    void append(const PdfTextLayout &other);
+    void clear();
+
+    int size() const { return int(pageNumbers.size()); }
+    bool isEmpty() const { return pageNumbers.isEmpty(); }
+
+    QRectF rect(int word) const;
+    QStringView text(int word) const; // Valid until the layout is modified
+    int pageNumber(int word) const { return pageNumbers[word]; }
+    int lineId(int word) const { return lineIds[word]; }
+    int paragraphId(int word) const { return paragraphIds[word]; }
+    bool hasSpaceAfter(int word) const { return flags[word] & SpaceAfter; }
+
+    // Index of the first word of a page (pages are contiguous), -1 if absent
+    int pageStart(int pageNumber) const;
+
+    // Heap bytes held by the layout (used as cache cost)
+    qsizetype memoryUsage() const;
+
+private:
+    enum WordFlag : quint8 { SpaceAfter = 0x1 };
+
+    QVector<float> wordRects;      // x, y, width, height per word
+    QVector<qint32> textStarts;    // Word i is textBuffer[textStarts[i] .. textStarts[i + 1]) (or to the end)
+    QString textBuffer;
+    QVector<qint32> pageNumbers;
+    QVector<qint32> lineIds;
+    QVector<qint32> paragraphIds;
+    QVector<quint8> flags;
+};
+
+// An internal link on a page
+struct PdfPageLink {
+    QRectF area;     // PDF coordinates
+    int targetPage;  // 0-based destination page
+};
+
+// Text and links of one page as cached by InkCanvas, each with a spatial index
+struct PdfPageText {
+    PdfTextLayout layout;
+    TextBoxGrid grid;             // Ids are word indices in layout
+    QVector<PdfPageLink> links;
+    TextBoxGrid linkGrid;         // Ids are indices into links
+    QSizeF pageSize;              // PDF page size in points
+
+    // Link under a point in PDF coordinates, nullptr if none
+    const PdfPageLink *linkAt(const QPointF &pdfPoint) const;
+
+    // Bytes held (used as cache cost)
+    qsizetype memoryUsage() const;
+
+    static PdfPageText extract(Poppler::Page *page, int pageNumber);
+};
+
+#endif // PDFTEXTLAYOUT_H
@@ -1,5 +1,8 @@
 #include "RecentNotebooksManager.h"
 #include "InkCanvas.h"
+#include "InkPageIndex.h"
+#include "SpnPackageManager.h"
+#include "SpnPackageReader.h"
 #include <QDir>
 #include <QStandardPaths>
 #include <QFileInfo>
@@ -233,88 +236,78 @@ void RecentNotebooksManager::generateAndSaveCoverPreview(const QString& folderPa
          // ✅ If canvas grab failed or was blank, try saved files
      if (!canvasGrabSuccessful) {
          // ✅ Fallback: check for saved pages using new JSON metadata system
-        QString notebookIdStr;
-        QString actualFolderPath = folderPath;
+        QImage pageImage;
         
-        // ✅ Handle .spn packages - extract to get notebook ID
         if (folderPath.endsWith(".spn", Qt::CaseInsensitive)) {
-            // For .spn files, we need to extract temporarily to read metadata
-            // This is a bit expensive but necessary for thumbnails
-            QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + 
-                             "/speedynote_thumb_" + QString::number(QDateTime::currentMSecsSinceEpoch());
-            QDir().mkpath(tempDir);
+            // ✅ .spn packages: the summary thumbnail, or the first page read straight from
+            // the package - nothing is extracted
+            SpnPackageSummary summary;
+            if (SpnPackageReader::readSummary(folderPath, summary) && !summary.thumbnail.isEmpty()) {
+                pageImage = QImage::fromData(summary.thumbnail, "JPEG");
+            } else {
+                SpnPackageReader reader(folderPath);
+                QString notebookIdStr = summary.notebookId;
+                if (notebookIdStr.isEmpty()) {
+                    notebookIdStr = readSpnMetadata(reader)["notebook_id"].toString();
+                }
+                if (notebookIdStr.isEmpty()) {
+                    notebookIdStr = QString::fromUtf8(reader.read(".notebook_id.txt")).trimmed();
+                }
+                if (!notebookIdStr.isEmpty()) {
+                    QByteArray pageData = reader.read(QString("annotated_%1_00000.png").arg(notebookIdStr));
+                    if (pageData.isEmpty()) {
+                        pageData = reader.read(QString("%1_00000.png").arg(notebookIdStr));
+                    }
+                    pageImage = QImage::fromData(pageData, "PNG");
+                }
+            }
+        } else {
+            QString notebookIdStr;
             
-            // Simple extraction for thumbnail purposes (we'll clean up after)
-            QFile spnFile(folderPath);
-            if (spnFile.open(QIODevice::ReadOnly)) {
-                QDataStream in(&spnFile);
-                
-                // Skip header
-                QString header;
-                in >> header;
-                if (header == "Contents") {
-                    int fileCount;
-                    in >> fileCount;
+            // ✅ Try new JSON metadata system first
+            QString jsonFile = folderPath + "/.speedynote_metadata.json";
+            if (QFile::exists(jsonFile)) {
+                QFile file(jsonFile);
+                if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                    QByteArray data = file.readAll();
+                    file.close();
+                    
+                    QJsonParseError error;
+                    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
                     
-                    for (int i = 0; i < fileCount; ++i) {
-                        QString fileName;
-                        QByteArray fileData;
-                        in >> fileName >> fileData;
-                        
-                        QString filePath = tempDir + "/" + fileName;
-                        QDir().mkpath(QFileInfo(filePath).absolutePath());
-                        
-                        QFile outFile(filePath);
-                        if (outFile.open(QIODevice::WriteOnly)) {
-                            outFile.write(fileData);
-                            outFile.close();
-                        }
+                    if (error.error == QJsonParseError::NoError) {
+                        QJsonObject obj = doc.object();
+                        notebookIdStr = obj["notebook_id"].toString();
                     }
                 }
-                spnFile.close();
-                actualFolderPath = tempDir;
             }
-        }
-        
-        // ✅ Try new JSON metadata system first
-        QString jsonFile = actualFolderPath + "/.speedynote_metadata.json";
-        if (QFile::exists(jsonFile)) {
-            QFile file(jsonFile);
-            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QByteArray data = file.readAll();
-                file.close();
-                
-                QJsonParseError error;
-                QJsonDocument doc = QJsonDocument::fromJson(data, &error);
-                
-                if (error.error == QJsonParseError::NoError) {
-                    QJsonObject obj = doc.object();
-                    notebookIdStr = obj["notebook_id"].toString();
+            
+            // ✅ Fallback to old system for backwards compatibility
+            if (notebookIdStr.isEmpty()) {
+                QFile idFile(folderPath + "/.notebook_id.txt");
+                if (idFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                    QTextStream in(&idFile);
+                    notebookIdStr = in.readLine().trimmed();
+                    idFile.close();
                 }
             }
-        }
-        
-        // ✅ Fallback to old system for backwards compatibility
-        if (notebookIdStr.isEmpty()) {
-            QFile idFile(actualFolderPath + "/.notebook_id.txt");
-            if (idFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QTextStream in(&idFile);
-                notebookIdStr = in.readLine().trimmed();
-                idFile.close();
+
+            QString firstPagePath, firstAnnotatedPagePath;
+            if (!notebookIdStr.isEmpty()) {
+                firstPagePath = folderPath + QString("/%1_00000.png").arg(notebookIdStr);
+                firstAnnotatedPagePath = folderPath + QString("/annotated_%1_00000.png").arg(notebookIdStr);
             }
-        }
 
-        QString firstPagePath, firstAnnotatedPagePath;
-        if (!notebookIdStr.isEmpty()) {
-            firstPagePath = actualFolderPath + QString("/%1_00000.png").arg(notebookIdStr);
-            firstAnnotatedPagePath = actualFolderPath + QString("/annotated_%1_00000.png").arg(notebookIdStr);
-        }
+            // ✅ Skip decoding a first page the ink index already knows is blank
+            InkPageBounds firstPageInk;
+            bool firstPageBlank = !notebookIdStr.isEmpty() &&
+                InkPageIndex::lookupPage(folderPath, notebookIdStr, 0, firstPageInk) && firstPageInk.isBlank();
 
-        QImage pageImage;
-        if (!firstAnnotatedPagePath.isEmpty() && QFile::exists(firstAnnotatedPagePath)) {
-            pageImage.load(firstAnnotatedPagePath);
-        } else if (!firstPagePath.isEmpty() && QFile::exists(firstPagePath)) {
-            pageImage.load(firstPagePath);
+            if (!firstAnnotatedPagePath.isEmpty() && QFile::exists(firstAnnotatedPagePath)) {
+                pageImage.load(firstAnnotatedPagePath);
+            } else if (!firstPageBlank && !firstPagePath.isEmpty() && QFile::exists(firstPagePath)) {
+                pageImage.load(firstPagePath);
+            }
         }
 
         if (!pageImage.isNull()) {
@@ -325,15 +318,15 @@ void RecentNotebooksManager::generateAndSaveCoverPreview(const QString& folderPa
             painter.setPen(Qt::white);
             painter.drawText(coverImage.rect(), Qt::AlignCenter, tr("No Page 0 Preview"));
         }
-        
-        // ✅ Clean up temporary directory if we extracted an .spn file
-        if (actualFolderPath != folderPath && actualFolderPath.contains("/speedynote_thumb_")) {
-            QDir tempDir(actualFolderPath);
-            tempDir.removeRecursively();
-        }
     }
+    painter.end();
     coverImage.save(coverFilePath, "PNG");
     
+    // ✅ Packages carry their own cover, so the launcher can show it without this cache
+    if (canvasGrabSuccessful && folderPath.endsWith(".spn", Qt::CaseInsensitive)) {
+        SpnPackageManager::setSpnThumbnail(folderPath, coverImage);
+    }
+    
     // ✅ Emit signal to notify that thumbnail was updated
     // This allows the launcher to invalidate its pixmap cache
     emit thumbnailUpdated(folderPath, coverFilePath);
@@ -355,84 +348,51 @@ QString RecentNotebooksManager::getPdfPathFromNotebook(const QString& folderPath
         return pdfPathCache.value(folderPath);
     }
     
-    QString actualFolderPath = folderPath;
-    bool needsCleanup = false;
-    
-    // ✅ Handle .spn packages - extract temporarily to read PDF path
-    if (folderPath.endsWith(".spn", Qt::CaseInsensitive)) {
-        QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + 
-                         "/speedynote_pdf_check_" + QString::number(QDateTime::currentMSecsSinceEpoch());
-        QDir().mkpath(tempDir);
-        
-        QFile spnFile(folderPath);
-        if (spnFile.open(QIODevice::ReadOnly)) {
-            QDataStream in(&spnFile);
-            QString header;
-            in >> header;
-            if (header == "Contents") {
-                int fileCount;
-                in >> fileCount;
-                
-                for (int i = 0; i < fileCount; ++i) {
-                    QString fileName;
-                    QByteArray fileData;
-                    in >> fileName >> fileData;
-                    
-                    if (fileName == ".speedynote_metadata.json") {
-                        QString filePath = tempDir + "/" + fileName;
-                        QDir().mkpath(QFileInfo(filePath).absolutePath()); // Ensure directory exists
-                        QFile outFile(filePath);
-                        if (outFile.open(QIODevice::WriteOnly)) {
-                            outFile.write(fileData);
-                            outFile.close();
-                        }
-                        break;
-                    }
-                }
-            }
-            spnFile.close();
-            actualFolderPath = tempDir;
-            needsCleanup = true;
-        }
-    }
-    
     QString pdfPath;
     
-    // ✅ Check for PDF metadata in JSON first
-    QString jsonFile = actualFolderPath + "/.speedynote_metadata.json";
-    if (QFile::exists(jsonFile)) {
-        QFile file(jsonFile);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QByteArray data = file.readAll();
-            file.close();
-            
-            QJsonParseError error;
-            QJsonDocument doc = QJsonDocument::fromJson(data, &error);
-            
-            if (error.error == QJsonParseError::NoError) {
-                QJsonObject obj = doc.object();
-                pdfPath = obj["pdf_path"].toString();
+    if (folderPath.endsWith(".spn", Qt::CaseInsensitive)) {
+        // ✅ .spn packages: the summary block, else the metadata entry - no extraction
+        SpnPackageSummary summary;
+        if (SpnPackageReader::readSummary(folderPath, summary)) {
+            pdfPath = summary.pdfPath;
+        } else {
+            SpnPackageReader reader(folderPath);
+            pdfPath = readSpnMetadata(reader)["pdf_path"].toString();
+            if (pdfPath.isEmpty()) {
+                pdfPath = QString::fromUtf8(reader.read(".pdf_path.txt")).section('\n', 0, 0).trimmed();
             }
         }
-    }
-    
-    // ✅ Fallback to old system
-    if (pdfPath.isEmpty()) {
-        QString metadataFile = actualFolderPath + "/.pdf_path.txt";
-        if (QFile::exists(metadataFile)) {
-            QFile file(metadataFile);
+    } else {
+        // ✅ Check for PDF metadata in JSON first
+        QString jsonFile = folderPath + "/.speedynote_metadata.json";
+        if (QFile::exists(jsonFile)) {
+            QFile file(jsonFile);
             if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QTextStream in(&file);
-                pdfPath = in.readLine().trimmed();
+                QByteArray data = file.readAll();
                 file.close();
+                
+                QJsonParseError error;
+                QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+                
+                if (error.error == QJsonParseError::NoError) {
+                    QJsonObject obj = doc.object();
+                    pdfPath = obj["pdf_path"].toString();
+                }
+            }
+        }
+        
+        // ✅ Fallback to old system
+        if (pdfPath.isEmpty()) {
+            QString metadataFile = folderPath + "/.pdf_path.txt";
+            if (QFile::exists(metadataFile)) {
+                QFile file(metadataFile);
+                if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                    QTextStream in(&file);
+                    pdfPath = in.readLine().trimmed();
+                    file.close();
+                }
             }
         }
-    }
-    
-    // ✅ Clean up temp directory if we extracted an .spn file
-    if (needsCleanup && actualFolderPath.contains("/speedynote_pdf_check_")) {
-        QDir tempDir(actualFolderPath);
-        tempDir.removeRecursively();
     }
     
     // Cache the result to avoid repeated expensive extraction
@@ -442,51 +402,25 @@ QString RecentNotebooksManager::getPdfPathFromNotebook(const QString& folderPath
 }
 
 QString RecentNotebooksManager::getNotebookIdFromPath(const QString& folderPath) const {
-    QString actualFolderPath = folderPath;
-    bool needsCleanup = false;
+    QString notebookId;
     
-    // ✅ Handle .spn packages - extract temporarily to read notebook ID
     if (folderPath.endsWith(".spn", Qt::CaseInsensitive)) {
-        QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + 
-                         "/speedynote_id_check_" + QString::number(QDateTime::currentMSecsSinceEpoch());
-        QDir().mkpath(tempDir);
-        
-        QFile spnFile(folderPath);
-        if (spnFile.open(QIODevice::ReadOnly)) {
-            QDataStream in(&spnFile);
-            QString header;
-            in >> header;
-            if (header == "Contents") {
-                int fileCount;
-                in >> fileCount;
-                
-                for (int i = 0; i < fileCount; ++i) {
-                    QString fileName;
-                    QByteArray fileData;
-                    in >> fileName >> fileData;
-                    
-                    if (fileName == ".speedynote_metadata.json") {
-                        QString filePath = tempDir + "/" + fileName;
-                        QDir().mkpath(QFileInfo(filePath).absolutePath()); // Ensure directory exists
-                        QFile outFile(filePath);
-                        if (outFile.open(QIODevice::WriteOnly)) {
-                            outFile.write(fileData);
-                            outFile.close();
-                        }
-                        break;
-                    }
-                }
+        // ✅ .spn packages: the summary block, else the metadata entry - no extraction
+        SpnPackageSummary summary;
+        if (SpnPackageReader::readSummary(folderPath, summary)) {
+            notebookId = summary.notebookId;
+        } else {
+            SpnPackageReader reader(folderPath);
+            notebookId = readSpnMetadata(reader)["notebook_id"].toString();
+            if (notebookId.isEmpty()) {
+                notebookId = QString::fromUtf8(reader.read(".notebook_id.txt")).section('\n', 0, 0).trimmed();
             }
-            spnFile.close();
-            actualFolderPath = tempDir;
-            needsCleanup = true;
         }
+        return notebookId;
     }
     
-    QString notebookId;
-    
     // ✅ Try new JSON metadata system first
-    QString jsonFile = actualFolderPath + "/.speedynote_metadata.json";
+    QString jsonFile = folderPath + "/.speedynote_metadata.json";
     if (QFile::exists(jsonFile)) {
         QFile file(jsonFile);
         if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
@@ -505,7 +439,7 @@ QString RecentNotebooksManager::getNotebookIdFromPath(const QString& folderPath)
     
     // ✅ Fallback to old system
     if (notebookId.isEmpty()) {
-        QFile idFile(actualFolderPath + "/.notebook_id.txt");
+        QFile idFile(folderPath + "/.notebook_id.txt");
         if (idFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
             QTextStream in(&idFile);
             notebookId = in.readLine().trimmed();
@@ -513,22 +447,15 @@ QString RecentNotebooksManager::getNotebookIdFromPath(const QString& folderPath)
         }
     }
     
-
-    
-    // ✅ Clean up temp directory if we extracted an .spn file
-    if (needsCleanup && actualFolderPath.contains("/speedynote_id_check_")) {
-        QDir tempDir(actualFolderPath);
-        if (tempDir.exists()) {
-            bool removed = tempDir.removeRecursively();
-            if (!removed) {
-                qWarning() << "Failed to clean up temporary directory:" << actualFolderPath;
-            }
-        }
-    }
-    
     return notebookId;
 }
 
+QJsonObject RecentNotebooksManager::readSpnMetadata(SpnPackageReader &reader) const {
+    bool ok = false;
+    QByteArray data = reader.read(".speedynote_metadata.json", &ok);
+    return ok ? QJsonDocument::fromJson(data).object() : QJsonObject();
+}
+
 QString RecentNotebooksManager::getNotebookDisplayName(const QString& folderPath) const {
     // Check cache first to avoid expensive operations
     if (displayNameCache.contains(folderPath)) {
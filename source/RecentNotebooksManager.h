@@ -5,8 +5,10 @@
 #include <QSettings>
 #include <QObject>
 #include <QHash>
+#include <QJsonObject>
 
 class InkCanvas; // Forward declaration
+class SpnPackageReader;
 
 class RecentNotebooksManager : public QObject {
     Q_OBJECT
@@ -42,6 +44,7 @@ private:
     QString sanitizeFolderName(const QString& folderPath) const;
     QString getPdfPathFromNotebook(const QString& folderPath) const;
     QString getNotebookIdFromPath(const QString& folderPath) const;
+    QJsonObject readSpnMetadata(SpnPackageReader &reader) const; // Metadata entry of a package, read in place
 
     QStringList recentNotebookPaths;
     QStringList starredNotebookPaths;
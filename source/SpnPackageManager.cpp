@@ -1,5 +1,7 @@
 #include "SpnPackageManager.h"
 #include "InkCanvas.h" // For BackgroundStyle enum
+#include "InkPageIndex.h"
+#include "SpnPackageReader.h"
 #include <QDir>
 #include <QFileInfo>
 #include <QStandardPaths>
@@ -20,13 +22,45 @@
 #include <QVersionNumber>
 #include <QCoreApplication>
 #include <QTextStream>
+#include <QSaveFile>
+#include <QSet>
+#include <QMutexLocker>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
 
 #ifdef Q_OS_WIN
 #include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
 #endif
 
+namespace {
+
+// Flush Qt's buffer and the OS cache, so what was written survives a crash
+bool syncToDisk(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
+
+} // namespace
+
 const QString SpnPackageManager::SPN_EXTENSION = ".spn";
 const QString SpnPackageManager::TEMP_PREFIX = "speedynote_";
+const QString SpnPackageManager::LOCK_FILE_NAME = ".inuse.lock";
+const QString SpnPackageManager::METADATA_FILE_NAME = ".speedynote_metadata.json";
+
+QMutex SpnPackageManager::syncMutex;
+QHash<QString, QHash<QString, SpnPackageManager::FileStamp>> SpnPackageManager::syncedStamps;
+QMutex SpnPackageManager::thumbnailMutex;
+QHash<QString, QByteArray> SpnPackageManager::pendingThumbnails;
 
 bool SpnPackageManager::isSpnPackage(const QString &path)
 {
@@ -61,9 +95,17 @@ QString SpnPackageManager::extractSpnToTemp(const QString &spnPath)
         QDir(tempDir).removeRecursively();
         return QString();
     }
+    InkPageIndex::forgetFolder(tempDir);
+    InkPageIndex::adoptUnpackedFolder(tempDir);
+    
+    // The folder now matches the package; later syncs only write what changes
+    {
+        QMutexLocker locker(&syncMutex);
+        syncedStamps.insert(spnPath, scanDirectory(tempDir));
+    }
     
     // ✅ Create a lock file to mark this directory as "in use" by current session
-    QString lockFilePath = tempDir + "/.inuse.lock";
+    QString lockFilePath = tempDir + "/" + LOCK_FILE_NAME;
     QFile lockFile(lockFilePath);
     if (lockFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         QTextStream out(&lockFile);
@@ -75,6 +117,22 @@ QString SpnPackageManager::extractSpnToTemp(const QString &spnPath)
     return tempDir;
 }
 
+QHash<QString, QByteArray> SpnPackageManager::readSpnFiles(const QString &spnPath,
+                                                           const std::function<bool(const QString &)> &wanted)
+{
+    QHash<QString, QByteArray> files;
+    SpnPackageReader reader(spnPath);
+    for (const SpnPackageReader::Entry &entry : reader.entries()) {
+        if (!wanted(entry.path)) continue;
+        bool ok = false;
+        QByteArray data = reader.read(entry, &ok);
+        if (ok) {
+            files.insert(entry.path, data);
+        }
+    }
+    return files;
+}
+
 bool SpnPackageManager::updateSpnFromTemp(const QString &spnPath, const QString &tempDir)
 {
     if (!QDir(tempDir).exists()) {
@@ -82,7 +140,138 @@ bool SpnPackageManager::updateSpnFromTemp(const QString &spnPath, const QString
         return false;
     }
     
-    return packDirectoryToSpn(tempDir, spnPath);
+    // One sync at a time, so appends never interleave
+    QMutexLocker locker(&syncMutex);
+    
+    const QHash<QString, FileStamp> current = scanDirectory(tempDir);
+    auto synced = syncedStamps.constFind(spnPath);
+    if (synced != syncedStamps.constEnd() && synced.value() == current) {
+        applyPendingThumbnail(spnPath);
+        return true; // Nothing changed since the last sync
+    }
+    
+    if (synced != syncedStamps.constEnd() && appendChangedEntries(spnPath, tempDir, current, synced.value())) {
+        syncedStamps.insert(spnPath, current);
+        applyPendingThumbnail(spnPath);
+        return true;
+    }
+    
+    // Files being rewritten: the save that's writing them schedules the next sync
+    if (scanDirectory(tempDir) != current) {
+        return false;
+    }
+    
+    // No sync state, an old-format package or too much dead space: rewrite it
+    QHash<QString, FileStamp> packedStamps;
+    if (!packDirectoryToSpn(tempDir, spnPath, &packedStamps)) {
+        return false;
+    }
+    syncedStamps.insert(spnPath, packedStamps);
+    applyPendingThumbnail(spnPath);
+    return true;
+}
+
+QHash<QString, SpnPackageManager::FileStamp> SpnPackageManager::scanDirectory(const QString &dirPath)
+{
+    QHash<QString, FileStamp> stamps;
+    QDir sourceDir(dirPath);
+    QDirIterator it(dirPath, QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (info.fileName() == LOCK_FILE_NAME) continue;
+        
+        FileStamp stamp;
+        stamp.size = info.size();
+        stamp.modified = info.lastModified().toMSecsSinceEpoch();
+        stamps.insert(sourceDir.relativeFilePath(info.filePath()), stamp);
+    }
+    return stamps;
+}
+
+SpnPackageManager::FileStamp SpnPackageManager::stampFile(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    return FileStamp{info.size(), info.lastModified().toMSecsSinceEpoch()};
+}
+
+bool SpnPackageManager::appendChangedEntries(const QString &spnPath, const QString &dirPath,
+                                             const QHash<QString, FileStamp> &current,
+                                             const QHash<QString, FileStamp> &synced)
+{
+    SpnPackageReader reader(spnPath);
+    if (reader.formatVersion() < 2 || reader.recovered()) {
+        return false; // A damaged tail is dropped by rewriting the package
+    }
+    
+    QStringList changed;
+    for (auto it = current.constBegin(); it != current.constEnd(); ++it) {
+        if (!reader.contains(it.key()) || synced.value(it.key()) != it.value()) {
+            changed.append(it.key());
+        }
+    }
+    
+    const QSet<QString> changedSet(changed.begin(), changed.end());
+    
+    // Entries that stay valid, and the bytes the update leaves behind
+    QList<SpnPackageReader::Entry> entries;
+    quint64 liveBytes = 0;
+    for (const SpnPackageReader::Entry &entry : reader.entries()) {
+        if (current.contains(entry.path) && !changedSet.contains(entry.path)) {
+            entries.append(entry);
+            liveBytes += entry.storedSize;
+        }
+    }
+    quint64 appendedBytes = 0; // Upper bound - compression only shrinks it
+    for (const QString &relativePath : std::as_const(changed)) {
+        appendedBytes += quint64(current.value(relativePath).size);
+    }
+    reader.close();
+    
+    QFile spnFile(spnPath);
+    const quint64 oldSize = quint64(spnFile.size());
+    const quint64 newSize = oldSize + appendedBytes;
+    if (newSize > 0 && double(newSize - liveBytes - appendedBytes) / double(newSize) > COMPACT_DEAD_RATIO) {
+        return false; // Mostly dead space - a rewrite is cheaper from here on
+    }
+    
+    if (!spnFile.open(QIODevice::ReadWrite) || !spnFile.seek(qint64(oldSize))) {
+        qWarning() << "Failed to open .spn file for update:" << spnPath;
+        return false;
+    }
+    
+    // ✅ New data, directory and trailer go after everything the current directory
+    // references, so a failed update is undone by cutting the file back
+    QDataStream stream(&spnFile);
+    stream.setVersion(QDataStream::Qt_6_0);
+    bool ok = writePackedFiles(stream, dirPath, changed, entries, nullptr);
+    quint64 directoryOffset = 0;
+    if (ok) {
+        directoryOffset = writeDirectory(stream, entries);
+        ok = stream.status() == QDataStream::Ok && syncToDisk(spnFile);
+    }
+    // ✅ The trailer goes last: until it is on disk, readers still find the previous one
+    if (ok) {
+        writeTrailer(stream, directoryOffset, quint32(entries.size()));
+        ok = stream.status() == QDataStream::Ok && syncToDisk(spnFile);
+    }
+    
+    if (!ok) {
+        qWarning() << "Failed to update .spn file:" << spnPath;
+        spnFile.resize(qint64(oldSize));
+        spnFile.close();
+        return false;
+    }
+    
+    spnFile.close();
+    
+    // Keep the summary in step with the notebook metadata
+    if (changedSet.contains(METADATA_FILE_NAME)) {
+        SpnPackageSummary previousSummary;
+        SpnPackageReader::readSummary(spnPath, previousSummary);
+        writeSummaryInPlace(spnPath, summaryFromFolder(dirPath, previousSummary.thumbnail));
+    }
+    return true;
 }
 
 bool SpnPackageManager::convertFolderToSpn(const QString &folderPath, QString &spnPath)
@@ -206,22 +395,10 @@ bool SpnPackageManager::isValidSpnPackage(const QString &spnPath)
         return false;
     }
     
-    // Try to extract to temp and check for SpeedyNote metadata
-    QString tempDir = extractSpnToTemp(spnPath);
-    if (tempDir.isEmpty()) {
-        return false;
-    }
-    
-    // Check for SpeedyNote metadata
-    QString metadataFile = tempDir + "/.speedynote_metadata.json";
-    QString oldIdFile = tempDir + "/.notebook_id.txt";
-    
-    bool isValid = QFile::exists(metadataFile) || QFile::exists(oldIdFile);
-    
-    // Clean up temp directory
-    cleanupTempDir(tempDir);
-    
-    return isValid;
+    // The entry list is enough - no need to extract anything
+    SpnPackageReader reader(spnPath);
+    return reader.isOpen() &&
+           (reader.contains(".speedynote_metadata.json") || reader.contains(".notebook_id.txt"));
 }
 
 QString SpnPackageManager::getSuggestedSpnName(const QString &pdfPath)
@@ -241,18 +418,254 @@ void SpnPackageManager::cleanupTempDir(const QString &tempDir)
 {
     if (!tempDir.isEmpty() && QDir(tempDir).exists()) {
         // ✅ Remove lock file first (if it exists)
-        QString lockFilePath = tempDir + "/.inuse.lock";
+        QString lockFilePath = tempDir + "/" + LOCK_FILE_NAME;
         if (QFile::exists(lockFilePath)) {
             QFile::remove(lockFilePath);
         }
         
         QDir(tempDir).removeRecursively();
     }
+    InkPageIndex::forgetFolder(tempDir);
+}
+
+SpnPackageManager::PackedFile SpnPackageManager::packFile(const QString &dirPath, const QString &relativePath)
+{
+    PackedFile packed;
+    packed.relativePath = relativePath;
+    
+    // Stamp taken before reading: a file changed meanwhile is picked up by the next sync
+    const QString fullPath = dirPath + "/" + relativePath;
+    const QFileInfo info(fullPath);
+    packed.stamp = stampFile(fullPath);
+    packed.compression = SpnPackageReader::compressionFor(relativePath, info.size());
+    if (packed.compression == SpnPackageReader::Stored) {
+        packed.ok = info.isFile();
+        return packed; // Streamed by the writer, never held in memory
+    }
+    
+    QFile file(fullPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to read file:" << fullPath;
+        return packed;
+    }
+    QByteArray fileData = file.readAll();
+    file.close();
+    
+    // ✅ The canvas rewrites working files while syncs run: a torn read must not be packed
+    if (stampFile(fullPath) != packed.stamp) {
+        packed.changed = true;
+        return packed;
+    }
+    
+    packed.size = quint64(fileData.size());
+    packed.checksum = SpnPackageReader::crc32c(fileData.constData(), fileData.size());
+    packed.storedData = SpnPackageReader::encode(fileData, packed.compression);
+    if (packed.storedData.size() >= fileData.size()) {
+        // Didn't shrink - not worth decoding on every read
+        packed.compression = SpnPackageReader::Stored;
+        packed.storedData = fileData;
+    }
+    packed.inMemory = true;
+    packed.ok = true;
+    return packed;
+}
+
+bool SpnPackageManager::copyFileToPackage(QFile &file, QIODevice &device, quint64 &size, quint32 &checksum)
+{
+    // ✅ Fixed-size buffer: a large picture or PDF never has to fit in memory
+    QByteArray buffer(1024 * 1024, Qt::Uninitialized);
+    size = 0;
+    checksum = 0;
+    for (;;) {
+        const qint64 chunk = file.read(buffer.data(), buffer.size());
+        if (chunk < 0) {
+            return false;
+        }
+        if (chunk == 0) {
+            break;
+        }
+        if (device.write(buffer.constData(), chunk) != chunk) {
+            return false;
+        }
+        checksum = SpnPackageReader::crc32c(buffer.constData(), chunk, checksum);
+        size += quint64(chunk);
+    }
+    return true;
 }
 
-bool SpnPackageManager::packDirectoryToSpn(const QString &dirPath, const QString &spnPath)
+bool SpnPackageManager::writePackedFiles(QDataStream &stream, const QString &dirPath, const QStringList &files,
+                                         QList<SpnPackageReader::Entry> &entries, QHash<QString, FileStamp> *stamps)
 {
+    QIODevice *device = stream.device();
+    
+    // ✅ Compressible files are read, checksummed and compressed on all cores; this
+    // thread writes the results in order and streams the stored files in between.
+    // Compressed files are capped in size, so a batch stays small.
+    const int batchSize = qMax(4, QThread::idealThreadCount() * 4);
+    for (int first = 0; first < files.size(); first += batchSize) {
+        const QStringList batch = files.mid(first, batchSize);
+        const QList<PackedFile> packedFiles = QtConcurrent::blockingMapped(batch, [dirPath](const QString &relativePath) {
+            return packFile(dirPath, relativePath);
+        });
+        
+        for (const PackedFile &packed : packedFiles) {
+            if (packed.changed) {
+                qWarning() << "File changed while packing, sync deferred:" << packed.relativePath;
+                return false;
+            }
+            if (!packed.ok) continue;
+            
+            SpnPackageReader::Entry entry;
+            entry.path = packed.relativePath;
+            entry.offset = quint64(device->pos());
+            entry.compression = packed.compression;
+            
+            if (packed.inMemory) {
+                if (stream.writeRawData(packed.storedData.constData(), packed.storedData.size()) != packed.storedData.size()) {
+                    return false;
+                }
+                entry.size = packed.size;
+                entry.checksum = packed.checksum;
+            } else {
+                QFile file(dirPath + "/" + packed.relativePath);
+                if (!file.open(QIODevice::ReadOnly)) {
+                    qWarning() << "Failed to read file:" << file.fileName();
+                    continue; // Unreadable files are left out, as before
+                }
+                if (!copyFileToPackage(file, *device, entry.size, entry.checksum)) {
+                    return false; // Half-written entry: the caller discards the package write
+                }
+                if (stampFile(file.fileName()) != packed.stamp) {
+                    qWarning() << "File changed while packing, sync deferred:" << packed.relativePath;
+                    return false;
+                }
+            }
+            entry.storedSize = quint64(device->pos()) - entry.offset;
+            entries.append(entry);
+            if (stamps) {
+                stamps->insert(packed.relativePath, packed.stamp);
+            }
+        }
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+quint64 SpnPackageManager::writeDirectory(QDataStream &stream, const QList<SpnPackageReader::Entry> &entries)
+{
+    const quint64 directoryOffset = quint64(stream.device()->pos());
+    for (const SpnPackageReader::Entry &entry : entries) {
+        stream << entry.path << entry.offset << entry.storedSize << entry.size << entry.checksum << entry.compression;
+    }
+    return directoryOffset;
+}
+
+void SpnPackageManager::writeTrailer(QDataStream &stream, quint64 directoryOffset, quint32 entryCount)
+{
+    const quint64 directorySize = quint64(stream.device()->pos()) - directoryOffset;
+    stream << directoryOffset << directorySize << entryCount << quint32(SpnPackageReader::TRAILER_MAGIC);
+}
+
+SpnPackageSummary SpnPackageManager::summaryFromFolder(const QString &dirPath, const QByteArray &thumbnail)
+{
+    SpnPackageSummary summary;
+    summary.thumbnail = thumbnail;
+    
+    QFile metaFile(dirPath + "/" + METADATA_FILE_NAME);
+    if (metaFile.open(QIODevice::ReadOnly)) {
+        QJsonObject obj = QJsonDocument::fromJson(metaFile.readAll()).object();
+        metaFile.close();
+        summary.notebookId = obj["notebook_id"].toString();
+        summary.name = obj["name"].toString();
+        summary.pdfPath = obj["pdf_path"].toString();
+        summary.lastAccessedPage = obj["last_accessed_page"].toInt();
+        summary.lastModified = obj["last_modified"].toString();
+    }
+    if (!summary.pdfPath.isEmpty()) {
+        QFileInfo pdfInfo(summary.pdfPath);
+        summary.pdfSize = pdfInfo.exists() ? pdfInfo.size() : -1;
+    }
+    return summary;
+}
+
+bool SpnPackageManager::writeSummaryInPlace(const QString &spnPath, const SpnPackageSummary &summary)
+{
+    const QByteArray block = SpnPackageReader::encodeSummaryBlock(summary);
+    if (block.isEmpty()) {
+        return false;
+    }
+    
     QFile spnFile(spnPath);
+    if (!spnFile.open(QIODevice::ReadWrite) || !spnFile.seek(SpnPackageReader::SUMMARY_OFFSET)) {
+        return false;
+    }
+    
+    // Only packages written with a summary block have room for one
+    QDataStream stream(&spnFile);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 capacity = 0;
+    stream >> magic >> capacity;
+    if (magic != SpnPackageReader::SUMMARY_MAGIC || capacity != quint32(SpnPackageReader::SUMMARY_CAPACITY) ||
+        !spnFile.seek(SpnPackageReader::SUMMARY_OFFSET)) {
+        return false;
+    }
+    
+    const bool ok = spnFile.write(block) == block.size();
+    spnFile.close();
+    return ok;
+}
+
+void SpnPackageManager::setSpnThumbnail(const QString &spnPath, const QImage &thumbnail)
+{
+    if (!isSpnPackage(spnPath) || thumbnail.isNull()) return;
+    
+    // Small JPEG; lower the quality until it fits the block
+    const QImage scaled = thumbnail.scaled(320, 240, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                                   .convertToFormat(QImage::Format_RGB32);
+    QByteArray jpeg;
+    for (int quality = 85; quality >= 40; quality -= 15) {
+        jpeg.clear();
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+        scaled.save(&buffer, "JPEG", quality);
+        if (jpeg.size() < SpnPackageReader::SUMMARY_CAPACITY / 2) break;
+    }
+    
+    {
+        QMutexLocker pendingLocker(&thumbnailMutex);
+        pendingThumbnails.insert(spnPath, jpeg);
+    }
+    
+    // ✅ Called on the GUI thread: never wait for a sync, the running one stores the thumbnail
+    if (!syncMutex.tryLock()) {
+        return;
+    }
+    applyPendingThumbnail(spnPath);
+    syncMutex.unlock();
+}
+
+void SpnPackageManager::applyPendingThumbnail(const QString &spnPath)
+{
+    QByteArray jpeg;
+    {
+        QMutexLocker pendingLocker(&thumbnailMutex);
+        if (!pendingThumbnails.contains(spnPath)) return;
+        jpeg = pendingThumbnails.take(spnPath);
+    }
+    
+    SpnPackageSummary summary;
+    if (!SpnPackageReader::readSummary(spnPath, summary)) {
+        return; // Older package without a summary block; the next full rewrite adds one
+    }
+    summary.thumbnail = jpeg;
+    writeSummaryInPlace(spnPath, summary);
+}
+
+bool SpnPackageManager::packDirectoryToSpn(const QString &dirPath, const QString &spnPath,
+                                           QHash<QString, FileStamp> *packedStamps)
+{
+    // ✅ Written next to the package and renamed over it, so a failed pack never truncates it
+    QSaveFile spnFile(spnPath);
     if (!spnFile.open(QIODevice::WriteOnly)) {
         qWarning() << "Failed to create .spn file:" << spnPath;
         return false;
@@ -262,8 +675,17 @@ bool SpnPackageManager::packDirectoryToSpn(const QString &dirPath, const QString
     stream.setVersion(QDataStream::Qt_6_0);
     
     // Write header
-    stream << QString("SPEEDYNOTE_PACKAGE");
-    stream << quint32(1); // Version
+    stream << SpnPackageReader::PACKAGE_MAGIC;
+    stream << quint32(SpnPackageReader::CURRENT_VERSION);
+    
+    // ✅ Summary block at a fixed offset; the thumbnail of the package being replaced is kept
+    SpnPackageSummary previousSummary;
+    SpnPackageReader::readSummary(spnPath, previousSummary);
+    QByteArray summaryBlock = SpnPackageReader::encodeSummaryBlock(summaryFromFolder(dirPath, previousSummary.thumbnail));
+    if (summaryBlock.isEmpty()) {
+        summaryBlock = SpnPackageReader::encodeSummaryBlock(summaryFromFolder(dirPath, QByteArray()));
+    }
+    stream.writeRawData(summaryBlock.constData(), summaryBlock.size());
     
     // Get all files in directory (including hidden files)
     QDir sourceDir(dirPath);
@@ -272,88 +694,39 @@ bool SpnPackageManager::packDirectoryToSpn(const QString &dirPath, const QString
     QStringList files;
     while (it.hasNext()) {
         QString filePath = it.next();
+        if (it.fileName() == LOCK_FILE_NAME) continue; // Session marker, not notebook data
         QString relativePath = sourceDir.relativeFilePath(filePath);
         files.append(relativePath);
     }
     
-    // Write file count
-    stream << quint32(files.size());
+    // Entry data back to back; where each one landed goes into the directory
+    QList<SpnPackageReader::Entry> entries;
+    if (!writePackedFiles(stream, dirPath, files, entries, packedStamps)) {
+        qWarning() << "Failed to write .spn file:" << spnPath;
+        return false; // QSaveFile discards the partial file
+    }
     
-    // Write each file
-    for (const QString &relativePath : files) {
-        QString fullPath = sourceDir.absoluteFilePath(relativePath);
-        QFile file(fullPath);
-        
-        if (!file.open(QIODevice::ReadOnly)) {
-            qWarning() << "Failed to read file:" << fullPath;
-            continue;
-        }
-        
-        QByteArray fileData = file.readAll();
-        file.close();
-        
-        // Write file path and data
-        stream << relativePath;
-        stream << quint64(fileData.size());
-        stream.writeRawData(fileData.constData(), fileData.size());
+    // ✅ Central directory and fixed-size trailer: readers seek to the end instead of scanning
+    writeTrailer(stream, writeDirectory(stream, entries), quint32(entries.size()));
+    
+    if (stream.status() != QDataStream::Ok || !spnFile.commit()) {
+        qWarning() << "Failed to write .spn file:" << spnPath;
+        return false;
     }
     
-    spnFile.close();
     return true;
 }
 
 bool SpnPackageManager::unpackSpnToDirectory(const QString &spnPath, const QString &dirPath)
 {
-    QFile spnFile(spnPath);
-    if (!spnFile.open(QIODevice::ReadOnly)) {
+    // Reads version 1 and version 2 packages alike
+    SpnPackageReader reader(spnPath);
+    if (!reader.isOpen()) {
         qWarning() << "Failed to open .spn file:" << spnPath;
         return false;
     }
     
-    QDataStream stream(&spnFile);
-    stream.setVersion(QDataStream::Qt_6_0);
-    
-    // Read and verify header
-    QString header;
-    quint32 version;
-    stream >> header >> version;
-    
-    if (header != "SPEEDYNOTE_PACKAGE" || version != 1) {
-        qWarning() << "Invalid .spn file format:" << spnPath;
-        return false;
-    }
-    
-    // Read file count
-    quint32 fileCount;
-    stream >> fileCount;
-    
-    // Extract each file
-    for (quint32 i = 0; i < fileCount; ++i) {
-        QString relativePath;
-        quint64 fileSize;
-        stream >> relativePath >> fileSize;
-        
-        // Create directory structure if needed
-        QString fullPath = dirPath + "/" + relativePath;
-        QFileInfo fileInfo(fullPath);
-        QDir().mkpath(fileInfo.absolutePath());
-        
-        // Read file data
-        QByteArray fileData(fileSize, 0);
-        stream.readRawData(fileData.data(), fileSize);
-        
-        // Write file
-        QFile outFile(fullPath);
-        if (outFile.open(QIODevice::WriteOnly)) {
-            outFile.write(fileData);
-            outFile.close();
-        } else {
-            qWarning() << "Failed to write file:" << fullPath;
-        }
-    }
-    
-    spnFile.close();
-    return true;
+    return reader.extractTo(dirPath);
 }
 
 QJsonObject SpnPackageManager::createSpnHeader(const QString &notebookName,
@@ -413,7 +786,7 @@ void SpnPackageManager::cleanupOrphanedTempDirs()
         QString dirPath = dirInfo.absoluteFilePath();
         
         // ✅ Check for lock file - if it exists, verify the process is still running
-        QString lockFilePath = dirPath + "/.inuse.lock";
+        QString lockFilePath = dirPath + "/" + LOCK_FILE_NAME;
         bool isInUse = false;
         
         if (QFile::exists(lockFilePath)) {
@@ -6,6 +6,13 @@
 #include <QFileInfo>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <QHash>
+#include <QByteArray>
+#include <QMutex>
+#include <QImage>
+#include <QDataStream>
+#include "SpnPackageReader.h"
+#include <functional>
 
 // Forward declaration to avoid circular includes
 enum class BackgroundStyle;
@@ -25,7 +32,14 @@ public:
     // Extract .spn package to a temporary working directory
     static QString extractSpnToTemp(const QString &spnPath);
     
-    // Update .spn package file from working directory
+    // Read selected files of a .spn package without extracting it (relative path -> contents).
+    // Only the entries the filter accepts are read (see SpnPackageReader).
+    static QHash<QString, QByteArray> readSpnFiles(const QString &spnPath,
+                                                   const std::function<bool(const QString &)> &wanted);
+    
+    // Update .spn package file from working directory. Only files changed since the
+    // last sync are appended; the package is compacted (rewritten and atomically
+    // replaced) once dead space passes COMPACT_DEAD_RATIO. Thread-safe.
     static bool updateSpnFromTemp(const QString &spnPath, const QString &tempDir);
     
     // Create a new .spn package file
@@ -35,6 +49,10 @@ public:
     static bool createSpnPackageWithBackground(const QString &spnPath, const QString &notebookName,
                                                BackgroundStyle style, const QColor &color, int density);
     
+    // Store a cover image in the package's summary block (rewritten in place).
+    // Never waits for a running sync; that sync stores the image when it's done.
+    static void setSpnThumbnail(const QString &spnPath, const QImage &thumbnail);
+    
     // Get the display name for a .spn package
     static QString getSpnDisplayName(const QString &spnPath);
     
@@ -59,9 +77,61 @@ public:
 private:
     static const QString SPN_EXTENSION;
     static const QString TEMP_PREFIX;
+    static const QString LOCK_FILE_NAME;
+    static const QString METADATA_FILE_NAME;
+    static constexpr double COMPACT_DEAD_RATIO = 0.5;
+    
+    // Size and modification time of a working-folder file when it was last synced
+    struct FileStamp {
+        qint64 size = -1;
+        qint64 modified = -1;
+        bool operator==(const FileStamp &other) const { return size == other.size && modified == other.modified; }
+        bool operator!=(const FileStamp &other) const { return !(*this == other); }
+    };
+    
+    // Per package: what its working folder looked like at the last sync (guarded by syncMutex)
+    static QMutex syncMutex;
+    static QHash<QString, QHash<QString, FileStamp>> syncedStamps;
+    
+    // Thumbnails (JPEG) waiting for the package's sync lock (guarded by thumbnailMutex)
+    static QMutex thumbnailMutex;
+    static QHash<QString, QByteArray> pendingThumbnails;
+    static void applyPendingThumbnail(const QString &spnPath); // Callers hold syncMutex
+    
+    // A working-folder file prepared for the package: compressible files are read,
+    // checksummed and compressed up front, the rest is streamed when written
+    struct PackedFile {
+        QString relativePath;
+        FileStamp stamp;          // Taken before reading
+        quint64 size = 0;
+        quint32 checksum = 0;
+        quint8 compression = 0;
+        QByteArray storedData;    // Only for compressed files; stored files are streamed
+        bool inMemory = false;
+        bool ok = false;
+        bool changed = false;     // Rewritten while it was read: the package write is abandoned
+    };
     
     // Internal helper methods
-    static bool packDirectoryToSpn(const QString &dirPath, const QString &spnPath);
+    static QHash<QString, FileStamp> scanDirectory(const QString &dirPath);
+    static FileStamp stampFile(const QString &filePath);
+    static PackedFile packFile(const QString &dirPath, const QString &relativePath);
+    static bool copyFileToPackage(QFile &file, QIODevice &device, quint64 &size, quint32 &checksum);
+    // Pack files on all cores and append them to the stream in the given order
+    static bool writePackedFiles(QDataStream &stream, const QString &dirPath, const QStringList &files,
+                                 QList<SpnPackageReader::Entry> &entries, QHash<QString, FileStamp> *stamps);
+    // Directory and trailer are written separately so an update can reach the disk before its trailer
+    static quint64 writeDirectory(QDataStream &stream, const QList<SpnPackageReader::Entry> &entries);
+    static void writeTrailer(QDataStream &stream, quint64 directoryOffset, quint32 entryCount);
+    // Summary of a working folder's metadata, keeping the given thumbnail
+    static SpnPackageSummary summaryFromFolder(const QString &dirPath, const QByteArray &thumbnail);
+    // Overwrite the summary block of a package that has one (callers hold syncMutex)
+    static bool writeSummaryInPlace(const QString &spnPath, const SpnPackageSummary &summary);
+    static bool packDirectoryToSpn(const QString &dirPath, const QString &spnPath,
+                                   QHash<QString, FileStamp> *packedStamps = nullptr);
+    static bool appendChangedEntries(const QString &spnPath, const QString &dirPath,
+                                     const QHash<QString, FileStamp> &current,
+                                     const QHash<QString, FileStamp> &synced);
     static bool unpackSpnToDirectory(const QString &spnPath, const QString &dirPath);
     static QJsonObject createSpnHeader(const QString &notebookName, 
                                        const QString &backgroundStyle = "None",
@@ -0,0 +1,522 @@
+#include "SpnPackageReader.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QtConcurrent/QtConcurrentMap>
+#include <atomic>
+
+const QString SpnPackageReader::PACKAGE_MAGIC = "SPEEDYNOTE_PACKAGE";
+
+QJsonObject SpnPackageSummary::toJson() const
+{
+    QJsonObject obj;
+    obj["notebook_id"] = notebookId;
+    if (!name.isEmpty()) obj["name"] = name;
+    obj["pdf_path"] = pdfPath;
+    obj["pdf_size"] = pdfSize;
+    obj["last_accessed_page"] = lastAccessedPage;
+    obj["last_modified"] = lastModified;
+    return obj;
+}
+
+SpnPackageSummary SpnPackageSummary::fromJson(const QJsonObject &obj)
+{
+    SpnPackageSummary summary;
+    summary.notebookId = obj["notebook_id"].toString();
+    summary.name = obj["name"].toString();
+    summary.pdfPath = obj["pdf_path"].toString();
+    summary.pdfSize = obj["pdf_size"].toInteger(-1);
+    summary.lastAccessedPage = obj["last_accessed_page"].toInt();
+    summary.lastModified = obj["last_modified"].toString();
+    return summary;
+}
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#include <cstring>
+
+namespace {
+#if !defined(__SSE4_2__) && !defined(__ARM_FEATURE_CRC32)
+// Reflected CRC-32C (Castagnoli) table for CPUs without a crc32 instruction
+struct Crc32cTable {
+    quint32 values[256];
+    Crc32cTable() {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+            }
+            values[i] = crc;
+        }
+    }
+};
+#endif
+
+const qint64 COPY_BUFFER_SIZE = 1024 * 1024;
+const qint64 TRAILER_SCAN_CHUNK = 1024 * 1024;
+}
+
+quint32 SpnPackageReader::crc32c(const char *data, qint64 size, quint32 crc)
+{
+    crc = ~crc;
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+
+#if defined(__SSE4_2__)
+    // ✅ SSE4.2 crc32 instruction (enabled for the modern x86 builds in CMakeLists)
+#if defined(__x86_64__) || defined(_M_X64)
+    quint64 crc64 = crc;
+    for (; size >= 8; size -= 8, bytes += 8) {
+        quint64 word;
+        std::memcpy(&word, bytes, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = quint32(crc64);
+#endif
+    for (; size >= 4; size -= 4, bytes += 4) {
+        quint32 word;
+        std::memcpy(&word, bytes, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; size > 0; --size, ++bytes) {
+        crc = _mm_crc32_u8(crc, *bytes);
+    }
+#elif defined(__ARM_FEATURE_CRC32)
+    // ✅ ARMv8 CRC extension
+    for (; size >= 8; size -= 8, bytes += 8) {
+        quint64 word;
+        std::memcpy(&word, bytes, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; size > 0; --size, ++bytes) {
+        crc = __crc32cb(crc, *bytes);
+    }
+#else
+    static const Crc32cTable table;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table.values[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+#endif
+
+    return ~crc;
+}
+
+bool SpnPackageReader::open(const QString &spnPath)
+{
+    close();
+
+    file.setFileName(spnPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    QString header;
+    quint32 packageVersion = 0;
+    stream >> header >> packageVersion;
+    if (stream.status() != QDataStream::Ok || header != PACKAGE_MAGIC) {
+        close();
+        return false;
+    }
+
+    bool ok = false;
+    if (packageVersion == 1) {
+        ok = readDirectoryV1();
+    } else if (packageVersion == 2) {
+        ok = readDirectoryV2();
+    }
+    if (!ok) {
+        qWarning() << "Invalid .spn file format:" << spnPath;
+        close();
+        return false;
+    }
+
+    version = int(packageVersion);
+    for (int i = 0; i < entryList.size(); ++i) {
+        indexByPath.insert(entryList[i].path, i);
+    }
+    return true;
+}
+
+void SpnPackageReader::close()
+{
+    if (file.isOpen()) {
+        file.close();
+    }
+    version = 0;
+    recoveredPackage = false;
+    entryList.clear();
+    indexByPath.clear();
+}
+
+bool SpnPackageReader::readDirectoryV1()
+{
+    // Entries follow the header back to back: path, size, data
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 fileCount = 0;
+    stream >> fileCount;
+    const quint64 packageSize = quint64(file.size());
+
+    for (quint32 i = 0; i < fileCount; ++i) {
+        Entry entry;
+        stream >> entry.path >> entry.size;
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+        entry.offset = quint64(file.pos());
+        entry.storedSize = entry.size;
+        if (entry.offset + entry.size > packageSize || !file.seek(qint64(entry.offset + entry.size))) {
+            return false;
+        }
+        entryList.append(entry);
+    }
+    return true;
+}
+
+bool SpnPackageReader::readDirectoryV2()
+{
+    const qint64 packageSize = file.size();
+    if (packageSize < TRAILER_SIZE) {
+        return false;
+    }
+    if (readDirectoryAt(packageSize - TRAILER_SIZE)) {
+        return true;
+    }
+
+    // ✅ An update cut short leaves bytes after the last complete trailer:
+    // scan back for the newest "SPND" whose directory still checks out
+    const QByteArray magicBytes("SPND", 4); // TRAILER_MAGIC as QDataStream writes it
+    qint64 chunkEnd = packageSize - 1;      // The magic at the very end was just tried
+    while (chunkEnd > TRAILER_SIZE) {
+        const qint64 chunkStart = qMax<qint64>(0, chunkEnd - TRAILER_SCAN_CHUNK);
+        if (!file.seek(chunkStart)) {
+            return false;
+        }
+        const QByteArray chunk = file.read(chunkEnd - chunkStart);
+        for (qsizetype at = chunk.lastIndexOf(magicBytes); at >= 0;
+             at = at > 0 ? chunk.lastIndexOf(magicBytes, at - 1) : -1) {
+            const qint64 trailerOffset = chunkStart + at + magicBytes.size() - TRAILER_SIZE;
+            if (trailerOffset > 0 && readDirectoryAt(trailerOffset)) {
+                qWarning() << "Recovered .spn directory from before an interrupted update:" << file.fileName();
+                recoveredPackage = true;
+                return true;
+            }
+        }
+        if (chunkStart == 0) {
+            break;
+        }
+        chunkEnd = chunkStart + magicBytes.size() - 1; // Overlap so a magic across chunks is found
+    }
+    return false;
+}
+
+bool SpnPackageReader::readDirectoryAt(qint64 trailerOffset)
+{
+    entryList.clear();
+    if (!file.seek(trailerOffset)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint64 directoryOffset = 0;
+    quint64 directorySize = 0;
+    quint32 entryCount = 0;
+    quint32 magic = 0;
+    stream >> directoryOffset >> directorySize >> entryCount >> magic;
+    if (stream.status() != QDataStream::Ok || magic != TRAILER_MAGIC ||
+        directoryOffset + directorySize != quint64(trailerOffset)) {
+        return false;
+    }
+
+    if (!file.seek(qint64(directoryOffset))) {
+        return false;
+    }
+    entryList.reserve(int(qMin<quint32>(entryCount, 1u << 20)));
+    for (quint32 i = 0; i < entryCount; ++i) {
+        Entry entry;
+        stream >> entry.path >> entry.offset >> entry.storedSize >> entry.size >> entry.checksum >> entry.compression;
+        if (stream.status() != QDataStream::Ok || entry.offset + entry.storedSize > directoryOffset) {
+            entryList.clear();
+            return false;
+        }
+        entryList.append(entry);
+    }
+    if (file.pos() != trailerOffset) {
+        entryList.clear();
+        return false;
+    }
+    return true;
+}
+
+QStringList SpnPackageReader::entryPaths() const
+{
+    QStringList paths;
+    paths.reserve(entryList.size());
+    for (const Entry &entry : entryList) {
+        paths.append(entry.path);
+    }
+    return paths;
+}
+
+const SpnPackageReader::Entry *SpnPackageReader::entry(const QString &relativePath) const
+{
+    auto it = indexByPath.constFind(relativePath);
+    return it == indexByPath.constEnd() ? nullptr : &entryList[it.value()];
+}
+
+QByteArray SpnPackageReader::read(const QString &relativePath, bool *ok)
+{
+    const Entry *found = entry(relativePath);
+    if (!found) {
+        if (ok) *ok = false;
+        return QByteArray();
+    }
+    return read(*found, ok);
+}
+
+QByteArray SpnPackageReader::read(const Entry &entry, bool *ok)
+{
+    if (ok) *ok = false;
+    if (!isOpen() || !file.seek(qint64(entry.offset))) {
+        return QByteArray();
+    }
+
+    QByteArray storedData = file.read(qint64(entry.storedSize));
+    if (quint64(storedData.size()) != entry.storedSize) {
+        return QByteArray();
+    }
+    return decode(storedData, entry, ok, version);
+}
+
+quint8 SpnPackageReader::compressionFor(const QString &relativePath, qint64 size)
+{
+    if (size > MAX_COMPRESSED_SIZE) {
+        return Stored;
+    }
+    const QString suffix = QFileInfo(relativePath).suffix().toLower();
+    static const QStringList precompressed = {"png", "jpg", "jpeg", "webp", "gif", "pdf", "spn", "zip", "gz"};
+    return precompressed.contains(suffix) ? Stored : Zlib;
+}
+
+QByteArray SpnPackageReader::encode(const QByteArray &data, quint8 compression)
+{
+    return compression == Zlib ? qCompress(data) : data;
+}
+
+QByteArray SpnPackageReader::decode(const QByteArray &storedData, const Entry &entry, bool *ok, int formatVersion)
+{
+    if (ok) *ok = false;
+
+    QByteArray data;
+    if (entry.compression == Stored) {
+        data = storedData;
+    } else if (entry.compression == Zlib) {
+        data = qUncompress(storedData);
+    } else {
+        qWarning() << "Unknown compression" << entry.compression << "for .spn entry" << entry.path;
+        return QByteArray();
+    }
+
+    if (quint64(data.size()) != entry.size ||
+        (formatVersion >= 2 && crc32c(data.constData(), data.size()) != entry.checksum)) {
+        qWarning() << "Checksum mismatch for .spn entry" << entry.path;
+        return QByteArray();
+    }
+
+    if (ok) *ok = true;
+    return data;
+}
+
+bool SpnPackageReader::readSummary(const QString &spnPath, SpnPackageSummary &summary)
+{
+    QFile spnFile(spnPath);
+    if (!spnFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // ✅ Header and summary block in one read
+    const QByteArray head = spnFile.read(SUMMARY_OFFSET + SUMMARY_BLOCK_SIZE);
+    spnFile.close();
+    if (head.size() < SUMMARY_OFFSET + 16) {
+        return false;
+    }
+
+    QDataStream stream(head);
+    stream.setVersion(QDataStream::Qt_6_0);
+    QString header;
+    quint32 packageVersion = 0;
+    quint32 magic = 0;
+    quint32 capacity = 0;
+    quint32 length = 0;
+    quint32 checksum = 0;
+    stream >> header >> packageVersion >> magic >> capacity >> length >> checksum;
+    if (header != PACKAGE_MAGIC || packageVersion < 2 || magic != SUMMARY_MAGIC ||
+        capacity != quint32(SUMMARY_CAPACITY) || length > capacity ||
+        head.size() < SUMMARY_OFFSET + 16 + int(length)) {
+        return false;
+    }
+
+    const QByteArray payload = head.mid(SUMMARY_OFFSET + 16, int(length));
+    if (crc32c(payload.constData(), payload.size()) != checksum) {
+        return false;
+    }
+
+    QDataStream payloadStream(payload);
+    payloadStream.setVersion(QDataStream::Qt_6_0);
+    QByteArray json;
+    QByteArray thumbnail;
+    payloadStream >> json >> thumbnail;
+    if (payloadStream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    summary = SpnPackageSummary::fromJson(QJsonDocument::fromJson(json).object());
+    summary.thumbnail = thumbnail;
+    return true;
+}
+
+QByteArray SpnPackageReader::encodeSummaryBlock(const SpnPackageSummary &summary)
+{
+    QByteArray payload;
+    {
+        QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+        payloadStream.setVersion(QDataStream::Qt_6_0);
+        payloadStream << QJsonDocument(summary.toJson()).toJson(QJsonDocument::Compact) << summary.thumbnail;
+    }
+    if (payload.size() > SUMMARY_CAPACITY) {
+        return QByteArray();
+    }
+
+    QByteArray block;
+    QDataStream stream(&block, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << SUMMARY_MAGIC << quint32(SUMMARY_CAPACITY) << quint32(payload.size())
+           << crc32c(payload.constData(), payload.size());
+    block.append(payload);
+    block.append(QByteArray(SUMMARY_BLOCK_SIZE - block.size(), '\0')); // Room to grow in place
+    return block;
+}
+
+bool SpnPackageReader::copyEntryTo(const Entry &entry, QIODevice &out)
+{
+    if (!isOpen()) return false;
+    if (entry.compression != Stored) {
+        bool ok = false;
+        QByteArray data = read(entry, &ok);
+        return ok && out.write(data) == data.size();
+    }
+    if (!file.seek(qint64(entry.offset))) {
+        return false;
+    }
+
+    // ✅ Fixed-size buffer: memory use doesn't depend on the entry size
+    QByteArray buffer(int(qMin<quint64>(entry.storedSize, COPY_BUFFER_SIZE)), Qt::Uninitialized);
+    quint64 remaining = entry.storedSize;
+    quint32 crc = 0;
+    while (remaining > 0) {
+        const qint64 chunk = qint64(qMin<quint64>(remaining, quint64(buffer.size())));
+        if (file.read(buffer.data(), chunk) != chunk || out.write(buffer.constData(), chunk) != chunk) {
+            return false;
+        }
+        crc = crc32c(buffer.constData(), chunk, crc);
+        remaining -= quint64(chunk);
+    }
+
+    if (version >= 2 && crc != entry.checksum) {
+        qWarning() << "Checksum mismatch for .spn entry" << entry.path << "in" << file.fileName();
+        return false;
+    }
+    return true;
+}
+
+bool SpnPackageReader::extractTo(const QString &dirPath)
+{
+    if (!isOpen()) return false;
+
+    struct PendingFile {
+        const Entry *entry;
+        QString fullPath;
+        QByteArray storedData;
+    };
+
+    // Stored entries (images, PDFs - the bulk of a package) are streamed straight
+    // into their files. Compressed entries are small by construction; they are
+    // read here and decoded and written on all cores in bounded batches.
+    const QString rootPath = QDir(dirPath).absolutePath();
+    const qint64 batchBytes = 64 * 1024 * 1024;
+    std::atomic<bool> failed(false);
+    QList<PendingFile> batch;
+    qint64 pendingBytes = 0;
+
+    auto flushBatch = [&]() {
+        QtConcurrent::blockingMap(batch, [&failed, this](PendingFile &pending) {
+            bool ok = false;
+            QByteArray data = decode(pending.storedData, *pending.entry, &ok, version);
+            pending.storedData.clear();
+            if (!ok) {
+                failed = true;
+                return;
+            }
+
+            QDir().mkpath(QFileInfo(pending.fullPath).absolutePath());
+            QFile outFile(pending.fullPath);
+            if (outFile.open(QIODevice::WriteOnly)) {
+                outFile.write(data);
+                outFile.close();
+            } else {
+                qWarning() << "Failed to write file:" << pending.fullPath;
+            }
+        });
+        batch.clear();
+        pendingBytes = 0;
+    };
+
+    for (const Entry &entry : std::as_const(entryList)) {
+        // Never write outside the target folder
+        const QString fullPath = QDir::cleanPath(rootPath + "/" + entry.path);
+        if (!fullPath.startsWith(rootPath + "/")) {
+            qWarning() << "Skipping .spn entry outside the notebook folder:" << entry.path;
+            continue;
+        }
+
+        if (entry.compression == Stored) {
+            QDir().mkpath(QFileInfo(fullPath).absolutePath());
+            QFile outFile(fullPath);
+            if (!outFile.open(QIODevice::WriteOnly)) {
+                qWarning() << "Failed to write file:" << fullPath;
+                continue;
+            }
+            if (!copyEntryTo(entry, outFile)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (!file.seek(qint64(entry.offset))) {
+            return false;
+        }
+        PendingFile pending{&entry, fullPath, file.read(qint64(entry.storedSize))};
+        if (quint64(pending.storedData.size()) != entry.storedSize) {
+            return false;
+        }
+        pendingBytes += pending.storedData.size();
+        batch.append(pending);
+
+        if (pendingBytes >= batchBytes) {
+            flushBatch();
+            if (failed) return false;
+        }
+    }
+    flushBatch();
+    return !failed;
+}
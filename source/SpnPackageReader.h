@@ -0,0 +1,119 @@
+#ifndef SPNPACKAGEREADER_H
+#define SPNPACKAGEREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QFile>
+#include <QJsonObject>
+
+// Summary kept at a fixed offset near the start of a version 2 package, so the
+// launcher and the open dialogs can describe a notebook with a single read
+struct SpnPackageSummary {
+    QString notebookId;
+    QString name;
+    QString pdfPath;
+    qint64 pdfSize = -1;       // Size of the PDF when the summary was written (-1 = none)
+    int lastAccessedPage = 0;
+    QString lastModified;      // ISO date from the notebook metadata
+    QByteArray thumbnail;      // JPEG cover image (may be empty)
+
+    QJsonObject toJson() const;
+    static SpnPackageSummary fromJson(const QJsonObject &obj);
+};
+
+// Random-access reader for .spn packages.
+//
+// Version 2 packages end with a central directory (path, offset, size,
+// checksum and compression of every entry) and a fixed-size trailer pointing
+// at it, so opening reads only the tail of the file no matter how large the
+// package is. Version 1 packages have no directory; it is rebuilt by walking
+// the entry headers and seeking over the data.
+//
+// A reader keeps its file open and is not thread-safe; use one per thread.
+class SpnPackageReader
+{
+public:
+    enum Compression : quint8 {
+        Stored = 0,
+        Zlib = 1     // qCompress() format
+    };
+
+    struct Entry {
+        QString path;            // Relative path inside the notebook folder
+        quint64 offset = 0;      // Start of the entry data in the package
+        quint64 storedSize = 0;  // Bytes in the package
+        quint64 size = 0;        // Bytes once decompressed
+        quint32 checksum = 0;    // CRC-32C of the decompressed data (version 2)
+        quint8 compression = Stored;
+    };
+
+    SpnPackageReader() = default;
+    explicit SpnPackageReader(const QString &spnPath) { open(spnPath); }
+
+    bool open(const QString &spnPath);
+    void close();
+
+    bool isOpen() const { return version != 0; }
+    int formatVersion() const { return version; }
+    // The last trailer was damaged (an interrupted update) and an earlier one was used
+    bool recovered() const { return recoveredPackage; }
+
+    const QList<Entry> &entries() const { return entryList; }
+    QStringList entryPaths() const;
+    bool contains(const QString &relativePath) const { return indexByPath.contains(relativePath); }
+    const Entry *entry(const QString &relativePath) const;
+
+    // Read one entry. Version 2 entries are checked against their checksum.
+    QByteArray read(const QString &relativePath, bool *ok = nullptr);
+    QByteArray read(const Entry &entry, bool *ok = nullptr);
+
+    // Stream an entry into a device (stored entries through a fixed-size buffer)
+    // and check its checksum on the way
+    bool copyEntryTo(const Entry &entry, QIODevice &out);
+
+    // Write every entry below dirPath. Fails on the first entry whose checksum doesn't match.
+    bool extractTo(const QString &dirPath);
+
+    static quint32 crc32c(const char *data, qint64 size, quint32 crc = 0);
+
+    // Compression for a file by content type: text and JSON shrink a lot,
+    // PNG/JPEG/PDF data is already compressed and is stored as is. Files over
+    // MAX_COMPRESSED_SIZE are always stored so they can be streamed.
+    static quint8 compressionFor(const QString &relativePath, qint64 size);
+    static QByteArray encode(const QByteArray &data, quint8 compression);
+    // Decompress and verify stored data against its entry
+    static QByteArray decode(const QByteArray &storedData, const Entry &entry, bool *ok, int formatVersion = CURRENT_VERSION);
+
+    // Read the summary block with one read of its fixed-size region. False for
+    // packages without one (version 1 and early version 2) or a damaged block.
+    static bool readSummary(const QString &spnPath, SpnPackageSummary &summary);
+    // Fixed-size block (SUMMARY_BLOCK_SIZE bytes) written right after the header.
+    // Returns an empty array if the summary doesn't fit.
+    static QByteArray encodeSummaryBlock(const SpnPackageSummary &summary);
+
+    static const QString PACKAGE_MAGIC;
+    static const quint32 CURRENT_VERSION = 2;
+    static const quint32 TRAILER_MAGIC = 0x53504E44; // "SPND"
+    static const qint64 MAX_COMPRESSED_SIZE = 16 * 1024 * 1024;
+    static const quint32 SUMMARY_MAGIC = 0x53504E53;  // "SPNS"
+    static const int SUMMARY_OFFSET = 44;             // QString PACKAGE_MAGIC (4 + 36 bytes) + quint32 version
+    static const int SUMMARY_CAPACITY = 64 * 1024;
+    static const int SUMMARY_BLOCK_SIZE = 16 + SUMMARY_CAPACITY; // magic, capacity, length, CRC-32C, payload
+    static const int TRAILER_SIZE = 24;              // quint64 dir offset, quint64 dir size, quint32 entry count, quint32 magic
+
+private:
+    bool readDirectoryV1();
+    bool readDirectoryV2();
+    bool readDirectoryAt(qint64 trailerOffset);
+
+    QFile file;
+    int version = 0;
+    bool recoveredPackage = false;
+    QList<Entry> entryList;
+    QHash<QString, int> indexByPath;
+};
+
+#endif // SPNPACKAGEREADER_H
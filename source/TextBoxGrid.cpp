@@ -0,0 +1,195 @@
+#include "TextBoxGrid.h"
+#include <QtMath>
+#include <algorithm>
+#include <limits>
+
+void TextBoxGrid::build(const QList<QRectF> &rects, const QList<int> &boxIds, const QSizeF &pageSize)
+{
+    boxRects.clear();
+    boxIdList.clear();
+    cellStart.clear();
+    cellItems.clear();
+    columns = rows = 0;
+
+    if (rects.isEmpty() || rects.size() != boxIds.size()) {
+        return;
+    }
+
+    // Cover the page plus any box that sticks out of it
+    bounds = QRectF(QPointF(0, 0), pageSize);
+    boxRects.reserve(rects.size());
+    for (const QRectF &rect : rects) {
+        QRectF box = rect.normalized();
+        boxRects.append(box);
+        bounds = bounds.isEmpty() ? box : bounds.united(box);
+    }
+    boxIdList = QVector<int>(boxIds.begin(), boxIds.end());
+    if (bounds.width() <= 0 || bounds.height() <= 0) {
+        bounds = bounds.adjusted(0, 0, 1, 1);
+    }
+
+    // Aim for a handful of boxes per cell, with cells roughly square in PDF units
+    const qreal targetCells = qMax<qreal>(1.0, boxRects.size() / 4.0);
+    columns = qBound(1, qCeil(qSqrt(targetCells * bounds.width() / bounds.height())), 128);
+    rows = qBound(1, qCeil(targetCells / columns), 128);
+    cellWidth = bounds.width() / columns;
+    cellHeight = bounds.height() / rows;
+
+    // Counting sort of box positions into cells (a box goes into every cell it overlaps)
+    cellStart.fill(0, columns * rows + 1);
+    for (const QRectF &box : std::as_const(boxRects)) {
+        for (int row = rowAt(box.top()); row <= rowAt(box.bottom()); ++row) {
+            for (int column = columnAt(box.left()); column <= columnAt(box.right()); ++column) {
+                ++cellStart[row * columns + column + 1];
+            }
+        }
+    }
+    for (int cell = 0; cell < columns * rows; ++cell) {
+        cellStart[cell + 1] += cellStart[cell];
+    }
+
+    cellItems.resize(cellStart.last());
+    QVector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (int i = 0; i < boxRects.size(); ++i) {
+        const QRectF &box = boxRects[i];
+        for (int row = rowAt(box.top()); row <= rowAt(box.bottom()); ++row) {
+            for (int column = columnAt(box.left()); column <= columnAt(box.right()); ++column) {
+                cellItems[fill[row * columns + column]++] = i;
+            }
+        }
+    }
+}
+
+int TextBoxGrid::columnAt(qreal x) const
+{
+    return qBound(0, int((x - bounds.left()) / cellWidth), columns - 1);
+}
+
+int TextBoxGrid::rowAt(qreal y) const
+{
+    return qBound(0, int((y - bounds.top()) / cellHeight), rows - 1);
+}
+
+QList<int> TextBoxGrid::query(const QRectF &rect) const
+{
+    QList<int> ids;
+    if (isEmpty()) {
+        return ids;
+    }
+
+    const QRectF area = rect.normalized();
+    const int firstColumn = columnAt(area.left()), lastColumn = columnAt(area.right());
+    const int firstRow = rowAt(area.top()), lastRow = rowAt(area.bottom());
+
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const int cell = row * columns + column;
+            for (int item = cellStart[cell]; item < cellStart[cell + 1]; ++item) {
+                const QRectF &box = boxRects[cellItems[item]];
+                if (!box.intersects(area)) continue;
+
+                // Report each box only from the first queried cell it occupies
+                if (qMax(columnAt(box.left()), firstColumn) == column && qMax(rowAt(box.top()), firstRow) == row) {
+                    ids.append(boxIdList[cellItems[item]]);
+                }
+            }
+        }
+    }
+
+    std::sort(ids.begin(), ids.end()); // Same order as a full scan of the text box list
+    return ids;
+}
+
+QList<int> TextBoxGrid::at(const QPointF &point) const
+{
+    QList<int> ids;
+    if (isEmpty()) {
+        return ids;
+    }
+
+    const int cell = rowAt(point.y()) * columns + columnAt(point.x());
+    for (int item = cellStart[cell]; item < cellStart[cell + 1]; ++item) {
+        if (boxRects[cellItems[item]].contains(point)) {
+            ids.append(boxIdList[cellItems[item]]);
+        }
+    }
+
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+qreal TextBoxGrid::score(const QRectF &box, const QPointF &point, qreal scaleX, qreal scaleY)
+{
+    if (box.contains(point)) {
+        // Inside: tiny distance, ordered by horizontal position within the box
+        return box.width() > 0 ? (point.x() - box.left()) / box.width() * 0.1 : 0.0;
+    }
+
+    qreal dx = 0;
+    qreal dy = 0;
+    if (point.x() < box.left()) {
+        dx = box.left() - point.x();
+    } else if (point.x() > box.right()) {
+        dx = point.x() - box.right();
+    }
+    if (point.y() < box.top()) {
+        dy = box.top() - point.y();
+    } else if (point.y() > box.bottom()) {
+        dy = point.y() - box.bottom();
+    }
+    dx *= scaleX;
+    dy *= scaleY;
+    return qSqrt(dx * dx + dy * dy);
+}
+
+int TextBoxGrid::nearest(const QPointF &point, qreal scaleX, qreal scaleY, qreal *distance) const
+{
+    if (isEmpty()) {
+        return -1;
+    }
+
+    scaleX = qAbs(scaleX);
+    scaleY = qAbs(scaleY);
+    const int pointColumn = columnAt(point.x());
+    const int pointRow = rowAt(point.y());
+    const qreal ringWidth = qMin(cellWidth * scaleX, cellHeight * scaleY);
+
+    int best = -1;
+    qreal bestScore = std::numeric_limits<qreal>::max();
+
+    auto visitCell = [&](int column, int row) {
+        const int cell = row * columns + column;
+        for (int item = cellStart[cell]; item < cellStart[cell + 1]; ++item) {
+            const int position = cellItems[item];
+            const qreal boxScore = score(boxRects[position], point, scaleX, scaleY);
+            // Ties go to the lower id, as in a linear scan
+            if (boxScore < bestScore || (best >= 0 && boxScore == bestScore && boxIdList[position] < boxIdList[best])) {
+                bestScore = boxScore;
+                best = position;
+            }
+        }
+    };
+
+    // Search rings of cells around the point. Boxes outside ring r are at least
+    // r cells away, so the search stops once the best score is within that.
+    const int maxRing = qMax(columns, rows);
+    for (int ring = 0; ring <= maxRing; ++ring) {
+        for (int row = pointRow - ring; row <= pointRow + ring; ++row) {
+            if (row < 0 || row >= rows) continue;
+            const bool edgeRow = qAbs(row - pointRow) == ring;
+            for (int column = pointColumn - ring; column <= pointColumn + ring; ++column) {
+                if (column < 0 || column >= columns) continue;
+                if (!edgeRow && qAbs(column - pointColumn) != ring) continue;
+                visitCell(column, row);
+            }
+        }
+        if (best >= 0 && bestScore <= ring * ringWidth) {
+            break;
+        }
+    }
+
+    if (distance) {
+        *distance = bestScore;
+    }
+    return best >= 0 ? boxIdList[best] : -1;
+}
@@ -0,0 +1,49 @@
+#ifndef TEXTBOXGRID_H
+#define TEXTBOXGRID_H
+
+#include <QRectF>
+#include <QSizeF>
+#include <QList>
+#include <QVector>
+
+// Uniform grid over the text box bounds of one PDF page (PDF coordinates).
+// Built once when a page's text boxes are cached, so selection only visits
+// the cells around the pointer instead of testing every box on the page.
+class TextBoxGrid
+{
+public:
+    // boxIds[i] is the caller's id for rects[i] (e.g. its index in the cached text box list)
+    void build(const QList<QRectF> &rects, const QList<int> &boxIds, const QSizeF &pageSize);
+
+    bool isEmpty() const { return boxRects.isEmpty(); }
+
+    // Ids of all boxes intersecting rect, each reported once
+    QList<int> query(const QRectF &rect) const;
+
+    // Ids of all boxes containing point (only the point's cell is visited)
+    QList<int> at(const QPointF &point) const;
+
+    // Id of the box closest to point, or -1 if the grid is empty. Distances are
+    // measured after scaling x by scaleX and y by scaleY so callers can compare
+    // them in their own units. A point inside a box scores below 0.1, ordered by
+    // its horizontal position within the box.
+    int nearest(const QPointF &point, qreal scaleX, qreal scaleY, qreal *distance = nullptr) const;
+
+private:
+    int columnAt(qreal x) const;
+    int rowAt(qreal y) const;
+    static qreal score(const QRectF &box, const QPointF &point, qreal scaleX, qreal scaleY);
+
+    QRectF bounds;
+    int columns = 0;
+    int rows = 0;
+    qreal cellWidth = 1.0;
+    qreal cellHeight = 1.0;
+
+    QVector<QRectF> boxRects;
+    QVector<int> boxIdList;
+    QVector<int> cellStart; // Boxes of cell c are cellItems[cellStart[c] .. cellStart[c + 1])
+    QVector<int> cellItems; // Positions in boxRects
+};
+
+#endif // TEXTBOXGRID_H